@@ -400,6 +400,7 @@ NB_MODULE(pylibremidi, m) {
       .value("KEYBOARD", libremidi::API::KEYBOARD)
       .value("NETWORK", libremidi::API::NETWORK)
       .value("RAW_IO", libremidi::API::RAW_IO)
+      .value("SHARED_MEMORY", libremidi::API::SHARED_MEMORY)
 
       .value("ALSA_RAW_UMP", libremidi::API::ALSA_RAW_UMP)
       .value("ALSA_SEQ_UMP", libremidi::API::ALSA_SEQ_UMP)
@@ -410,6 +411,7 @@ NB_MODULE(pylibremidi, m) {
       .value("JACK_UMP", libremidi::API::JACK_UMP)
       .value("PIPEWIRE_UMP", libremidi::API::PIPEWIRE_UMP)
       .value("RAW_IO_UMP", libremidi::API::RAW_IO_UMP)
+      .value("SHARED_MEMORY_UMP", libremidi::API::SHARED_MEMORY_UMP)
 
       .value("DUMMY", libremidi::API::DUMMY)
       .export_values();
@@ -542,10 +544,33 @@ NB_MODULE(pylibremidi, m) {
   nb::class_<libremidi::unspecified_configuration>(m, "UnspecifiedConfiguration");
   nb::class_<libremidi::dummy_configuration>(m, "DummyConfiguration");
 
-  nb::class_<libremidi::alsa_raw_input_configuration>(m, "AlsaRawInputConfiguration").def(nb::init<>()).def_rw("poll_period", &libremidi::alsa_raw_input_configuration::poll_period);
-  nb::class_<libremidi::alsa_raw_ump::input_configuration>(m, "AlsaRawUmpInputConfiguration").def(nb::init<>()).def_rw("poll_period", &libremidi::alsa_raw_ump::input_configuration::poll_period);
-  nb::class_<libremidi::alsa_seq::input_configuration>(m, "AlsaSeqInputConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::alsa_seq::input_configuration::client_name);
-  nb::class_<libremidi::alsa_seq_ump::input_configuration>(m, "AlsaSeqUmpInputConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::alsa_seq_ump::input_configuration::client_name);
+  nb::enum_<libremidi::thread_policy>(m, "ThreadPolicy")
+      .value("Default", libremidi::thread_policy::Default)
+      .value("Fifo", libremidi::thread_policy::Fifo)
+      .value("RoundRobin", libremidi::thread_policy::RoundRobin)
+      .export_values();
+  nb::class_<libremidi::thread_report>(m, "ThreadReport")
+      .def(nb::init<>())
+      .def_ro("policy", &libremidi::thread_report::policy)
+      .def_ro("priority", &libremidi::thread_report::priority)
+      .def_ro("affinity_applied", &libremidi::thread_report::affinity_applied)
+      .def_ro("memory_locked", &libremidi::thread_report::memory_locked)
+      .def_ro("name_applied", &libremidi::thread_report::name_applied)
+      .def_ro("error", &libremidi::thread_report::error);
+  nb::class_<libremidi::thread_configuration>(m, "ThreadConfiguration")
+      .def(nb::init<>())
+      .def_rw("policy", &libremidi::thread_configuration::policy)
+      .def_rw("priority", &libremidi::thread_configuration::priority)
+      .def_rw("cpu_affinity", &libremidi::thread_configuration::cpu_affinity)
+      .def_rw("lock_memory", &libremidi::thread_configuration::lock_memory)
+      .def_rw("stack_prefault", &libremidi::thread_configuration::stack_prefault)
+      .def_rw("name", &libremidi::thread_configuration::name)
+      .def_rw("on_started", &libremidi::thread_configuration::on_started);
+
+  nb::class_<libremidi::alsa_raw_input_configuration>(m, "AlsaRawInputConfiguration").def(nb::init<>()).def_rw("poll_period", &libremidi::alsa_raw_input_configuration::poll_period).def_rw("shared_thread", &libremidi::alsa_raw_input_configuration::shared_thread).def_rw("io_uring", &libremidi::alsa_raw_input_configuration::io_uring).def_rw("thread", &libremidi::alsa_raw_input_configuration::thread);
+  nb::class_<libremidi::alsa_raw_ump::input_configuration>(m, "AlsaRawUmpInputConfiguration").def(nb::init<>()).def_rw("poll_period", &libremidi::alsa_raw_ump::input_configuration::poll_period).def_rw("shared_thread", &libremidi::alsa_raw_ump::input_configuration::shared_thread).def_rw("thread", &libremidi::alsa_raw_ump::input_configuration::thread);
+  nb::class_<libremidi::alsa_seq::input_configuration>(m, "AlsaSeqInputConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::alsa_seq::input_configuration::client_name).def_rw("shared_client", &libremidi::alsa_seq::input_configuration::shared_client).def_rw("thread", &libremidi::alsa_seq::input_configuration::thread);
+  nb::class_<libremidi::alsa_seq_ump::input_configuration>(m, "AlsaSeqUmpInputConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::alsa_seq_ump::input_configuration::client_name).def_rw("shared_client", &libremidi::alsa_seq_ump::input_configuration::shared_client).def_rw("thread", &libremidi::alsa_seq_ump::input_configuration::thread);
   nb::class_<libremidi::coremidi_input_configuration>(m, "CoremidiInputConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::coremidi_input_configuration::client_name);
   nb::class_<libremidi::coremidi_ump::input_configuration>(m, "CoremidiUmpInputConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::coremidi_ump::input_configuration::client_name);
   nb::class_<libremidi::emscripten_input_configuration>(m, "EmscriptenInputConfiguration").def(nb::init<>());
@@ -593,12 +618,13 @@ NB_MODULE(pylibremidi, m) {
       .def(nb::init<>())
       .def_rw("write_ump", &libremidi::rawio_ump_output_configuration_python::write_ump);
 
-  nb::class_<libremidi::alsa_raw_observer_configuration>(m, "AlsaRawObserverConfiguration").def(nb::init<>());
+  nb::class_<libremidi::alsa_raw_observer_configuration>(m, "AlsaRawObserverConfiguration").def(nb::init<>()).def_rw("shared_thread", &libremidi::alsa_raw_observer_configuration::shared_thread).def_rw("thread", &libremidi::alsa_raw_observer_configuration::thread);
   nb::class_<libremidi::alsa_raw_ump::observer_configuration>(m, "AlsaRawUmpObserverConfiguration").def(nb::init<>());
-  nb::class_<libremidi::alsa_seq::observer_configuration>(m, "AlsaSeqObserverConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::alsa_seq::observer_configuration::client_name);
+  nb::class_<libremidi::alsa_seq::observer_configuration>(m, "AlsaSeqObserverConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::alsa_seq::observer_configuration::client_name).def_rw("thread", &libremidi::alsa_seq::observer_configuration::thread);
   nb::class_<libremidi::alsa_seq_ump::observer_configuration>(m, "AlsaSeqUmpObserverConfiguration")
       .def(nb::init<>())
-      .def_rw("client_name", &libremidi::alsa_seq_ump::observer_configuration::client_name);
+      .def_rw("client_name", &libremidi::alsa_seq_ump::observer_configuration::client_name)
+      .def_rw("thread", &libremidi::alsa_seq_ump::observer_configuration::thread);
   nb::class_<libremidi::coremidi_observer_configuration>(m, "CoremidiObserverConfiguration").def(nb::init<>()).def_rw("client_name", &libremidi::coremidi_observer_configuration::client_name);
   nb::class_<libremidi::coremidi_ump::observer_configuration>(m, "CoremidiUmpObserverConfiguration")
       .def(nb::init<>())
@@ -32,6 +32,11 @@ add_example(midi2_echo)
 add_example(midi2_virtual)
 add_example(rawmidiin)
 add_example(rawio)
+add_example(ump_segment_benchmark)
+
+if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+  add_example(rawio_fd_benchmark)
+endif()
 
 if(LIBREMIDI_HAS_STD_FLAT_SET AND LIBREMIDI_HAS_STD_PRINTLN)
   add_example(midi_to_pattern)
@@ -54,6 +59,8 @@ if(LIBREMIDI_HAS_ALSA)
   add_example(alsa_share)
   target_link_libraries(alsa_share PRIVATE ${ALSA_LIBRARIES})
 
+  add_example(alsa_seq_throughput)
+
   add_backend_example(midi1_in_alsa_seq)
   add_backend_example(midi1_out_alsa_seq)
 
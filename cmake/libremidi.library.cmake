@@ -40,6 +40,11 @@ if(LIBREMIDI_SLIM_MESSAGE GREATER 0)
   target_compile_definitions(libremidi ${_public} LIBREMIDI_SLIM_MESSAGE=${LIBREMIDI_SLIM_MESSAGE})
 endif()
 
+# Public: the statistics are recorded in the header-only and inline parts
+if(LIBREMIDI_STATS)
+  target_compile_definitions(libremidi ${_public} LIBREMIDI_STATS)
+endif()
+
 if(LIBREMIDI_NO_BOOST)
   target_compile_definitions(libremidi ${_public} LIBREMIDI_NO_BOOST)
   message(STATUS "libremidi: Using std::vector for libremidi::message")
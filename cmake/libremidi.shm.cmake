@@ -0,0 +1,14 @@
+if(LIBREMIDI_NO_SHM)
+  return()
+endif()
+
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Linux")
+  return()
+endif()
+
+set(LIBREMIDI_HAS_SHM 1)
+
+target_compile_definitions(libremidi
+  ${_public}
+    LIBREMIDI_SHM
+)
@@ -15,6 +15,7 @@ target_sources(libremidi PRIVATE
 
     include/libremidi/backends/alsa_seq/config.hpp
     include/libremidi/backends/alsa_seq/helpers.hpp
+    include/libremidi/backends/alsa_seq/input_dispatcher.hpp
     include/libremidi/backends/alsa_seq/midi_in.hpp
     include/libremidi/backends/alsa_seq/midi_out.hpp
     include/libremidi/backends/alsa_seq/observer.hpp
@@ -77,7 +78,10 @@ target_sources(libremidi PRIVATE
 
     include/libremidi/backends/linux/alsa.hpp
     include/libremidi/backends/linux/dylib_loader.hpp
+    include/libremidi/backends/linux/epoll_dispatcher.hpp
+    include/libremidi/backends/linux/epoll_reactor.hpp
     include/libremidi/backends/linux/helpers.hpp
+    include/libremidi/backends/linux/io_uring_reader.hpp
     include/libremidi/backends/linux/pipewire/context.hpp
     include/libremidi/backends/linux/pipewire/drm_modifiers.hpp
     include/libremidi/backends/linux/pipewire/filter.hpp
@@ -87,13 +91,24 @@ target_sources(libremidi PRIVATE
     include/libremidi/backends/linux/pipewire/stream.hpp
     include/libremidi/backends/linux/pipewire/subscription.hpp
     include/libremidi/backends/linux/pipewire/types.hpp
+    include/libremidi/backends/linux/thread.hpp
     include/libremidi/backends/linux/udev.hpp
 
+    include/libremidi/backends/net/clock_sync.hpp
     include/libremidi/backends/net/config.hpp
     include/libremidi/backends/net/helpers.hpp
     include/libremidi/backends/net/midi_in.hpp
     include/libremidi/backends/net/midi_out.hpp
+    include/libremidi/backends/net/network_midi2.hpp
+    include/libremidi/backends/net/network_midi2_in.hpp
+    include/libremidi/backends/net/network_midi2_out.hpp
     include/libremidi/backends/net/observer.hpp
+    include/libremidi/backends/net/rtpmidi.hpp
+    include/libremidi/backends/net/rtpmidi_in.hpp
+    include/libremidi/backends/net/rtpmidi_out.hpp
+    include/libremidi/backends/net/stream.hpp
+    include/libremidi/backends/net/stream_in.hpp
+    include/libremidi/backends/net/stream_out.hpp
 
     include/libremidi/backends/pipewire/config.hpp
     include/libremidi/backends/pipewire/helpers.hpp
@@ -103,6 +118,14 @@ target_sources(libremidi PRIVATE
     include/libremidi/backends/pipewire.hpp
     include/libremidi/backends/pipewire_ump.hpp
 
+    include/libremidi/backends/shm/config.hpp
+    include/libremidi/backends/shm/midi_in.hpp
+    include/libremidi/backends/shm/midi_out.hpp
+    include/libremidi/backends/shm/observer.hpp
+    include/libremidi/backends/shm/ring.hpp
+    include/libremidi/backends/shm.hpp
+    include/libremidi/backends/shm_ump.hpp
+
     include/libremidi/backends/winmidi/config.hpp
     include/libremidi/backends/winmidi/helpers.hpp
     include/libremidi/backends/winmidi/midi_in.hpp
@@ -124,6 +147,7 @@ target_sources(libremidi PRIVATE
     include/libremidi/backends/winuwp/observer.hpp
     include/libremidi/backends/winuwp.hpp
 
+    include/libremidi/detail/clock_correlator.hpp
     include/libremidi/detail/conversion.hpp
     include/libremidi/detail/memory.hpp
     include/libremidi/detail/midi_api.hpp
@@ -137,16 +161,25 @@ target_sources(libremidi PRIVATE
     include/libremidi/api.hpp
     # include/libremidi/client.cpp
     # include/libremidi/client.hpp
+    include/libremidi/clock_tracker.hpp
+    include/libremidi/coalescing.hpp
     include/libremidi/config.hpp
     include/libremidi/configurations.hpp
+    include/libremidi/coroutines.hpp
     include/libremidi/error.hpp
     include/libremidi/error_handler.hpp
     include/libremidi/input_configuration.hpp
+    include/libremidi/input_queue.hpp
+    include/libremidi/jr_timestamps.hpp
     include/libremidi/libremidi.hpp
+    include/libremidi/manual_dispatch.hpp
     include/libremidi/message.hpp
     include/libremidi/port_comparison.hpp
+    include/libremidi/port_counters.hpp
     include/libremidi/port_information.hpp
+    include/libremidi/port_stats.hpp
     include/libremidi/output_configuration.hpp
+    include/libremidi/thread_configuration.hpp
     include/libremidi/ump_events.hpp
 
     include/libremidi/reader.hpp
@@ -55,6 +55,30 @@ target_link_libraries(midi_timing_test PRIVATE libremidi Catch2::Catch2WithMain)
 add_executable(rawio_test tests/unit/rawio.cpp)
 target_link_libraries(rawio_test PRIVATE libremidi Catch2::Catch2WithMain)
 
+add_executable(input_queue_test tests/unit/input_queue.cpp)
+target_link_libraries(input_queue_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(coroutines_test tests/unit/coroutines.cpp)
+target_link_libraries(coroutines_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(manual_dispatch_test tests/unit/manual_dispatch.cpp)
+target_link_libraries(manual_dispatch_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(clock_correlator_test tests/unit/clock_correlator.cpp)
+target_link_libraries(clock_correlator_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(port_stats_test tests/unit/port_stats.cpp)
+target_link_libraries(port_stats_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(port_counters_test tests/unit/port_counters.cpp)
+target_link_libraries(port_counters_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(coalescing_test tests/unit/coalescing.cpp)
+target_link_libraries(coalescing_test PRIVATE libremidi Catch2::Catch2WithMain)
+
+add_executable(jr_timestamps_test tests/unit/jr_timestamps.cpp)
+target_link_libraries(jr_timestamps_test PRIVATE libremidi Catch2::Catch2WithMain)
+
 include(CTest)
 add_test(NAME conversion_test COMMAND conversion_test)
 add_test(NAME error_test COMMAND error_test)
@@ -67,6 +91,48 @@ add_test(NAME protocols_test COMMAND protocols_test)
 add_test(NAME midi_stream_decoder_test COMMAND midi_stream_decoder_test)
 add_test(NAME midi_timing_test COMMAND midi_timing_test)
 add_test(NAME rawio_test COMMAND rawio_test)
+add_test(NAME input_queue_test COMMAND input_queue_test)
+add_test(NAME coroutines_test COMMAND coroutines_test)
+add_test(NAME manual_dispatch_test COMMAND manual_dispatch_test)
+add_test(NAME clock_correlator_test COMMAND clock_correlator_test)
+add_test(NAME port_stats_test COMMAND port_stats_test)
+add_test(NAME port_counters_test COMMAND port_counters_test)
+add_test(NAME coalescing_test COMMAND coalescing_test)
+add_test(NAME jr_timestamps_test COMMAND jr_timestamps_test)
+
+if(LIBREMIDI_HAS_NETWORK)
+  add_executable(network_test tests/unit/network.cpp)
+  target_link_libraries(network_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME network_test COMMAND network_test)
+
+  add_executable(rtpmidi_test tests/unit/rtpmidi.cpp)
+  target_link_libraries(rtpmidi_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME rtpmidi_test COMMAND rtpmidi_test)
+
+  add_executable(network_midi2_test tests/unit/network_midi2.cpp)
+  target_link_libraries(network_midi2_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME network_midi2_test COMMAND network_midi2_test)
+
+  add_executable(network_stream_test tests/unit/network_stream.cpp)
+  target_link_libraries(network_stream_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME network_stream_test COMMAND network_stream_test)
+endif()
+
+if(LIBREMIDI_HAS_SHM)
+  add_executable(shm_test tests/unit/shm.cpp)
+  target_link_libraries(shm_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME shm_test COMMAND shm_test)
+endif()
+
+if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+  add_executable(epoll_reactor_test tests/unit/epoll_reactor.cpp)
+  target_link_libraries(epoll_reactor_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME epoll_reactor_test COMMAND epoll_reactor_test)
+
+  add_executable(thread_configuration_test tests/unit/thread_configuration.cpp)
+  target_link_libraries(thread_configuration_test PRIVATE libremidi Catch2::Catch2WithMain)
+  add_test(NAME thread_configuration_test COMMAND thread_configuration_test)
+endif()
 
 # PipeWire shared-context regression tests. Standalone programs (no Catch2):
 # each skips with exit 0 when no daemon is reachable and arms a watchdog so a
@@ -0,0 +1,85 @@
+//*****************************************//
+//  alsa_seq_throughput.cpp
+//
+//  Measures the input throughput of the ALSA sequencer back-end:
+//  an output sends bursts of messages to a virtual input, as fast as possible,
+//  and the time until the input has received all of them is reported.
+//
+//  Usage: alsa_seq_throughput [message count] [burst size]
+//
+//*****************************************//
+
+#include <libremidi/backends/alsa_seq.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+int main(int argc, const char** argv)
+{
+  using namespace std::literals;
+  const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+  const int burst = argc > 2 ? std::atoi(argv[2]) : 256;
+
+  std::atomic_int received{};
+  std::atomic_int overruns{};
+
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .on_message = [&](const libremidi::message&) { received++; },
+          .on_warning = [&](std::string_view, const libremidi::source_location&) { overruns++; },
+          .timestamps = libremidi::timestamp_mode::NoTimestamp},
+      libremidi::alsa_seq::input_configuration{.client_name = "libremidi-throughput"}};
+  if (midiin.open_virtual_port("input") != stdx::error{})
+    return 1;
+
+  libremidi::output_port target;
+  libremidi::observer obs{{.track_virtual = true}, libremidi::alsa_seq::observer_configuration{}};
+  for (auto& p : obs.get_output_ports())
+    if (p.device_name == "libremidi-throughput" && p.port_name == "input")
+      target = p;
+
+  libremidi::midi_out midiout{{}, libremidi::alsa_seq::output_configuration{}};
+  if (midiout.open_port(target) != stdx::error{})
+    return 1;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int sent = 0; sent < count;)
+  {
+    for (int i = 0; i < burst && sent < count; i++, sent++)
+      midiout.send_message(0x90, sent % 128, 64);
+
+    // Lets the input catch up between bursts, as long as nothing was lost
+    while (received < sent - 4 * burst && overruns == 0)
+      std::this_thread::yield();
+  }
+
+  // Waits until everything is received, or nothing more arrives:
+  // the messages lost in overruns never do
+  auto end = std::chrono::steady_clock::now();
+  for (int last = received; received < count;)
+  {
+    std::this_thread::sleep_for(1ms);
+    const auto now = std::chrono::steady_clock::now();
+    if (received != last)
+    {
+      last = received;
+      end = now;
+    }
+    else if (now - end > 500ms)
+    {
+      break;
+    }
+  }
+  if (received == count)
+    end = std::chrono::steady_clock::now();
+  const auto elapsed = std::chrono::duration<double>(end - start);
+
+  std::cout << "Received " << received << " / " << count << " messages in " << elapsed.count()
+            << " s: " << received / elapsed.count() << " messages/s, " << overruns
+            << " overruns\n";
+  return 0;
+}
@@ -1,31 +1,17 @@
 #include "utils.hpp"
 
+#include <libremidi/coroutines.hpp>
 #include <libremidi/libremidi.hpp>
 
 #if defined(_WIN32) && __has_include(<winrt/base.h>)
   #include <winrt/base.h>
 #endif
 
-#include <boost/asio/detached.hpp>
 #include <boost/cobalt.hpp>
 
-namespace asio = boost::asio;
-namespace cobalt = boost::cobalt;
-
-// Could go in a libremidi/cobalt.hpp helper
-namespace libremidi
-{
-struct channel
-{
-  cobalt::channel<libremidi::message>& impl;
-  void operator()(const libremidi::message& message)
-  {
-    cobalt::spawn(impl.get_executor(), task(message), asio::detached);
-  }
+#include <array>
 
-  cobalt::task<void> task(libremidi::message message) { co_await impl.write(std::move(message)); }
-};
-}
+namespace cobalt = boost::cobalt;
 
 cobalt::main co_main(int argc, char** argv)
 {
@@ -34,15 +20,18 @@ cobalt::main co_main(int argc, char** argv)
   winrt::init_apartment();
 #endif
 
-  cobalt::channel<libremidi::message> channel_impl{64};
-  libremidi::channel channel{channel_impl};
-  libremidi::midi_in midiin{{.on_message = channel}};
+  // The messages are queued by the backend, and the coroutine is resumed on the executor
+  // of cobalt once there are some: no task is spawned per message.
+  libremidi::midi_in midiin{libremidi::input_configuration{.queue_size = 1024}};
   midiin.open_port(*libremidi::midi1::in_default_port());
 
+  libremidi::coro::asio_scheduler scheduler{co_await cobalt::this_coro::executor};
+  std::array<libremidi::message, 64> messages;
   for (;;)
   {
-    auto msg = co_await channel_impl.read();
-    std::cerr << msg << "\n";
+    const std::size_t n = co_await midiin.next_batch(messages, scheduler);
+    for (std::size_t i = 0; i < n; i++)
+      std::cerr << messages[i] << "\n";
   }
   co_return 0;
 }
@@ -0,0 +1,164 @@
+//*****************************************//
+//  rawio_fd_benchmark.cpp
+//
+//  Compares the ways of reading many MIDI devices on Linux, with pipes standing in
+//  for the devices: one thread per device calling poll() then read(), as the
+//  threaded ALSA raw inputs do, the epoll thread shared by all the devices,
+//  and the io_uring reader.
+//  A writer sends a message to every device at a fixed rate; the CPU time and the
+//  context switches (i.e. the wakeups) of the readers are reported per message.
+//
+//  Usage: rawio_fd_benchmark [device count] [messages per device] [period in us]
+//
+//*****************************************//
+
+#include <libremidi/libremidi.hpp>
+
+#include <libremidi/backends/linux/helpers.hpp>
+#include <libremidi/backends/rawio/fd_input.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct usage
+{
+  double cpu_us{};
+  long switches{};
+
+  static usage get(int who)
+  {
+    rusage u{};
+    getrusage(who, &u);
+    const auto us = [](timeval t) { return t.tv_sec * 1e6 + t.tv_usec; };
+    return {us(u.ru_utime) + us(u.ru_stime), u.ru_nvcsw + u.ru_nivcsw};
+  }
+
+  usage operator-(const usage& other) const
+  {
+    return {cpu_us - other.cpu_us, switches - other.switches};
+  }
+};
+
+// The loop of the threaded ALSA raw inputs, reading a descriptor
+struct poll_reader
+{
+  poll_reader(int fd, libremidi::rawio_input_configuration::receive_callback cb)
+      : m_thread{[this, fd, cb = std::move(cb)] {
+        pollfd fds[2]{{.fd = fd, .events = POLLIN, .revents = 0}, m_termination_event};
+        for (;;)
+        {
+          if (poll(fds, 2, -1) < 0)
+            return;
+          if (m_termination_event.ready(fds[1]))
+            return;
+
+          uint8_t bytes[1024];
+          ssize_t n = 0;
+          while ((n = read(fd, bytes, sizeof(bytes))) > 0)
+            cb({bytes, static_cast<std::size_t>(n)}, 0);
+        }
+      }}
+  {
+  }
+
+  ~poll_reader()
+  {
+    m_termination_event.notify();
+    m_thread.join();
+  }
+
+  libremidi::eventfd_notifier m_termination_event{};
+  std::thread m_thread;
+};
+}
+
+int main(int argc, const char** argv)
+{
+  using namespace std::literals;
+  const int devices = argc > 1 ? std::atoi(argv[1]) : 32;
+  const int messages = argc > 2 ? std::atoi(argv[2]) : 2000;
+  const auto period = std::chrono::microseconds(argc > 3 ? std::atoi(argv[3]) : 500);
+  const int total = devices * messages;
+
+  for (std::string mode : {"poll", "epoll", "io_uring"})
+  {
+    std::vector<std::array<int, 2>> pipes(devices);
+    for (auto& p : pipes)
+      if (pipe2(p.data(), O_NONBLOCK | O_CLOEXEC) < 0)
+        return 1;
+
+    std::atomic_int received{};
+    std::vector<std::unique_ptr<poll_reader>> poll_readers;
+    std::vector<std::unique_ptr<libremidi::midi_in>> inputs;
+    for (auto& p : pipes)
+    {
+      auto api_conf = libremidi::rawio_fd_input_configuration(p[0], mode == "io_uring");
+      if (mode == "poll")
+      {
+        api_conf.set_receive_callback = [&, fd = p[0]](auto cb) {
+          poll_readers.push_back(std::make_unique<poll_reader>(fd, std::move(cb)));
+        };
+        api_conf.stop_receive = [] { };
+      }
+
+      auto in = std::make_unique<libremidi::midi_in>(
+          libremidi::input_configuration{
+              .on_message = [&](const libremidi::message&) { received++; },
+              .timestamps = libremidi::timestamp_mode::NoTimestamp},
+          std::move(api_conf));
+      if (in->open_virtual_port("bench") != stdx::error{})
+        return 1;
+      inputs.push_back(std::move(in));
+    }
+
+    // The writer is excluded from the measurement
+    usage writer;
+    const auto before = usage::get(RUSAGE_SELF);
+    std::thread{[&] {
+      const auto start_usage = usage::get(RUSAGE_THREAD);
+      auto next = std::chrono::steady_clock::now();
+      for (int i = 0; i < messages; i++)
+      {
+        for (auto& p : pipes)
+        {
+          const uint8_t msg[3]{0x90, uint8_t(i % 128), 64};
+          [[maybe_unused]] auto res = write(p[1], msg, 3);
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+      writer = usage::get(RUSAGE_THREAD) - start_usage;
+    }}.join();
+
+    for (int i = 0; i < 1000 && received < total; i++)
+      std::this_thread::sleep_for(1ms);
+    const auto readers = usage::get(RUSAGE_SELF) - before - writer;
+
+    std::cout << mode << ": " << received << " / " << total << " messages, "
+              << readers.cpu_us * 1000. / total << " ns CPU and "
+              << double(readers.switches) / total << " context switches per message\n";
+
+    poll_readers.clear();
+    inputs.clear();
+    for (auto& p : pipes)
+    {
+      close(p[0]);
+      close(p[1]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+//*****************************************//
+//  ump_segment_benchmark.cpp
+//
+//  Measures the segmentation of large UMP buffers, as read from ALSA raw UMP,
+//  JACK UMP or PipeWire UMP ports: the walk which decodes the size of each packet
+//  with cmidi2 in turn, against for_each_ump_packet which computes the sizes of a
+//  block of words at once, and the MIDI 2 input state machine which relies on it.
+//
+//  Usage: ump_segment_benchmark [words per buffer] [iterations]
+//
+//*****************************************//
+
+#include <libremidi/libremidi.hpp>
+
+#include <libremidi/detail/midi_stream_decoder.hpp>
+#include <libremidi/detail/ump_stream.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace
+{
+// A mix of MIDI 1 and MIDI 2 channel voice messages, system messages, SysEx and
+// NOOP padding
+std::vector<uint32_t> make_stream(std::size_t words)
+{
+  std::vector<uint32_t> stream;
+  stream.reserve(words + 4);
+  std::mt19937 rng{42};
+  while (stream.size() < words)
+  {
+    switch (rng() % 8)
+    {
+      case 0:
+        stream.push_back(0);
+        break;
+      case 1:
+        stream.push_back(0x10F80000);
+        break;
+      case 2:
+      case 3:
+        stream.push_back(0x20903C40);
+        break;
+      case 4:
+      case 5:
+        stream.insert(stream.end(), {0x40B00100u, static_cast<uint32_t>(rng())});
+        break;
+      case 6:
+        stream.insert(stream.end(), {0x30167E7Fu, 0x06010000u});
+        break;
+      case 7:
+        stream.insert(stream.end(), {0xF0010000u, 1u, 2u, 3u});
+        break;
+    }
+  }
+  return stream;
+}
+
+// The walk segment_ump_stream and the MIDI 2 input state machine used to do
+std::size_t per_packet(std::span<const uint32_t> stream, uint64_t& sum)
+{
+  std::size_t packets = 0;
+  auto count = static_cast<int64_t>(stream.size());
+  auto ump = stream.data();
+  while (count > 0)
+  {
+    while (count > 0 && ump[0] == 0)
+    {
+      count--;
+      ump++;
+    }
+    if (count == 0)
+      break;
+
+    const auto words = cmidi2_ump_get_num_bytes(ump[0]) / 4;
+    if (words > count)
+      break;
+    sum += ump[0];
+    packets++;
+    ump += words;
+    count -= words;
+  }
+  return packets;
+}
+
+std::size_t batched(std::span<const uint32_t> stream, uint64_t& sum)
+{
+  std::size_t packets = 0;
+  libremidi::for_each_ump_packet(stream, [&](const uint32_t* ump, uint32_t) {
+    sum += ump[0];
+    packets++;
+    return true;
+  });
+  return packets;
+}
+
+template <typename F>
+void run(const char* name, int iterations, std::size_t words, F&& f)
+{
+  using clk = std::chrono::steady_clock;
+  std::size_t packets = 0;
+  const auto t0 = clk::now();
+  for (int i = 0; i < iterations; i++)
+    packets = f();
+  const auto t1 = clk::now();
+
+  const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+  std::cout << name << ": " << ns / (double(iterations) * double(words)) << " ns / word, "
+            << packets << " packets\n";
+}
+}
+
+int main(int argc, const char** argv)
+{
+  const std::size_t words = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+  const auto stream = make_stream(words);
+
+  uint64_t sum{};
+  run("per packet", iterations, stream.size(), [&] { return per_packet(stream, sum); });
+  run("batched   ", iterations, stream.size(), [&] { return batched(stream, sum); });
+
+  // With the default configuration: SysEx and utility messages are filtered
+  std::size_t received = 0;
+  libremidi::ump_input_configuration conf{
+      .on_message = [&](libremidi::ump&&) { received++; },
+      .timestamps = libremidi::timestamp_mode::NoTimestamp};
+  libremidi::midi2::input_state_machine sm{conf};
+  run("decoder   ", iterations, stream.size(), [&] {
+    received = 0;
+    sm.on_bytes_multi(std::span<const uint32_t>{stream}, 0);
+    return received;
+  });
+
+  return sum == 0;
+}
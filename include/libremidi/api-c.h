@@ -27,6 +27,7 @@ enum libremidi_api
   ANDROID_AMIDI,  /*!< Android AMidi API */
   KDMAPI,         /*!< OmniMIDI KDMAPI (Windows) */
   RAW_IO,         /*!< User-provided raw byte I/O (serial, SPI, USB, etc.) */
+  SHARED_MEMORY,  /*!< Inter-process rings in shared memory (Linux) */
 
   // MIDI 2.0 APIs
   ALSA_RAW_UMP = 0x1000, /*!< Raw ALSA API for MIDI 2.0 */
@@ -38,6 +39,7 @@ enum libremidi_api
   JACK_UMP,              /*!< MIDI2 over JACK, type "32 bit raw UMP". Requires PipeWire v1.4+. */
   PIPEWIRE_UMP,          /*!< MIDI2 over PipeWire. Requires v1.4+. */
   RAW_IO_UMP,            /*!< User-provided raw UMP I/O (serial, SPI, USB, etc.) */
+  SHARED_MEMORY_UMP,     /*!< Inter-process rings of UMP in shared memory (Linux) */
 
   DUMMY = 0xFFFF /*!< A compilable but non-functional API. */
 };
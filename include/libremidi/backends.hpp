@@ -80,6 +80,11 @@
 #include <libremidi/backends/rawio.hpp>
 #include <libremidi/backends/rawio_ump.hpp>
 
+#if defined(LIBREMIDI_SHM)
+  #include <libremidi/backends/shm.hpp>
+  #include <libremidi/backends/shm_ump.hpp>
+#endif
+
 #if defined(LIBREMIDI_ANDROID)
   #include <libremidi/backends/android/android.hpp>
 #endif
@@ -145,6 +150,10 @@ LIBREMIDI_STATIC constexpr auto available_backends = make_tl(
 #if defined(LIBREMIDI_ANDROID)
     ,
     android::backend{}
+#endif
+#if defined(LIBREMIDI_SHM)
+    ,
+    shm::backend{}
 #endif
     ,
     rawio::backend{},
@@ -196,6 +205,10 @@ LIBREMIDI_STATIC constexpr auto available_backends = make_tl(
 #if defined(LIBREMIDI_PIPEWIRE_UMP)
     ,
     pipewire_ump::backend{}
+#endif
+#if defined(LIBREMIDI_SHM)
+    ,
+    shm_ump::backend{}
 #endif
     ,
     rawio_ump::backend{},
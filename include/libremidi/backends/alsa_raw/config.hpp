@@ -1,5 +1,6 @@
 #pragma once
 #include <libremidi/config.hpp>
+#include <libremidi/thread_configuration.hpp>
 
 #include <chrono>
 #include <cstdint>
@@ -63,6 +64,19 @@ struct alsa_raw_input_configuration
 {
   std::function<bool(const manual_poll_parameters&)> manual_poll;
   std::chrono::milliseconds poll_period{2};
+
+  //! All the inputs of the process are read from a single thread waiting on their devices,
+  //! instead of a thread per input. Not used with manual polling.
+  bool shared_thread = true;
+
+  //! The inputs are read through io_uring from a single thread, with one system call
+  //! for all the devices on each wakeup. Requires Linux 5.19; when it is not available,
+  //! shared_thread applies. Not used with manual polling.
+  bool io_uring = false;
+
+  //! Scheduling of the thread reading the input. A thread shared between inputs is
+  //! configured by the first input which starts it.
+  thread_configuration thread{};
 };
 
 struct alsa_raw_output_configuration
@@ -77,5 +91,12 @@ struct alsa_raw_output_configuration
 struct alsa_raw_observer_configuration
 {
   std::chrono::milliseconds poll_period{100};
+
+  //! The hotplug events are watched from the thread shared with the inputs,
+  //! instead of a thread per observer
+  bool shared_thread = true;
+
+  //! Scheduling of the thread watching for devices
+  thread_configuration thread{};
 };
 }
@@ -1,13 +1,18 @@
 #pragma once
 #include <libremidi/backends/alsa_raw/config.hpp>
 #include <libremidi/backends/alsa_raw/helpers.hpp>
+#include <libremidi/backends/linux/epoll_dispatcher.hpp>
+#include <libremidi/backends/linux/epoll_reactor.hpp>
+#include <libremidi/backends/linux/io_uring_reader.hpp>
 #include <libremidi/backends/linux/helpers.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
 
 #include <alsa/asoundlib.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <thread>
 
 NAMESPACE_LIBREMIDI::alsa_raw
@@ -140,16 +145,33 @@ public:
     unsigned char bytes[nbytes];
 
     ssize_t err = 0;
+    bool backlog = false;
     // err is the amount of bytes read
     while ((err = snd.rawmidi.read(this->midiport_, bytes, nbytes)) > 0)
     {
       const auto to_ns = [this] { return absolute_timestamp(); };
       m_processing.on_bytes(
           {bytes, bytes + err}, m_processing.timestamp<timestamp_info>(to_ns, 0));
+      backlog |= (err == nbytes);
     }
+    if (backlog)
+      check_xruns();
     return err;
   }
 
+  // The kernel counts the bytes it could not store because its buffer was full, and resets
+  // the count when the status is read. It can only have been full if a read filled ours.
+  void check_xruns()
+  {
+    snd_rawmidi_status_t* st{};
+    snd_rawmidi_status_alloca(&st);
+    if (snd.rawmidi.status(this->midiport_, st) < 0)
+      return;
+
+    if (snd.rawmidi.status_get_xruns(st) > 0)
+      this->counters.overrun(configuration.on_overrun);
+  }
+
 #if LIBREMIDI_ALSA_HAS_RAWMIDI_TREAD
   ssize_t read_input_buffer_with_timestamps()
   {
@@ -164,6 +186,7 @@ public:
     struct timespec ts;
 
     ssize_t err = 0;
+    bool backlog = false;
     // err is the amount of bytes read
     while ((err = snd.rawmidi.tread(this->midiport_, &ts, bytes, nbytes)) > 0)
     {
@@ -172,7 +195,10 @@ public:
       };
       m_processing.on_bytes(
           {bytes, bytes + err}, m_processing.timestamp<timestamp_info>(to_ns, 0));
+      backlog |= (err == nbytes);
     }
+    if (backlog)
+      check_xruns();
     return err;
   }
 #else
@@ -191,7 +217,8 @@ public:
 
   snd_rawmidi_t* midiport_{};
   std::vector<pollfd> fds_;
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 
 class midi_in_alsa_raw_threaded : public midi_in_impl
@@ -220,6 +247,7 @@ public:
 private:
   void run_thread(auto parse_func)
   {
+    apply_thread_configuration(this->configuration.thread);
     fds_.push_back(this->m_termination_event);
     const auto period
         = std::chrono::duration_cast<std::chrono::milliseconds>(this->configuration.poll_period)
@@ -293,6 +321,270 @@ private:
   eventfd_notifier m_termination_event{};
 };
 
+class midi_in_alsa_raw_reactor : public midi_in_impl
+{
+public:
+  midi_in_alsa_raw_reactor(
+      input_configuration&& conf, alsa_raw_input_configuration&& apiconf,
+      std::shared_ptr<epoll_reactor> reactor)
+      : midi_in_impl{std::move(conf), std::move(apiconf)}
+      , m_reactor{std::move(reactor)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in_alsa_raw_reactor() override
+  {
+    // Close a connection if it exists.
+    this->midi_in_alsa_raw_reactor::close_port();
+
+    client_open_ = std::errc::not_connected;
+  }
+
+private:
+  // Edge-triggered: the parse functions read until the device would block
+  bool on_ready(auto parse_func, uint32_t events)
+  {
+    if (events & (EPOLLERR | EPOLLHUP))
+      return false;
+    const ssize_t err = (this->*parse_func)();
+    return err >= 0 || err == -EAGAIN;
+  }
+
+  stdx::error open_port(const input_port& port, std::string_view /*name*/) override
+  {
+    if (auto err = midi_in_impl::init_port(port); err != stdx::error{})
+      return err;
+
+    for (auto& fd : fds_)
+    {
+      int64_t id{};
+      if (configuration.timestamps == timestamp_mode::NoTimestamp)
+        id = m_reactor->add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer, events);
+        });
+      else
+        id = m_reactor->add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer_with_timestamps, events);
+        });
+
+      if (id < 0)
+      {
+        libremidi_handle_error(this->configuration, "cannot watch the device.");
+        close_port();
+        return from_errc(static_cast<int>(id));
+      }
+      m_registrations.push_back(id);
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    for (auto id : m_registrations)
+      m_reactor->remove(id);
+    m_registrations.clear();
+
+    return midi_in_impl::close_port();
+  }
+
+  std::shared_ptr<epoll_reactor> m_reactor;
+  std::vector<int64_t> m_registrations;
+};
+
+// With manual_dispatch: the devices are read from dispatch(), called by the application
+// when the descriptor is readable. No thread is started.
+class midi_in_alsa_raw_dispatched : public midi_in_impl
+{
+public:
+  midi_in_alsa_raw_dispatched(input_configuration&& conf, alsa_raw_input_configuration&& apiconf)
+      : midi_in_impl{std::move(conf), std::move(apiconf)}
+  {
+    if (m_dispatcher.descriptor() < 0)
+    {
+      libremidi_handle_error(this->configuration, "error creating epoll descriptor.");
+      return;
+    }
+
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in_alsa_raw_dispatched() override
+  {
+    // Close a connection if it exists.
+    this->midi_in_alsa_raw_dispatched::close_port();
+
+    client_open_ = std::errc::not_connected;
+  }
+
+  int descriptor() const noexcept override { return m_dispatcher.descriptor(); }
+
+  stdx::error dispatch() override
+  {
+    if (int err = m_dispatcher.dispatch(); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+private:
+  bool on_ready(auto parse_func, uint32_t events)
+  {
+    if (events & (EPOLLERR | EPOLLHUP))
+      return false;
+    const ssize_t err = (this->*parse_func)();
+    return err >= 0 || err == -EAGAIN;
+  }
+
+  stdx::error open_port(const input_port& port, std::string_view /*name*/) override
+  {
+    if (auto err = midi_in_impl::init_port(port); err != stdx::error{})
+      return err;
+
+    for (auto& fd : fds_)
+    {
+      int64_t id{};
+      if (configuration.timestamps == timestamp_mode::NoTimestamp)
+        id = m_dispatcher.add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer, events);
+        });
+      else
+        id = m_dispatcher.add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer_with_timestamps, events);
+        });
+
+      if (id < 0)
+      {
+        libremidi_handle_error(this->configuration, "cannot watch the device.");
+        close_port();
+        return from_errc(static_cast<int>(id));
+      }
+      m_registrations.push_back(id);
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    for (auto id : m_registrations)
+      m_dispatcher.remove(id);
+    m_registrations.clear();
+
+    return midi_in_impl::close_port();
+  }
+
+  epoll_dispatcher m_dispatcher;
+  std::vector<int64_t> m_registrations;
+};
+
+#if LIBREMIDI_HAS_IO_URING
+// The hw rawmidi descriptors are read directly from the io_uring, bypassing alsa-lib:
+// in timestamped mode, the kernel then returns snd_rawmidi_framing_tstamp frames.
+class midi_in_alsa_raw_uring : public midi_in_impl
+{
+public:
+  midi_in_alsa_raw_uring(
+      input_configuration&& conf, alsa_raw_input_configuration&& apiconf,
+      std::shared_ptr<io_uring_reader> reader)
+      : midi_in_impl{std::move(conf), std::move(apiconf)}
+      , m_reader{std::move(reader)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in_alsa_raw_uring() override
+  {
+    // Close a connection if it exists.
+    this->midi_in_alsa_raw_uring::close_port();
+
+    client_open_ = std::errc::not_connected;
+  }
+
+private:
+  bool on_bytes(std::span<const uint8_t> bytes)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = false,
+        .absolute_is_monotonic = false,
+        .has_samples = false,
+    };
+
+    const auto to_ns = [this] { return absolute_timestamp(); };
+    m_processing.on_bytes(bytes, m_processing.timestamp<timestamp_info>(to_ns, 0));
+    if (bytes.size() == io_uring_reader::buffer_size)
+      check_xruns();
+    return true;
+  }
+
+  #if LIBREMIDI_ALSA_HAS_RAWMIDI_TREAD
+  // Layout of struct snd_rawmidi_framing_tstamp
+  static constexpr std::size_t frame_size = 32;
+  static constexpr std::size_t frame_data_size = 16;
+
+  bool on_frames(std::span<const uint8_t> bytes)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = true,
+        .absolute_is_monotonic = true,
+        .has_samples = false,
+    };
+
+    for (std::size_t i = 0; i + frame_size <= bytes.size(); i += frame_size)
+    {
+      const uint8_t* frame = bytes.data() + i;
+      if (frame[0] != 0) // SND_RAWMIDI_FRAME_TYPE_DEFAULT
+        continue;
+
+      uint32_t nsec{};
+      uint64_t sec{};
+      std::memcpy(&nsec, frame + 4, sizeof(nsec));
+      std::memcpy(&sec, frame + 8, sizeof(sec));
+      const auto to_ns = [=] {
+        return static_cast<int64_t>(sec) * 1'000'000'000 + static_cast<int64_t>(nsec);
+      };
+
+      const std::size_t len = std::min<std::size_t>(frame[1], frame_data_size);
+      m_processing.on_bytes(
+          {frame + 16, len}, m_processing.timestamp<timestamp_info>(to_ns, 0));
+    }
+    if (bytes.size() == io_uring_reader::buffer_size)
+      check_xruns();
+    return true;
+  }
+  #else
+  bool on_frames(std::span<const uint8_t> bytes) { return on_bytes(bytes); }
+  #endif
+
+  stdx::error open_port(const input_port& port, std::string_view /*name*/) override
+  {
+    if (auto err = midi_in_impl::init_port(port); err != stdx::error{})
+      return err;
+
+    for (auto& fd : fds_)
+    {
+      if (configuration.timestamps == timestamp_mode::NoTimestamp)
+        m_registrations.push_back(
+            m_reader->add(fd.fd, [this](std::span<const uint8_t> b) { return on_bytes(b); }));
+      else
+        m_registrations.push_back(
+            m_reader->add(fd.fd, [this](std::span<const uint8_t> b) { return on_frames(b); }));
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    for (auto id : m_registrations)
+      m_reader->remove(id);
+    m_registrations.clear();
+
+    return midi_in_impl::close_port();
+  }
+
+  std::shared_ptr<io_uring_reader> m_reader;
+  std::vector<int64_t> m_registrations;
+};
+#endif
+
 class midi_in_alsa_raw_manual : public midi_in_impl
 {
 public:
@@ -351,7 +643,19 @@ inline std::unique_ptr<midi_in_api> make<alsa_raw::midi_in_impl>(
 {
   if (api.manual_poll)
     return std::make_unique<alsa_raw::midi_in_alsa_raw_manual>(std::move(conf), std::move(api));
-  else
-    return std::make_unique<alsa_raw::midi_in_alsa_raw_threaded>(std::move(conf), std::move(api));
+  if (conf.manual_dispatch)
+    return std::make_unique<alsa_raw::midi_in_alsa_raw_dispatched>(
+        std::move(conf), std::move(api));
+#if LIBREMIDI_HAS_IO_URING
+  if (api.io_uring)
+    if (auto reader = io_uring_reader::instance(api.thread))
+      return std::make_unique<alsa_raw::midi_in_alsa_raw_uring>(
+          std::move(conf), std::move(api), std::move(reader));
+#endif
+  if (api.shared_thread)
+    if (auto reactor = epoll_reactor::instance(api.thread))
+      return std::make_unique<alsa_raw::midi_in_alsa_raw_reactor>(
+          std::move(conf), std::move(api), std::move(reactor));
+  return std::make_unique<alsa_raw::midi_in_alsa_raw_threaded>(std::move(conf), std::move(api));
 }
 }
@@ -4,6 +4,8 @@
 #include <libremidi/backends/dummy.hpp>
 
 #if LIBREMIDI_HAS_UDEV
+  #include <libremidi/backends/linux/epoll_dispatcher.hpp>
+  #include <libremidi/backends/linux/epoll_reactor.hpp>
   #include <libremidi/backends/linux/helpers.hpp>
   #include <libremidi/backends/linux/udev.hpp>
 #endif
@@ -34,6 +36,12 @@ public:
   ~observer_impl_base()
   {
 #if LIBREMIDI_HAS_UDEV
+    if (m_reactor)
+    {
+      for (auto id : m_registrations)
+        m_reactor->remove(id);
+    }
+
     m_termination_event.notify();
 
     if (m_thread.joinable())
@@ -57,6 +65,11 @@ public:
     this->check_devices(configuration.notify_in_constructor);
 
 #if LIBREMIDI_HAS_UDEV
+    if (configuration.manual_dispatch && watch_from_dispatcher())
+      return;
+    if (configuration.shared_thread && watch_from_reactor())
+      return;
+
     // Start thread
     m_thread = std::thread{[this] { this->run(); }};
 #endif
@@ -91,6 +104,7 @@ public:
 #if LIBREMIDI_HAS_UDEV
   void run()
   {
+    apply_thread_configuration(configuration.thread);
     for (;;)
     {
       if (int err = poll(m_fds, 3, -1); err < 0)
@@ -110,38 +124,114 @@ public:
       // Check udev
       if (m_fds[0].revents & POLLIN)
       {
-        udev_device* dev = m_udev.udev.monitor_receive_device(m_udev.monitor);
-        if (!dev)
-          continue;
-
-        std::string_view act = m_udev.udev.device_get_action(dev);
-        std::string_view ss = m_udev.udev.device_get_subsystem(dev);
-        if (!act.empty() && ss == "snd_seq")
-        {
-          if (act == "add" || act == "remove")
-          {
-            // Check every 100 milliseconds for ten seconds
-            this->m_timer_fd.restart(configuration.poll_period.count());
-            m_timer_check_counts = 100;
-          }
-        }
-
-        m_udev.udev.device_unref(dev);
-
+        on_udev();
         m_fds[0].revents = 0;
       }
 
       // Check timer
       if (m_fds[2].revents & POLLIN)
       {
-        if (this->m_timer_check_counts-- <= 0)
-          this->m_timer_fd.cancel();
+        on_timer();
         m_fds[2].revents = 0;
+      }
+    }
+  }
 
-        check_devices(true);
+  // Reads the monitor until it is empty, as required by the edge-triggered reactor
+  void on_udev()
+  {
+    while (udev_device* dev = m_udev.udev.monitor_receive_device(m_udev.monitor))
+    {
+      std::string_view act = m_udev.udev.device_get_action(dev);
+      std::string_view ss = m_udev.udev.device_get_subsystem(dev);
+      if (!act.empty() && ss == "snd_seq")
+      {
+        if (act == "add" || act == "remove")
+        {
+          // Check every poll period, a hundred times
+          this->m_timer_fd.restart(
+              std::chrono::nanoseconds(configuration.poll_period).count());
+          m_timer_check_counts = 100;
+        }
       }
+
+      m_udev.udev.device_unref(dev);
     }
   }
+
+  void on_timer()
+  {
+    uint64_t expirations{};
+    [[maybe_unused]] auto sz = ::read(m_timer_fd, &expirations, sizeof(expirations));
+
+    if (this->m_timer_check_counts-- <= 0)
+      this->m_timer_fd.cancel();
+
+    check_devices(true);
+  }
+
+  // With manual_dispatch, the application waits on the descriptors and calls dispatch()
+  bool watch_from_dispatcher()
+  {
+    auto dispatcher = std::make_unique<epoll_dispatcher>();
+    if (dispatcher->descriptor() < 0)
+      return false;
+
+    const int64_t udev_id = dispatcher->add(m_fds[0].fd, [this](uint32_t) {
+      on_udev();
+      return true;
+    });
+    const int64_t timer_id = dispatcher->add(m_timer_fd, [this](uint32_t) {
+      on_timer();
+      return true;
+    });
+    if (udev_id < 0 || timer_id < 0)
+      return false;
+
+    m_dispatcher = std::move(dispatcher);
+    return true;
+  }
+
+  int descriptor() const noexcept override
+  {
+    return m_dispatcher ? m_dispatcher->descriptor() : -1;
+  }
+
+  stdx::error dispatch() override
+  {
+    if (!m_dispatcher)
+      return std::errc::operation_not_supported;
+    if (int err = m_dispatcher->dispatch(); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+  bool watch_from_reactor()
+  {
+    m_reactor = epoll_reactor::instance(configuration.thread);
+    if (!m_reactor)
+      return false;
+
+    const int64_t udev_id = m_reactor->add(m_fds[0].fd, [this](uint32_t) {
+      on_udev();
+      return true;
+    });
+    const int64_t timer_id = m_reactor->add(m_timer_fd, [this](uint32_t) {
+      on_timer();
+      return true;
+    });
+    if (udev_id < 0 || timer_id < 0)
+    {
+      m_reactor->remove(udev_id);
+      m_reactor->remove(timer_id);
+      m_reactor.reset();
+      return false;
+    }
+
+    m_registrations[0] = udev_id;
+    m_registrations[1] = timer_id;
+    return true;
+  }
 #endif
 
   template <bool Input>
@@ -251,6 +341,11 @@ public:
   int m_timer_check_counts = 0;
   std::thread m_thread;
   pollfd m_fds[3]{};
+
+  std::shared_ptr<epoll_reactor> m_reactor;
+  int64_t m_registrations[2]{};
+
+  std::unique_ptr<epoll_dispatcher> m_dispatcher;
 #endif
 
   std::vector<alsa_raw_port_info> m_current_inputs;
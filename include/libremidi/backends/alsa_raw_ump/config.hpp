@@ -10,6 +10,14 @@ struct input_configuration
 {
   std::function<bool(const manual_poll_parameters&)> manual_poll;
   std::chrono::milliseconds poll_period{2};
+
+  //! All the inputs of the process are read from a single thread waiting on their devices,
+  //! instead of a thread per input. Not used with manual polling.
+  bool shared_thread = true;
+
+  //! Scheduling of the thread reading the input. A thread shared between inputs is
+  //! configured by the first input which starts it.
+  thread_configuration thread{};
 };
 
 struct output_configuration
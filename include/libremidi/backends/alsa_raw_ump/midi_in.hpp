@@ -1,6 +1,8 @@
 #pragma once
 #include <libremidi/backends/alsa_raw_ump/config.hpp>
 #include <libremidi/backends/alsa_raw_ump/helpers.hpp>
+#include <libremidi/backends/linux/epoll_dispatcher.hpp>
+#include <libremidi/backends/linux/epoll_reactor.hpp>
 #include <libremidi/backends/linux/helpers.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
@@ -40,8 +42,7 @@ public:
   // Must be a string such as: "hw:2,4,1"
   [[nodiscard]] stdx::error do_init_port(const char* portname)
   {
-    constexpr int mode = 0;
-    SND_RAWMIDI_NONBLOCK; // fixme
+    constexpr int mode = SND_RAWMIDI_NONBLOCK;
     if (int err = snd.ump.open(&midiport_, 0, portname, mode); err < 0)
     {
       libremidi_handle_error(
@@ -144,7 +145,7 @@ public:
     while ((err = snd.ump.read(this->midiport_, words, nwords * 4)) > 0)
     {
       const auto to_ns = [this] { return absolute_timestamp(); };
-      m_processing.on_bytes(
+      m_processing.on_bytes_multi(
           {words, words + err / 4}, m_processing.timestamp<timestamp_info>(to_ns, 0));
     }
     return err;
@@ -168,7 +169,7 @@ public:
       const auto to_ns = [ts] {
         return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + static_cast<int64_t>(ts.tv_nsec);
       };
-      m_processing.on_bytes(
+      m_processing.on_bytes_multi(
           {words, words + err / 4}, m_processing.timestamp<timestamp_info>(to_ns, 0));
     }
     return err;
@@ -187,7 +188,8 @@ public:
 
   snd_ump_t* midiport_{};
   std::vector<pollfd> fds_;
-  midi2::input_state_machine m_processing{this->configuration};
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 
 class midi_in_impl_threaded : public midi_in_impl
@@ -216,6 +218,7 @@ public:
 private:
   void run_thread(auto parse_func)
   {
+    apply_thread_configuration(this->configuration.thread);
     fds_.push_back(this->m_termination_event);
     const auto period
         = std::chrono::duration_cast<std::chrono::milliseconds>(this->configuration.poll_period)
@@ -289,6 +292,160 @@ private:
   eventfd_notifier m_termination_event{};
 };
 
+class midi_in_impl_reactor : public midi_in_impl
+{
+public:
+  midi_in_impl_reactor(
+      libremidi::ump_input_configuration&& conf, alsa_raw_ump::input_configuration&& apiconf,
+      std::shared_ptr<epoll_reactor> reactor)
+      : midi_in_impl{std::move(conf), std::move(apiconf)}
+      , m_reactor{std::move(reactor)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in_impl_reactor()
+  {
+    // Close a connection if it exists.
+    midi_in_impl_reactor::close_port();
+    client_open_ = std::errc::not_connected;
+  }
+
+private:
+  // Edge-triggered: the parse functions read until the device would block
+  bool on_ready(auto parse_func, uint32_t events)
+  {
+    if (events & (EPOLLERR | EPOLLHUP))
+      return false;
+    const ssize_t err = (this->*parse_func)();
+    return err >= 0 || err == -EAGAIN;
+  }
+
+  stdx::error open_port(const input_port& port, [[maybe_unused]] std::string_view name) override
+  {
+    if (auto err = midi_in_impl::init_port(port); err != stdx::error{})
+      return err;
+
+    for (auto& fd : fds_)
+    {
+      int64_t id{};
+      if (configuration.timestamps == timestamp_mode::NoTimestamp)
+        id = m_reactor->add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer, events);
+        });
+      else
+        id = m_reactor->add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer_with_timestamps, events);
+        });
+
+      if (id < 0)
+      {
+        libremidi_handle_error(this->configuration, "cannot watch the device.");
+        close_port();
+        return from_errc(static_cast<int>(id));
+      }
+      m_registrations.push_back(id);
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    for (auto id : m_registrations)
+      m_reactor->remove(id);
+    m_registrations.clear();
+
+    return midi_in_impl::close_port();
+  }
+
+  std::shared_ptr<epoll_reactor> m_reactor;
+  std::vector<int64_t> m_registrations;
+};
+
+// With manual_dispatch: the devices are read from dispatch(), called by the application
+// when the descriptor is readable. No thread is started.
+class midi_in_impl_dispatched : public midi_in_impl
+{
+public:
+  midi_in_impl_dispatched(
+      libremidi::ump_input_configuration&& conf, alsa_raw_ump::input_configuration&& apiconf)
+      : midi_in_impl{std::move(conf), std::move(apiconf)}
+  {
+    if (m_dispatcher.descriptor() < 0)
+    {
+      libremidi_handle_error(this->configuration, "error creating epoll descriptor.");
+      return;
+    }
+
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in_impl_dispatched()
+  {
+    // Close a connection if it exists.
+    midi_in_impl_dispatched::close_port();
+    client_open_ = std::errc::not_connected;
+  }
+
+  int descriptor() const noexcept override { return m_dispatcher.descriptor(); }
+
+  stdx::error dispatch() override
+  {
+    if (int err = m_dispatcher.dispatch(); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+private:
+  bool on_ready(auto parse_func, uint32_t events)
+  {
+    if (events & (EPOLLERR | EPOLLHUP))
+      return false;
+    const ssize_t err = (this->*parse_func)();
+    return err >= 0 || err == -EAGAIN;
+  }
+
+  stdx::error open_port(const input_port& port, [[maybe_unused]] std::string_view name) override
+  {
+    if (auto err = midi_in_impl::init_port(port); err != stdx::error{})
+      return err;
+
+    for (auto& fd : fds_)
+    {
+      int64_t id{};
+      if (configuration.timestamps == timestamp_mode::NoTimestamp)
+        id = m_dispatcher.add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer, events);
+        });
+      else
+        id = m_dispatcher.add(fd.fd, [this](uint32_t events) {
+          return on_ready(&midi_in_impl::read_input_buffer_with_timestamps, events);
+        });
+
+      if (id < 0)
+      {
+        libremidi_handle_error(this->configuration, "cannot watch the device.");
+        close_port();
+        return from_errc(static_cast<int>(id));
+      }
+      m_registrations.push_back(id);
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    for (auto id : m_registrations)
+      m_dispatcher.remove(id);
+    m_registrations.clear();
+
+    return midi_in_impl::close_port();
+  }
+
+  epoll_dispatcher m_dispatcher;
+  std::vector<int64_t> m_registrations;
+};
+
 class midi_in_impl_manual : public midi_in_impl
 {
 public:
@@ -347,7 +504,13 @@ inline std::unique_ptr<midi_in_api> make<alsa_raw_ump::midi_in_impl>(
 {
   if (api.manual_poll)
     return std::make_unique<alsa_raw_ump::midi_in_impl_manual>(std::move(conf), std::move(api));
-  else
-    return std::make_unique<alsa_raw_ump::midi_in_impl_threaded>(std::move(conf), std::move(api));
+  if (conf.manual_dispatch)
+    return std::make_unique<alsa_raw_ump::midi_in_impl_dispatched>(
+        std::move(conf), std::move(api));
+  if (api.shared_thread)
+    if (auto reactor = epoll_reactor::instance(api.thread))
+      return std::make_unique<alsa_raw_ump::midi_in_impl_reactor>(
+          std::move(conf), std::move(api), std::move(reactor));
+  return std::make_unique<alsa_raw_ump::midi_in_impl_threaded>(std::move(conf), std::move(api));
 }
 }
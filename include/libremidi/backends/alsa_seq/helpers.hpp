@@ -157,6 +157,24 @@ inline unsigned int iterate_port_info(
   return 0;
 }
 
+// Allocates a queue used to timestamp the incoming events.
+// Returns the queue id, or a negative error code.
+inline int create_timestamp_queue(const libasound& snd, snd_seq_t* seq)
+{
+  int queue = snd.seq.alloc_queue(seq);
+  if (queue < 0)
+    return queue;
+
+  // Set arbitrary tempo (mm=100) and resolution (240)
+  snd_seq_queue_tempo_t* qtempo{};
+  snd_seq_queue_tempo_alloca(&qtempo);
+  snd.seq.queue_tempo_set_tempo(qtempo, 600000);
+  snd.seq.queue_tempo_set_ppq(qtempo, 240);
+  snd.seq.set_queue_tempo(seq, queue, qtempo);
+  snd.seq.drain_output(seq);
+  return queue;
+}
+
 // A structure to hold variables related to the ALSA API
 // implementation.
 struct alsa_data
@@ -0,0 +1,284 @@
+#pragma once
+#include <libremidi/backends/alsa_seq/config.hpp>
+#include <libremidi/backends/alsa_seq/helpers.hpp>
+#include <libremidi/backends/linux/helpers.hpp>
+#include <libremidi/backends/linux/thread.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::alsa_seq
+{
+//! Timestamping queue of a sequencer client, and the time at which it was started
+struct shared_queue
+{
+  int id{-1};
+  std::chrono::steady_clock::time_point start{};
+};
+
+//! A sequencer client with a single thread reading its events, shared by all the inputs
+//! of the process which have the same client name. Each input is a port of the client:
+//! events are routed to its callback through a table indexed by destination port.
+//! The callbacks run without any lock held: they can open and close inputs themselves.
+//! alsa-lib handles are not thread-safe: the inputs make their calls on the client
+//! under client_mutex(), which the thread only holds while it reads events.
+template <typename ConfigurationImpl>
+class input_dispatcher : public std::enable_shared_from_this<input_dispatcher<ConfigurationImpl>>
+{
+public:
+  using callback_type = decltype(typename ConfigurationImpl::poll_parameters_type{}.callback);
+
+  //! The dispatcher of the given client name, created on first use.
+  //! Returns nullptr if the sequencer cannot be opened.
+  //! The thread configuration is the one of the input which creates the dispatcher.
+  static std::shared_ptr<input_dispatcher>
+  acquire(const std::string& client_name, const thread_configuration& thread = {})
+  {
+    static std::mutex mutex;
+    static std::vector<std::pair<std::string, std::weak_ptr<input_dispatcher>>> dispatchers;
+
+    std::lock_guard lock{mutex};
+    std::erase_if(dispatchers, [](const auto& d) { return d.second.expired(); });
+    for (auto& [name, ptr] : dispatchers)
+      if (name == client_name)
+        if (auto d = ptr.lock())
+          return d;
+
+    auto d = std::make_shared<input_dispatcher>(client_name);
+    if (!d->m_data.seq || d->m_termination_event < 0 || !d->start(thread))
+      return nullptr;
+    dispatchers.emplace_back(client_name, d);
+    return d;
+  }
+
+  explicit input_dispatcher(const std::string& client_name)
+  {
+    ConfigurationImpl conf;
+    conf.client_name = client_name;
+    if (m_data.init_client(conf) < 0)
+      m_data.seq = nullptr;
+  }
+
+  ~input_dispatcher()
+  {
+    m_termination_event.notify();
+    if (m_thread.get_id() == std::this_thread::get_id())
+    {
+      // The last input was closed by a callback: run() returns without touching this
+      m_thread.detach();
+    }
+    else if (m_thread.joinable())
+    {
+      m_thread.join();
+    }
+
+    if (m_data.seq)
+    {
+      if (m_queue.id >= 0)
+        m_data.snd.seq.free_queue(m_data.seq, m_queue.id);
+      m_data.snd.seq.close(m_data.seq);
+    }
+  }
+
+  input_dispatcher(const input_dispatcher&) = delete;
+  input_dispatcher& operator=(const input_dispatcher&) = delete;
+
+  snd_seq_t* client() const noexcept { return m_data.seq; }
+  std::mutex& client_mutex() noexcept { return m_client_mutex; }
+
+  //! The queue used by the ports which want timestamps, started on the first call
+  shared_queue timestamp_queue()
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_queue.id < 0)
+    {
+      std::lock_guard client{m_client_mutex};
+      auto& snd = m_data.snd;
+      if (int q = create_timestamp_queue(snd, m_data.seq); q >= 0)
+      {
+        snd.seq.control_queue(m_data.seq, q, SND_SEQ_EVENT_START, 0, nullptr);
+        m_queue.start = std::chrono::steady_clock::now();
+        snd.seq.drain_output(m_data.seq);
+        m_queue.id = q;
+      }
+    }
+    return m_queue;
+  }
+
+  //! Routes the events received by a port to a callback.
+  //! on_overrun is called when events may have been lost for all the ports of the client.
+  void add(int port, callback_type on_event, std::function<void()> on_overrun)
+  {
+    auto callbacks = std::make_shared<const port_callbacks>(
+        port_callbacks{std::move(on_event), std::move(on_overrun)});
+    std::lock_guard lock{m_mutex};
+    if (port >= 0 && port < std::ssize(m_ports))
+      m_ports[port] = std::move(callbacks);
+  }
+
+  //! Once this returns, the callback of the port is not running and will not be called again,
+  //! unless this is called from that callback itself.
+  void remove(int port)
+  {
+    std::unique_lock lock{m_mutex};
+    if (port < 0 || port >= std::ssize(m_ports))
+      return;
+    m_ports[port].reset();
+    if (std::this_thread::get_id() != m_thread.get_id())
+      m_idle.wait(lock, [this, port] { return m_running != port; });
+  }
+
+private:
+  bool start(const thread_configuration& thread)
+  {
+    try
+    {
+      m_thread = std::thread{[this, weak = this->weak_from_this(), thread] {
+        apply_thread_configuration(thread);
+        run(weak);
+      }};
+      return true;
+    }
+    catch (const std::system_error& e)
+    {
+      LIBREMIDI_LOG("error starting MIDI input thread: ", e.what());
+      return false;
+    }
+  }
+
+  void run(const std::weak_ptr<input_dispatcher>& weak)
+  {
+    auto& snd = m_data.snd;
+    const int count = snd.seq.poll_descriptors_count(m_data.seq, POLLIN);
+    std::vector<pollfd> fds(count + 1);
+    fds[0] = m_termination_event;
+    snd.seq.poll_descriptors(m_data.seq, fds.data() + 1, count, POLLIN);
+
+    for (;;)
+    {
+      {
+        // The callbacks may close the last input: the dispatcher is then destroyed here
+        auto self = weak.lock();
+        if (!self)
+          return;
+        read_events();
+      }
+      if (weak.expired())
+        return;
+
+      if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+        return;
+      if (weak.expired() || m_termination_event.ready(fds[0]))
+        return;
+    }
+  }
+
+  // Reads everything available, until the input would block.
+  // The events point into the input buffer of the client, which only this thread reads:
+  // they stay valid after the lock is released for the callbacks.
+  void read_events()
+  {
+    auto& snd = m_data.snd;
+    for (;;)
+    {
+      std::unique_lock client{m_client_mutex};
+      int err = snd.seq.event_input_pending(m_data.seq, 1);
+      if (err > 0)
+      {
+        if constexpr (ConfigurationImpl::midi_version == 1)
+        {
+          snd_seq_event_t* ev{};
+          event_handle handle{snd};
+          if ((err = snd.seq.event_input(m_data.seq, &ev)) >= 0)
+          {
+            client.unlock();
+            handle.reset(ev);
+            dispatch(*ev);
+            continue;
+          }
+        }
+#if __has_include(<alsa/ump.h>)
+        else
+        {
+          snd_seq_ump_event_t* ev{};
+          event_handle handle{snd};
+          if ((err = snd.seq.ump.event_input(m_data.seq, &ev)) >= 0)
+          {
+            client.unlock();
+            handle.reset((snd_seq_event_t*)ev);
+            dispatch(*ev);
+            continue;
+          }
+        }
+#endif
+      }
+      client.unlock();
+
+      if (err != -ENOSPC)
+        return;
+
+      for (int port = 0; port < std::ssize(m_ports); port++)
+        invoke(port, [](const port_callbacks& cb) {
+          if (cb.on_overrun)
+            cb.on_overrun();
+        });
+    }
+  }
+
+  void dispatch(const auto& ev)
+  {
+    invoke(ev.dest.port, [&](const port_callbacks& cb) {
+      if (cb.on_event)
+        if (int err = cb.on_event(ev); err < 0)
+          LIBREMIDI_LOG("MIDI input error: ", m_data.snd.strerror(err));
+    });
+  }
+
+  // Calls f with the callbacks of a port, outside of the lock: remove() waits for it
+  template <typename F>
+  void invoke(int port, F&& f)
+  {
+    std::unique_lock lock{m_mutex};
+    auto callbacks = m_ports[port];
+    if (!callbacks)
+      return;
+    m_running = port;
+    lock.unlock();
+
+    f(*callbacks);
+    callbacks.reset();
+
+    lock.lock();
+    m_running = -1;
+    lock.unlock();
+    m_idle.notify_all();
+  }
+
+  alsa_data m_data;
+  std::mutex m_client_mutex;
+  shared_queue m_queue;
+
+  struct port_callbacks
+  {
+    callback_type on_event;
+    std::function<void()> on_overrun;
+  };
+
+  // The table, and the port whose callback the thread is running
+  std::mutex m_mutex;
+  std::condition_variable m_idle;
+  std::vector<std::shared_ptr<const port_callbacks>> m_ports
+      = std::vector<std::shared_ptr<const port_callbacks>>(256);
+  int m_running{-1};
+
+  eventfd_notifier m_termination_event{};
+  std::thread m_thread;
+};
+}
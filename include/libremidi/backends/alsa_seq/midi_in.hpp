@@ -1,6 +1,8 @@
 #pragma once
 #include <libremidi/backends/alsa_seq/config.hpp>
 #include <libremidi/backends/alsa_seq/helpers.hpp>
+#include <libremidi/backends/alsa_seq/input_dispatcher.hpp>
+#include <libremidi/backends/linux/epoll_dispatcher.hpp>
 #include <libremidi/backends/linux/helpers.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
@@ -31,24 +33,27 @@ public:
       , ConfigurationImpl
   {
   } configuration;
-  midi_in_processing<ConfigurationImpl> m_processing{this->configuration};
+  midi_in_processing<ConfigurationImpl> m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 
-  bool require_timestamps() const noexcept
+  static bool require_timestamps(uint32_t mode) noexcept
   {
-    switch (configuration.timestamps)
+    switch (mode)
     {
       case timestamp_mode::NoTimestamp:
-      case timestamp_mode::SystemMonotonic:
       case timestamp_mode::AudioFrame:
         return false;
       case timestamp_mode::Absolute:
       case timestamp_mode::Relative:
+      case timestamp_mode::SystemMonotonic: // Correlated with the monotonic clock
       case timestamp_mode::Custom:
         return true;
     }
     return true;
   }
 
+  bool require_timestamps() const noexcept { return require_timestamps(configuration.timestamps); }
+
   explicit midi_in_impl(ConfigurationBase&& conf, ConfigurationImpl&& apiconf)
       : midi_in_base<ConfigurationImpl>{}
       , configuration{std::move(conf), std::move(apiconf)}
@@ -64,28 +69,40 @@ public:
 
     // Create the input queue
     if (require_timestamps())
+      this->queue_id = create_timestamp_queue(snd, seq);
+
+    init_coder();
+  }
+
+  // Uses the client given in the configuration and a queue started by its owner
+  explicit midi_in_impl(
+      ConfigurationBase&& conf, ConfigurationImpl&& apiconf, const shared_queue& queue)
+      : midi_in_base<ConfigurationImpl>{}
+      , configuration{std::move(conf), std::move(apiconf)}
+      , queue_id{queue.id}
+      , queue_creation_time{queue.start}
+      , queue_is_shared{true}
+  {
+    if (init_client(configuration) < 0)
     {
-      this->queue_id = snd.seq.alloc_queue(seq);
-      // Set arbitrary tempo (mm=100) and resolution (240)
-      snd_seq_queue_tempo_t* qtempo{};
-      snd_seq_queue_tempo_alloca(&qtempo);
-      snd.seq.queue_tempo_set_tempo(qtempo, 600000);
-      snd.seq.queue_tempo_set_ppq(qtempo, 240);
-      snd.seq.set_queue_tempo(this->seq, this->queue_id, qtempo);
-      snd.seq.drain_output(this->seq);
+      libremidi_handle_error(this->configuration, "error creating ALSA sequencer client object.");
+      return;
     }
 
+    init_coder();
+  }
+
+  void init_coder()
+  {
     // Create the event -> midi encoder
+    int result = snd.midi.event_new(0, &coder);
+    if (result < 0)
     {
-      int result = snd.midi.event_new(0, &coder);
-      if (result < 0)
-      {
-        libremidi_handle_error(this->configuration, "error during snd_midi_event_new.");
-        return;
-      }
-      snd.midi.event_init(coder);
-      snd.midi.event_no_status(coder, 1);
+      libremidi_handle_error(this->configuration, "error during snd_midi_event_new.");
+      return;
     }
+    snd.midi.event_init(coder);
+    snd.midi.event_no_status(coder, 1);
   }
 
   ~midi_in_impl() override
@@ -94,7 +111,7 @@ public:
     if (this->vport >= 0)
       snd.seq.delete_port(this->seq, this->vport);
 
-    if (require_timestamps())
+    if (require_timestamps() && !queue_is_shared)
       snd.seq.free_queue(this->seq, this->queue_id);
 
     snd.midi.event_free(coder);
@@ -112,8 +129,15 @@ public:
       return libremidi::API::ALSA_SEQ_UMP;
   }
 
+  // With a client shared with a dispatcher thread, its calls are serialized with it
+  std::unique_lock<std::mutex> lock_client()
+  {
+    return client_mutex ? std::unique_lock{*client_mutex} : std::unique_lock<std::mutex>{};
+  }
+
   [[nodiscard]] int create_port(std::string_view portName)
   {
+    auto lock = lock_client();
     return alsa_data::create_port(
         *this, portName, SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
         SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION,
@@ -122,7 +146,7 @@ public:
 
   void start_queue()
   {
-    if (require_timestamps())
+    if (require_timestamps() && !queue_is_shared)
     {
       snd.seq.control_queue(this->seq, this->queue_id, SND_SEQ_EVENT_START, 0, nullptr);
       this->queue_creation_time = std::chrono::steady_clock::now();
@@ -132,7 +156,7 @@ public:
 
   void stop_queue()
   {
-    if (require_timestamps())
+    if (require_timestamps() && !queue_is_shared)
     {
       snd.seq.control_queue(this->seq, this->queue_id, SND_SEQ_EVENT_STOP, 0, nullptr);
       snd.seq.drain_output(this->seq);
@@ -141,6 +165,7 @@ public:
 
   int connect_port(snd_seq_addr_t sender)
   {
+    auto lock = lock_client();
     snd_seq_addr_t receiver{};
     receiver.client = snd.seq.client_id(this->seq);
     receiver.port = this->vport;
@@ -190,6 +215,7 @@ public:
 
   stdx::error close_port() override
   {
+    auto lock = lock_client();
     unsubscribe();
     stop_queue();
     return stdx::error{};
@@ -197,6 +223,7 @@ public:
 
   stdx::error set_port_name(std::string_view portName) override
   {
+    auto lock = lock_client();
     return alsa_data::set_port_name(portName);
   }
 
@@ -207,6 +234,18 @@ public:
         .count();
   }
 
+  // The real time at which our queue stamped the event, or 0 when another queue did:
+  // its time is unrelated to the one of our queue
+  template <typename Event>
+  int64_t event_time_ns(const Event& ev) const noexcept
+  {
+    if (!require_timestamps() || ev.queue != this->queue_id
+        || (ev.flags & SND_SEQ_TIME_STAMP_MASK) != SND_SEQ_TIME_STAMP_REAL)
+      return 0;
+    return static_cast<int64_t>(ev.time.time.tv_sec) * 1'000'000'000
+           + static_cast<int64_t>(ev.time.time.tv_nsec);
+  }
+
   int64_t process_event(const snd_seq_event_t& ev)
   {
     if constexpr (ConfigurationImpl::midi_version == 1)
@@ -218,7 +257,10 @@ public:
           return 0;
         case SND_SEQ_EVENT_SYSEX: {
           if (configuration.ignore_sysex)
+          {
+            atomic_port_counters::add(this->counters.filtered);
             return 0;
+          }
           else if (ev.data.ext.len > decoding_buffer.size())
             decoding_buffer.resize(ev.data.ext.len);
           break;
@@ -231,9 +273,7 @@ public:
           .has_samples = false,
       };
 
-      const auto to_ns = [ts = ev.time.time] {
-        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + static_cast<int64_t>(ts.tv_nsec);
-      };
+      const auto to_ns = [this, &ev] { return event_time_ns(ev); };
       auto buf = decoding_buffer.data();
       auto buf_space = decoding_buffer.size();
 
@@ -253,22 +293,55 @@ public:
     return 0;
   }
 
-  int64_t process_events()
+  // Reads every event available, until the input would block.
+  // snd_seq_event_input_pending only reads from the kernel FIFO once the buffer of the
+  // library is empty, so a burst costs one read for as many events as fit in the buffer.
+  // Returns the number of events processed, or a negative error code.
+  template <typename Event>
+  int64_t drain_events(auto event_input, auto process)
   {
-    if constexpr (ConfigurationImpl::midi_version == 1)
+    int64_t count = 0;
+    event_handle handle{snd};
+    for (;;)
     {
-      snd_seq_event_t* ev{};
-      event_handle handle{snd};
-      int64_t result = 0;
-      if ((result = snd.seq.event_input(seq, &ev)) > 0)
+      int err = snd.seq.event_input_pending(seq, 1);
+      if (err > 0)
       {
-        handle.reset(ev);
-        if (auto err = process_event(*ev); err < 0)
+        Event* ev{};
+        err = event_input(seq, &ev);
+        if (err >= 0)
         {
-          return err;
+          handle.reset((snd_seq_event_t*)ev);
+          if (int64_t res = process(*ev); res < 0)
+            return res;
+          count++;
+          continue;
         }
       }
-      return result;
+
+      if (err == -ENOSPC)
+      {
+        report_overrun();
+        continue;
+      }
+
+      return (err == 0 || err == -EAGAIN) ? count : err;
+    }
+  }
+
+  // The kernel FIFO of the client overflowed and was reset: the events it held are lost
+  void report_overrun()
+  {
+    this->counters.overrun(configuration.on_overrun);
+    libremidi_handle_warning(configuration, "ALSA sequencer input overrun, events lost.");
+  }
+
+  int64_t process_events()
+  {
+    if constexpr (ConfigurationImpl::midi_version == 1)
+    {
+      return drain_events<snd_seq_event_t>(
+          snd.seq.event_input, [this](const snd_seq_event_t& ev) { return process_event(ev); });
     }
     else
     {
@@ -290,17 +363,17 @@ public:
       case SND_SEQ_EVENT_TICK:   // 0xF9 ... MIDI timing tick
       case SND_SEQ_EVENT_CLOCK:  // 0xF8 ... MIDI timing (clock) tick
         if (configuration.ignore_timing)
-          return 0;
+          return filtered();
         break;
 
       case SND_SEQ_EVENT_SENSING: // Active sensing
         if (configuration.ignore_sensing)
-          return 0;
+          return filtered();
         break;
 
       case SND_SEQ_EVENT_SYSEX: {
         if (configuration.ignore_sysex)
-          return 0;
+          return filtered();
         break;
       }
     }
@@ -310,27 +383,24 @@ public:
         .absolute_is_monotonic = false,
         .has_samples = false,
     };
-    const auto to_ns = [ts = ev.time.time] {
-      return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + static_cast<int64_t>(ts.tv_nsec);
-    };
+    const auto to_ns = [this, &ev] { return event_time_ns(ev); };
 
     m_processing.on_bytes_multi(
         {ev.ump, ev.ump + 4}, m_processing.template timestamp<timestamp_info>(to_ns, 0));
     return 0;
   }
 
-  int process_ump_events()
+  int filtered() noexcept
   {
-    snd_seq_ump_event_t* ev{};
-    event_handle handle{snd};
-    int result = 0;
-    while ((result = snd.seq.ump.event_input(seq, &ev)) > 0)
-    {
-      handle.reset((snd_seq_event_t*)ev);
-      if (int err = process_ump_event(*ev); err < 0)
-        return err;
-    }
-    return result;
+    atomic_port_counters::add(this->counters.filtered);
+    return 0;
+  }
+
+  int64_t process_ump_events()
+  {
+    return drain_events<snd_seq_ump_event_t>(
+        snd.seq.ump.event_input,
+        [this](const snd_seq_ump_event_t& ev) { return process_ump_event(ev); });
   }
 #endif
 
@@ -339,6 +409,12 @@ public:
   // Only needed for midi 1
   std::vector<unsigned char> decoding_buffer = std::vector<unsigned char>(4096);
   std::chrono::steady_clock::time_point queue_creation_time;
+
+  // The queue belongs to an input_dispatcher and runs as long as it exists
+  bool queue_is_shared{};
+
+  // The lock of the client, when it belongs to an input_dispatcher
+  std::mutex* client_mutex{};
 };
 
 template <typename ConfigurationBase, typename ConfigurationImpl>
@@ -421,6 +497,7 @@ private:
 
   void thread_handler()
   {
+    apply_thread_configuration(this->configuration.thread);
     int poll_fd_count = alsa_data::snd.seq.poll_descriptors_count(this->seq, POLLIN) + 1;
     auto poll_fds = (struct pollfd*)alloca(poll_fd_count * sizeof(struct pollfd));
     poll_fds[0] = this->m_termination_event;
@@ -431,20 +508,6 @@ private:
               .count();
     for (;;)
     {
-      if (alsa_data::snd.seq.event_input_pending(this->seq, 1) == 0)
-      {
-        // No data pending
-        if (poll(poll_fds, poll_fd_count, static_cast<int32_t>(period)) >= 0)
-        {
-          // We got our stop-thread signal
-          if (m_termination_event.ready(poll_fds[0]))
-          {
-            break;
-          }
-        }
-        continue;
-      }
-
       int64_t res{};
       if constexpr (ConfigurationImpl::midi_version == 1)
       {
@@ -459,6 +522,14 @@ private:
 
       if (res < 0)
         LIBREMIDI_LOG("MIDI input error: ", this->snd.strerror(res));
+
+      // Everything available was read: wait for more
+      if (poll(poll_fds, poll_fd_count, static_cast<int32_t>(period)) >= 0)
+      {
+        // We got our stop-thread signal
+        if (m_termination_event.ready(poll_fds[0]))
+          break;
+      }
     }
   }
 
@@ -523,6 +594,207 @@ public:
     return midi_in_impl<ConfigurationBase, ConfigurationImpl>::close_port();
   }
 };
+
+// With manual_dispatch: the events of the client are read from dispatch(), called by the
+// application when the descriptor is readable. No thread is started.
+template <typename ConfigurationBase, typename ConfigurationImpl>
+class midi_in_alsa_dispatched : public midi_in_impl<ConfigurationBase, ConfigurationImpl>
+{
+public:
+  midi_in_alsa_dispatched(ConfigurationBase&& conf, ConfigurationImpl&& apiconf)
+      : midi_in_impl<ConfigurationBase, ConfigurationImpl>{std::move(conf), std::move(apiconf)}
+  {
+    if (!this->seq)
+      return;
+
+    if (m_dispatcher.descriptor() < 0)
+    {
+      this->libremidi_handle_error(this->configuration, "error creating epoll descriptor.");
+      return;
+    }
+
+    auto& snd = alsa_data::snd;
+    const int n = snd.seq.poll_descriptors_count(this->seq, POLLIN);
+    auto fds = (struct pollfd*)alloca(n * sizeof(struct pollfd));
+    snd.seq.poll_descriptors(this->seq, fds, n, POLLIN);
+    for (int i = 0; i < n; i++)
+    {
+      if (m_dispatcher.add(fds[i].fd, [this](uint32_t) { return on_ready(); }) < 0)
+      {
+        this->libremidi_handle_error(this->configuration, "cannot watch the client.");
+        return;
+      }
+    }
+
+    this->client_open_ = stdx::error{};
+  }
+
+  ~midi_in_alsa_dispatched()
+  {
+    midi_in_alsa_dispatched::close_port();
+    this->client_open_ = std::errc::not_connected;
+  }
+
+  int descriptor() const noexcept override { return m_dispatcher.descriptor(); }
+
+  stdx::error dispatch() override
+  {
+    if (int err = m_dispatcher.dispatch(); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+private:
+  bool on_ready()
+  {
+    int64_t res{};
+    if constexpr (ConfigurationImpl::midi_version == 1)
+    {
+      res = this->process_events();
+    }
+#if __has_include(<alsa/ump.h>)
+    else if constexpr (ConfigurationImpl::midi_version == 2)
+    {
+      res = this->process_ump_events();
+    }
+#endif
+
+    if (res < 0)
+      LIBREMIDI_LOG("MIDI input error: ", this->snd.strerror(res));
+    return true;
+  }
+
+  stdx::error open_port(const input_port& pt, std::string_view local_port_name) override
+  {
+    if (int err = this->init_port(this->to_address(pt), local_port_name); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (int err = this->init_virtual_port(name); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+  epoll_dispatcher m_dispatcher;
+};
+
+// Each input is a port of a client shared with the other inputs of the process,
+// whose events are read by a single thread: see input_dispatcher.
+template <typename ConfigurationBase, typename ConfigurationImpl>
+class midi_in_alsa_shared : public midi_in_impl<ConfigurationBase, ConfigurationImpl>
+{
+public:
+  using dispatcher_type = input_dispatcher<ConfigurationImpl>;
+
+  midi_in_alsa_shared(
+      ConfigurationBase&& conf, ConfigurationImpl&& apiconf,
+      std::shared_ptr<dispatcher_type> dispatcher, const shared_queue& queue)
+      : midi_in_impl<ConfigurationBase, ConfigurationImpl>{
+            std::move(conf), with_context(std::move(apiconf), *dispatcher), queue}
+      , m_dispatcher{std::move(dispatcher)}
+  {
+    this->client_mutex = &m_dispatcher->client_mutex();
+    if (this->require_timestamps() && this->queue_id < 0)
+    {
+      this->libremidi_handle_error(this->configuration, "error creating ALSA sequencer queue.");
+      return;
+    }
+
+    this->client_open_ = stdx::error{};
+  }
+
+  ~midi_in_alsa_shared()
+  {
+    midi_in_alsa_shared::close_port();
+
+    // The client may be closed along with the dispatcher
+    if (this->vport >= 0)
+    {
+      auto lock = this->lock_client();
+      this->snd.seq.delete_port(this->seq, this->vport);
+    }
+    this->vport = -1;
+    this->client_open_ = std::errc::not_connected;
+  }
+
+  stdx::error open_port(const input_port& pt, std::string_view local_port_name) override
+  {
+    if (int err = this->init_port(this->to_address(pt), local_port_name); err < 0)
+      return from_errc(err);
+
+    add_callback();
+    return stdx::error{};
+  }
+
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (int err = this->init_virtual_port(name); err < 0)
+      return from_errc(err);
+
+    add_callback();
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    m_dispatcher->remove(this->vport);
+
+    return midi_in_impl<ConfigurationBase, ConfigurationImpl>::close_port();
+  }
+
+private:
+  static ConfigurationImpl with_context(ConfigurationImpl&& apiconf, dispatcher_type& dispatcher)
+  {
+    apiconf.context = dispatcher.client();
+    return std::move(apiconf);
+  }
+
+  void add_callback()
+  {
+    auto on_event = [this](const auto& ev) {
+      if constexpr (ConfigurationImpl::midi_version == 1)
+        return this->process_event(ev);
+#if __has_include(<alsa/ump.h>)
+      else
+        return this->process_ump_event(ev);
+#endif
+    };
+    m_dispatcher->add(this->vport, std::move(on_event), [this] { this->report_overrun(); });
+  }
+
+  std::shared_ptr<dispatcher_type> m_dispatcher;
+};
+
+template <typename ConfigurationBase, typename ConfigurationImpl>
+inline std::unique_ptr<midi_in_api>
+make_midi_in(ConfigurationBase&& conf, ConfigurationImpl&& api)
+{
+  if (api.manual_poll)
+    return std::make_unique<midi_in_alsa_manual<ConfigurationBase, ConfigurationImpl>>(
+        std::move(conf), std::move(api));
+  if (conf.manual_dispatch)
+    return std::make_unique<midi_in_alsa_dispatched<ConfigurationBase, ConfigurationImpl>>(
+        std::move(conf), std::move(api));
+
+  using impl = midi_in_impl<ConfigurationBase, ConfigurationImpl>;
+  if (api.shared_client && !api.context)
+  {
+    if (auto dispatcher
+        = input_dispatcher<ConfigurationImpl>::acquire(api.client_name, api.thread))
+    {
+      auto queue = impl::require_timestamps(conf.timestamps) ? dispatcher->timestamp_queue()
+                                                             : shared_queue{};
+      return std::make_unique<midi_in_alsa_shared<ConfigurationBase, ConfigurationImpl>>(
+          std::move(conf), std::move(api), std::move(dispatcher), queue);
+    }
+  }
+
+  return std::make_unique<midi_in_alsa_threaded<ConfigurationBase, ConfigurationImpl>>(
+      std::move(conf), std::move(api));
+}
 }
 
 NAMESPACE_LIBREMIDI
@@ -532,13 +804,6 @@ inline std::unique_ptr<midi_in_api>
 make<alsa_seq::midi_in_impl<libremidi::input_configuration, alsa_seq::input_configuration>>(
     libremidi::input_configuration&& conf, libremidi::alsa_seq::input_configuration&& api)
 {
-  if (api.manual_poll)
-    return std::make_unique<alsa_seq::midi_in_alsa_manual<
-        libremidi::input_configuration, alsa_seq::input_configuration>>(
-        std::move(conf), std::move(api));
-  else
-    return std::make_unique<alsa_seq::midi_in_alsa_threaded<
-        libremidi::input_configuration, alsa_seq::input_configuration>>(
-        std::move(conf), std::move(api));
+  return alsa_seq::make_midi_in(std::move(conf), std::move(api));
 }
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include <libremidi/backends/alsa_seq/config.hpp>
 #include <libremidi/backends/alsa_seq/helpers.hpp>
+#include <libremidi/backends/linux/epoll_dispatcher.hpp>
 #include <libremidi/backends/linux/helpers.hpp>
+#include <libremidi/backends/linux/thread.hpp>
 #include <libremidi/detail/midi_api.hpp>
 #include <libremidi/detail/observer.hpp>
 
@@ -11,6 +13,7 @@
   #include <libremidi/backends/linux/udev.hpp>
 #endif
 
+#include <algorithm>
 #include <map>
 
 NAMESPACE_LIBREMIDI::alsa_seq
@@ -347,6 +350,61 @@ public:
     }
   }
 
+  void handle_event_delayed(const snd_seq_event_t& ev)
+  {
+    switch (ev.type)
+    {
+      case SND_SEQ_EVENT_CLIENT_START:
+      case SND_SEQ_EVENT_CLIENT_EXIT:
+      case SND_SEQ_EVENT_CLIENT_CHANGE:
+
+#if LIBREMIDI_ALSA_HAS_UMP_SEQ_EVENTS
+      case SND_SEQ_EVENT_UMP_EP_CHANGE:
+      case SND_SEQ_EVENT_UMP_BLOCK_CHANGE:
+#endif
+
+      case SND_SEQ_EVENT_PORT_START:
+      case SND_SEQ_EVENT_PORT_EXIT:
+      case SND_SEQ_EVENT_PORT_CHANGE:
+        queued_events.emplace_back(ev, std::chrono::steady_clock::now());
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Put the ALSA events in our queue
+  void read_events()
+  {
+    snd_seq_event_t* ev{};
+    event_handle handle{snd};
+    while (snd.seq.event_input(this->seq, &ev) >= 0)
+    {
+      handle.reset(ev);
+      this->handle_event_delayed(*ev);
+    }
+  }
+
+  // Process the events in a deferred way.
+  // This is because udev takes some milliseconds to populate its field after a
+  // port was added
+  void handle_delayed_events()
+  {
+    auto tm = std::chrono::steady_clock::now();
+    for (auto it = queued_events.begin(); it != queued_events.end();)
+    {
+      if ((tm - it->second) >= this->configuration.poll_period)
+      {
+        this->handle_event_direct(it->first);
+        it = queued_events.erase(it);
+      }
+      else
+      {
+        break;
+      }
+    }
+  }
+
   ~observer_impl()
   {
     if (seq)
@@ -359,6 +417,8 @@ public:
     }
   }
 
+  std::vector<std::pair<snd_seq_event_t, std::chrono::steady_clock::time_point>> queued_events;
+
 private:
   std::map<std::pair<int, int>, port_info> m_knownClients;
 
@@ -391,7 +451,7 @@ public:
 
     // Start the listening thread
     thread = std::thread{[this, n] {
-      auto& snd = alsa_data::snd;
+      apply_thread_configuration(this->configuration.thread);
       const auto period
           = std::chrono::duration_cast<std::chrono::milliseconds>(this->configuration.poll_period)
                 .count();
@@ -404,59 +464,13 @@ public:
           if (descriptors[n].revents & POLLIN)
             break;
 
-          // Put ALSA event in our queue
-          snd_seq_event_t* ev{};
-          event_handle handle{snd};
-          while (snd.seq.event_input(this->seq, &ev) >= 0)
-          {
-            handle.reset(ev);
-            this->handle_event_delayed(*ev);
-          }
-
-          // Process the events in a deferred way.
-          // This is because udev takes some milliseconds to populate its field after a
-          // port was added
-          auto tm = std::chrono::steady_clock::now();
-          for (auto it = queued_events.begin(); it != queued_events.end();)
-          {
-            if ((tm - it->second) >= this->configuration.poll_period)
-            {
-              this->handle_event_direct(it->first);
-              it = queued_events.erase(it);
-            }
-            else
-            {
-              break;
-            }
-          }
+          this->read_events();
+          this->handle_delayed_events();
         }
       }
     }};
   }
 
-  void handle_event_delayed(const snd_seq_event_t& ev)
-  {
-    switch (ev.type)
-    {
-      case SND_SEQ_EVENT_CLIENT_START:
-      case SND_SEQ_EVENT_CLIENT_EXIT:
-      case SND_SEQ_EVENT_CLIENT_CHANGE:
-
-#if LIBREMIDI_ALSA_HAS_UMP_SEQ_EVENTS
-      case SND_SEQ_EVENT_UMP_EP_CHANGE:
-      case SND_SEQ_EVENT_UMP_BLOCK_CHANGE:
-#endif
-
-      case SND_SEQ_EVENT_PORT_START:
-      case SND_SEQ_EVENT_PORT_EXIT:
-      case SND_SEQ_EVENT_PORT_CHANGE:
-        queued_events.emplace_back(ev, std::chrono::steady_clock::now());
-        break;
-      default:
-        break;
-    }
-  }
-
   ~observer_threaded()
   {
     termination_event.notify();
@@ -468,7 +482,67 @@ public:
   eventfd_notifier termination_event{};
   std::thread thread;
   std::vector<pollfd> descriptors;
-  std::vector<std::pair<snd_seq_event_t, std::chrono::steady_clock::time_point>> queued_events;
+};
+
+// With manual_dispatch: the events of the client are read from dispatch(), called by the
+// application when the descriptor is readable, and a timer delays them as the thread does.
+template <typename ConfigurationImpl>
+class observer_dispatched : public observer_impl<ConfigurationImpl>
+{
+public:
+  observer_dispatched(libremidi::observer_configuration&& conf, ConfigurationImpl&& apiconf)
+      : observer_impl<ConfigurationImpl>{std::move(conf), std::move(apiconf)}
+  {
+    if (!this->seq || !this->configuration.has_callbacks())
+      return;
+
+    auto& snd = alsa_data::snd;
+    const int n = snd.seq.poll_descriptors_count(this->seq, POLLIN);
+    std::vector<pollfd> descriptors(n);
+    snd.seq.poll_descriptors(this->seq, descriptors.data(), n, POLLIN);
+    for (auto& fd : descriptors)
+    {
+      m_dispatcher.add(fd.fd, [this](uint32_t) {
+        this->read_events();
+        this->handle_delayed_events();
+        rearm();
+        return true;
+      });
+    }
+
+    m_dispatcher.add(m_timer, [this](uint32_t) {
+      uint64_t expirations{};
+      [[maybe_unused]] auto sz = ::read(m_timer, &expirations, sizeof(expirations));
+      this->handle_delayed_events();
+      rearm();
+      return true;
+    });
+  }
+
+  int descriptor() const noexcept override { return m_dispatcher.descriptor(); }
+
+  stdx::error dispatch() override
+  {
+    if (int err = m_dispatcher.dispatch(); err < 0)
+      return from_errc(err);
+    return stdx::error{};
+  }
+
+private:
+  // Wakes up the application when the oldest delayed event is due
+  void rearm()
+  {
+    if (this->queued_events.empty())
+      return;
+
+    const auto due = this->queued_events.front().second + this->configuration.poll_period;
+    const auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        due - std::chrono::steady_clock::now());
+    m_timer.oneshot(std::max<int64_t>(delay.count(), 1));
+  }
+
+  epoll_dispatcher m_dispatcher;
+  timerfd_timer m_timer;
 };
 
 template <typename ConfigurationImpl>
@@ -499,6 +573,9 @@ make<alsa_seq::observer_impl<alsa_seq::observer_configuration>>(
   if (api.manual_poll)
     return std::make_unique<alsa_seq::observer_manual<alsa_seq::observer_configuration>>(
         std::move(conf), std::move(api));
+  else if (conf.manual_dispatch)
+    return std::make_unique<alsa_seq::observer_dispatched<alsa_seq::observer_configuration>>(
+        std::move(conf), std::move(api));
   else
     return std::make_unique<alsa_seq::observer_threaded<alsa_seq::observer_configuration>>(
         std::move(conf), std::move(api));
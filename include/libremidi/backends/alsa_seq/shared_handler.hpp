@@ -3,6 +3,7 @@
   #include <libremidi/backends/alsa_seq/config.hpp>
   #include <libremidi/backends/alsa_seq/helpers.hpp>
   #include <libremidi/backends/linux/helpers.hpp>
+  #include <libremidi/backends/linux/thread.hpp>
   #include <libremidi/shared_context.hpp>
 
   #include <boost/lockfree/spsc_queue.hpp>
@@ -46,7 +47,10 @@ struct shared_handler : public libremidi::shared_context
 
   void start_processing() override
   {
-    thread = std::thread{[this] { process(); }};
+    thread = std::thread{[this] {
+      apply_thread_configuration(thread_config);
+      process();
+    }};
   }
 
   void stop_processing() override
@@ -57,9 +61,11 @@ struct shared_handler : public libremidi::shared_context
     termination_event.consume();
   }
 
-  static shared_configurations make(std::string_view client_name)
+  static shared_configurations
+  make(std::string_view client_name, const thread_configuration& thread = {})
   {
     auto clt = std::make_shared<shared_handler>(client_name);
+    clt->thread_config = thread;
 
     auto cb = [client = std::weak_ptr{clt}](libremidi::alsa_seq::poll_parameters params) {
       if (auto clt = client.lock())
@@ -190,6 +196,7 @@ struct shared_handler : public libremidi::shared_context
   std::vector<pollfd> fds;
   eventfd_notifier termination_event, queue_event{false};
   std::thread thread;
+  thread_configuration thread_config;
 };
 }
 #endif
@@ -20,6 +20,10 @@ make<alsa_seq::observer_impl<alsa_seq_ump::observer_configuration>>(
   if (api.manual_poll)
     return std::make_unique<alsa_seq::observer_manual<alsa_seq_ump::observer_configuration>>(
         std::move(conf), std::move(api));
+  else if (conf.manual_dispatch)
+    return std::make_unique<
+        alsa_seq::observer_dispatched<alsa_seq_ump::observer_configuration>>(
+        std::move(conf), std::move(api));
   else
     return std::make_unique<alsa_seq::observer_threaded<alsa_seq_ump::observer_configuration>>(
         std::move(conf), std::move(api));
@@ -30,14 +34,7 @@ inline std::unique_ptr<midi_in_api> make<
     alsa_seq::midi_in_impl<libremidi::ump_input_configuration, alsa_seq_ump::input_configuration>>(
     libremidi::ump_input_configuration&& conf, libremidi::alsa_seq_ump::input_configuration&& api)
 {
-  if (api.manual_poll)
-    return std::make_unique<alsa_seq::midi_in_alsa_manual<
-        libremidi::ump_input_configuration, alsa_seq_ump::input_configuration>>(
-        std::move(conf), std::move(api));
-  else
-    return std::make_unique<alsa_seq::midi_in_alsa_threaded<
-        libremidi::ump_input_configuration, alsa_seq_ump::input_configuration>>(
-        std::move(conf), std::move(api));
+  return alsa_seq::make_midi_in(std::move(conf), std::move(api));
 }
 
 }
@@ -30,6 +30,16 @@ struct input_configuration
   std::function<bool(snd_seq_addr_t)> stop_poll;
   std::chrono::milliseconds poll_period{2};
 
+  //! Inputs with the same client name share a single sequencer client, timestamping queue
+  //! and thread, each of them being a port of the client.
+  //! Renaming the client through one of them renames it for all.
+  //! Not used with a user-provided context or manual polling.
+  bool shared_client = true;
+
+  //! Scheduling of the thread reading the input. A shared client is configured
+  //! by the first input which creates it.
+  thread_configuration thread{};
+
   static constexpr int midi_version = 2;
 };
 
@@ -49,6 +59,9 @@ struct observer_configuration
   std::function<bool(snd_seq_addr_t)> stop_poll;
   std::chrono::milliseconds poll_period{100};
 
+  //! Scheduling of the thread watching for devices
+  thread_configuration thread{};
+
   static constexpr int midi_version = 2;
 };
 
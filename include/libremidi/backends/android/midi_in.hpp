@@ -159,7 +159,8 @@ private:
   std::thread poll_thread;
   std::atomic<bool> port_open{false};
   std::atomic<bool> running{false};
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
 }
@@ -143,6 +143,7 @@ public:
     }
   }
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
@@ -140,7 +140,8 @@ public:
     }
   }
 
-  midi2::input_state_machine m_processing{this->configuration};
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 
 }
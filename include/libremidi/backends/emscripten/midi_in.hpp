@@ -33,6 +33,7 @@ public:
 private:
   int m_portNumber{};
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
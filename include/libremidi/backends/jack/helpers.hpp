@@ -1,6 +1,7 @@
 #pragma once
 
 #include <libremidi/backends/jack/error_domain.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/semaphore.hpp>
 
@@ -9,6 +10,7 @@
 #include <cstring>
 #include <memory>
 #include <thread>
+#include <vector>
 
 NAMESPACE_LIBREMIDI
 {
@@ -260,6 +262,10 @@ public:
     ringbuffer = other.ringbuffer;
     ringbuffer_space = other.ringbuffer_space;
     other.ringbuffer = nullptr;
+    m_coalescing = std::move(other.m_coalescing);
+    m_events = std::move(other.m_events);
+    m_bytes = std::move(other.m_bytes);
+    m_ump = other.m_ump;
     return *this;
   }
 
@@ -289,8 +295,25 @@ public:
     return stdx::error{};
   }
 
-  void read(void* jack_events) const noexcept
+  //! Only the latest value of each controller is sent per cycle, see coalescing_table.
+  //! The events are UMP for the MIDI 2 backend, else MIDI 1 bytes.
+  void coalesce(bool ump)
   {
+    m_coalescing = ump ? make_coalescing_table<libremidi::ump>(true)
+                       : make_coalescing_table<libremidi::message>(true);
+    m_events.resize(ringbuffer_space / (size_sz + 1));
+    m_bytes.resize(ringbuffer_space);
+    m_ump = ump;
+  }
+
+  //! Moves the queued events to the port buffer of the cycle.
+  //! Returns the number of events dropped because the port buffer was full.
+  std::size_t read(void* jack_events) noexcept
+  {
+    if (m_coalescing)
+      return read_coalesced(jack_events);
+
+    std::size_t dropped = 0;
     int32_t sz;
     while (jack.ringbuffer.peek(ringbuffer, reinterpret_cast<char*>(&sz), size_sz) == size_sz
            && jack.ringbuffer.read_space(ringbuffer) >= size_sz + sz)
@@ -300,13 +323,82 @@ public:
       if (auto midi = jack.midi.event_reserve(jack_events, 0, sz))
         jack.ringbuffer.read(ringbuffer, reinterpret_cast<char*>(midi), sz);
       else
+      {
         jack.ringbuffer.read_advance(ringbuffer, sz);
+        dropped++;
+      }
     }
+    return dropped;
   }
 
   const libjack& jack = libjack::instance();
   jack_ringbuffer_t* ringbuffer{};
   std::size_t ringbuffer_space{}; // actual writable size, usually 1 less than ringbuffer
+
+private:
+  struct event
+  {
+    std::size_t offset{};
+    int32_t size{};
+    bool keep{};
+  };
+
+  int coalescing_key(const event& ev) const noexcept
+  {
+    const unsigned char* bytes = m_bytes.data() + ev.offset;
+    if (m_ump)
+    {
+      if (ev.size < 4)
+        return coalescing_table::barrier;
+      uint32_t word;
+      std::memcpy(&word, bytes, 4);
+      return coalescing_table::key(word);
+    }
+
+    if (ev.size < 1)
+      return coalescing_table::pass;
+    return coalescing_table::key(bytes[0], ev.size > 1 ? bytes[1] : 0);
+  }
+
+  // Takes all the events of the cycle out of the ring buffer, before deciding which are sent
+  std::size_t read_coalesced(void* jack_events) noexcept
+  {
+    std::size_t n = 0;
+    std::size_t used = 0;
+    int32_t sz;
+    while (n < m_events.size()
+           && jack.ringbuffer.peek(ringbuffer, reinterpret_cast<char*>(&sz), size_sz) == size_sz
+           && jack.ringbuffer.read_space(ringbuffer) >= size_sz + sz
+           && used + sz <= m_bytes.size())
+    {
+      jack.ringbuffer.read_advance(ringbuffer, size_sz);
+      jack.ringbuffer.read(ringbuffer, reinterpret_cast<char*>(m_bytes.data() + used), sz);
+      m_events[n++] = {.offset = used, .size = sz};
+      used += sz;
+    }
+
+    m_coalescing->begin();
+    for (std::size_t i = n; i-- > 0;)
+      m_events[i].keep = m_coalescing->keep(coalescing_key(m_events[i]));
+
+    std::size_t dropped = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      const auto& ev = m_events[i];
+      if (!ev.keep)
+        continue;
+      if (auto midi = jack.midi.event_reserve(jack_events, 0, ev.size))
+        std::memcpy(midi, m_bytes.data() + ev.offset, ev.size);
+      else
+        dropped++;
+    }
+    return dropped;
+  }
+
+  std::unique_ptr<coalescing_table> m_coalescing;
+  std::vector<event> m_events;
+  std::vector<unsigned char> m_bytes;
+  bool m_ump{};
 };
 
 struct jack_midi1
@@ -168,6 +168,7 @@ struct libjack
       LIBREMIDI_SYMBOL_INIT(jack_midi, event_write)
       LIBREMIDI_SYMBOL_INIT(jack_midi, event_reserve)
       LIBREMIDI_SYMBOL_INIT(jack_midi, clear_buffer)
+      LIBREMIDI_SYMBOL_INIT(jack_midi, get_lost_event_count)
     }
     bool available{true};
 
@@ -176,6 +177,7 @@ struct libjack
     LIBREMIDI_SYMBOL_DEF(jack_midi, event_write)
     LIBREMIDI_SYMBOL_DEF(jack_midi, event_reserve)
     LIBREMIDI_SYMBOL_DEF(jack_midi, clear_buffer)
+    LIBREMIDI_SYMBOL_DEF(jack_midi, get_lost_event_count)
   } midi{library};
 
   struct ringbuffer_t
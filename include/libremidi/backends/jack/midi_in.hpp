@@ -20,6 +20,10 @@ public:
   {
   } configuration;
 
+  // With coalesce_controllers in callback mode, the messages of each cycle are coalesced
+  std::unique_ptr<cycle_coalescer<message>> m_coalescer{
+      cycle_coalescer<message>::install(configuration)};
+
   explicit midi_in_jack(input_configuration&& conf, jack_input_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
   {
@@ -111,9 +115,20 @@ public:
           m_processing.timestamp<timestamp_info>(to_ns, event.time));
     }
 
+    if (m_coalescer)
+      m_coalescer->flush();
+
+    // Events which did not fit in the buffer of the port in this cycle
+    if (const auto lost = jack.midi.get_lost_event_count(buff); lost > 0)
+    {
+      atomic_port_counters::add(this->counters.dropped, lost);
+      this->counters.overrun(this->configuration.on_overrun);
+    }
+
     return 0;
   }
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
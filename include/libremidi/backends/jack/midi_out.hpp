@@ -67,6 +67,9 @@ public:
       : midi_out_jack{std::move(conf), std::move(apiconf)}
       , m_queue{configuration.ringbuffer_size}
   {
+    if (configuration.coalesce_controllers)
+      m_queue.coalesce(false);
+
     auto status = connect(*this);
     if (!this->client)
     {
@@ -95,7 +98,11 @@ public:
     void* buff = jack.port.get_buffer(this->port, nframes);
     jack.midi.clear_buffer(buff);
 
-    this->m_queue.read(buff);
+    if (const auto dropped = this->m_queue.read(buff))
+    {
+      atomic_port_counters::add(this->counters.dropped, dropped);
+      this->counters.overrun(this->configuration.on_overrun);
+    }
 
     return 0;
   }
@@ -20,6 +20,9 @@ public:
   {
   } configuration;
 
+  // With coalesce_controllers in callback mode, the messages of each cycle are coalesced
+  std::unique_ptr<cycle_coalescer<ump>> m_coalescer{cycle_coalescer<ump>::install(configuration)};
+
   explicit midi_in_jack(
       libremidi::ump_input_configuration&& conf, jack_ump::input_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
@@ -108,14 +111,25 @@ public:
       const auto to_ns
           = [=, this] { return 1000 * jack.frames_to_time(client, current_frames + event.time); };
 
-      m_processing.on_bytes(
+      m_processing.on_bytes_multi(
           {(uint32_t*)event.buffer, (uint32_t*)(event.buffer + event.size)},
           m_processing.timestamp<timestamp_info>(to_ns, event.time));
     }
 
+    if (m_coalescer)
+      m_coalescer->flush();
+
+    // Events which did not fit in the buffer of the port in this cycle
+    if (const auto lost = jack.midi.get_lost_event_count(buff); lost > 0)
+    {
+      atomic_port_counters::add(this->counters.dropped, lost);
+      this->counters.overrun(this->configuration.on_overrun);
+    }
+
     return 0;
   }
 
-  midi2::input_state_machine m_processing{this->configuration};
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
@@ -194,6 +194,7 @@ struct libasound
       LIBREMIDI_SYMBOL_INIT(snd_rawmidi, read)
       LIBREMIDI_SYMBOL_INIT(snd_rawmidi, status)
       LIBREMIDI_SYMBOL_INIT(snd_rawmidi, status_get_avail)
+      LIBREMIDI_SYMBOL_INIT(snd_rawmidi, status_get_xruns)
       LIBREMIDI_SYMBOL_INIT(snd_rawmidi, status_sizeof)
       LIBREMIDI_SYMBOL_INIT(snd_rawmidi, tread)
       LIBREMIDI_SYMBOL_INIT(snd_rawmidi, write)
@@ -222,6 +223,7 @@ struct libasound
     LIBREMIDI_SYMBOL_DEF(snd_rawmidi, read)
     LIBREMIDI_SYMBOL_DEF(snd_rawmidi, status)
     LIBREMIDI_SYMBOL_DEF(snd_rawmidi, status_get_avail)
+    LIBREMIDI_SYMBOL_DEF(snd_rawmidi, status_get_xruns)
     LIBREMIDI_SYMBOL_DEF(snd_rawmidi, status_sizeof)
     LIBREMIDI_SYMBOL_DEF(snd_rawmidi, tread)
     LIBREMIDI_SYMBOL_DEF(snd_rawmidi, write)
@@ -0,0 +1,102 @@
+#pragma once
+#include <libremidi/config.hpp>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+NAMESPACE_LIBREMIDI
+{
+//! The descriptors of an input or observer driven by the application, with manual_dispatch.
+//! The epoll descriptor is readable while one of them is: the application waits on it
+//! with its own event loop, then calls dispatch(), which runs the handlers of the ready
+//! descriptors without blocking. Not thread-safe: everything happens on the thread of the
+//! application, and no thread is started.
+class epoll_dispatcher
+{
+public:
+  //! Called with the epoll events of the descriptor. Returning false deregisters it.
+  using handler = std::function<bool(uint32_t events)>;
+
+  epoll_dispatcher()
+      : m_epoll{::epoll_create1(EPOLL_CLOEXEC)}
+  {
+  }
+
+  ~epoll_dispatcher()
+  {
+    if (m_epoll >= 0)
+      ::close(m_epoll);
+  }
+
+  epoll_dispatcher(const epoll_dispatcher&) = delete;
+  epoll_dispatcher& operator=(const epoll_dispatcher&) = delete;
+
+  [[nodiscard]] int descriptor() const noexcept { return m_epoll; }
+
+  //! Returns an identifier for remove(), or a negative error code.
+  //! Level-triggered: a handler which does not read everything is called again
+  //! on the next dispatch().
+  int64_t add(int fd, handler h)
+  {
+    const uint64_t id = ++m_last_id;
+    epoll_event ev{.events = EPOLLIN, .data = {.u64 = id}};
+    if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+      return -errno;
+
+    m_handlers.emplace(id, registration{fd, std::make_shared<handler>(std::move(h))});
+    return static_cast<int64_t>(id);
+  }
+
+  //! Can be called from a handler, e.g. when a port is closed from a callback
+  void remove(int64_t id)
+  {
+    if (auto it = m_handlers.find(id); it != m_handlers.end())
+    {
+      ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, it->second.fd, nullptr);
+      m_handlers.erase(it);
+    }
+  }
+
+  //! Runs the handlers of the ready descriptors.
+  //! Returns how many were ready, or a negative error code.
+  int dispatch()
+  {
+    std::array<epoll_event, 16> events;
+    const int n = ::epoll_wait(m_epoll, events.data(), events.size(), 0);
+    if (n < 0)
+      return errno == EINTR ? 0 : -errno;
+
+    for (int i = 0; i < n; i++)
+    {
+      const auto id = static_cast<int64_t>(events[i].data.u64);
+      auto it = m_handlers.find(id);
+      if (it == m_handlers.end())
+        continue;
+
+      // Kept alive if the handler removes itself
+      auto h = it->second.h;
+      if (!(*h)(events[i].events))
+        remove(id);
+    }
+    return n;
+  }
+
+private:
+  struct registration
+  {
+    int fd{-1};
+    std::shared_ptr<handler> h;
+  };
+
+  int m_epoll{-1};
+  std::unordered_map<int64_t, registration> m_handlers;
+  uint64_t m_last_id{};
+};
+}
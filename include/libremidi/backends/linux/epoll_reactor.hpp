@@ -0,0 +1,203 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/error.hpp>
+#include <libremidi/backends/linux/helpers.hpp>
+#include <libremidi/backends/linux/thread.hpp>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+NAMESPACE_LIBREMIDI
+{
+//! A single thread waiting on the file descriptors of every device of the process,
+//! through an edge-triggered epoll set: handlers must read until the descriptor would block.
+//! Descriptors are registered and deregistered while the thread runs.
+//! The handlers run without any lock held: they can open and close devices themselves.
+class epoll_reactor : public std::enable_shared_from_this<epoll_reactor>
+{
+public:
+  //! Called with the epoll events of the descriptor. Returning false deregisters it.
+  using handler = std::function<bool(uint32_t events)>;
+
+  //! The reactor of the process, started on first use and stopped with its last user.
+  //! Returns nullptr if it cannot be started.
+  //! The thread configuration is the one of the user which starts the reactor.
+  static std::shared_ptr<epoll_reactor> instance(const thread_configuration& thread = {})
+  {
+    static std::mutex mutex;
+    static std::weak_ptr<epoll_reactor> current;
+
+    std::lock_guard lock{mutex};
+    if (auto r = current.lock())
+      return r;
+
+    auto r = std::make_shared<epoll_reactor>();
+    if (r->m_epoll < 0 || r->m_termination_event < 0 || !r->start(thread))
+      return nullptr;
+    current = r;
+    return r;
+  }
+
+  epoll_reactor()
+      : m_epoll{::epoll_create1(EPOLL_CLOEXEC)}
+  {
+    // Registration 0 is the termination event
+    epoll_event ev{.events = EPOLLIN, .data = {.u64 = 0}};
+    if (m_epoll >= 0 && ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_termination_event, &ev) < 0)
+    {
+      ::close(m_epoll);
+      m_epoll = -1;
+    }
+  }
+
+  ~epoll_reactor()
+  {
+    m_termination_event.notify();
+    if (m_thread.get_id() == std::this_thread::get_id())
+    {
+      // The last user was closed by a handler: run() returns without touching this
+      m_thread.detach();
+    }
+    else if (m_thread.joinable())
+    {
+      m_thread.join();
+    }
+    if (m_epoll >= 0)
+      ::close(m_epoll);
+  }
+
+  epoll_reactor(const epoll_reactor&) = delete;
+  epoll_reactor& operator=(const epoll_reactor&) = delete;
+
+  //! Returns an identifier for remove(), or a negative error code.
+  //! If the descriptor is already readable, the handler is called right away.
+  int64_t add(int fd, handler h)
+  {
+    std::lock_guard lock{m_mutex};
+    const uint64_t id = ++m_last_id;
+    epoll_event ev{.events = EPOLLIN | EPOLLET, .data = {.u64 = id}};
+    if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+      return -errno;
+
+    m_handlers.emplace(id, registration{fd, std::make_shared<handler>(std::move(h))});
+    return static_cast<int64_t>(id);
+  }
+
+  //! Once this returns, the handler is not running and will not be called again,
+  //! unless this is called from the reactor thread.
+  void remove(int64_t id)
+  {
+    std::unique_lock lock{m_mutex};
+    remove_locked(id);
+    if (std::this_thread::get_id() != m_thread.get_id())
+      m_idle.wait(lock, [this, id] { return m_running != id; });
+  }
+
+private:
+  struct registration
+  {
+    int fd{-1};
+    std::shared_ptr<handler> h;
+  };
+
+  bool start(const thread_configuration& thread)
+  {
+    try
+    {
+      m_thread = std::thread{[this, weak = weak_from_this(), thread] {
+        apply_thread_configuration(thread);
+        run(weak);
+      }};
+      return true;
+    }
+    catch (const std::system_error& e)
+    {
+      LIBREMIDI_LOG("error starting the epoll thread: ", e.what());
+      return false;
+    }
+  }
+
+  void remove_locked(int64_t id)
+  {
+    if (auto it = m_handlers.find(id); it != m_handlers.end())
+    {
+      ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, it->second.fd, nullptr);
+      m_handlers.erase(it);
+    }
+  }
+
+  void run(const std::weak_ptr<epoll_reactor>& weak)
+  {
+    std::array<epoll_event, 64> events;
+    while (!weak.expired())
+    {
+      const int n = ::epoll_wait(m_epoll, events.data(), events.size(), -1);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+
+      // The handlers may close the last user: the reactor is then destroyed with self
+      auto self = weak.lock();
+      if (!self)
+        return;
+      for (int i = 0; i < n; i++)
+      {
+        const auto id = static_cast<int64_t>(events[i].data.u64);
+        if (id == 0)
+          return;
+        invoke(id, events[i].events);
+      }
+    }
+  }
+
+  // Calls a handler outside of the lock: remove() waits for it
+  void invoke(int64_t id, uint32_t events)
+  {
+    std::unique_lock lock{m_mutex};
+    auto it = m_handlers.find(id);
+    if (it == m_handlers.end())
+      return;
+
+    // Kept alive if the handler removes itself
+    auto h = it->second.h;
+    m_running = id;
+    lock.unlock();
+
+    const bool keep = (*h)(events);
+    h.reset();
+
+    lock.lock();
+    if (!keep)
+      remove_locked(id);
+    m_running = 0;
+    lock.unlock();
+    m_idle.notify_all();
+  }
+
+  int m_epoll{-1};
+  eventfd_notifier m_termination_event{};
+
+  // The table, and the registration whose handler the thread is running
+  std::mutex m_mutex;
+  std::condition_variable m_idle;
+  std::unordered_map<int64_t, registration> m_handlers;
+  uint64_t m_last_id{};
+  int64_t m_running{};
+
+  std::thread m_thread;
+};
+}
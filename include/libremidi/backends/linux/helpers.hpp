@@ -52,15 +52,15 @@ struct timerfd_timer
   void oneshot(int64_t nsec)
   {
     itimerspec t{};
-    t.it_value.tv_nsec = nsec;
+    t.it_value = to_timespec(nsec);
     timerfd_settime(this->fd, 0, &t, nullptr);
   }
 
   void restart(int64_t nsec)
   {
     itimerspec t{};
-    t.it_value.tv_nsec = nsec;
-    t.it_interval.tv_nsec = nsec;
+    t.it_value = to_timespec(nsec);
+    t.it_interval = t.it_value;
     timerfd_settime(this->fd, 0, &t, nullptr);
   }
 
@@ -73,5 +73,11 @@ struct timerfd_timer
   operator int() const noexcept { return fd; }
   operator pollfd() const noexcept { return {.fd = fd, .events = POLLIN, .revents = 0}; }
   int fd{-1};
+
+private:
+  static timespec to_timespec(int64_t nsec) noexcept
+  {
+    return {.tv_sec = nsec / 1'000'000'000, .tv_nsec = nsec % 1'000'000'000};
+  }
 };
 }
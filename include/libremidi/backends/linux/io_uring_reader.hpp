@@ -0,0 +1,564 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/error.hpp>
+#include <libremidi/backends/linux/helpers.hpp>
+#include <libremidi/backends/linux/thread.hpp>
+
+#if __has_include(<linux/io_uring.h>)
+  #include <linux/io_uring.h>
+#endif
+
+// Provided buffer rings: Linux 5.19
+#if defined(IORING_SETUP_COOP_TASKRUN)
+  #define LIBREMIDI_HAS_IO_URING 1
+
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+
+  #include <algorithm>
+  #include <atomic>
+  #include <cerrno>
+  #include <condition_variable>
+  #include <cstdint>
+  #include <cstring>
+  #include <functional>
+  #include <future>
+  #include <memory>
+  #include <mutex>
+  #include <span>
+  #include <system_error>
+  #include <thread>
+  #include <unordered_map>
+  #include <utility>
+  #include <vector>
+
+NAMESPACE_LIBREMIDI
+{
+//! A single thread reading the file descriptors of every device of the process through an
+//! io_uring: each descriptor has a read in flight, completed into a ring of buffers
+//! registered with the kernel, so that a single system call submits the reads and waits
+//! for the data of all the devices.
+//! Reads are multishot when the kernel supports it (Linux 6.7): a single submission
+//! then keeps delivering data until the descriptor is removed.
+//! The descriptors must be non-blocking and pollable.
+class io_uring_reader : public std::enable_shared_from_this<io_uring_reader>
+{
+public:
+  //! Called with the bytes read from the descriptor. Returning false deregisters it.
+  //! Reading stops without calling it again at end of file or on a read error.
+  using handler = std::function<bool(std::span<const uint8_t> bytes)>;
+
+  static constexpr unsigned ring_entries = 256;
+  static constexpr unsigned buffer_count = 256;
+  static constexpr unsigned buffer_size = 1024;
+
+  //! The reader of the process, started on first use and stopped with its last user.
+  //! Returns nullptr if the kernel does not support it.
+  //! The thread configuration is the one of the user which starts the reader.
+  static std::shared_ptr<io_uring_reader> instance(const thread_configuration& thread = {})
+  {
+    static std::mutex mutex;
+    static std::weak_ptr<io_uring_reader> current;
+
+    std::lock_guard lock{mutex};
+    if (auto r = current.lock())
+      return r;
+
+    auto r = std::make_shared<io_uring_reader>();
+    if (!r->start(thread))
+      return nullptr;
+    current = r;
+    return r;
+  }
+
+  io_uring_reader() = default;
+
+  ~io_uring_reader()
+  {
+    if (m_thread.joinable())
+    {
+      {
+        std::lock_guard lock{m_mutex};
+        m_stop = true;
+      }
+      m_wake.notify();
+      if (m_thread.get_id() == std::this_thread::get_id())
+      {
+        // The last device was closed by a handler: run() returns without touching this
+        m_thread.detach();
+      }
+      else
+      {
+        m_thread.join();
+      }
+    }
+
+    if (m_buffer_ring)
+      ::munmap(m_buffer_ring, buffer_count * sizeof(io_uring_buf));
+    if (m_sqes)
+      ::munmap(m_sqes, m_sqes_size);
+    if (m_rings)
+      ::munmap(m_rings, m_rings_size);
+    if (m_fd >= 0)
+      ::close(m_fd);
+  }
+
+  io_uring_reader(const io_uring_reader&) = delete;
+  io_uring_reader& operator=(const io_uring_reader&) = delete;
+
+  //! Whether reads are multishot, or resubmitted after each completion
+  bool multishot() const noexcept { return m_multishot; }
+
+  //! Returns an identifier for remove()
+  int64_t add(int fd, handler h)
+  {
+    uint64_t id{};
+    {
+      std::lock_guard lock{m_mutex};
+      id = ++m_last_id;
+      m_registrations.emplace(id, registration{fd, std::make_shared<handler>(std::move(h))});
+      m_pending.push_back(id);
+    }
+    m_wake.notify();
+    return static_cast<int64_t>(id);
+  }
+
+  //! Once this returns, the handler is not running and will not be called again, and the
+  //! reader does not use the descriptor anymore, unless this is called from the handler.
+  void remove(int64_t id)
+  {
+    std::unique_lock lock{m_mutex};
+    auto it = m_registrations.find(id);
+    if (it == m_registrations.end())
+      return;
+
+    it->second.removed = true;
+    m_pending.push_back(id);
+    if (std::this_thread::get_id() == m_thread.get_id())
+      return;
+
+    m_wake.notify();
+    m_removed.wait(lock, [&] { return !m_registrations.contains(id) && m_running != id; });
+  }
+
+private:
+  // IORING_OP_READ_MULTISHOT: part of the kernel ABI since Linux 6.7,
+  // but missing from the older headers
+  static constexpr uint8_t op_read_multishot = 49;
+
+  static constexpr uint64_t wake_tag = 0;
+  static constexpr uint64_t cancel_tag = uint64_t(1) << 63;
+
+  struct registration
+  {
+    int fd{-1};
+    std::shared_ptr<handler> h;
+
+    // A read is in flight
+    bool armed{};
+    bool canceling{};
+    bool removed{};
+  };
+
+  // Everything happens on the reader thread, which is the only one to use the ring
+  bool start(const thread_configuration& thread)
+  {
+    std::promise<bool> ready;
+    auto res = ready.get_future();
+    try
+    {
+      m_thread = std::thread{[this, &ready, weak = weak_from_this(), thread] {
+        apply_thread_configuration(thread);
+        run(ready, weak);
+      }};
+    }
+    catch (const std::system_error& e)
+    {
+      LIBREMIDI_LOG("error starting the io_uring thread: ", e.what());
+      return false;
+    }
+
+    if (res.get())
+      return true;
+
+    m_thread.join();
+    return false;
+  }
+
+  static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept
+  {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+  }
+
+  static int register_op(int fd, unsigned op, void* arg, unsigned count) noexcept
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, op, arg, count));
+  }
+
+  bool init()
+  {
+    if (m_wake < 0)
+      return false;
+
+    // Completions are only processed by the reader thread when it waits for them
+    io_uring_params p{};
+  #if defined(IORING_SETUP_DEFER_TASKRUN)
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+  #else
+    p.flags = IORING_SETUP_COOP_TASKRUN;
+  #endif
+    m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, ring_entries, &p));
+    if (m_fd < 0 && errno == EINVAL)
+    {
+      p = {};
+      m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, ring_entries, &p));
+    }
+    if (m_fd < 0 || !(p.features & IORING_FEAT_SINGLE_MMAP))
+      return false;
+
+    m_rings_size = std::max(
+        p.sq_off.array + p.sq_entries * sizeof(unsigned),
+        p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+    m_rings = ::mmap(
+        nullptr, m_rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+        IORING_OFF_SQ_RING);
+    if (m_rings == MAP_FAILED)
+    {
+      m_rings = nullptr;
+      return false;
+    }
+
+    m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(
+        nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+        IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      return false;
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto* base = static_cast<char*>(m_rings);
+    m_sq_head = reinterpret_cast<unsigned*>(base + p.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(base + p.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*>(base + p.sq_off.ring_mask);
+    m_sq_entries = p.sq_entries;
+    m_sq_array = reinterpret_cast<unsigned*>(base + p.sq_off.array);
+    m_cq_head = reinterpret_cast<unsigned*>(base + p.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(base + p.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*>(base + p.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(base + p.cq_off.cqes);
+    m_sq_local_tail = *m_sq_tail;
+
+    return init_buffers() && init_probe();
+  }
+
+  bool init_buffers()
+  {
+    void* ring = ::mmap(
+        nullptr, buffer_count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+      return false;
+    m_buffer_ring = static_cast<io_uring_buf*>(ring);
+    m_buffers.resize(buffer_count * buffer_size);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(m_buffer_ring);
+    reg.ring_entries = buffer_count;
+    reg.bgid = 0;
+    if (register_op(m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+      return false;
+
+    for (unsigned i = 0; i < buffer_count; i++)
+      recycle(static_cast<uint16_t>(i));
+    return true;
+  }
+
+  bool init_probe()
+  {
+    std::vector<char> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (register_op(m_fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+      return true;
+
+    m_multishot = probe->last_op >= op_read_multishot
+                  && (probe->ops[op_read_multishot].flags & IO_URING_OP_SUPPORTED);
+    return true;
+  }
+
+  // Gives a buffer back to the kernel.
+  // The ring is an array of io_uring_buf whose first reserved field is the tail:
+  // io_uring_buf_ring itself cannot be used as its flexible array is misplaced in C++.
+  void recycle(uint16_t bid) noexcept
+  {
+    auto& buf = m_buffer_ring[m_buffer_tail & (buffer_count - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(m_buffers.data() + bid * buffer_size);
+    buf.len = buffer_size;
+    buf.bid = bid;
+    m_buffer_tail++;
+    std::atomic_ref<uint16_t>{m_buffer_ring[0].resv}.store(
+        m_buffer_tail, std::memory_order_release);
+  }
+
+  io_uring_sqe& next_sqe()
+  {
+    // Full: submits what is queued to make room
+    if (m_sq_local_tail - std::atomic_ref<unsigned>{*m_sq_head}.load(std::memory_order_acquire)
+        >= m_sq_entries)
+      enter(m_fd, flush(), 0, 0);
+
+    const unsigned index = m_sq_local_tail & m_sq_mask;
+    m_sq_array[index] = index;
+    m_sq_local_tail++;
+    m_unsubmitted++;
+
+    auto& sqe = m_sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    return sqe;
+  }
+
+  // Publishes the queued submissions; returns their count
+  unsigned flush() noexcept
+  {
+    std::atomic_ref<unsigned>{*m_sq_tail}.store(m_sq_local_tail, std::memory_order_release);
+    return std::exchange(m_unsubmitted, 0);
+  }
+
+  void arm_wake()
+  {
+    auto& sqe = next_sqe();
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = m_wake;
+    sqe.addr = reinterpret_cast<uint64_t>(&m_wake_value);
+    sqe.len = sizeof(m_wake_value);
+    sqe.off = uint64_t(-1);
+    sqe.user_data = wake_tag;
+  }
+
+  void arm_read(uint64_t id, int fd)
+  {
+    auto& sqe = next_sqe();
+    sqe.opcode = m_multishot ? op_read_multishot : uint8_t(IORING_OP_READ);
+    sqe.fd = fd;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = 0;
+    sqe.len = m_multishot ? 0 : buffer_size;
+    sqe.off = uint64_t(-1);
+    sqe.user_data = id;
+  }
+
+  void cancel(uint64_t id)
+  {
+    auto& sqe = next_sqe();
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.addr = id;
+    sqe.user_data = id | cancel_tag;
+  }
+
+  // Arms the new registrations and the ones whose read completed, cancels the removed ones
+  void update_registrations()
+  {
+    bool erased = false;
+    for (auto id : m_pending)
+    {
+      auto it = m_registrations.find(id);
+      if (it == m_registrations.end())
+        continue;
+
+      auto& reg = it->second;
+      if (reg.removed)
+      {
+        if (!reg.armed)
+        {
+          m_registrations.erase(it);
+          erased = true;
+        }
+        else if (!reg.canceling)
+        {
+          cancel(id);
+          reg.canceling = true;
+        }
+      }
+      else if (!reg.armed)
+      {
+        arm_read(id, reg.fd);
+        reg.armed = true;
+      }
+    }
+    m_pending.clear();
+
+    if (erased)
+      m_removed.notify_all();
+  }
+
+  void on_completion(const io_uring_cqe& cqe, std::unique_lock<std::mutex>& lock)
+  {
+    const uint64_t id = cqe.user_data;
+    const bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+    const auto bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+    auto it = m_registrations.find(id);
+    if (it == m_registrations.end())
+    {
+      if (has_buffer)
+        recycle(bid);
+      return;
+    }
+
+    auto& reg = it->second;
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+      reg.armed = false;
+      m_pending.push_back(id);
+    }
+
+    if (cqe.res > 0 && has_buffer)
+    {
+      if (!reg.removed)
+        invoke(id, reg.h, {m_buffers.data() + bid * buffer_size, std::size_t(cqe.res)}, lock);
+      recycle(bid);
+    }
+    else if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -EAGAIN
+                              && cqe.res != -EINTR && cqe.res != -ECANCELED))
+    {
+      if (cqe.res < 0 && !reg.removed)
+        LIBREMIDI_LOG("io_uring read error: ", std::strerror(-cqe.res));
+      reg.removed = true;
+      m_pending.push_back(id);
+    }
+  }
+
+  // Calls a handler outside of the lock: remove() waits for it.
+  // h is kept alive if the handler removes itself; the buffer stays ours until it is
+  // recycled, and only this thread uses the rings.
+  void invoke(
+      uint64_t id, std::shared_ptr<handler> h, std::span<const uint8_t> bytes,
+      std::unique_lock<std::mutex>& lock)
+  {
+    m_running = id;
+    lock.unlock();
+
+    const bool keep = (*h)(bytes);
+    h.reset();
+
+    lock.lock();
+    m_running = 0;
+    if (!keep)
+    {
+      if (auto it = m_registrations.find(id); it != m_registrations.end())
+      {
+        it->second.removed = true;
+        m_pending.push_back(id);
+      }
+    }
+    m_removed.notify_all();
+  }
+
+  void process_completions(std::unique_lock<std::mutex>& lock)
+  {
+    unsigned head = *m_cq_head;
+    const unsigned tail = std::atomic_ref<unsigned>{*m_cq_tail}.load(std::memory_order_acquire);
+    for (; head != tail; head++)
+    {
+      const auto& cqe = m_cqes[head & m_cq_mask];
+      if (cqe.user_data == wake_tag)
+        arm_wake();
+      else if (!(cqe.user_data & cancel_tag))
+        on_completion(cqe, lock);
+    }
+    std::atomic_ref<unsigned>{*m_cq_head}.store(head, std::memory_order_release);
+  }
+
+  // Nothing will be read anymore
+  void stop_reading()
+  {
+    std::lock_guard lock{m_mutex};
+    m_registrations.clear();
+    m_removed.notify_all();
+  }
+
+  void run(std::promise<bool>& ready, const std::weak_ptr<io_uring_reader>& weak)
+  {
+    if (!init())
+    {
+      ready.set_value(false);
+      return;
+    }
+
+    {
+      std::lock_guard lock{m_mutex};
+      arm_wake();
+    }
+    ready.set_value(true);
+
+    for (;;)
+    {
+      unsigned to_submit{};
+      {
+        // The handlers may close the last device: the reader is then destroyed with self,
+        // after the lock is released
+        auto self = weak.lock();
+        if (!self)
+          return;
+        std::unique_lock lock{m_mutex};
+        process_completions(lock);
+        if (m_stop)
+          break;
+        update_registrations();
+        to_submit = flush();
+      }
+      if (weak.expired())
+        return;
+
+      const int res = enter(m_fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+      if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+      {
+        LIBREMIDI_LOG("io_uring wait error: ", std::strerror(errno));
+        break;
+      }
+    }
+
+    stop_reading();
+  }
+
+  int m_fd{-1};
+  void* m_rings{};
+  std::size_t m_rings_size{};
+  io_uring_sqe* m_sqes{};
+  std::size_t m_sqes_size{};
+
+  unsigned* m_sq_head{};
+  unsigned* m_sq_tail{};
+  unsigned* m_sq_array{};
+  unsigned m_sq_mask{};
+  unsigned m_sq_entries{};
+  unsigned m_sq_local_tail{};
+  unsigned m_unsubmitted{};
+
+  unsigned* m_cq_head{};
+  unsigned* m_cq_tail{};
+  unsigned m_cq_mask{};
+  io_uring_cqe* m_cqes{};
+
+  io_uring_buf* m_buffer_ring{};
+  std::vector<uint8_t> m_buffers;
+  uint16_t m_buffer_tail{};
+  bool m_multishot{};
+
+  eventfd_notifier m_wake{false};
+  uint64_t m_wake_value{};
+
+  // The registrations, and the one whose handler the thread is running
+  std::mutex m_mutex;
+  std::condition_variable m_removed;
+  std::unordered_map<uint64_t, registration> m_registrations;
+  std::vector<uint64_t> m_pending;
+  uint64_t m_last_id{};
+  uint64_t m_running{};
+  bool m_stop{};
+
+  std::thread m_thread;
+};
+}
+#endif
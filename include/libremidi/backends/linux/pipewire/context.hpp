@@ -8,6 +8,7 @@
 #endif
 
 #include <libremidi/backends/linux/pipewire/instance.hpp>
+#include <libremidi/backends/linux/thread.hpp>
 #include <libremidi/backends/linux/pipewire/loader.hpp>
 #include <libremidi/backends/linux/pipewire/subscription.hpp>
 #include <libremidi/backends/linux/pipewire/types.hpp>
@@ -75,6 +76,9 @@ struct context_config
   pw_thread_loop* borrow_thread_loop{};
   pw_main_loop* borrow_main_loop{};
   pw_core* borrow_core{};
+
+  // Applied to the thread of the loop when libremidi starts it, not to borrowed loops
+  thread_configuration thread{};
 };
 
 class context : public std::enable_shared_from_this<context>
@@ -769,6 +773,7 @@ private:
     {
       if (pw.thread_loop_start(m_thread_loop) < 0)
         return false;
+      invoke_async([thread = m_cfg.thread] { apply_thread_configuration(thread); });
     }
 
     m_state.store(connection_state::connecting, std::memory_order_release);
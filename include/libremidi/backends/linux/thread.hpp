@@ -0,0 +1,115 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/error.hpp>
+#include <libremidi/thread_configuration.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <alloca.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+NAMESPACE_LIBREMIDI
+{
+// Touches the stack so that its pages are mapped before they are needed
+[[gnu::noinline]] inline void prefault_thread_stack(std::size_t bytes) noexcept
+{
+  if (bytes == 0)
+    return;
+  auto* stack = static_cast<volatile char*>(alloca(bytes));
+  for (std::size_t i = 0; i < bytes; i += 4096)
+    stack[i] = 0;
+}
+
+//! Applies a thread configuration to the calling thread. Never fails: what cannot be
+//! applied is left as is, and reported.
+inline thread_report apply_thread_configuration(const thread_configuration& conf) noexcept
+{
+  thread_report report;
+  const auto fail = [&report](int err) {
+    if (report.error == stdx::error{})
+      report.error = from_errc(-err);
+  };
+
+  const pthread_t self = pthread_self();
+
+  if (!conf.name.empty())
+  {
+    const std::string name = conf.name.substr(0, 15);
+    if (int err = pthread_setname_np(self, name.c_str()); err == 0)
+      report.name_applied = true;
+    else
+      fail(err);
+  }
+
+  if (!conf.cpu_affinity.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : conf.cpu_affinity)
+      if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+
+    if (int err = pthread_setaffinity_np(self, sizeof(set), &set); err == 0)
+      report.affinity_applied = true;
+    else
+      fail(err);
+  }
+
+  if (conf.policy != thread_policy::Default)
+  {
+    const int policy = conf.policy == thread_policy::Fifo ? SCHED_FIFO : SCHED_RR;
+    sched_param param{};
+    param.sched_priority = std::clamp(
+        conf.priority, sched_get_priority_min(policy), sched_get_priority_max(policy));
+
+    int err = pthread_setschedparam(self, policy, &param);
+    if (err == EPERM)
+    {
+      // Without CAP_SYS_NICE, an unprivileged process may still be allowed a lower priority
+      if (rlimit lim{}; getrlimit(RLIMIT_RTPRIO, &lim) == 0 && lim.rlim_cur > 0
+                        && param.sched_priority > int(lim.rlim_cur))
+      {
+        param.sched_priority = int(lim.rlim_cur);
+        err = pthread_setschedparam(self, policy, &param);
+      }
+    }
+    if (err != 0)
+      fail(err);
+  }
+
+  if (conf.lock_memory)
+  {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+      report.memory_locked = true;
+    else
+      fail(errno);
+  }
+
+  prefault_thread_stack(conf.stack_prefault);
+
+  // What the thread actually got
+  int policy{};
+  sched_param param{};
+  if (pthread_getschedparam(self, &policy, &param) == 0)
+  {
+    report.policy = policy == SCHED_FIFO ? thread_policy::Fifo
+                    : policy == SCHED_RR ? thread_policy::RoundRobin
+                                         : thread_policy::Default;
+    report.priority = param.sched_priority;
+  }
+
+  if (report.error != stdx::error{})
+    LIBREMIDI_LOG("thread configuration not fully applied: ", report.error.message().data());
+
+  if (conf.on_started)
+    conf.on_started(report);
+  return report;
+}
+}
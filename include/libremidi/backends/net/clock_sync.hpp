@@ -0,0 +1,322 @@
+#pragma once
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+NAMESPACE_LIBREMIDI
+{
+//! Address of the clock synchronization messages exchanged by libremidi OSC peers.
+//! A request carries the sender time as a single timetag argument: ",t".
+//! The reply echoes it, followed by the times at which the receiver got the request
+//! and answered it, on the receiver clock: ",ttt".
+//! Timetags are nanoseconds of the monotonic clock of each peer.
+inline constexpr std::string_view osc_clock_address = "/libremidi/clock";
+
+LIBREMIDI_STATIC std::vector<uint8_t> write_osc_clock(std::span<const int64_t> times)
+{
+  std::vector<uint8_t> res{osc_clock_address.begin(), osc_clock_address.end()};
+  res.resize((res.size() / 4 + 1) * 4, 0);
+
+  res.push_back(',');
+  res.insert(res.end(), times.size(), 't');
+  res.resize((res.size() / 4 + 1) * 4, 0);
+
+  byte_writer w{res};
+  for (auto t : times)
+    w.u64(static_cast<uint64_t>(t));
+  return res;
+}
+
+struct osc_clock_message
+{
+  std::array<int64_t, 3> times{};
+
+  //! 1 for a request, 3 for a reply
+  std::size_t count{};
+};
+
+//! The timetags of a clock message, or nothing if the datagram is something else
+LIBREMIDI_STATIC std::optional<osc_clock_message>
+parse_osc_clock(const char* data, std::size_t sz)
+{
+  // The address and its null terminator, padded to 4 bytes
+  static constexpr std::size_t address_size = (osc_clock_address.size() / 4 + 1) * 4;
+  if (sz < address_size + 4
+      || std::string_view{data, osc_clock_address.size()} != osc_clock_address
+      || data[osc_clock_address.size()] != 0)
+    return std::nullopt;
+
+  byte_reader r{{reinterpret_cast<const uint8_t*>(data) + address_size, sz - address_size}};
+  if (r.u8() != ',')
+    return std::nullopt;
+
+  osc_clock_message msg;
+  while (r.peek() == 't')
+  {
+    r.u8();
+    msg.count++;
+  }
+  if (msg.count != 1 && msg.count != 3)
+    return std::nullopt;
+
+  // ',', the type tags and their null terminator, padded to 4 bytes
+  r.pos = osc_padded_size(msg.count + 2);
+  for (std::size_t i = 0; i < msg.count; i++)
+    msg.times[i] = static_cast<int64_t>(r.u64());
+  if (!r.ok)
+    return std::nullopt;
+  return msg;
+}
+
+//! Estimates the clock of a remote peer from NTP-style exchanges:
+//! t0 request sent, t1 request received, t2 reply sent, t3 reply received,
+//! t0 and t3 on the local clock, t1 and t2 on the remote one.
+//! The offset is taken from the exchanges with the shortest round trip, which are the
+//! least disturbed by queuing, and the drift is the slope of the offset over time.
+class clock_sync_estimator
+{
+public:
+  //! Exchanges kept for the estimation
+  static constexpr std::size_t window = 16;
+
+  //! Clocks drifting more than this relative to each other are assumed to be measured wrong
+  static constexpr double max_drift = 1e-3;
+
+  void add(int64_t t0, int64_t t1, int64_t t2, int64_t t3)
+  {
+    const int64_t delay = (t3 - t0) - (t2 - t1);
+    if (t3 < t0 || delay < 0)
+      return;
+
+    if (m_samples.size() == window)
+      m_samples.pop_front();
+    m_samples.push_back(
+        {.local = t0 + (t3 - t0) / 2, .offset = ((t1 - t0) + (t2 - t3)) / 2, .delay = delay});
+    update();
+  }
+
+  bool valid() const noexcept { return !m_samples.empty(); }
+
+  //! Remote time corresponding to a local time
+  int64_t to_remote(int64_t local) const noexcept
+  {
+    return local + m_offset
+           + static_cast<int64_t>(m_drift * static_cast<double>(local - m_anchor));
+  }
+
+  //! Remote minus local time, at the anchor of the estimation
+  int64_t offset() const noexcept { return m_offset; }
+
+  //! Relative rate of the remote clock, e.g. 1e-5 when it runs 10 ppm faster
+  double drift() const noexcept { return m_drift; }
+
+  //! Round trip of the best exchange of the window
+  int64_t round_trip() const noexcept { return m_round_trip; }
+
+  void reset() noexcept
+  {
+    m_samples.clear();
+    m_offset = 0;
+    m_anchor = 0;
+    m_drift = 0.;
+    m_round_trip = 0;
+  }
+
+private:
+  struct sample
+  {
+    int64_t local{};
+    int64_t offset{};
+    int64_t delay{};
+  };
+
+  void update()
+  {
+    // The best half of the window
+    std::vector<sample> best{m_samples.begin(), m_samples.end()};
+    std::ranges::sort(best, {}, &sample::delay);
+    best.resize(std::max<std::size_t>(1, (best.size() + 1) / 2));
+    m_round_trip = best.front().delay;
+
+    // Least squares fit of the offset over time, relative to the first sample
+    // so that the products stay within the precision of a double
+    const auto base = best.front();
+    double mx = 0., my = 0.;
+    int64_t first = base.local, last = base.local;
+    for (auto& s : best)
+    {
+      mx += double(s.local - base.local);
+      my += double(s.offset - base.offset);
+      first = std::min(first, s.local);
+      last = std::max(last, s.local);
+    }
+    mx /= double(best.size());
+    my /= double(best.size());
+
+    double sxx = 0., sxy = 0.;
+    for (auto& s : best)
+    {
+      const double dx = double(s.local - base.local) - mx;
+      const double dy = double(s.offset - base.offset) - my;
+      sxx += dx * dx;
+      sxy += dx * dy;
+    }
+
+    // Over a shorter span, the jitter of the exchanges outweighs the drift
+    if (best.size() >= 3 && last - first >= 1'000'000'000)
+      m_drift = std::clamp(sxy / sxx, -max_drift, max_drift);
+    else
+      m_drift = 0.;
+
+    m_anchor = base.local + static_cast<int64_t>(mx);
+    m_offset = base.offset + static_cast<int64_t>(my);
+  }
+
+  std::deque<sample> m_samples;
+  int64_t m_offset{};
+  int64_t m_anchor{};
+  double m_drift{};
+  int64_t m_round_trip{};
+};
+
+//! Messages held until they are due, in order of due time then of arrival
+template <typename T>
+class timed_queue
+{
+public:
+  void push(int64_t due, T value)
+  {
+    // Mostly in order: searched from the back
+    auto it = m_items.end();
+    while (it != m_items.begin() && std::prev(it)->first > due)
+      --it;
+    m_items.emplace(it, due, std::move(value));
+  }
+
+  bool empty() const noexcept { return m_items.empty(); }
+  int64_t next_due() const noexcept { return m_items.front().first; }
+
+  //! Calls f(due, value) for each message due at the given time
+  template <typename F>
+  void pop_until(int64_t now, F&& f)
+  {
+    while (!m_items.empty() && m_items.front().first <= now)
+    {
+      auto item = std::move(m_items.front());
+      m_items.pop_front();
+      f(item.first, item.second);
+    }
+  }
+
+  void clear() noexcept { m_items.clear(); }
+
+private:
+  std::deque<std::pair<int64_t, T>> m_items;
+};
+
+//! Answers the clock requests received by an input.
+//! Returns whether the datagram was a clock message.
+template <typename Sockets>
+bool answer_osc_clock(
+    Sockets& sockets, std::size_t shard, const char* data, std::size_t sz,
+    const boost::asio::ip::udp::endpoint& from)
+{
+  const int64_t t1 = system_ns();
+  auto msg = parse_osc_clock(data, sz);
+  if (!msg)
+    return false;
+
+  if (msg->count == 1)
+  {
+    const int64_t times[3]{msg->times[0], t1, system_ns()};
+    sockets.reply(shard, write_osc_clock(times), from);
+  }
+  return true;
+}
+
+template <typename Configuration>
+int64_t latency_ns(const Configuration& conf) noexcept
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(conf.latency).count();
+}
+
+//! Delivers timestamped messages when they are due, from a timer of an io_context.
+//! The owner pushes the messages with its mutex held; the timer takes it before delivering,
+//! unless the owner was destroyed in the meantime.
+template <typename T>
+class timed_delivery
+{
+public:
+  using callback = std::function<void(int64_t due, T&)>;
+
+  timed_delivery(
+      boost::asio::io_context& ctx, std::shared_ptr<async_lifetime> lifetime, callback on_due)
+      : m_timer{ctx}
+      , m_lifetime{std::move(lifetime)}
+      , m_on_due{std::move(on_due)}
+  {
+  }
+
+  //! Must be called with the mutex held
+  void push(int64_t due, T value)
+  {
+    m_queue.push(due, std::move(value));
+    arm();
+  }
+
+  //! Must be called with the mutex held
+  void clear()
+  {
+    m_queue.clear();
+    m_timer.cancel();
+    m_armed = std::numeric_limits<int64_t>::max();
+  }
+
+private:
+  void arm()
+  {
+    const auto due = m_queue.next_due();
+    if (due >= m_armed)
+      return;
+    m_armed = due;
+
+    // The timer and the timestamps are both on the steady clock
+    m_timer.expires_at(std::chrono::steady_clock::time_point{std::chrono::nanoseconds(due)});
+    m_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+      m_armed = std::numeric_limits<int64_t>::max();
+      m_queue.pop_until(system_ns(), m_on_due);
+      if (!m_queue.empty())
+        arm();
+    });
+  }
+
+  boost::asio::steady_timer m_timer;
+  std::shared_ptr<async_lifetime> m_lifetime;
+  callback m_on_due;
+  timed_queue<T> m_queue;
+  int64_t m_armed{std::numeric_limits<int64_t>::max()};
+};
+}
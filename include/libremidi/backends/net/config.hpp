@@ -1,6 +1,8 @@
 #pragma once
 #include <libremidi/config.hpp>
+#include <libremidi/thread_configuration.hpp>
 
+#include <chrono>
 #include <string>
 
 #if !defined(BOOST_ASIO_IO_CONTEXT_HPP)
@@ -25,6 +27,19 @@ NAMESPACE_LIBREMIDI::net
 enum class protocol
 {
   OSC_MIDI,
+
+  //! RTP-MIDI (RFC 6295) with the AppleMIDI session protocol.
+  //! The port is the session control port, the data port is the next one.
+  //! Input accepts invitations, output invites the host it sends to.
+  RTP_MIDI,
+
+  //! Length-prefixed MIDI messages over a TCP connection.
+  //! Input listens on `accept` and `port`, output connects to `host` and `port`.
+  STREAM_TCP,
+
+  //! Length-prefixed MIDI messages over a Unix domain socket,
+  //! whose path is `accept` for the input and `host` for the output.
+  STREAM_UNIX,
 };
 
 struct dgram_input_configuration
@@ -36,6 +51,40 @@ struct dgram_input_configuration
   int port{};
 
   boost::asio::io_context* io_context{};
+
+  //! Scheduling of the threads serving the sockets, when no io_context is provided
+  thread_configuration thread{};
+
+  //! Largest message, e.g. a SysEx dump, reassembled from fragments
+  //! spread across multiple datagrams. Larger messages are dropped.
+  int max_message_size = 1024 * 1024;
+
+  //! Datagrams read per system call when draining the socket (recvmmsg on Linux)
+  int receive_batch = 32;
+
+  //! SO_RCVBUF: size of the kernel receive buffer, in bytes. Zero keeps the system default.
+  int receive_buffer_size{};
+
+  //! SO_BUSY_POLL (Linux): busy polling time of the device queue on reads, in microseconds.
+  //! Zero disables it. Values above net.core.busy_read require CAP_NET_ADMIN.
+  int busy_poll{};
+
+  //! Join this IP multicast group, e.g. "239.255.0.1", instead of binding to `accept`.
+  std::string multicast_group{};
+
+  //! Address of the interface the multicast group is joined on.
+  //! Empty lets the system choose.
+  std::string multicast_interface{};
+
+  //! Number of sockets bound to the port with SO_REUSEPORT, each served by its own thread,
+  //! across which the kernel spreads the senders. When an io_context is provided,
+  //! they all run on it. A multicast group is always received on a single socket.
+  int receive_threads = 1;
+
+  //! OSC: messages timestamped by a sender with clock_sync are delivered this long after
+  //! their timestamp, which absorbs the network jitter. Their timestamp is then the time
+  //! of delivery. Zero delivers them on arrival, with the timestamp of the sender.
+  std::chrono::microseconds latency{};
 };
 
 struct dgram_output_configuration
@@ -48,6 +97,41 @@ struct dgram_output_configuration
   bool broadcast{};
 
   boost::asio::io_context* io_context{};
+
+  //! Scheduling of the thread running the timed sends and the sessions,
+  //! when no io_context is provided
+  thread_configuration thread{};
+
+  //! Coalesce the messages sent within this time window into a single datagram,
+  //! as successive arguments of one OSC message.
+  //! Zero sends one datagram per message.
+  //! Stream transports coalesce the messages into a single write instead.
+  //! Timed flushes run on the io_context, which must thus be running
+  //! if it is provided by the user.
+  std::chrono::microseconds flush_interval{};
+
+  //! Upper bound for the size of a coalesced datagram, in bytes.
+  //! The default fits in an Ethernet frame with IPv4 and UDP headers.
+  int max_datagram_size = 1472;
+
+  //! OSC: estimate the clock of the receiving libremidi input through periodic exchanges,
+  //! and send every message with its timestamp on that clock. The receiver must be
+  //! the only host at `host`: the replies of other hosts are ignored.
+  bool clock_sync{};
+
+  //! RTP-MIDI and OSC with clock_sync: period of the clock synchronization exchanges
+  //! with the remote peer
+  std::chrono::milliseconds clock_sync_interval = std::chrono::seconds(10);
+
+  //! Multicast: how many routers the datagrams may cross, 1 staying on the local network
+  int multicast_ttl = 1;
+
+  //! Multicast: whether the datagrams are also delivered to the group members of this host
+  bool multicast_loopback = true;
+
+  //! Multicast: address of the interface the datagrams are sent from.
+  //! Empty lets the system choose.
+  std::string multicast_interface{};
 };
 
 struct dgram_observer_configuration
@@ -64,6 +148,19 @@ NAMESPACE_LIBREMIDI::net_ump
 enum class protocol
 {
   OSC_MIDI2,
+
+  //! Network MIDI 2.0 (UDP) transport.
+  //! Input acts as the host: it accepts the invitations of clients.
+  //! Output acts as a client: it invites the host it sends to.
+  NETWORK_MIDI2_UDP,
+
+  //! Length-prefixed UMPs over a TCP connection.
+  //! Input listens on `accept` and `port`, output connects to `host` and `port`.
+  STREAM_TCP,
+
+  //! Length-prefixed UMPs over a Unix domain socket,
+  //! whose path is `accept` for the input and `host` for the output.
+  STREAM_UNIX,
 };
 
 struct dgram_input_configuration
@@ -75,6 +172,40 @@ struct dgram_input_configuration
   int port{};
 
   boost::asio::io_context* io_context{};
+
+  //! Scheduling of the threads serving the sockets, when no io_context is provided
+  thread_configuration thread{};
+
+  //! Network MIDI 2.0: delay during which missing UMP data is awaited from a retransmission,
+  //! after which it is skipped and the following data delivered.
+  std::chrono::milliseconds retransmit_timeout{50};
+
+  //! Datagrams read per system call when draining the socket (recvmmsg on Linux)
+  int receive_batch = 32;
+
+  //! SO_RCVBUF: size of the kernel receive buffer, in bytes. Zero keeps the system default.
+  int receive_buffer_size{};
+
+  //! SO_BUSY_POLL (Linux): busy polling time of the device queue on reads, in microseconds.
+  //! Zero disables it. Values above net.core.busy_read require CAP_NET_ADMIN.
+  int busy_poll{};
+
+  //! Join this IP multicast group, e.g. "239.255.0.1", instead of binding to `accept`.
+  std::string multicast_group{};
+
+  //! Address of the interface the multicast group is joined on.
+  //! Empty lets the system choose.
+  std::string multicast_interface{};
+
+  //! Number of sockets bound to the port with SO_REUSEPORT, each served by its own thread,
+  //! across which the kernel spreads the senders. When an io_context is provided,
+  //! they all run on it. A multicast group is always received on a single socket.
+  int receive_threads = 1;
+
+  //! OSC: messages timestamped by a sender with clock_sync are delivered this long after
+  //! their timestamp, which absorbs the network jitter. Their timestamp is then the time
+  //! of delivery. Zero delivers them on arrival, with the timestamp of the sender.
+  std::chrono::microseconds latency{};
 };
 
 struct dgram_output_configuration
@@ -87,6 +218,47 @@ struct dgram_output_configuration
   bool broadcast{};
 
   boost::asio::io_context* io_context{};
+
+  //! Scheduling of the thread running the timed sends and the sessions,
+  //! when no io_context is provided
+  thread_configuration thread{};
+
+  //! Coalesce the messages sent within this time window into a single datagram,
+  //! as successive arguments of one OSC message.
+  //! Zero sends one datagram per message.
+  //! Stream transports coalesce the messages into a single write instead.
+  //! Timed flushes run on the io_context, which must thus be running
+  //! if it is provided by the user.
+  std::chrono::microseconds flush_interval{};
+
+  //! Upper bound for the size of a coalesced datagram, in bytes.
+  //! The default fits in an Ethernet frame with IPv4 and UDP headers.
+  int max_datagram_size = 1472;
+
+  //! Network MIDI 2.0: number of previous UMP data commands repeated in each datagram
+  //! for forward error correction, as far as they fit in max_datagram_size.
+  int fec_count = 2;
+
+  //! Network MIDI 2.0: number of UMP data commands kept to answer retransmit requests
+  int retransmit_buffer_size = 256;
+
+  //! OSC: estimate the clock of the receiving libremidi input through periodic exchanges,
+  //! and send every UMP with its timestamp on that clock. The receiver must be
+  //! the only host at `host`: the replies of other hosts are ignored.
+  bool clock_sync{};
+
+  //! OSC with clock_sync: period of the clock synchronization exchanges
+  std::chrono::milliseconds clock_sync_interval = std::chrono::seconds(10);
+
+  //! Multicast: how many routers the datagrams may cross, 1 staying on the local network
+  int multicast_ttl = 1;
+
+  //! Multicast: whether the datagrams are also delivered to the group members of this host
+  bool multicast_loopback = true;
+
+  //! Multicast: address of the interface the datagrams are sent from.
+  //! Empty lets the system choose.
+  std::string multicast_interface{};
 };
 
 struct dgram_observer_configuration
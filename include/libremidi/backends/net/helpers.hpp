@@ -1,9 +1,31 @@
 #pragma once
 #include <libremidi/config.hpp>
+#include <libremidi/error.hpp>
+#include <libremidi/thread_configuration.hpp>
 
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/multicast.hpp>
 #include <boost/asio/ip/udp.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+  #include <libremidi/backends/linux/thread.hpp>
+
+  #include <sys/socket.h>
+#endif
 namespace stdx
 { /*
 
@@ -37,6 +59,17 @@ public:
 
 NAMESPACE_LIBREMIDI
 {
+#if !defined(__linux__)
+// Thread scheduling is only implemented on Linux: elsewhere the threads run as created
+inline thread_report apply_thread_configuration(const thread_configuration& conf) noexcept
+{
+  thread_report report{.error = std::errc::function_not_supported};
+  if (conf.on_started)
+    conf.on_started(report);
+  return report;
+}
+#endif
+
 template <typename T>
 struct optionally_owned
 {
@@ -91,4 +124,619 @@ private:
     unowned
   } m_ownership{};
 };
+
+//! The mutex of an object with asynchronous handlers, shared with them.
+//! With a caller-provided io_context, a handler which completed before its timer or socket
+//! was cancelled still runs, possibly after the object is destroyed: the handlers lock the
+//! mutex through their own reference, and return without touching the object once it died.
+struct async_lifetime
+{
+  std::mutex mutex;
+  bool alive{true};
+
+  //! Called by the destructor of the object: no handler uses it anymore once this returns
+  void end()
+  {
+    std::lock_guard lock{mutex};
+    alive = false;
+  }
+};
+
+LIBREMIDI_STATIC constexpr std::size_t osc_padded_size(std::size_t sz) noexcept
+{
+  return (sz + 3) & ~std::size_t(3);
+}
+
+// MIDI 1 messages too large for a single datagram, e.g. big SysEx dumps,
+// are split across datagrams as ",ib" OSC messages.
+// The int argument identifies the fragment:
+// [ 0 | transfer: 15 bits | index: 15 bits | last: 1 bit ]
+struct osc_fragment
+{
+  static constexpr int max_index = 0x7FFF;
+
+  int transfer{};
+  int index{};
+  bool last{};
+
+  constexpr int32_t encode() const noexcept
+  {
+    return ((transfer & 0x7FFF) << 16) | ((index & 0x7FFF) << 1) | (last ? 1 : 0);
+  }
+
+  static constexpr osc_fragment decode(int32_t v) noexcept
+  {
+    return {.transfer = (v >> 16) & 0x7FFF, .index = (v >> 1) & 0x7FFF, .last = bool(v & 1)};
+  }
+};
+
+// Reassembles one fragmented message at a time.
+// A missing, duplicated or out-of-order fragment drops the whole message:
+// there is no retransmission in OSC over UDP.
+struct osc_fragment_reassembler
+{
+  explicit osc_fragment_reassembler(std::size_t max_size = 0)
+      : max_size{max_size}
+  {
+  }
+
+  std::size_t max_size{};
+
+  std::optional<std::span<const uint8_t>>
+  push(osc_fragment frag, const uint8_t* data, std::size_t sz)
+  {
+    if (frag.index == 0)
+    {
+      m_buffer.clear();
+      m_transfer = frag.transfer;
+      m_expected = 0;
+    }
+    else if (frag.transfer != m_transfer || frag.index != m_expected)
+    {
+      reset();
+      return std::nullopt;
+    }
+
+    if (m_buffer.size() + sz > max_size)
+    {
+      reset();
+      return std::nullopt;
+    }
+
+    m_buffer.insert(m_buffer.end(), data, data + sz);
+
+    if (frag.last)
+    {
+      m_expected = -1;
+      return std::span<const uint8_t>{m_buffer};
+    }
+
+    m_expected++;
+    return std::nullopt;
+  }
+
+  void reset() noexcept
+  {
+    m_buffer.clear();
+    m_transfer = -1;
+    m_expected = -1;
+  }
+
+private:
+  std::vector<uint8_t> m_buffer;
+  int m_transfer{-1};
+  int m_expected{-1};
+};
+
+// Whether a comes after b, modulo 2^16
+LIBREMIDI_STATIC constexpr bool sequence_after(uint16_t a, uint16_t b) noexcept
+{
+  return static_cast<int16_t>(a - b) > 0;
+}
+
+// Network byte order (big-endian) serialization of protocol fields
+struct byte_writer
+{
+  std::vector<uint8_t>& out;
+
+  void u8(uint8_t v) { out.push_back(v); }
+  void u16(uint16_t v)
+  {
+    u8(v >> 8);
+    u8(v & 0xFF);
+  }
+  void u32(uint32_t v)
+  {
+    u16(v >> 16);
+    u16(v & 0xFFFF);
+  }
+  void u64(uint64_t v)
+  {
+    u32(v >> 32);
+    u32(v & 0xFFFFFFFF);
+  }
+  void bytes(std::span<const uint8_t> b) { out.insert(out.end(), b.begin(), b.end()); }
+};
+
+// Bounds-checked reading: any overflow sets ok to false
+struct byte_reader
+{
+  std::span<const uint8_t> data;
+  std::size_t pos{};
+  bool ok = true;
+
+  bool has(std::size_t n) const noexcept { return ok && pos + n <= data.size(); }
+  std::size_t remaining() const noexcept { return ok ? data.size() - pos : 0; }
+  uint8_t peek() const noexcept { return has(1) ? data[pos] : 0; }
+
+  uint8_t u8() noexcept
+  {
+    if (!has(1))
+    {
+      ok = false;
+      return 0;
+    }
+    return data[pos++];
+  }
+  uint16_t u16() noexcept
+  {
+    const uint16_t hi = u8();
+    return (hi << 8) | u8();
+  }
+  uint32_t u32() noexcept
+  {
+    const uint32_t hi = u16();
+    return (hi << 16) | u16();
+  }
+  uint64_t u64() noexcept
+  {
+    const uint64_t hi = u32();
+    return (hi << 32) | u32();
+  }
+  std::span<const uint8_t> bytes(std::size_t n) noexcept
+  {
+    if (!has(n))
+    {
+      ok = false;
+      return {};
+    }
+    auto res = data.subspan(pos, n);
+    pos += n;
+    return res;
+  }
+};
+
+//! Applies the socket options of an input configuration.
+//! Returns a description of what could not be applied, if anything.
+template <typename Configuration>
+std::string tune_input_socket(boost::asio::ip::udp::socket& socket, const Configuration& conf)
+{
+  std::string failed;
+  boost::system::error_code ec;
+  if (conf.receive_buffer_size > 0)
+  {
+    socket.set_option(
+        boost::asio::socket_base::receive_buffer_size(conf.receive_buffer_size), ec);
+    if (ec)
+      failed += "SO_RCVBUF: " + ec.message() + ". ";
+  }
+
+  if (conf.busy_poll > 0)
+  {
+#if defined(SO_BUSY_POLL)
+    const int us = conf.busy_poll;
+    if (::setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) != 0)
+      failed += std::string("SO_BUSY_POLL: ") + std::strerror(errno) + ". ";
+#else
+    failed += "SO_BUSY_POLL: not supported on this platform. ";
+#endif
+  }
+  return failed;
+}
+
+//! Receives datagrams in batches.
+//! On Linux, every wakeup drains the socket with recvmmsg into a ring of preallocated
+//! buffers; elsewhere, it falls back to one asynchronous receive per datagram.
+class dgram_batch_receiver
+{
+public:
+  // Above the largest UDP payload, and a multiple of 16 so that every slot of the ring
+  // is as aligned as the UMP parsing expects
+  static constexpr std::size_t max_datagram_size = 65536;
+
+  explicit dgram_batch_receiver(std::size_t batch)
+      : m_batch{std::clamp<std::size_t>(batch, 1, 1024)}
+  {
+#if defined(__linux__)
+    // Left uninitialized: only the pages actually written to get committed
+    m_storage.reset(new char[m_batch * max_datagram_size]);
+    m_iovecs.resize(m_batch);
+    m_headers.resize(m_batch);
+    m_addresses.resize(m_batch);
+#else
+    m_storage.reset(new char[max_datagram_size]);
+#endif
+  }
+
+  //! Calls on_datagram(const char*, std::size_t, const udp::endpoint& sender)
+  //! for each datagram received, until cancelled.
+  //! The receiver belongs to the owner of lifetime: on_datagram is called with its mutex held,
+  //! and nothing is touched anymore once it is destroyed.
+  template <typename F>
+  void receive(
+      boost::asio::ip::udp::socket& socket, std::shared_ptr<async_lifetime> lifetime,
+      F on_datagram)
+  {
+#if defined(__linux__)
+    socket.async_wait(
+        boost::asio::socket_base::wait_read,
+        [this, lifetime, &socket, on_datagram](boost::system::error_code ec) mutable {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      if (!ec)
+        drain(socket.native_handle(), on_datagram);
+
+      receive(socket, lifetime, std::move(on_datagram));
+    });
+#else
+    socket.async_receive_from(
+        boost::asio::buffer(m_storage.get(), max_datagram_size), m_from,
+        [this, lifetime, &socket,
+         on_datagram](boost::system::error_code ec, std::size_t sz) mutable {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      if (!ec && sz > 0)
+        on_datagram(m_storage.get(), sz, std::as_const(m_from));
+
+      receive(socket, lifetime, std::move(on_datagram));
+    });
+#endif
+  }
+
+private:
+#if defined(__linux__)
+  template <typename F>
+  void drain(int fd, F& on_datagram)
+  {
+    // Bounded, so that a flood does not starve the other handlers of the io_context
+    for (int round = 0; round < 16; round++)
+    {
+      for (std::size_t i = 0; i < m_batch; i++)
+      {
+        m_iovecs[i] = {m_storage.get() + i * max_datagram_size, max_datagram_size};
+        m_headers[i] = {};
+        m_headers[i].msg_hdr.msg_iov = &m_iovecs[i];
+        m_headers[i].msg_hdr.msg_iovlen = 1;
+        m_headers[i].msg_hdr.msg_name = &m_addresses[i];
+        m_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+      }
+
+      const int n = ::recvmmsg(fd, m_headers.data(), m_batch, MSG_DONTWAIT, nullptr);
+      if (n <= 0)
+        return;
+
+      for (int i = 0; i < n; i++)
+      {
+        auto& hdr = m_headers[i];
+        if (hdr.msg_len == 0 || (hdr.msg_hdr.msg_flags & MSG_TRUNC))
+          continue;
+
+        if (hdr.msg_hdr.msg_namelen <= m_from.capacity())
+        {
+          std::memcpy(m_from.data(), &m_addresses[i], hdr.msg_hdr.msg_namelen);
+          m_from.resize(hdr.msg_hdr.msg_namelen);
+        }
+        on_datagram(m_storage.get() + i * max_datagram_size, hdr.msg_len, std::as_const(m_from));
+      }
+
+      if (std::size_t(n) < m_batch)
+        return;
+    }
+  }
+
+  std::vector<iovec> m_iovecs;
+  std::vector<mmsghdr> m_headers;
+  std::vector<sockaddr_storage> m_addresses;
+#endif
+  boost::asio::ip::udp::endpoint m_from;
+  std::size_t m_batch{};
+  std::unique_ptr<char[]> m_storage;
+};
+
+//! Sends several datagrams to the same endpoint in as few system calls as possible:
+//! a single sendmmsg on Linux, one send_to per datagram elsewhere.
+//! The datagrams are copied in a ring of buffers which keep their capacity,
+//! except for the parts pushed by reference, which are gathered from their memory.
+class dgram_batch_sender
+{
+public:
+  bool empty() const noexcept { return m_count == 0; }
+  std::size_t size() const noexcept { return m_count; }
+
+  template <typename Buffers>
+  void push(const Buffers& buffers)
+  {
+    push(buffers, std::span<const boost::asio::const_buffer>{});
+  }
+
+  //! The datagram is the copied buffers followed by the referenced ones,
+  //! whose memory must stay valid until send() or clear()
+  template <typename Buffers>
+  void push(const Buffers& copied, std::span<const boost::asio::const_buffer> referenced)
+  {
+    if (m_count == m_datagrams.size())
+      m_datagrams.emplace_back();
+
+    auto& d = m_datagrams[m_count++];
+    d.bytes.resize(boost::asio::buffer_size(copied));
+    boost::asio::buffer_copy(boost::asio::buffer(d.bytes), copied);
+    d.referenced.assign(referenced.begin(), referenced.end());
+  }
+
+  boost::system::error_code
+  send(boost::asio::ip::udp::socket& socket, const boost::asio::ip::udp::endpoint& to)
+  {
+    boost::system::error_code ec;
+#if defined(__linux__)
+    m_iovecs.clear();
+    for (std::size_t i = 0; i < m_count; i++)
+    {
+      auto& d = m_datagrams[i];
+      m_iovecs.push_back({d.bytes.data(), d.bytes.size()});
+      for (auto& b : d.referenced)
+        m_iovecs.push_back({const_cast<void*>(b.data()), b.size()});
+    }
+
+    m_headers.resize(m_count);
+    for (std::size_t i = 0, iov = 0; i < m_count; i++)
+    {
+      const std::size_t iovlen = 1 + m_datagrams[i].referenced.size();
+      m_headers[i] = {};
+      m_headers[i].msg_hdr.msg_name = const_cast<sockaddr*>(to.data());
+      m_headers[i].msg_hdr.msg_namelen = static_cast<socklen_t>(to.size());
+      m_headers[i].msg_hdr.msg_iov = &m_iovecs[iov];
+      m_headers[i].msg_hdr.msg_iovlen = iovlen;
+      iov += iovlen;
+    }
+
+    // Asio makes the descriptor non-blocking once it served asynchronous operations:
+    // wait for room in the send buffer as its synchronous send_to would.
+    for (std::size_t sent = 0; sent < m_count;)
+    {
+      const int n = ::sendmmsg(
+          socket.native_handle(), m_headers.data() + sent, unsigned(m_count - sent), 0);
+      if (n > 0)
+      {
+        sent += n;
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        if (socket.wait(boost::asio::socket_base::wait_write, ec))
+          break;
+      }
+      else
+      {
+        ec.assign(errno, boost::asio::error::get_system_category());
+        break;
+      }
+    }
+#else
+    std::vector<boost::asio::const_buffer> buffers;
+    for (std::size_t i = 0; i < m_count && !ec; i++)
+    {
+      auto& d = m_datagrams[i];
+      buffers.assign(1, boost::asio::buffer(d.bytes));
+      buffers.insert(buffers.end(), d.referenced.begin(), d.referenced.end());
+      socket.send_to(buffers, to, 0, ec);
+    }
+#endif
+    m_count = 0;
+    return ec;
+  }
+
+  void clear() noexcept { m_count = 0; }
+
+private:
+  struct datagram
+  {
+    std::vector<char> bytes;
+    std::vector<boost::asio::const_buffer> referenced;
+  };
+
+  std::vector<datagram> m_datagrams;
+  std::size_t m_count{};
+#if defined(__linux__)
+  std::vector<iovec> m_iovecs;
+  std::vector<mmsghdr> m_headers;
+#endif
+};
+
+//! The sockets of a datagram input: a single one, or with receive_threads, several bound
+//! to the same port with SO_REUSEPORT, across which the kernel spreads the senders.
+//! Each socket is served by a thread running its own io_context, unless one is provided.
+template <typename Configuration>
+class dgram_input_sockets
+{
+public:
+  explicit dgram_input_sockets(const Configuration& conf)
+      : configuration{conf}
+  {
+  }
+
+  ~dgram_input_sockets() { stop(); }
+
+  std::size_t size() const noexcept { return m_shards.size(); }
+
+  //! Creates and binds the sockets.
+  //! The socket options that could not be applied are described in warnings.
+  stdx::error open(std::string& warnings)
+  {
+    boost::system::error_code ec;
+    const bool multicast = !configuration.multicast_group.empty();
+    const auto address = boost::asio::ip::make_address(
+        multicast ? configuration.multicast_group : configuration.accept, ec);
+    if (ec || (multicast && !address.is_multicast()) || configuration.port < 0
+        || configuration.port >= 65536)
+      return std::errc::invalid_argument;
+
+    boost::asio::ip::address iface;
+    if (!configuration.multicast_interface.empty())
+    {
+      iface = boost::asio::ip::make_address(configuration.multicast_interface, ec);
+      if (ec)
+        return std::errc::invalid_argument;
+    }
+
+    // Multicast datagrams are delivered to every socket bound to the port:
+    // a single one receives them.
+    using boost::asio::ip::address_v4;
+    using boost::asio::ip::address_v6;
+    boost::asio::ip::address bound = address;
+    if (multicast && address.is_v6())
+      bound = address_v6::any();
+    else if (multicast)
+      bound = address_v4::any();
+    const boost::asio::ip::udp::endpoint endpoint{
+        bound, static_cast<unsigned short>(configuration.port)};
+    int count = multicast ? 1 : std::clamp(configuration.receive_threads, 1, 64);
+#if !defined(SO_REUSEPORT)
+    if (count > 1)
+      warnings += "SO_REUSEPORT: not supported on this platform. ";
+    count = 1;
+#endif
+
+    for (int i = 0; i < count; i++)
+    {
+      auto& s = *m_shards.emplace_back(std::make_unique<shard>(configuration));
+      s.socket.open(endpoint.protocol(), ec);
+      if (ec)
+        return std::errc::address_family_not_supported;
+
+      s.socket.set_option(boost::asio::ip::udp::socket::reuse_address(true), ec);
+#if defined(SO_REUSEPORT)
+      if (count > 1)
+      {
+        const int enable = 1;
+        ::setsockopt(s.socket.native_handle(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+      }
+#endif
+
+      s.socket.bind(endpoint, ec);
+      if (ec)
+      {
+        m_shards.clear();
+        return std::errc::address_in_use;
+      }
+
+      if (multicast)
+      {
+        if (address.is_v4() && iface.is_v4())
+          s.socket.set_option(
+              boost::asio::ip::multicast::join_group(address.to_v4(), iface.to_v4()), ec);
+        else
+          s.socket.set_option(boost::asio::ip::multicast::join_group(address), ec);
+        if (ec)
+        {
+          m_shards.clear();
+          return std::errc::address_not_available;
+        }
+      }
+
+      warnings += tune_input_socket(s.socket, configuration);
+    }
+    return stdx::error{};
+  }
+
+  //! Calls on_datagram(shard index, const char*, std::size_t, const udp::endpoint& sender)
+  //! for each datagram received, possibly from as many threads as there are sockets,
+  //! with the mutex of the owner's lifetime held.
+  template <typename F>
+  void start(const std::shared_ptr<async_lifetime>& lifetime, F on_datagram)
+  {
+    for (std::size_t i = 0; i < m_shards.size(); i++)
+    {
+      auto& s = *m_shards[i];
+      if (s.running)
+        continue;
+      s.running = true;
+
+      s.receiver.receive(
+          s.socket, lifetime,
+          [on_datagram, i](const char* data, std::size_t sz, const auto& from) mutable {
+        on_datagram(i, data, sz, from);
+      });
+
+      if (s.ctx)
+      {
+        s.thread = std::thread{[&ctx = *s.ctx, &thread = configuration.thread] {
+          apply_thread_configuration(thread);
+          auto wg = boost::asio::make_work_guard(ctx);
+          ctx.run();
+        }};
+      }
+    }
+  }
+
+  //! Answers a sender from the socket it was received on.
+  //! Called from the thread serving that socket, within on_datagram.
+  void reply(
+      std::size_t shard, std::span<const uint8_t> data, const boost::asio::ip::udp::endpoint& to)
+  {
+    boost::system::error_code ec;
+    m_shards[shard]->socket.send_to(boost::asio::buffer(data.data(), data.size()), to, 0, ec);
+  }
+
+  //! The context on which the first socket is served
+  boost::asio::io_context& context() noexcept
+  {
+    return m_shards.front()->ctx ? *m_shards.front()->ctx : *configuration.io_context;
+  }
+
+  void stop()
+  {
+    for (auto& s : m_shards)
+    {
+      boost::system::error_code ec;
+      s->socket.cancel(ec);
+      s->running = false;
+
+      if (s->ctx && s->thread.joinable())
+      {
+        s->ctx->stop();
+        s->thread.join();
+        s->ctx->restart();
+      }
+    }
+  }
+
+private:
+  struct shard
+  {
+    explicit shard(const Configuration& conf)
+        : ctx{conf.io_context ? nullptr : std::make_unique<boost::asio::io_context>()}
+        , socket{ctx ? *ctx : *conf.io_context}
+        , receiver{std::size_t(std::max(conf.receive_batch, 1))}
+    {
+    }
+
+    std::unique_ptr<boost::asio::io_context> ctx;
+    boost::asio::ip::udp::socket socket;
+    dgram_batch_receiver receiver;
+    std::thread thread;
+    bool running{};
+  };
+
+  const Configuration& configuration;
+  std::vector<std::unique_ptr<shard>> m_shards;
+};
 }
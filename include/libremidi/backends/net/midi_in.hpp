@@ -1,10 +1,18 @@
 #pragma once
+#include <libremidi/backends/net/clock_sync.hpp>
 #include <libremidi/backends/net/config.hpp>
 #include <libremidi/backends/net/helpers.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
 
-#include <thread>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/endian/conversion.hpp>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 NAMESPACE_LIBREMIDI
 {
 template <typename Impl, typename F>
@@ -15,6 +23,9 @@ struct osc_parser
   F on_message;
   std::string_view port_name;
 
+  // Set by the timetag (t) arguments, which stamp the messages that follow them
+  std::optional<int64_t>* timetag{};
+
   stdx::error parse_bundle(const char* data, std::size_t sz)
   {
     std::string_view txt(data, sz);
@@ -49,41 +60,79 @@ struct osc_parser
     if (*data++ != ',')
       return std::errc::bad_message;
 
-    // Count the ,mmmmm arguments... yummy
-    int num_msgs = 0;
+    const auto typetags_begin = data;
     for (; data < end; ++data)
-      if (*data == Impl::typetag)
-        num_msgs++;
-      else if (*data == 0)
+      if (*data == 0)
         break;
-      else
-        return std::errc::bad_message;
 
-    if (num_msgs == 0)
+    if (data == end)
+      return std::errc::bad_message;
+
+    const auto typetags = std::string_view(typetags_begin, data - typetags_begin);
+    if (typetags.empty())
       return std::errc::no_message;
 
-    // By now there's at least 5 bytes left as the ,mmm has to be round-up to 4 and padded with zeros:
-    if (end - data < 4)
+    // Arguments start after the type tags null terminator, rounded up to 4 bytes
+    data = begin + ((data - begin) / 4 + 1) * 4;
+    if (data > end)
       return std::errc::bad_message;
 
-    switch ((1 + num_msgs) % 4)
+    // Data starts
+    std::optional<osc_fragment> fragment;
+    for (char tag : typetags)
     {
-      case 0:
-        data += 4;
-        break;
-      case 1:
-        data += 3;
-        break;
-      case 2:
-        data += 2;
-        break;
-      case 3:
-        data += 1;
-        break;
+      const std::size_t remaining = end - data;
+      switch (tag)
+      {
+        case 't': {
+          if (remaining < 8)
+            return std::errc::bad_message;
+          const auto t
+              = boost::endian::load_big_s64(reinterpret_cast<const unsigned char*>(data));
+          if (timetag)
+            *timetag = t;
+          data += 8;
+          break;
+        }
+
+        // Fragment header of the blob that follows
+        case 'i': {
+          if (remaining < 4)
+            return std::errc::bad_message;
+          fragment = osc_fragment::decode(boost::endian::load_big_s32(
+              reinterpret_cast<const unsigned char*>(data)));
+          data += 4;
+          break;
+        }
+
+        case 'b': {
+          if (remaining < 4)
+            return std::errc::bad_message;
+          const auto blob_size
+              = boost::endian::load_big_s32(reinterpret_cast<const unsigned char*>(data));
+          if (blob_size < 0 || ((std::size_t(blob_size) + 3) & ~std::size_t(3)) > remaining - 4)
+            return std::errc::bad_message;
+
+          impl.process_blob(on_message, data + 4, blob_size, fragment);
+          data += 4 + ((blob_size + 3) & ~3);
+          fragment.reset();
+          break;
+        }
+
+        default: {
+          if (tag != Impl::typetag)
+            return std::errc::bad_message;
+
+          const std::size_t consumed = impl.process_midi_bytes(on_message, data, remaining);
+          if (consumed == 0)
+            return std::errc::bad_message;
+          data += consumed;
+          break;
+        }
+      }
     }
 
-    // Data starts
-    return impl.process_midi_bytes(on_message, num_msgs, data, end - data);
+    return {};
   }
 
   stdx::error parse_int_message(const char* /* data */, std::size_t /* sz */)
@@ -122,17 +171,35 @@ struct osc_parser_midi1
 {
   static constexpr char typetag = 'm';
 
-  stdx::error
-  process_midi_bytes(auto& on_message, std::size_t num_msgs, const char* data, std::size_t sz)
+  osc_fragment_reassembler* reassembly{};
+
+  // MIDI message (m) spec: port n°, status byte, data 1, data 2
+  std::size_t process_midi_bytes(auto& on_message, const char* data, std::size_t sz)
   {
-    if (sz != num_msgs * 4)
-      return std::errc::bad_message;
+    if (sz < 4)
+      return 0;
 
-    auto end = data + sz;
-    for (; data < end; data += 4)
-      on_message(data + 1);
+    auto bytes = reinterpret_cast<uint8_t*>(const_cast<char*>(data + 1));
+    if ((bytes[0] & 0x80) && bytes[0] != 0xF0)
+      on_message(std::span<const uint8_t>(
+          bytes, std::min(3u, cmidi2_midi1_get_message_size(bytes, 3))));
 
-    return {};
+    return 4;
+  }
+
+  // One complete MIDI message per blob, or one fragment of it
+  void process_blob(
+      auto& on_message, const char* data, std::size_t sz, std::optional<osc_fragment> fragment)
+  {
+    if (sz == 0)
+      return;
+
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    if (!fragment)
+      on_message(std::span<const uint8_t>(bytes, sz));
+    else if (reassembly)
+      if (auto msg = reassembly->push(*fragment, bytes, sz))
+        on_message(*msg);
   }
 };
 
@@ -150,28 +217,32 @@ public:
 
   explicit midi_in(input_configuration&& conf, dgram_input_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
-      , m_ctx{configuration.io_context}
-      , m_socket{m_ctx.get()}
+      , m_sockets{configuration}
   {
-    m_socket.open(boost::asio::ip::udp::v4());
-    m_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
-
-    m_endpoint
-        = {boost::asio::ip::make_address(this->configuration.accept),
-           static_cast<unsigned short>(this->configuration.port)};
-
-    boost::system::error_code ec;
-    m_socket.bind(m_endpoint, ec);
-    if (ec != boost::system::error_code{})
+    std::string failed;
+    if (auto err = m_sockets.open(failed); err != stdx::error{})
     {
-      client_open_ = std::errc::address_in_use;
+      client_open_ = err;
       return;
     }
+    if (!failed.empty())
+      libremidi_handle_warning(configuration, failed);
 
+    // The kernel keeps each sender on the same socket: its fragments are reassembled there
+    for (std::size_t i = 0; i < m_sockets.size(); i++)
+      m_reassembly.emplace_back(std::size_t(std::max(configuration.max_message_size, 0)));
+
+    m_delivery.emplace(
+        m_sockets.context(), m_lifetime,
+        [this](int64_t due, std::vector<uint8_t>& bytes) { deliver(due, bytes); });
     client_open_ = stdx::error{};
   }
 
-  ~midi_in() override { close_port(); }
+  ~midi_in() override
+  {
+    close_port();
+    m_lifetime->end();
+  }
 
   libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
 
@@ -182,41 +253,28 @@ public:
 
   stdx::error open_virtual_port(std::string_view port) override
   {
-    m_portname = std::string(port);
+    if (client_open_ != stdx::error{})
+      return client_open_;
 
-    receive();
-
-    if (m_ctx.is_owned())
     {
-      m_thread = std::jthread{[this, &ctx = m_ctx.get()] {
-        auto wg = boost::asio::make_work_guard(m_ctx);
-        ctx.run();
-      }};
+      std::lock_guard lock{m_mutex};
+      m_portname = std::string(port);
     }
 
-    return stdx::error{};
-  }
-
-  void receive()
-  {
-    m_socket.async_receive_from(
-        boost::asio::mutable_buffer(&m_data[0], std::size(m_data)), m_endpoint,
-        [this](auto ec, std::size_t sz) {
-      if (ec == boost::asio::error::operation_aborted)
-        return;
-
-      if (!ec && sz > 0)
-        this->on_bytes(reinterpret_cast<const char*>(m_data), sz);
-
-      this->receive();
+    m_sockets.start(
+        m_lifetime, [this](std::size_t shard, const char* data, std::size_t sz, const auto& from) {
+      this->on_bytes(shard, data, sz, from);
     });
+    return stdx::error{};
   }
 
   stdx::error close_port() override
   {
-    // FIXME async close
-    if (m_socket.is_open())
-      m_socket.close();
+    m_sockets.stop();
+
+    std::lock_guard lock{m_mutex};
+    if (m_delivery)
+      m_delivery->clear();
     return {};
   }
 
@@ -225,16 +283,24 @@ public:
     return std::chrono::steady_clock::now().time_since_epoch().count();
   }
 
-  void on_bytes(const char* data, std::size_t size)
+  // The sockets may be served by several threads: the messages are delivered one at a time,
+  // with m_mutex held by the receiving sockets
+  void on_bytes(
+      std::size_t shard, const char* data, std::size_t size,
+      const boost::asio::ip::udp::endpoint& from)
   {
-    const auto on_msg = [this](const char* bytes) { this->on_message(bytes); };
-    osc_parser<osc_parser_midi1, decltype(on_msg)> parser{{}, on_msg, m_portname};
+    if (answer_osc_clock(m_sockets, shard, data, size, from))
+      return;
+
+    m_timetag.reset();
+    const auto on_msg = [this](std::span<const uint8_t> bytes) { this->on_message(bytes); };
+    osc_parser<osc_parser_midi1, decltype(on_msg)> parser{
+        {&m_reassembly[shard]}, on_msg, m_portname, &m_timetag};
     parser.parse_packet(data, size);
   }
 
-  void on_message(const char* data)
+  void on_message(std::span<const uint8_t> bytes)
   {
-    // OSC enforces always 3 bytes
     static constexpr timestamp_backend_info timestamp_info{
         .has_absolute_timestamps = false,
         .absolute_is_monotonic = false,
@@ -247,20 +313,43 @@ public:
           .count();
     };
 
-    auto ptr = reinterpret_cast<const uint8_t*>(data);
-    m_processing.on_bytes({ptr, ptr + 3}, m_processing.timestamp<timestamp_info>(to_ns, 0));
+    if (!m_timetag)
+    {
+      m_processing.on_bytes(bytes, m_processing.timestamp<timestamp_info>(to_ns, 0));
+      return;
+    }
+
+    // Held until the latency elapsed
+    const auto due = *m_timetag + latency_ns(configuration);
+    if (due > system_ns() && configuration.latency.count() > 0)
+      m_delivery->push(due, {bytes.begin(), bytes.end()});
+    else
+      deliver(due, bytes);
   }
 
-  midi1::input_state_machine m_processing{this->configuration};
+  // Timestamped by a synchronized sender, on our clock
+  void deliver(int64_t due, std::span<const uint8_t> bytes)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = true,
+        .absolute_is_monotonic = true,
+        .has_samples = false,
+    };
 
-  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
-  boost::asio::ip::udp::endpoint m_endpoint;
-  boost::asio::ip::udp::socket m_socket;
+    m_processing.on_bytes(
+        bytes, m_processing.timestamp<timestamp_info>([due] { return due; }, 0));
+  }
 
-  std::jthread m_thread;
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+  std::vector<osc_fragment_reassembler> m_reassembly;
 
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
   std::string m_portname;
-  alignas(16) unsigned char m_data[65535];
+  std::optional<int64_t> m_timetag;
+  dgram_input_sockets<decltype(configuration)> m_sockets;
+  std::optional<timed_delivery<std::vector<uint8_t>>> m_delivery;
 };
 }
 
@@ -270,41 +359,30 @@ struct osc_parser_midi2
 {
   static constexpr char typetag = 'M';
 
-  stdx::error
-  process_midi_bytes(auto& on_message, std::size_t num_msgs, const char* data, std::size_t byte_sz)
+  // MIDI 2 message (M) spec: an UMP
+  std::size_t process_midi_bytes(auto& on_message, const char* data, std::size_t byte_sz)
   {
-    if (byte_sz % 4 != 0)
-      return std::errc::bad_message;
-
-    auto sz = byte_sz / 4;
+    if (byte_sz < 4)
+      return 0;
 
-    auto begin = reinterpret_cast<const uint32_t*>(data);
-    auto end = begin + sz;
-    std::size_t accounted = 0;
-    for (auto it = begin; it < end && accounted < num_msgs;)
+    auto it = reinterpret_cast<const uint32_t*>(data);
+    const std::size_t N = cmidi2_ump_get_message_size_bytes(it) / 4;
+    switch (N)
     {
-      const auto N = cmidi2_ump_get_message_size_bytes(it) / 4;
-      switch (N)
-      {
-        case 1:
-        case 2:
-        case 4:
-          if (it + N <= end)
-          {
-            on_message(it, N);
-            accounted++;
-          }
-          else
-            return std::errc::bad_message;
-          break;
-        default:
-          return std::errc::bad_message;
-      }
-      it += N;
+      case 1:
+      case 2:
+      case 4:
+        if (N * 4 > byte_sz)
+          return 0;
+        on_message(it, N);
+        return N * 4;
+      default:
+        return 0;
     }
-
-    return {};
   }
+
+  // Blobs only carry MIDI 1 data
+  void process_blob(auto&, const char*, std::size_t, std::optional<osc_fragment>) { }
 };
 
 class midi_in final
@@ -321,28 +399,28 @@ public:
 
   explicit midi_in(ump_input_configuration&& conf, dgram_input_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
-      , m_ctx{configuration.io_context}
-      , m_socket{m_ctx.get()}
+      , m_sockets{configuration}
   {
-    m_socket.open(boost::asio::ip::udp::v4());
-    m_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
-
-    m_endpoint
-        = {boost::asio::ip::make_address(this->configuration.accept),
-           static_cast<unsigned short>(this->configuration.port)};
-
-    boost::system::error_code ec;
-    m_socket.bind(m_endpoint, ec);
-    if (ec != boost::system::error_code{})
+    std::string failed;
+    if (auto err = m_sockets.open(failed); err != stdx::error{})
     {
-      client_open_ = std::errc::address_in_use;
+      client_open_ = err;
       return;
     }
+    if (!failed.empty())
+      libremidi_handle_warning(configuration, failed);
 
+    m_delivery.emplace(
+        m_sockets.context(), m_lifetime,
+        [this](int64_t due, ump_words& ump) { deliver(due, ump.words, ump.size); });
     client_open_ = stdx::error{};
   }
 
-  ~midi_in() override { close_port(); }
+  ~midi_in() override
+  {
+    close_port();
+    m_lifetime->end();
+  }
 
   libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK_UMP; }
 
@@ -353,43 +431,28 @@ public:
 
   stdx::error open_virtual_port(std::string_view port) override
   {
-    m_portname = std::string(port);
-
-    receive();
+    if (client_open_ != stdx::error{})
+      return client_open_;
 
-    if (m_ctx.is_owned())
     {
-      m_thread = std::jthread{[this, &ctx = m_ctx.get()] {
-        auto wg = boost::asio::make_work_guard(m_ctx);
-        ctx.run();
-      }};
+      std::lock_guard lock{m_mutex};
+      m_portname = std::string(port);
     }
-    return stdx::error{};
-  }
-
-  void receive()
-  {
-    m_socket.async_receive_from(
-        boost::asio::mutable_buffer(&m_data[0], std::size(m_data)), m_endpoint,
-        [this](auto ec, std::size_t sz) {
-      if (ec == boost::asio::error::operation_aborted)
-        return;
-
-      if (!ec && sz > 0)
-        this->on_bytes(reinterpret_cast<const char*>(m_data), sz);
 
-      this->receive();
+    m_sockets.start(
+        m_lifetime, [this](std::size_t shard, const char* data, std::size_t sz, const auto& from) {
+      this->on_bytes(shard, data, sz, from);
     });
+    return stdx::error{};
   }
 
   stdx::error close_port() override
   {
-    // FIXME async close
-    if (m_ctx.is_owned())
-      m_ctx.get().stop();
+    m_sockets.stop();
 
-    if (m_socket.is_open())
-      m_socket.close();
+    std::lock_guard lock{m_mutex};
+    if (m_delivery)
+      m_delivery->clear();
     return {};
   }
 
@@ -398,11 +461,19 @@ public:
     return std::chrono::steady_clock::now().time_since_epoch().count();
   }
 
-  void on_bytes(const char* data, std::size_t size)
+  // The sockets may be served by several threads: the messages are delivered one at a time,
+  // with m_mutex held by the receiving sockets
+  void on_bytes(
+      std::size_t shard, const char* data, std::size_t size,
+      const boost::asio::ip::udp::endpoint& from)
   {
+    if (answer_osc_clock(m_sockets, shard, data, size, from))
+      return;
+
+    m_timetag.reset();
     const auto on_msg
         = [this](const uint32_t* bytes, std::size_t N) { this->on_message(bytes, N); };
-    osc_parser<osc_parser_midi2, decltype(on_msg)> parser{{}, on_msg, m_portname};
+    osc_parser<osc_parser_midi2, decltype(on_msg)> parser{{}, on_msg, m_portname, &m_timetag};
     parser.parse_packet(data, size);
   }
 
@@ -420,18 +491,53 @@ public:
           .count();
     };
 
-    m_processing.on_bytes({ump, sz}, m_processing.timestamp<timestamp_info>(to_ns, 0));
+    if (!m_timetag)
+    {
+      m_processing.on_bytes({ump, sz}, m_processing.timestamp<timestamp_info>(to_ns, 0));
+      return;
+    }
+
+    // Held until the latency elapsed
+    const auto due = *m_timetag + latency_ns(configuration);
+    if (due > system_ns() && configuration.latency.count() > 0)
+    {
+      ump_words held{.size = sz};
+      std::copy_n(ump, sz, held.words);
+      m_delivery->push(due, held);
+    }
+    else
+    {
+      deliver(due, ump, sz);
+    }
   }
 
-  midi2::input_state_machine m_processing{this->configuration};
+  // Timestamped by a synchronized sender, on our clock
+  void deliver(int64_t due, const uint32_t* ump, std::size_t sz)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = true,
+        .absolute_is_monotonic = true,
+        .has_samples = false,
+    };
 
-  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
-  boost::asio::ip::udp::endpoint m_endpoint;
-  boost::asio::ip::udp::socket m_socket;
+    m_processing.on_bytes(
+        {ump, sz}, m_processing.timestamp<timestamp_info>([due] { return due; }, 0));
+  }
+
+  struct ump_words
+  {
+    uint32_t words[4]{};
+    std::size_t size{};
+  };
 
-  std::jthread m_thread;
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
   std::string m_portname;
-  alignas(16) unsigned char m_data[65535];
+  std::optional<int64_t> m_timetag;
+  dgram_input_sockets<decltype(configuration)> m_sockets;
+  std::optional<timed_delivery<ump_words>> m_delivery;
 };
 }
@@ -1,211 +1,745 @@
 #pragma once
+#include <libremidi/backends/net/clock_sync.hpp>
 #include <libremidi/backends/net/config.hpp>
 #include <libremidi/backends/net/helpers.hpp>
 #include <libremidi/cmidi2.hpp>
 #include <libremidi/detail/midi_out.hpp>
 
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/multicast.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/endian.hpp>
 
-NAMESPACE_LIBREMIDI::net
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+NAMESPACE_LIBREMIDI
 {
-
-struct osc_midi1_packet
+// An OSC message built argument by argument, e.g. /pattern ,mmbm
+// The message is sent as a scatter / gather sequence so that
+// the type tags can grow without moving the arguments around.
+struct osc_packet
 {
-  stdx::error init_packet(std::string_view osc_pattern)
-  {
-    int i = 0;
-    for (; i < std::ssize(osc_pattern); i++)
-      if (osc_pattern.data()[i] != 0)
-        bytes[i] = osc_pattern.data()[i];
-      else
-        break;
-    bytes[i] = 0;
-    while (i % 4 != 3)
+  stdx::error init_packet(std::string_view osc_pattern, std::size_t max_size)
+  {
+    const auto pattern_len = osc_pattern.find('\0');
+    osc_pattern = osc_pattern.substr(0, pattern_len);
+
+    header.assign(osc_pattern.begin(), osc_pattern.end());
+    header.resize((header.size() / 4 + 1) * 4, 0);
+
+    max_datagram_size = max_size;
+
+    // Room for the smallest possible message: ",x\0\0" and one argument
+    if (header.size() + 4 + 4 > max_datagram_size)
     {
-      ++i;
-      bytes[i] = 0;
+      deinit();
+      return std::errc::message_size;
     }
 
-    bytes[++i] = ',';
-    bytes[++i] = 'm';
-    bytes[++i] = 0;
-    bytes[++i] = 0;
+    typetags.reserve(max_datagram_size - header.size());
+    arguments.reserve(max_datagram_size - header.size());
+    clear();
 
-    // MIDI message (m) spec: port n°, status byte, data 1, data 2
-    bytes[++i] = 0;
-    message_size = ++i + 3;
-
-    return stdx::error{}; // FIXME
+    return stdx::error{};
   }
 
   stdx::error deinit()
   {
-    message_size = 0;
+    header.clear();
+    clear();
     return stdx::error{};
   }
 
-  stdx::error set_packet_content(const unsigned char* message, size_t size)
+  bool is_open() const noexcept { return !header.empty(); }
+  bool empty() const noexcept { return count == 0; }
+  int size() const noexcept { return count; }
+
+  void clear() noexcept
   {
-    if (message_size == 0)
-      return std::errc::not_connected;
+    typetags.assign(4, 0);
+    typetags[0] = ',';
+    arguments.clear();
+    count = 0;
+    last_timetag.reset();
+  }
 
-    if (size != 3)
-      return std::errc::message_size;
+  // Size of the datagram once an argument of the given size is added
+  std::size_t datagram_size_with(std::size_t argument_bytes) const noexcept
+  {
+    // ',' + N type tags + at least one null terminator, padded to 4 bytes
+    return header.size() + osc_padded_size(count + 3) + arguments.size() + argument_bytes;
+  }
 
-    std::memcpy(this->bytes + message_size - 3, message, 3);
+  bool fits(std::size_t argument_bytes) const noexcept
+  {
+    return datagram_size_with(argument_bytes) <= max_datagram_size;
+  }
 
-    return stdx::error{};
+  // Whether an argument could fit at all, once the pending ones are sent
+  bool fits_alone(std::size_t argument_bytes) const noexcept
+  {
+    return header.size() + 4 + argument_bytes <= max_datagram_size;
+  }
+
+  static constexpr std::size_t blob_size(std::size_t bytes) noexcept
+  {
+    return 4 + osc_padded_size(bytes);
+  }
+
+  void add_tag(char tag)
+  {
+    count++;
+    typetags.resize(osc_padded_size(count + 2), 0);
+    typetags[count] = tag;
+  }
+
+  void add_argument(char tag, const void* data, std::size_t bytes)
+  {
+    add_tag(tag);
+
+    auto ptr = static_cast<const char*>(data);
+    arguments.insert(arguments.end(), ptr, ptr + bytes);
+  }
+
+  // Timestamp of the arguments that follow, on the clock of the receiver.
+  // Successive messages with the same timestamp share it.
+  void add_timetag(int64_t t)
+  {
+    if (last_timetag == t)
+      return;
+    last_timetag = t;
+
+    add_tag('t');
+    const auto be = boost::endian::native_to_big(t);
+    auto ptr = reinterpret_cast<const char*>(&be);
+    arguments.insert(arguments.end(), ptr, ptr + 8);
+  }
+
+  void add_blob(const void* data, std::size_t bytes)
+  {
+    add_tag('b');
+
+    const auto be_size = boost::endian::native_to_big(static_cast<int32_t>(bytes));
+    auto sz = reinterpret_cast<const char*>(&be_size);
+    arguments.insert(arguments.end(), sz, sz + 4);
+
+    auto ptr = static_cast<const char*>(data);
+    arguments.insert(arguments.end(), ptr, ptr + bytes);
+    arguments.resize(osc_padded_size(arguments.size()), 0);
   }
 
-  std::span<const char> get_data() { return std::span(this->bytes, this->message_size); }
-  char bytes[512 + 8 + 8];
-  int message_size{};
+  std::array<boost::asio::const_buffer, 3> get_data() const noexcept
+  {
+    return {
+        boost::asio::buffer(header), boost::asio::buffer(typetags),
+        boost::asio::buffer(arguments)};
+  }
+
+  std::vector<char> header;
+  std::vector<char> typetags;
+  std::vector<char> arguments;
+  std::size_t max_datagram_size{};
+  int count{};
+  std::optional<int64_t> last_timetag;
 };
 
-class midi_out final
-    : public midi1::out_api
-    , public error_handler
+// Sends OSC messages over UDP.
+// Messages are either sent immediately, or coalesced as long as they
+// fit in a datagram, until the flush window elapses.
+// With clock_sync, the clock of the receiver is estimated from periodic exchanges
+// and every message is preceded by its timestamp on that clock, as a timetag argument.
+template <typename Configuration>
+class osc_dgram_sender
 {
 public:
-  struct
-      : output_configuration
-      , dgram_output_configuration
-  {
-  } configuration;
+  using clock = std::chrono::steady_clock;
 
-  midi_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
-      : configuration{std::move(conf), std::move(apiconf)}
-      , ctx{configuration.io_context}
+  explicit osc_dgram_sender(const Configuration& conf)
+      : configuration{conf}
+      , ctx{conf.io_context}
       , m_socket{ctx.get()}
+      , m_timer{ctx.get()}
+      , m_sync_timer{ctx.get()}
   {
     m_socket.open(boost::asio::ip::udp::v4());
     m_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
     m_socket.set_option(boost::asio::socket_base::broadcast(true));
 
     m_endpoint
-        = {boost::asio::ip::make_address(this->configuration.host),
-           static_cast<unsigned short>(this->configuration.port)};
+        = {boost::asio::ip::make_address(configuration.host),
+           static_cast<unsigned short>(configuration.port)};
 
-    this->client_open_ = stdx::error{};
+    if (m_endpoint.address().is_multicast())
+    {
+      namespace mc = boost::asio::ip::multicast;
+      boost::system::error_code ec;
+      m_socket.set_option(mc::hops(std::clamp(configuration.multicast_ttl, 0, 255)), ec);
+      m_socket.set_option(mc::enable_loopback(configuration.multicast_loopback), ec);
+      if (!configuration.multicast_interface.empty())
+      {
+        auto iface = boost::asio::ip::make_address(configuration.multicast_interface, ec);
+        if (!ec && iface.is_v4())
+          m_socket.set_option(mc::outbound_interface(iface.to_v4()), ec);
+      }
+    }
   }
 
-  ~midi_out() override { close_port(); }
-
-  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
-
-  stdx::error open_port(const output_port& /* port */, std::string_view portName) override
+  ~osc_dgram_sender()
   {
-    return open_virtual_port(portName);
+    close();
+    m_lifetime->end();
   }
 
-  stdx::error open_virtual_port(std::string_view portName) override
+  stdx::error open(std::string_view osc_pattern)
   {
-    // Random arbitrary limit to avoid abuse
-    if (portName.size() >= 512)
-      return std::errc::invalid_argument;
-
-    pkt.init_packet(portName);
+    std::lock_guard lock{m_mutex};
+    if (auto err = m_packet.init_packet(osc_pattern, std::max(configuration.max_datagram_size, 0));
+        err != stdx::error{})
+      return err;
 
+    if (configuration.clock_sync)
+      start_clock_sync();
     return stdx::error{};
   }
 
-  stdx::error close_port() override
+  stdx::error close()
   {
-    pkt.deinit();
+    {
+      std::lock_guard lock{m_mutex};
+      flush_impl();
+      m_packet.deinit();
+      m_timer.cancel();
+      m_sync_timer.cancel();
+      m_clock.reset();
+    }
+
+    if (ctx.is_owned() && m_thread.joinable())
+    {
+      ctx.get().stop();
+      m_thread.join();
+      ctx.get().restart();
+    }
+
     // FIXME async close
     if (m_socket.is_open())
       m_socket.close();
-    return {};
+    return stdx::error{};
   }
 
-  stdx::error send_message(const unsigned char* message, size_t size) override
+  stdx::error send(char tag, const void* data, std::size_t bytes)
   {
-    if (auto err = pkt.set_packet_content(message, size); err != stdx::error{})
+    std::lock_guard lock{m_mutex};
+    const auto now = clock::now();
+    if (auto err = append(tag, data, bytes, now); err != stdx::error{})
       return err;
 
-    auto dat = pkt.get_data();
+    if (configuration.flush_interval.count() <= 0)
+      return flush_impl();
+
+    arm(now + configuration.flush_interval);
+    return stdx::error{};
+  }
+
+  // Unless the clocks are synchronized, OSC arguments carry no individual time:
+  // the message joins the datagram being coalesced, and its timestamp is the latest
+  // point at which that datagram gets sent.
+  stdx::error schedule(int64_t ts, char tag, const void* data, std::size_t bytes)
+  {
+    std::lock_guard lock{m_mutex};
+    const auto now = clock::now();
+    const auto due = due_time(ts, now);
+    if (auto err = append(tag, data, bytes, due); err != stdx::error{})
+      return err;
+
+    const auto deadline = schedule_deadline(due, now);
+    if (deadline <= now)
+      return flush_impl();
+
+    arm(deadline);
+    return stdx::error{};
+  }
+
+  stdx::error send_blob(const void* data, std::size_t bytes)
+  {
+    std::lock_guard lock{m_mutex};
+    const auto now = clock::now();
+    return blob_impl(data, bytes, now + configuration.flush_interval, now);
+  }
+
+  stdx::error schedule_blob(int64_t ts, const void* data, std::size_t bytes)
+  {
+    std::lock_guard lock{m_mutex};
+    const auto now = clock::now();
+    const auto due = due_time(ts, now);
+    return blob_impl(data, bytes, schedule_deadline(due, now), due);
+  }
+
+  stdx::error flush()
+  {
+    std::lock_guard lock{m_mutex};
+    return flush_impl();
+  }
+
+  int64_t current_time() const noexcept { return to_ns(clock::now()); }
+
+  //! The estimated clock of the receiver, when clock_sync is enabled
+  clock_sync_estimator clock_estimate() const
+  {
+    std::lock_guard lock{m_mutex};
+    return m_clock;
+  }
+
+private:
+  // Datagrams held at most before a batch is sent
+  static constexpr std::size_t max_batched_datagrams = 64;
+
+  // A timetag argument, and the type tag padding it may add
+  static constexpr std::size_t timetag_size = 8 + 4;
+
+  static int64_t to_ns(clock::time_point t) noexcept
+  {
+    namespace clk = std::chrono;
+    return clk::duration_cast<clk::nanoseconds>(t.time_since_epoch()).count();
+  }
+
+  // When the message is due on the clock of the receiver, once it is known
+  std::optional<int64_t> remote_time(clock::time_point due) const noexcept
+  {
+    if (!m_clock.valid())
+      return std::nullopt;
+    return m_clock.to_remote(to_ns(due));
+  }
+
+  stdx::error append(char tag, const void* data, std::size_t bytes, clock::time_point due)
+  {
+    if (!m_packet.is_open())
+      return std::errc::not_connected;
+
+    const auto stamp = remote_time(due);
+    const auto arg_size = bytes + (stamp ? timetag_size : 0);
+    if (!m_packet.fits(arg_size))
+    {
+      if (m_packet.empty())
+        return std::errc::message_size;
+
+      if (auto err = overflow(); err != stdx::error{})
+        return err;
+    }
+
+    if (stamp)
+      m_packet.add_timetag(*stamp);
+    m_packet.add_argument(tag, data, bytes);
+    return stdx::error{};
+  }
+
+  // The datagram being coalesced is full. While a timed flush is pending, it waits
+  // in the batch so that the whole burst goes out in a single system call.
+  stdx::error overflow()
+  {
+    if (m_deadline == clock::time_point::max() || m_batch.size() >= max_batched_datagrams)
+      return flush_impl();
+
+    m_batch.push(m_packet.get_data());
+    m_packet.clear();
+    return stdx::error{};
+  }
+
+  stdx::error blob_impl(
+      const void* data, std::size_t bytes, clock::time_point deadline, clock::time_point due)
+  {
+    if (!m_packet.is_open())
+      return std::errc::not_connected;
+
+    const auto stamp = remote_time(due);
+    const auto arg_size = osc_packet::blob_size(bytes) + (stamp ? timetag_size : 0);
+    if (deadline > clock::now() && m_packet.fits_alone(arg_size))
+    {
+      // Coalesced: the blob has to be copied as it outlives the call
+      if (!m_packet.fits(arg_size))
+        if (auto err = overflow(); err != stdx::error{})
+          return err;
+
+      if (stamp)
+        m_packet.add_timetag(*stamp);
+      m_packet.add_blob(data, bytes);
+      arm(deadline);
+      return stdx::error{};
+    }
+
+    // Sent right away, after what is pending in order to keep the ordering
+    m_deadline = clock::time_point::max();
+    if (!m_packet.empty())
+    {
+      m_batch.push(m_packet.get_data());
+      m_packet.clear();
+    }
+
+    if (m_packet.fits_alone(arg_size))
+      return write_blob(data, bytes, stamp);
+    else
+      return write_fragments(static_cast<const char*>(data), bytes, stamp);
+  }
+
+  stdx::error write_blob(const void* data, std::size_t bytes, std::optional<int64_t> stamp)
+  {
+    static constexpr char typetags[4]{',', 'b', 0, 0};
+    static constexpr char stamped_typetags[4]{',', 't', 'b', 0};
+    static constexpr char padding[4]{};
+    const auto be_size = boost::endian::native_to_big(static_cast<int32_t>(bytes));
+    const auto be_stamp = boost::endian::native_to_big(stamp.value_or(0));
+
+    const std::array<boost::asio::const_buffer, 6> dgram{
+        boost::asio::buffer(m_packet.header),
+        boost::asio::buffer(stamp ? stamped_typetags : typetags, 4),
+        boost::asio::buffer(&be_stamp, stamp ? 8 : 0),
+        boost::asio::buffer(&be_size, 4),
+        boost::asio::buffer(data, bytes),
+        boost::asio::buffer(padding, osc_padded_size(bytes) - bytes)};
+
+    // From the caller's memory when it is alone
+    if (m_batch.empty())
+      return write(dgram);
+
+    // Only the header is copied: the blob is sent before returning
+    m_batch.push(std::span{dgram}.first<4>(), std::span{dgram}.last<2>());
+    return write_batch();
+  }
+
+  // With a timestamp, it is repeated in every fragment
+  stdx::error
+  write_fragments(const char* data, std::size_t bytes, std::optional<int64_t> stamp)
+  {
+    static constexpr char typetags[4]{',', 'i', 'b', 0};
+    static constexpr char stamped_typetags[8]{',', 't', 'i', 'b', 0, 0, 0, 0};
+    static constexpr char padding[4]{};
+    const auto be_stamp = boost::endian::native_to_big(stamp.value_or(0));
+    const auto tags
+        = stamp ? boost::asio::buffer(stamped_typetags) : boost::asio::buffer(typetags);
+
+    // header, ",ib\0" or ",tib\0\0\0\0" and timetag, fragment header, blob size
+    const std::size_t overhead = m_packet.header.size() + tags.size() + (stamp ? 8 : 0) + 4 + 4;
+    // Without room for a fragment in a datagram, nothing can be sent
+    const std::size_t max_size = m_packet.max_datagram_size;
+    const std::size_t fragment_size
+        = max_size > overhead ? (max_size - overhead) & ~std::size_t(3) : 0;
+    const std::size_t num_fragments
+        = fragment_size > 0 ? (bytes + fragment_size - 1) / fragment_size : 0;
+    if (num_fragments == 0 || num_fragments > osc_fragment::max_index + 1)
+    {
+      write_batch();
+      return std::errc::message_size;
+    }
+
+    const int transfer = m_transfer++;
+    for (std::size_t i = 0; i < num_fragments; i++)
+    {
+      const std::size_t offset = i * fragment_size;
+      const std::size_t sz = std::min(fragment_size, bytes - offset);
+
+      const osc_fragment frag{
+          .transfer = transfer, .index = int(i), .last = (i == num_fragments - 1)};
+      const auto be_frag = boost::endian::native_to_big(frag.encode());
+      const auto be_size = boost::endian::native_to_big(static_cast<int32_t>(sz));
+
+      const std::array<boost::asio::const_buffer, 7> dgram{
+          boost::asio::buffer(m_packet.header),
+          tags,
+          boost::asio::buffer(&be_stamp, stamp ? 8 : 0),
+          boost::asio::buffer(&be_frag, 4),
+          boost::asio::buffer(&be_size, 4),
+          boost::asio::buffer(data + offset, sz),
+          boost::asio::buffer(padding, osc_padded_size(sz) - sz)};
+
+      // Only the header is copied: the fragments are gathered from the caller's memory,
+      // as every batch is sent before returning
+      m_batch.push(std::span{dgram}.first<5>(), std::span{dgram}.last<2>());
+
+      if (m_batch.size() >= max_batched_datagrams)
+        if (auto err = write_batch(); err != stdx::error{})
+          return err;
+    }
+    return write_batch();
+  }
+
+  stdx::error write(const auto& buffers)
+  {
+    boost::system::error_code ec;
+    m_socket.send_to(buffers, m_endpoint, 0, ec);
+    if (ec)
+      return static_cast<std::errc>(ec.value());
+    return stdx::error{};
+  }
+
+  stdx::error write_batch()
+  {
+    if (m_batch.empty())
+      return stdx::error{};
+
+    if (auto ec = m_batch.send(m_socket, m_endpoint))
+      return static_cast<std::errc>(ec.value());
+    return stdx::error{};
+  }
+
+  stdx::error flush_impl()
+  {
+    m_deadline = clock::time_point::max();
+    if (m_packet.empty())
+      return write_batch();
+
+    // Straight from the packet being coalesced when it is alone
+    if (m_batch.empty())
+    {
+      auto ret = write(m_packet.get_data());
+      m_packet.clear();
+      return ret;
+    }
+
+    m_batch.push(m_packet.get_data());
+    m_packet.clear();
+    return write_batch();
+  }
+
+  // When a scheduled message is due
+  clock::time_point due_time(int64_t ts, clock::time_point now) const noexcept
+  {
+    switch (configuration.timestamps)
+    {
+      case timestamp_mode::Relative:
+        return now + std::chrono::nanoseconds(ts);
+
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        return clock::time_point{std::chrono::nanoseconds(ts)};
+
+      default:
+        return now;
+    }
+  }
+
+  clock::time_point schedule_deadline(clock::time_point due, clock::time_point now) const noexcept
+  {
+    if (configuration.flush_interval.count() > 0)
+      return std::min(due, now + configuration.flush_interval);
+    return due;
+  }
+
+  // Must be called with m_mutex held.
+  // The timer is only ever accessed under the mutex, the handler re-checks the
+  // deadline as it may have been moved by an explicit or size-triggered flush.
+  void arm(clock::time_point deadline)
+  {
+    if (deadline >= m_deadline)
+      return;
+    m_deadline = deadline;
+
+    ensure_running();
+    m_timer.expires_at(deadline);
+    m_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (lifetime->alive && clock::now() >= m_deadline)
+        flush_impl();
+    });
+  }
+
+  void ensure_running()
+  {
+    if (ctx.is_owned() && !m_thread.joinable())
+    {
+      m_thread = std::thread{[&ctx = ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+  }
+
+  // Must be called with m_mutex held.
+  // A burst of exchanges gives a first estimate, refined every clock_sync_interval.
+  void start_clock_sync()
+  {
+    m_clock.reset();
+    m_sync_count = 0;
+    ensure_running();
+
+    // Sending binds the socket, which can then receive the replies
+    send_clock_request();
+    receive_clock_reply();
+  }
+
+  void send_clock_request()
+  {
+    const int64_t t0 = to_ns(clock::now());
+    const auto req = write_osc_clock(std::span{&t0, 1});
     boost::system::error_code ec;
-    m_socket.send_to(boost::asio::const_buffer(dat.data(), dat.size()), m_endpoint, 0, ec);
-    return stdx::error{}; // FIXME
+    m_socket.send_to(boost::asio::buffer(req), m_endpoint, 0, ec);
+
+    using namespace std::chrono_literals;
+    static constexpr int initial_exchanges = 8;
+    std::chrono::milliseconds interval = 20ms;
+    if (++m_sync_count >= initial_exchanges)
+      interval = std::max(configuration.clock_sync_interval, std::chrono::milliseconds(1));
+    m_sync_timer.expires_after(interval);
+    m_sync_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (lifetime->alive && m_packet.is_open())
+        send_clock_request();
+    });
   }
 
-  stdx::error schedule_message(int64_t, const unsigned char*, size_t) override
+  void receive_clock_reply()
   {
-    int ret = 0;
-    return from_errc(ret);
+    m_socket.async_receive_from(
+        boost::asio::buffer(m_clock_buffer), m_clock_from,
+        [this, lifetime = m_lifetime](boost::system::error_code ec, std::size_t sz) {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      const int64_t t3 = to_ns(clock::now());
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive || !m_packet.is_open())
+        return;
+
+      // Only the receiver we send to is listened to
+      if (!ec && m_clock_from == m_endpoint)
+        if (auto msg = parse_osc_clock(m_clock_buffer.data(), sz); msg && msg->count == 3)
+          if (const auto t0 = msg->times[0]; t0 <= t3 && t3 - t0 < 1'000'000'000)
+            m_clock.add(t0, msg->times[1], msg->times[2], t3);
+
+      receive_clock_reply();
+    });
   }
 
+  const Configuration& configuration;
+
+public:
   libremidi::optionally_owned<boost::asio::io_context> ctx;
+
+private:
   boost::asio::ip::udp::endpoint m_endpoint;
   boost::asio::ip::udp::socket m_socket;
-
-  osc_midi1_packet pkt;
+  boost::asio::steady_timer m_timer;
+  boost::asio::steady_timer m_sync_timer;
+  std::thread m_thread;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+
+  osc_packet m_packet;
+  dgram_batch_sender m_batch;
+  clock::time_point m_deadline{clock::time_point::max()};
+  int m_transfer{};
+
+  clock_sync_estimator m_clock;
+  int m_sync_count{};
+  std::array<char, 64> m_clock_buffer{};
+  boost::asio::ip::udp::endpoint m_clock_from;
 };
-
 }
 
-NAMESPACE_LIBREMIDI::net_ump
+NAMESPACE_LIBREMIDI::net
 {
-struct osc_midi2_packet
+class midi_out final
+    : public midi1::out_api
+    , public error_handler
 {
-  stdx::error init_packet(std::string_view osc_pattern)
-  {
-    int i = 0;
-    for (; i < std::ssize(osc_pattern); i++)
-      if (osc_pattern.data()[i] != 0)
-        bytes[i] = osc_pattern.data()[i];
-      else
-        break;
-    bytes[i] = 0;
-    while (i % 4 != 3)
-    {
-      ++i;
-      bytes[i] = 0;
-    }
+public:
+  struct
+      : output_configuration
+      , dgram_output_configuration
+  {
+  } configuration;
 
-    bytes[++i] = ',';
-    bytes[++i] = 'M';
-    bytes[++i] = 0;
-    bytes[++i] = 0;
+  midi_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_sender{configuration}
+  {
+    this->client_open_ = stdx::error{};
+  }
 
-    // MIDI 2 message (M) spec: an UMP
-    header_size = ++i;
+  ~midi_out() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
 
-    return stdx::error{}; // FIXME
+  stdx::error open_port(const output_port& /* port */, std::string_view portName) override
+  {
+    return open_virtual_port(portName);
   }
 
-  stdx::error deinit()
+  stdx::error open_virtual_port(std::string_view portName) override
   {
-    header_size = 0;
-    return stdx::error{};
+    // Random arbitrary limit to avoid abuse
+    if (portName.size() >= 512)
+      return std::errc::invalid_argument;
+
+    return m_sender.open(portName);
   }
 
-  stdx::error set_packet_content(const uint32_t* message, size_t size)
+  stdx::error close_port() override { return m_sender.close(); }
+
+  // Channel and system messages are sent as MIDI (m) arguments:
+  // port n°, status byte, data 1, data 2.
+  // SysEx and anything longer are sent as blobs (b).
+  static bool fits_osc_midi_argument(const unsigned char* message, size_t size) noexcept
   {
-    if (header_size == 0)
-      return std::errc::not_connected;
+    return size <= 3 && message[0] != 0xF0;
+  }
 
-    if (size > 4)
+  stdx::error send_message(const unsigned char* message, size_t size) override
+  {
+    if (size == 0)
       return std::errc::message_size;
 
-    message_size = 4 * size;
-
-    std::memcpy(this->bytes + header_size, message, message_size);
+    if (fits_osc_midi_argument(message, size))
+    {
+      char arg[4]{};
+      std::memcpy(arg + 1, message, size);
+      return m_sender.send('m', arg, 4);
+    }
 
-    return stdx::error{};
+    return m_sender.send_blob(message, size);
   }
 
-  std::span<const char> get_data()
+  stdx::error schedule_message(int64_t ts, const unsigned char* message, size_t size) override
   {
-    return std::span(this->bytes, this->header_size + this->message_size);
+    if (size == 0)
+      return std::errc::message_size;
+
+    if (fits_osc_midi_argument(message, size))
+    {
+      char arg[4]{};
+      std::memcpy(arg + 1, message, size);
+      return m_sender.schedule(ts, 'm', arg, 4);
+    }
+
+    return m_sender.schedule_blob(ts, message, size);
   }
-  char bytes[512 + 8 + 64];
-  int header_size{};
-  int message_size{};
+
+  stdx::error flush() override { return m_sender.flush(); }
+
+  int64_t current_time() const noexcept override { return m_sender.current_time(); }
+
+  osc_dgram_sender<decltype(configuration)> m_sender;
 };
 
+}
+
+NAMESPACE_LIBREMIDI::net_ump
+{
 class midi_out final
     : public midi2::out_api
     , public error_handler
@@ -219,17 +753,8 @@ public:
 
   midi_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
-      , ctx{configuration.io_context}
-      , m_socket{ctx.get()}
+      , m_sender{configuration}
   {
-    m_socket.open(boost::asio::ip::udp::v4());
-    m_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
-    m_socket.set_option(boost::asio::socket_base::broadcast(true));
-
-    m_endpoint
-        = {boost::asio::ip::make_address(this->configuration.host),
-           static_cast<unsigned short>(this->configuration.port)};
-
     this->client_open_ = stdx::error{};
   }
 
@@ -248,41 +773,33 @@ public:
     if (portName.size() >= 512)
       return std::errc::invalid_argument;
 
-    pkt.init_packet(portName);
-
-    return stdx::error{};
+    return m_sender.open(portName);
   }
 
-  stdx::error close_port() override
-  {
-    pkt.deinit();
-    if (m_socket.is_open())
-      m_socket.close();
-    return {};
-  }
+  stdx::error close_port() override { return m_sender.close(); }
 
   stdx::error send_ump(const uint32_t* message, size_t size) override
   {
-    if (auto err = pkt.set_packet_content(message, size); err != stdx::error{})
-      return err;
+    if (size == 0 || size > 4)
+      return std::errc::message_size;
 
-    auto dat = pkt.get_data();
-    boost::system::error_code ec;
-    m_socket.send_to(boost::asio::const_buffer(dat.data(), dat.size()), m_endpoint, 0, ec);
-    return stdx::error{}; // FIXME
+    // MIDI 2 message (M) spec: an UMP
+    return m_sender.send('M', message, 4 * size);
   }
 
-  stdx::error schedule_ump(int64_t, const uint32_t*, size_t) override
+  stdx::error schedule_ump(int64_t ts, const uint32_t* message, size_t size) override
   {
-    int ret = 0;
-    return from_errc(ret);
+    if (size == 0 || size > 4)
+      return std::errc::message_size;
+
+    return m_sender.schedule(ts, 'M', message, 4 * size);
   }
 
-  libremidi::optionally_owned<boost::asio::io_context> ctx;
-  boost::asio::ip::udp::endpoint m_endpoint;
-  boost::asio::ip::udp::socket m_socket;
+  stdx::error flush() override { return m_sender.flush(); }
+
+  int64_t current_time() const noexcept override { return m_sender.current_time(); }
 
-  osc_midi2_packet pkt;
+  osc_dgram_sender<decltype(configuration)> m_sender;
 };
 
 }
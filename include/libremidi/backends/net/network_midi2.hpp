@@ -0,0 +1,388 @@
+#pragma once
+#include <libremidi/backends/net/helpers.hpp>
+
+#include <boost/asio/buffer.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Network MIDI 2.0 (UDP) transport, as specified by the MIDI Association.
+// This file contains the wire format and the UMP data streams, independently of any socket:
+// the sessions themselves are in network_midi2_in.hpp and network_midi2_out.hpp.
+NAMESPACE_LIBREMIDI::network_midi2
+{
+//! Every datagram starts with "MIDI"
+static constexpr uint32_t signature = 0x4D494449;
+
+//! The payload length of a command is counted in 32-bit words on a single byte
+static constexpr std::size_t max_payload_words = 255;
+
+enum class command : uint8_t
+{
+  invitation = 0x01,
+  invitation_with_auth = 0x02,
+  invitation_with_user_auth = 0x03,
+  invitation_accepted = 0x10,
+  invitation_pending = 0x11,
+  authentication_required = 0x12,
+  user_authentication_required = 0x13,
+  ping = 0x20,
+  ping_reply = 0x21,
+  retransmit_request = 0x80,
+  retransmit_error = 0x81,
+  session_reset = 0x82,
+  session_reset_reply = 0x83,
+  nak = 0x8F,
+  bye = 0xF0,
+  bye_reply = 0xF1,
+  ump_data = 0xFF,
+};
+
+enum class bye_reason : uint8_t
+{
+  unknown = 0x00,
+  user_terminated = 0x01,
+  power_down = 0x02,
+  too_many_missing_packets = 0x03,
+  timeout = 0x04,
+  session_not_established = 0x05,
+  no_pending_session = 0x06,
+  protocol_error = 0x07,
+  too_many_sessions = 0x40,
+};
+
+enum class nak_reason : uint8_t
+{
+  other = 0x00,
+  command_not_supported = 0x01,
+  command_not_expected = 0x02,
+  command_malformed = 0x03,
+};
+
+enum class retransmit_error_reason : uint8_t
+{
+  unknown = 0x00,
+  data_not_available = 0x01,
+};
+
+struct command_header
+{
+  enum command command{};
+  uint8_t length{};    // payload, in words
+  uint16_t specific{}; // command-specific data
+};
+
+//! Appends a command, its payload padded to a whole number of words
+LIBREMIDI_STATIC void write_command(
+    std::vector<uint8_t>& out, command cmd, uint16_t specific,
+    std::span<const uint8_t> payload = {})
+{
+  const auto words = std::min((payload.size() + 3) / 4, max_payload_words);
+  byte_writer w{out};
+  w.u8(static_cast<uint8_t>(cmd));
+  w.u8(static_cast<uint8_t>(words));
+  w.u16(specific);
+  w.bytes(payload.first(std::min(payload.size(), words * 4)));
+  out.resize(out.size() + words * 4 - std::min(payload.size(), words * 4));
+}
+
+//! Invitation and invitation accepted: the UMP endpoint name and product instance id,
+//! each padded to a whole number of words.
+LIBREMIDI_STATIC void write_identity(
+    std::vector<uint8_t>& out, command cmd, std::string_view name,
+    std::string_view product_instance_id, uint8_t capabilities = 0)
+{
+  // Arbitrary limits, to keep the command within its maximum length
+  name = name.substr(0, 98);
+  product_instance_id = product_instance_id.substr(0, 42);
+
+  const auto name_words = (name.size() + 3) / 4;
+  const auto id_words = (product_instance_id.size() + 3) / 4;
+  std::vector<uint8_t> payload((name_words + id_words) * 4);
+  std::copy(name.begin(), name.end(), payload.begin());
+  std::copy(
+      product_instance_id.begin(), product_instance_id.end(), payload.begin() + name_words * 4);
+
+  write_command(out, cmd, static_cast<uint16_t>((name_words << 8) | capabilities), payload);
+}
+
+//! Name sent along with an invitation or its acceptance
+LIBREMIDI_STATIC std::string_view
+read_identity(const command_header& header, std::span<const uint8_t> payload) noexcept
+{
+  const auto name_words = std::min<std::size_t>(header.specific >> 8, payload.size() / 4);
+  std::string_view name{reinterpret_cast<const char*>(payload.data()), name_words * 4};
+  return name.substr(0, name.find('\0'));
+}
+
+//! Calls f(header, payload) for each command of a datagram.
+//! Returns false if the datagram is not a Network MIDI 2.0 one or is truncated.
+template <typename F>
+bool read_datagram(std::span<const uint8_t> data, F&& f)
+{
+  byte_reader r{data};
+  if (r.u32() != signature)
+    return false;
+
+  while (r.remaining() > 0)
+  {
+    command_header header;
+    header.command = static_cast<command>(r.u8());
+    header.length = r.u8();
+    header.specific = r.u16();
+    auto payload = r.bytes(header.length * 4);
+    if (!r.ok)
+      return false;
+    f(header, payload);
+  }
+  return true;
+}
+
+//! Sending side of an UMP data stream.
+//! The UMPs are byte-swapped once into a ring of UMP data commands,
+//! which the datagrams then gather without further copy: the new command,
+//! preceded by the previous ones for forward error correction.
+class ump_sender
+{
+public:
+  //! Previous commands repeated in each datagram
+  int fec_count = 2;
+  std::size_t max_datagram_size = 1472;
+
+  explicit ump_sender(std::size_t history_size = 256)
+      : m_history(std::bit_ceil(std::clamp<std::size_t>(history_size + 1, 2, 65536)))
+  {
+  }
+
+  //! Sequence number of the next UMP data command
+  uint16_t sequence() const noexcept { return m_sequence; }
+  bool empty() const noexcept { return m_pending_words == 0; }
+
+  template <typename F>
+  void write(std::span<const uint32_t> ump, F&& send_datagram)
+  {
+    if (m_pending_words + ump.size() > capacity())
+      flush(send_datagram);
+
+    auto& bytes = at(m_sequence).bytes;
+    if (m_pending_words == 0)
+      bytes.assign(4, 0);
+
+    byte_writer w{bytes};
+    for (uint32_t word : ump)
+      w.u32(word);
+    m_pending_words += ump.size();
+  }
+
+  template <typename F>
+  void flush(F&& send_datagram)
+  {
+    if (m_pending_words == 0)
+      return;
+
+    auto& e = at(m_sequence);
+    e.bytes[0] = static_cast<uint8_t>(command::ump_data);
+    e.bytes[1] = static_cast<uint8_t>(m_pending_words);
+    e.bytes[2] = m_sequence >> 8;
+    e.bytes[3] = m_sequence & 0xFF;
+
+    // As many of the previous commands as fit, oldest first
+    std::size_t budget = max_datagram_size - std::min(max_datagram_size, 4 + e.bytes.size());
+    std::size_t fec = 0;
+    const auto max_fec = std::min<std::size_t>(std::max(fec_count, 0), max_buffers - 2);
+    while (fec < max_fec && fec < m_count)
+    {
+      auto& prev = at(static_cast<uint16_t>(m_sequence - fec - 1));
+      if (prev.bytes.size() > budget)
+        break;
+      budget -= prev.bytes.size();
+      fec++;
+    }
+
+    m_buffers.clear();
+    m_buffers.push_back(boost::asio::buffer(signature_bytes));
+    for (std::size_t i = fec; i > 0; i--)
+      m_buffers.push_back(boost::asio::buffer(at(static_cast<uint16_t>(m_sequence - i)).bytes));
+    m_buffers.push_back(boost::asio::buffer(e.bytes));
+    send_datagram(std::as_const(m_buffers));
+
+    m_sequence++;
+    m_count = std::min(m_count + 1, m_history.size() - 1);
+    m_pending_words = 0;
+  }
+
+  //! Sends again the commands starting at first, count of them or all if zero.
+  //! Returns false if the first one is not in the history anymore.
+  template <typename F>
+  bool retransmit(uint16_t first, uint16_t count, F&& send_datagram)
+  {
+    const std::size_t age = uint16_t(m_sequence - first);
+    if (age == 0 || age > m_count)
+      return false;
+    if (count == 0 || count > age)
+      count = static_cast<uint16_t>(age);
+
+    std::size_t size = max_datagram_size;
+    m_buffers.clear();
+    for (uint16_t i = 0; i < count; i++)
+    {
+      auto& e = at(static_cast<uint16_t>(first + i));
+      if (!m_buffers.empty()
+          && (size + e.bytes.size() > max_datagram_size || m_buffers.size() == max_buffers))
+      {
+        send_datagram(std::as_const(m_buffers));
+        m_buffers.clear();
+      }
+      if (m_buffers.empty())
+      {
+        m_buffers.push_back(boost::asio::buffer(signature_bytes));
+        size = 4;
+      }
+      m_buffers.push_back(boost::asio::buffer(e.bytes));
+      size += e.bytes.size();
+    }
+    send_datagram(std::as_const(m_buffers));
+    return true;
+  }
+
+  //! Back to the start of a session: the sequence numbers restart from zero
+  void reset() noexcept
+  {
+    m_sequence = 0;
+    m_count = 0;
+    m_pending_words = 0;
+  }
+
+private:
+  struct entry
+  {
+    std::vector<uint8_t> bytes;
+  };
+
+  static constexpr uint8_t signature_bytes[4]{'M', 'I', 'D', 'I'};
+
+  // Asio gathers at most this many buffers in a single send
+  static constexpr std::size_t max_buffers = 64;
+
+  entry& at(uint16_t seq) noexcept { return m_history[seq % m_history.size()]; }
+
+  // Words of the pending command, so that the datagram fits with at least its signature
+  std::size_t capacity() const noexcept
+  {
+    const auto words = max_datagram_size > 8 ? (max_datagram_size - 8) / 4 : 1;
+    return std::clamp<std::size_t>(words, 4, max_payload_words);
+  }
+
+  // Indexed by the sequence number: its size is a power of two so that
+  // the index stays consistent when the 16-bit sequence wraps around.
+  std::vector<entry> m_history;
+  std::vector<boost::asio::const_buffer> m_buffers;
+  uint16_t m_sequence{};
+  std::size_t m_count{};
+  std::size_t m_pending_words{};
+};
+
+//! Receiving side of an UMP data stream: delivers the commands in order,
+//! drops the duplicates brought by forward error correction, and holds
+//! the commands received after a gap until it is filled or skipped.
+class ump_receiver
+{
+public:
+  //! Commands held at most while waiting for missing ones
+  std::size_t max_pending = 256;
+
+  struct gap
+  {
+    uint16_t first{};
+    uint16_t count{};
+  };
+
+  //! Calls deliver(payload) for the command and those it unblocks
+  template <typename F>
+  void on_data(uint16_t seq, std::span<const uint8_t> payload, F&& deliver)
+  {
+    if (seq == m_expected)
+    {
+      deliver(payload);
+      m_expected++;
+      drain(deliver);
+    }
+    else if (sequence_after(seq, m_expected))
+    {
+      if (std::ranges::any_of(m_pending, [seq](auto& p) { return p.sequence == seq; }))
+        return;
+
+      m_pending.push_back({seq, {payload.begin(), payload.end()}});
+      if (m_pending.size() > max_pending)
+        skip(deliver);
+    }
+  }
+
+  //! The commands missing before the first held one, if any
+  std::optional<gap> missing() const noexcept
+  {
+    if (m_pending.empty())
+      return std::nullopt;
+
+    uint16_t first = m_pending.front().sequence;
+    for (auto& p : m_pending)
+      if (sequence_after(first, p.sequence))
+        first = p.sequence;
+    return gap{m_expected, static_cast<uint16_t>(first - m_expected)};
+  }
+
+  //! Gives up on the missing commands and delivers the following ones
+  template <typename F>
+  void skip(F&& deliver)
+  {
+    if (auto g = missing())
+    {
+      m_expected += g->count;
+      m_skipped += g->count;
+      drain(deliver);
+    }
+  }
+
+  void reset() noexcept
+  {
+    m_expected = 0;
+    m_pending.clear();
+  }
+
+  //! Commands that were never received
+  uint64_t skipped() const noexcept { return m_skipped; }
+
+private:
+  template <typename F>
+  void drain(F& deliver)
+  {
+    for (auto it = find(m_expected); it != m_pending.end(); it = find(m_expected))
+    {
+      deliver(std::span<const uint8_t>{it->bytes});
+      m_expected++;
+      m_pending.erase(it);
+    }
+  }
+
+  auto find(uint16_t seq) noexcept
+  {
+    return std::ranges::find_if(m_pending, [seq](auto& p) { return p.sequence == seq; });
+  }
+
+  struct pending
+  {
+    uint16_t sequence{};
+    std::vector<uint8_t> bytes;
+  };
+
+  std::vector<pending> m_pending;
+  uint16_t m_expected{};
+  uint64_t m_skipped{};
+};
+}
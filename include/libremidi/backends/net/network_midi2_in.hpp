@@ -0,0 +1,412 @@
+#pragma once
+#include <libremidi/backends/net/config.hpp>
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/backends/net/midi_in.hpp>
+#include <libremidi/backends/net/network_midi2.hpp>
+#include <libremidi/detail/midi_in.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::net_ump
+{
+// Host side of Network MIDI 2.0 sessions: accepts the invitations of clients
+// and receives their UMP streams, requesting the retransmission of what is missing.
+class network_midi2_in final
+    : public midi2::in_api
+    , public error_handler
+{
+public:
+  using midi_api::client_open_;
+  using clock = std::chrono::steady_clock;
+
+  struct
+      : ump_input_configuration
+      , dgram_input_configuration
+  {
+  } configuration;
+
+  explicit network_midi2_in(ump_input_configuration&& conf, dgram_input_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_ctx{configuration.io_context}
+      , m_socket{m_ctx.get()}
+      , m_timer{m_ctx.get()}
+  {
+    boost::system::error_code ec;
+    const auto address = boost::asio::ip::make_address(configuration.accept, ec);
+    if (ec || configuration.port < 0 || configuration.port >= 65536)
+    {
+      client_open_ = std::errc::invalid_argument;
+      return;
+    }
+
+    m_socket.open(address.is_v6() ? boost::asio::ip::udp::v6() : boost::asio::ip::udp::v4(), ec);
+    if (!ec)
+      m_socket.bind({address, static_cast<unsigned short>(configuration.port)}, ec);
+    if (ec)
+    {
+      client_open_ = std::errc::address_in_use;
+      return;
+    }
+
+    if (auto failed = tune_input_socket(m_socket, configuration); !failed.empty())
+      libremidi_handle_warning(configuration, failed);
+
+    client_open_ = stdx::error{};
+  }
+
+  ~network_midi2_in() override
+  {
+    close_port();
+    m_lifetime->end();
+  }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK_UMP; }
+
+  stdx::error open_port(const input_port&, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  // The port name is the UMP endpoint name sent to the clients
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_open)
+        return std::errc::device_or_resource_busy;
+      m_open = true;
+      m_name = name;
+
+      receive();
+    }
+
+    if (m_ctx.is_owned() && !m_thread.joinable())
+    {
+      m_thread = std::thread{[&ctx = m_ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    {
+      std::lock_guard lock{m_mutex};
+      for (auto& s : m_sessions)
+      {
+        m_reply.clear();
+        m_refused = false;
+        write_bye(network_midi2::bye_reason::user_terminated);
+        send_reply(s.endpoint);
+      }
+      m_sessions.clear();
+      m_open = false;
+
+      boost::system::error_code ec;
+      m_timer.cancel();
+      m_deadline = clock::time_point::max();
+      m_socket.cancel(ec);
+    }
+
+    if (m_ctx.is_owned() && m_thread.joinable())
+    {
+      m_ctx.get().stop();
+      m_thread.join();
+      m_ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  timestamp absolute_timestamp() const noexcept override
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+private:
+  struct session
+  {
+    boost::asio::ip::udp::endpoint endpoint{};
+    network_midi2::ump_receiver receiver{};
+
+    //! Start of the gap whose retransmission was requested, and until when it is awaited
+    uint16_t requested{};
+    clock::time_point deadline{clock::time_point::max()};
+  };
+
+  // Arbitrary limit to avoid abuse
+  static constexpr std::size_t max_sessions = 16;
+
+  session* find(const boost::asio::ip::udp::endpoint& ep) noexcept
+  {
+    for (auto& s : m_sessions)
+      if (s.endpoint == ep)
+        return &s;
+    return nullptr;
+  }
+
+  void receive()
+  {
+    m_buffer.resize(65535);
+    m_socket.async_receive_from(
+        boost::asio::buffer(m_buffer), m_from,
+        [this, lifetime = m_lifetime](boost::system::error_code ec, std::size_t sz) {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      if (!ec)
+        on_datagram({m_buffer.data(), sz});
+
+      receive();
+    });
+  }
+
+  // All the replies to a datagram are batched in a single one
+  void on_datagram(std::span<const uint8_t> bytes)
+  {
+    m_reply.clear();
+    m_refused = false;
+    network_midi2::read_datagram(bytes, [this](const auto& header, auto payload) {
+      on_command(header, payload);
+    });
+
+    if (auto s = find(m_from))
+      request_missing(*s);
+    send_reply(m_from);
+  }
+
+  void on_command(const network_midi2::command_header& header, std::span<const uint8_t> payload)
+  {
+    using namespace network_midi2;
+    using enum network_midi2::command;
+    auto s = find(m_from);
+    switch (header.command)
+    {
+      case invitation: {
+        if (!s && m_sessions.size() < max_sessions)
+          s = &m_sessions.emplace_back(session{.endpoint = m_from});
+
+        if (!s)
+        {
+          write_bye(bye_reason::too_many_sessions);
+          return;
+        }
+
+        // A new invitation from a known client starts its session over
+        s->receiver.reset();
+        s->deadline = clock::time_point::max();
+        write_identity(m_reply, invitation_accepted, m_name, configuration.client_name);
+        break;
+      }
+
+      case ump_data: {
+        if (!s)
+        {
+          write_bye(bye_reason::session_not_established);
+          return;
+        }
+
+        s->receiver.on_data(header.specific, payload, [this](auto ump) { on_ump(ump); });
+        break;
+      }
+
+      case retransmit_error:
+        if (s)
+          skip(*s);
+        break;
+
+      case ping:
+        write_command(m_reply, ping_reply, 0, payload);
+        break;
+
+      case session_reset:
+        if (s)
+        {
+          s->receiver.reset();
+          s->deadline = clock::time_point::max();
+          write_command(m_reply, session_reset_reply, 0);
+        }
+        break;
+
+      case bye:
+        if (s)
+          std::erase_if(m_sessions, [this](auto& other) { return other.endpoint == m_from; });
+        write_command(m_reply, bye_reply, 0);
+        break;
+
+      case bye_reply:
+      case ping_reply:
+      case nak:
+        break;
+
+      default: {
+        // The header of the command being refused is the payload of the NAK
+        std::vector<uint8_t> refused;
+        byte_writer w{refused};
+        w.u8(static_cast<uint8_t>(header.command));
+        w.u8(header.length);
+        w.u16(header.specific);
+        write_command(
+            m_reply, nak, static_cast<uint16_t>(nak_reason::command_not_supported) << 8,
+            refused);
+        break;
+      }
+    }
+  }
+
+  // Once per datagram, which may carry many commands for a session that does not exist
+  void write_bye(network_midi2::bye_reason reason)
+  {
+    if (std::exchange(m_refused, true))
+      return;
+    network_midi2::write_command(
+        m_reply, network_midi2::command::bye, static_cast<uint16_t>(reason) << 8);
+  }
+
+  void send_reply(const boost::asio::ip::udp::endpoint& to)
+  {
+    if (m_reply.empty())
+      return;
+
+    const uint8_t sig[4]{'M', 'I', 'D', 'I'};
+    const std::array<boost::asio::const_buffer, 2> buffers{
+        boost::asio::buffer(sig), boost::asio::buffer(m_reply)};
+    boost::system::error_code ec;
+    m_socket.send_to(buffers, to, 0, ec);
+    m_reply.clear();
+  }
+
+  // A new gap is requested once: the following datagrams bring the missing data
+  // through forward error correction, the retransmission, or the timeout skips it.
+  void request_missing(session& s)
+  {
+    auto gap = s.receiver.missing();
+    if (!gap)
+    {
+      s.deadline = clock::time_point::max();
+      return;
+    }
+
+    if (s.deadline != clock::time_point::max() && gap->first == s.requested)
+      return;
+
+    std::vector<uint8_t> count;
+    byte_writer w{count};
+    w.u16(gap->count);
+    w.u16(0);
+    network_midi2::write_command(
+        m_reply, network_midi2::command::retransmit_request, gap->first, count);
+
+    s.requested = gap->first;
+    s.deadline = clock::now() + configuration.retransmit_timeout;
+    arm(s.deadline);
+  }
+
+  void skip(session& s)
+  {
+    s.receiver.skip([this](auto ump) { on_ump(ump); });
+    s.deadline = clock::time_point::max();
+  }
+
+  // Must be called with m_mutex held, as all the functions above
+  void arm(clock::time_point deadline)
+  {
+    if (deadline >= m_deadline)
+      return;
+    m_deadline = deadline;
+
+    m_timer.expires_at(deadline);
+    m_timer.async_wait([this, lifetime = m_lifetime, deadline](boost::system::error_code ec) {
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      // Nothing is armed anymore, unless an earlier deadline replaced this one
+      if (m_deadline == deadline)
+        m_deadline = clock::time_point::max();
+      if (ec)
+        return;
+
+      const auto now = clock::now();
+      auto next = clock::time_point::max();
+      for (auto& s : m_sessions)
+      {
+        if (s.deadline <= now)
+        {
+          skip(s);
+          m_reply.clear();
+          request_missing(s);
+          send_reply(s.endpoint);
+        }
+        next = std::min(next, s.deadline);
+      }
+
+      if (next != clock::time_point::max())
+        arm(next);
+    });
+  }
+
+  // The UMPs are in network byte order
+  void on_ump(std::span<const uint8_t> payload)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = false,
+        .absolute_is_monotonic = false,
+        .has_samples = false,
+    };
+
+    static constexpr auto to_ns = []() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    };
+
+    byte_reader r{payload};
+    m_words.clear();
+    while (r.remaining() >= 4)
+      m_words.push_back(r.u32());
+
+    m_processing.on_bytes_multi(m_words, m_processing.timestamp<timestamp_info>(to_ns, 0));
+  }
+
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+
+  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
+  boost::asio::ip::udp::socket m_socket;
+  boost::asio::ip::udp::endpoint m_from;
+  boost::asio::steady_timer m_timer;
+  std::thread m_thread;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+  bool m_open{};
+  bool m_refused{};
+  std::string m_name;
+  std::vector<session> m_sessions;
+  clock::time_point m_deadline{clock::time_point::max()};
+  std::vector<uint8_t> m_buffer, m_reply;
+  std::vector<uint32_t> m_words;
+};
+}
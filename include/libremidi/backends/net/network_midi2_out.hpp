@@ -0,0 +1,409 @@
+#pragma once
+#include <libremidi/backends/net/config.hpp>
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/backends/net/midi_out.hpp>
+#include <libremidi/backends/net/network_midi2.hpp>
+#include <libremidi/detail/midi_out.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::net_ump
+{
+// Client side of a Network MIDI 2.0 session: invites the host and sends it an UMP stream,
+// with the previous UMP data commands repeated in each datagram and a retransmission history.
+class network_midi2_out final
+    : public midi2::out_api
+    , public error_handler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct
+      : output_configuration
+      , dgram_output_configuration
+  {
+  } configuration;
+
+  network_midi2_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_ctx{configuration.io_context}
+      , m_socket{m_ctx.get()}
+      , m_session_timer{m_ctx.get()}
+      , m_flush_timer{m_ctx.get()}
+      , m_stream{std::size_t(std::max(configuration.retransmit_buffer_size, 1))}
+  {
+    boost::system::error_code ec;
+    const auto host = boost::asio::ip::make_address(configuration.host, ec);
+    if (ec || configuration.port <= 0 || configuration.port >= 65536)
+    {
+      client_open_ = std::errc::invalid_argument;
+      return;
+    }
+    m_remote = {host, static_cast<unsigned short>(configuration.port)};
+
+    m_socket.open(m_remote.protocol(), ec);
+    if (!ec)
+      m_socket.bind({m_remote.protocol(), 0}, ec);
+    if (ec)
+    {
+      client_open_ = std::errc::address_in_use;
+      return;
+    }
+
+    m_stream.fec_count = configuration.fec_count;
+    m_stream.max_datagram_size = std::max(configuration.max_datagram_size, 0);
+    client_open_ = stdx::error{};
+  }
+
+  ~network_midi2_out() override
+  {
+    close_port();
+    m_lifetime->end();
+  }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK_UMP; }
+
+  stdx::error open_port(const output_port& /* port */, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  // The port name is the UMP endpoint name sent to the host
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_state != state::closed)
+        return std::errc::device_or_resource_busy;
+
+      m_name = name;
+      m_state = state::inviting;
+      m_attempts = 0;
+
+      receive();
+      invite();
+    }
+
+    if (m_ctx.is_owned() && !m_thread.joinable())
+    {
+      m_thread = std::thread{[&ctx = m_ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_state == state::connected)
+      {
+        flush_impl();
+        m_reply.clear();
+        network_midi2::write_command(
+            m_reply, network_midi2::command::bye,
+            static_cast<uint16_t>(network_midi2::bye_reason::user_terminated) << 8);
+        send_reply();
+      }
+      m_state = state::closed;
+
+      boost::system::error_code ec;
+      m_session_timer.cancel();
+      m_flush_timer.cancel();
+      m_socket.cancel(ec);
+    }
+
+    if (m_ctx.is_owned() && m_thread.joinable())
+    {
+      m_ctx.get().stop();
+      m_thread.join();
+      m_ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  // Sending fails with not_connected until the host accepts the invitation
+  stdx::error send_ump(const uint32_t* message, size_t size) override
+  {
+    return write_ump(clock::now() + configuration.flush_interval, message, size);
+  }
+
+  // The transport has no timestamps of its own: the datagram is sent at the requested time,
+  // or earlier to honor flush_interval. JR timestamps in the stream can convey finer timing.
+  stdx::error schedule_ump(int64_t ts, const uint32_t* message, size_t size) override
+  {
+    const auto now = clock::now();
+    auto deadline = now;
+    switch (configuration.timestamps)
+    {
+      case timestamp_mode::Relative:
+        deadline = now + std::chrono::nanoseconds(ts);
+        break;
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        deadline = clock::time_point{std::chrono::nanoseconds(ts)};
+        break;
+      default:
+        break;
+    }
+
+    if (configuration.flush_interval.count() > 0)
+      deadline = std::min(deadline, now + configuration.flush_interval);
+    return write_ump(deadline, message, size);
+  }
+
+  stdx::error flush() override
+  {
+    std::lock_guard lock{m_mutex};
+    return flush_impl();
+  }
+
+  int64_t current_time() const noexcept override
+  {
+    namespace clk = std::chrono;
+    return clk::duration_cast<clk::nanoseconds>(clock::now().time_since_epoch()).count();
+  }
+
+private:
+  enum class state
+  {
+    closed,
+    inviting,
+    connected,
+    rejected,
+  };
+
+  static constexpr int max_invitations = 12;
+  static constexpr auto invitation_interval = std::chrono::seconds(1);
+
+  stdx::error write_ump(clock::time_point deadline, const uint32_t* message, size_t size)
+  {
+    if (size == 0 || size > 4)
+      return std::errc::message_size;
+
+    std::lock_guard lock{m_mutex};
+    if (m_state != state::connected)
+      return std::errc::not_connected;
+
+    stdx::error ret;
+    m_stream.write({message, size}, [&](const auto& buffers) {
+      if (auto err = write(buffers); err != stdx::error{})
+        ret = err;
+    });
+
+    if (deadline <= clock::now())
+    {
+      if (auto err = flush_impl(); err != stdx::error{})
+        ret = err;
+    }
+    else
+    {
+      arm_flush(deadline);
+    }
+    return ret;
+  }
+
+  // Must be called with m_mutex held, as all the functions below
+  stdx::error flush_impl()
+  {
+    m_flush_deadline = clock::time_point::max();
+
+    stdx::error ret;
+    m_stream.flush([&](const auto& buffers) { ret = write(buffers); });
+    return ret;
+  }
+
+  void arm_flush(clock::time_point deadline)
+  {
+    if (deadline >= m_flush_deadline)
+      return;
+    m_flush_deadline = deadline;
+
+    m_flush_timer.expires_at(deadline);
+    m_flush_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (lifetime->alive && clock::now() >= m_flush_deadline)
+        flush_impl();
+    });
+  }
+
+  template <typename Buffers>
+  stdx::error write(const Buffers& buffers)
+  {
+    boost::system::error_code ec;
+    m_socket.send_to(buffers, m_remote, 0, ec);
+    if (ec)
+      return static_cast<std::errc>(ec.value());
+    return stdx::error{};
+  }
+
+  void send_reply()
+  {
+    if (m_reply.empty())
+      return;
+
+    const uint8_t sig[4]{'M', 'I', 'D', 'I'};
+    write(std::array<boost::asio::const_buffer, 2>{
+        boost::asio::buffer(sig), boost::asio::buffer(m_reply)});
+    m_reply.clear();
+  }
+
+  void invite()
+  {
+    if (++m_attempts > max_invitations)
+    {
+      m_state = state::rejected;
+      return;
+    }
+
+    m_reply.clear();
+    network_midi2::write_identity(
+        m_reply, network_midi2::command::invitation, m_name, configuration.client_name);
+    send_reply();
+
+    m_session_timer.expires_after(invitation_interval);
+    m_session_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (lifetime->alive && m_state == state::inviting)
+        invite();
+    });
+  }
+
+  void receive()
+  {
+    m_buffer.resize(65535);
+    m_socket.async_receive_from(
+        boost::asio::buffer(m_buffer), m_from,
+        [this, lifetime = m_lifetime](boost::system::error_code ec, std::size_t sz) {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      if (!ec && m_from == m_remote)
+      {
+        m_reply.clear();
+        network_midi2::read_datagram(
+            {m_buffer.data(), sz},
+            [this](const auto& header, auto payload) { on_command(header, payload); });
+        send_reply();
+      }
+
+      receive();
+    });
+  }
+
+  void on_command(const network_midi2::command_header& header, std::span<const uint8_t> payload)
+  {
+    using namespace network_midi2;
+    using enum network_midi2::command;
+    switch (header.command)
+    {
+      case invitation_accepted:
+        if (m_state == state::inviting)
+        {
+          m_state = state::connected;
+          m_session_timer.cancel();
+          m_stream.reset();
+        }
+        break;
+
+      case invitation_pending:
+        break;
+
+      // Authentication is not supported
+      case authentication_required:
+      case user_authentication_required:
+        if (m_state == state::inviting)
+        {
+          m_state = state::rejected;
+          m_session_timer.cancel();
+        }
+        break;
+
+      case bye:
+        if (m_state == state::inviting || m_state == state::connected)
+        {
+          m_state = state::rejected;
+          m_session_timer.cancel();
+        }
+        write_command(m_reply, bye_reply, 0);
+        break;
+
+      case retransmit_request: {
+        if (m_state != state::connected)
+          break;
+
+        byte_reader r{payload};
+        const uint16_t count = r.u16();
+        const bool done = m_stream.retransmit(
+            header.specific, count, [this](const auto& buffers) { write(buffers); });
+        if (!done)
+        {
+          std::vector<uint8_t> sequence;
+          byte_writer w{sequence};
+          w.u16(header.specific);
+          w.u16(0);
+          write_command(
+              m_reply, retransmit_error,
+              static_cast<uint16_t>(retransmit_error_reason::data_not_available) << 8, sequence);
+        }
+        break;
+      }
+
+      case ping:
+        write_command(m_reply, ping_reply, 0, payload);
+        break;
+
+      case session_reset:
+        m_stream.reset();
+        write_command(m_reply, session_reset_reply, 0);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
+  boost::asio::ip::udp::socket m_socket;
+  boost::asio::ip::udp::endpoint m_remote, m_from;
+  boost::asio::steady_timer m_session_timer;
+  boost::asio::steady_timer m_flush_timer;
+  std::thread m_thread;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+  state m_state{state::closed};
+  std::string m_name;
+  int m_attempts{};
+  clock::time_point m_flush_deadline{clock::time_point::max()};
+
+  network_midi2::ump_sender m_stream;
+  std::vector<uint8_t> m_buffer, m_reply;
+};
+}
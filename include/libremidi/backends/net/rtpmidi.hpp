@@ -0,0 +1,1185 @@
+#pragma once
+#include <libremidi/backends/net/helpers.hpp>
+
+#include <boost/asio/ip/udp.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+// RTP-MIDI (RFC 6295) with the AppleMIDI session protocol.
+// This file contains the wire format, independently of any socket:
+// the sessions themselves are in rtpmidi_in.hpp and rtpmidi_out.hpp.
+NAMESPACE_LIBREMIDI::rtpmidi
+{
+//! Rate of the RTP timestamps and of the AppleMIDI clock synchronization: 100 µs ticks
+static constexpr int64_t clock_rate = 10000;
+static constexpr int64_t ns_per_tick = 1'000'000'000 / clock_rate;
+
+//! Dynamic payload type sent; any of the dynamic range 96-127 is accepted (RFC 6295 §6.1)
+static constexpr uint8_t payload_type = 0x61;
+static constexpr uint32_t protocol_version = 2;
+
+// RTP header + command section header with the 12-bit length
+static constexpr std::size_t packet_overhead = 12 + 2;
+
+LIBREMIDI_STATIC int64_t now_ticks() noexcept
+{
+  namespace clk = std::chrono;
+  return clk::duration_cast<clk::nanoseconds>(clk::steady_clock::now().time_since_epoch()).count()
+         / ns_per_tick;
+}
+
+LIBREMIDI_STATIC uint32_t random_id()
+{
+  std::random_device rd;
+  return std::uniform_int_distribution<uint32_t>{}(rd);
+}
+
+//! AppleMIDI session commands
+enum class command : uint16_t
+{
+  invitation = 0x494E, // IN
+  accepted = 0x4F4B,   // OK
+  rejected = 0x4E4F,   // NO
+  end = 0x4259,        // BY
+  sync = 0x434B,       // CK
+  feedback = 0x5253,   // RS
+};
+
+LIBREMIDI_STATIC bool is_session_packet(std::span<const uint8_t> data) noexcept
+{
+  return data.size() >= 4 && data[0] == 0xFF && data[1] == 0xFF;
+}
+
+struct session_packet
+{
+  enum command command{};
+
+  // IN, OK, NO, BY
+  uint32_t token{};
+  uint32_t ssrc{};
+  std::string name{};
+
+  // CK: count is the step of the exchange, 0 to 2
+  uint8_t count{};
+  std::array<uint64_t, 3> timestamps{};
+
+  // RS: last sequence number received
+  uint16_t sequence{};
+
+  void write(std::vector<uint8_t>& out) const
+  {
+    out.clear();
+    byte_writer w{out};
+    w.u16(0xFFFF);
+    w.u16(static_cast<uint16_t>(command));
+    switch (command)
+    {
+      case command::sync:
+        w.u32(ssrc);
+        w.u8(count);
+        w.u8(0);
+        w.u16(0);
+        for (auto ts : timestamps)
+          w.u64(ts);
+        break;
+
+      case command::feedback:
+        w.u32(ssrc);
+        w.u16(sequence);
+        w.u16(0);
+        break;
+
+      default:
+        w.u32(protocol_version);
+        w.u32(token);
+        w.u32(ssrc);
+        if (command == command::invitation || command == command::accepted)
+        {
+          w.bytes({reinterpret_cast<const uint8_t*>(name.data()), name.size()});
+          w.u8(0);
+        }
+        break;
+    }
+  }
+
+  static std::optional<session_packet> read(std::span<const uint8_t> data)
+  {
+    byte_reader r{data};
+    if (r.u16() != 0xFFFF)
+      return std::nullopt;
+
+    session_packet p;
+    p.command = static_cast<enum command>(r.u16());
+    switch (p.command)
+    {
+      case command::sync:
+        p.ssrc = r.u32();
+        p.count = r.u8();
+        r.bytes(3);
+        for (auto& ts : p.timestamps)
+          ts = r.u64();
+        if (p.count > 2)
+          return std::nullopt;
+        break;
+
+      case command::feedback:
+        p.ssrc = r.u32();
+        p.sequence = r.u16();
+        break;
+
+      case command::invitation:
+      case command::accepted:
+      case command::rejected:
+      case command::end: {
+        if (r.u32() != protocol_version)
+          return std::nullopt;
+        p.token = r.u32();
+        p.ssrc = r.u32();
+
+        auto name = r.bytes(r.remaining());
+        std::size_t len = 0;
+        while (len < name.size() && name[len] != 0)
+          len++;
+        p.name.assign(reinterpret_cast<const char*>(name.data()), len);
+        break;
+      }
+
+      default:
+        return std::nullopt;
+    }
+
+    if (!r.ok)
+      return std::nullopt;
+    return p;
+  }
+};
+
+struct rtp_header
+{
+  uint16_t sequence{};
+  uint32_t timestamp{};
+  uint32_t ssrc{};
+};
+
+// Splits a RTP-MIDI packet into its header and payload
+LIBREMIDI_STATIC std::optional<std::pair<rtp_header, std::span<const uint8_t>>>
+read_rtp_packet(std::span<const uint8_t> data) noexcept
+{
+  byte_reader r{data};
+  const uint8_t flags = r.u8();
+  const uint8_t pt = r.u8();
+  rtp_header h;
+  h.sequence = r.u16();
+  h.timestamp = r.u32();
+  h.ssrc = r.u32();
+  if (!r.ok || (flags >> 6) != 2 || (pt & 0x7F) < 96)
+    return std::nullopt;
+
+  // CSRC list, header extension, padding
+  r.bytes(4 * (flags & 0x0F));
+  if (flags & 0x10)
+  {
+    r.u16();
+    r.bytes(4 * std::size_t(r.u16()));
+  }
+  std::size_t end = data.size();
+  if ((flags & 0x20) && end > 0)
+    end -= std::min<std::size_t>(data[end - 1], end);
+
+  if (!r.ok || r.pos > end)
+    return std::nullopt;
+  return std::make_pair(h, data.subspan(r.pos, end - r.pos));
+}
+
+// Number of data bytes following a status byte, except for SysEx
+LIBREMIDI_STATIC constexpr int data_bytes(uint8_t status) noexcept
+{
+  switch (status & 0xF0)
+  {
+    case 0x80:
+    case 0x90:
+    case 0xA0:
+    case 0xB0:
+    case 0xE0:
+      return 2;
+    case 0xC0:
+    case 0xD0:
+      return 1;
+    default:
+      break;
+  }
+
+  switch (status)
+  {
+    case 0xF1:
+    case 0xF3:
+      return 1;
+    case 0xF2:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+// Recovery journal of the sender (RFC 6295 §5 and appendix A).
+// Only the channel chapters P (program), C (controllers), W (pitch wheel) and
+// N (notes) are coded: they are the ones whose loss leaves the receiver in a wrong state.
+// The journal codes everything that changed since the checkpoint,
+// i.e. the last packet the receiver acknowledged through RS.
+// Without RS the history would grow forever: it is bounded to max_history packets,
+// and only its most recent part is written when it does not fit in the packet.
+class journal_writer
+{
+public:
+  static constexpr uint16_t max_history = 0x4000;
+
+  void update(std::span<const uint8_t> msg, uint16_t seq)
+  {
+    if (msg.size() < 2 || msg[0] < 0x80 || msg[0] >= 0xF0)
+      return;
+
+    if (!m_has_checkpoint)
+    {
+      m_checkpoint = seq - 1;
+      m_has_checkpoint = true;
+    }
+    else if (sequence_after(seq, uint16_t(m_checkpoint + max_history)))
+    {
+      acknowledge(uint16_t(seq - max_history));
+    }
+    m_newest = seq;
+
+    auto& c = m_channels[msg[0] & 0x0F];
+    const uint8_t d1 = msg[1] & 0x7F;
+    const uint8_t d2 = msg.size() > 2 ? msg[2] & 0x7F : 0;
+    switch (msg[0] & 0xF0)
+    {
+      case 0x80:
+        c.note_off(d1, seq);
+        break;
+
+      case 0x90:
+        if (d2 == 0)
+          c.note_off(d1, seq);
+        else
+          c.note_on(d1, d2, seq);
+        break;
+
+      case 0xB0:
+        c.controller[d1] = d2;
+        c.controller_seq[d1] = seq;
+        c.controller_dirty.set(d1);
+        if (d1 == 0)
+          c.bank_msb = d2;
+        else if (d1 == 32)
+          c.bank_lsb = d2;
+        else if (d1 == 120 || d1 == 123)
+          for (int n = 0; n < 128; n++)
+            if (c.velocity[n] > 0)
+              c.note_off(n, seq);
+        break;
+
+      case 0xC0:
+        c.program = d1;
+        c.program_bank_msb = c.bank_msb;
+        c.program_bank_lsb = c.bank_lsb;
+        c.program_seq = seq;
+        c.program_dirty = true;
+        break;
+
+      case 0xE0:
+        c.pitch_lsb = d1;
+        c.pitch_msb = d2;
+        c.pitch_seq = seq;
+        c.pitch_dirty = true;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  // The receiver got every packet up to seq: they no longer need to be coded
+  void acknowledge(uint16_t seq) noexcept
+  {
+    if (m_has_checkpoint && !sequence_after(seq, m_checkpoint))
+      return;
+
+    m_checkpoint = seq;
+    m_has_checkpoint = true;
+    for (auto& c : m_channels)
+    {
+      if (c.program_dirty && !sequence_after(c.program_seq, seq))
+        c.program_dirty = false;
+      if (c.pitch_dirty && !sequence_after(c.pitch_seq, seq))
+        c.pitch_dirty = false;
+      for (int i = 0; i < 128; i++)
+      {
+        if (c.controller_dirty[i] && !sequence_after(c.controller_seq[i], seq))
+          c.controller_dirty.reset(i);
+        if (c.note_dirty[i] && !sequence_after(c.note_seq[i], seq))
+          c.note_dirty.reset(i);
+      }
+    }
+  }
+
+  bool empty() const noexcept
+  {
+    for (auto& c : m_channels)
+      if (c.dirty())
+        return false;
+    return true;
+  }
+
+  // Appends the journal to the packet, in at most max_size bytes.
+  // Returns false if the oldest changes had to be left out to fit:
+  // RFC 6295 has no way to flag it, the receiver only recovers the most recent state.
+  bool write(std::vector<uint8_t>& out, std::size_t max_size) const
+  {
+    const std::size_t begin = out.size();
+    write_since(out, max_history);
+    if (out.size() - begin <= max_size)
+      return true;
+
+    // Longest history that fits: -1 is none of it
+    int fits = -1, too_long = max_history;
+    while (too_long - fits > 1)
+    {
+      const int age = (fits + too_long) / 2;
+      out.resize(begin);
+      write_since(out, age);
+      if (out.size() - begin <= max_size)
+        fits = age;
+      else
+        too_long = age;
+    }
+
+    out.resize(begin);
+    if (fits >= 0)
+      write_since(out, fits);
+    return false;
+  }
+
+private:
+  struct channel;
+
+  // Writes the changes of the last max_age + 1 packets
+  void write_since(std::vector<uint8_t>& out, int max_age) const
+  {
+    const auto coded = [this, max_age](uint16_t seq) {
+      return uint16_t(m_newest - seq) <= max_age;
+    };
+    const auto dirty = [&](const channel& c) {
+      if (c.program_dirty && coded(c.program_seq))
+        return true;
+      if (c.pitch_dirty && coded(c.pitch_seq))
+        return true;
+      for (int i = 0; i < 128; i++)
+        if ((c.controller_dirty[i] && coded(c.controller_seq[i]))
+            || (c.note_dirty[i] && coded(c.note_seq[i])))
+          return true;
+      return false;
+    };
+
+    int num_channels = 0;
+    for (auto& c : m_channels)
+      num_channels += dirty(c);
+    if (num_channels == 0)
+      return;
+
+    byte_writer w{out};
+
+    // S Y A H TOTCHAN | checkpoint
+    w.u8(0x20 | ((num_channels - 1) & 0x0F));
+    w.u16(m_checkpoint);
+
+    for (int chan = 0; chan < 16; chan++)
+    {
+      auto& c = m_channels[chan];
+      if (!dirty(c))
+        continue;
+
+      const std::size_t header = out.size();
+      w.u16(0);
+      w.u8(0);
+
+      std::bitset<128> controllers, notes;
+      for (int i = 0; i < 128; i++)
+      {
+        controllers[i] = c.controller_dirty[i] && coded(c.controller_seq[i]);
+        notes[i] = c.note_dirty[i] && coded(c.note_seq[i]);
+      }
+
+      uint8_t toc = 0;
+      if (c.program_dirty && coded(c.program_seq))
+      {
+        toc |= 0x80;
+        const bool bank = c.program_bank_msb >= 0 && c.program_bank_lsb >= 0;
+        w.u8(c.program);
+        w.u8((bank ? 0x80 : 0) | std::max(c.program_bank_msb, 0));
+        w.u8(std::max(c.program_bank_lsb, 0));
+      }
+
+      if (controllers.any())
+      {
+        toc |= 0x40;
+        w.u8(controllers.count() - 1);
+        for (int i = 0; i < 128; i++)
+        {
+          if (controllers[i])
+          {
+            w.u8(i);
+            w.u8(c.controller[i]);
+          }
+        }
+      }
+
+      if (c.pitch_dirty && coded(c.pitch_seq))
+      {
+        toc |= 0x10;
+        w.u8(c.pitch_lsb);
+        w.u8(c.pitch_msb);
+      }
+
+      if (notes.any())
+      {
+        toc |= 0x08;
+        write_notes(w, c, notes);
+      }
+
+      // S CHAN H LENGTH | TOC
+      const std::size_t length = out.size() - header;
+      out[header] = (chan << 3) | ((length >> 8) & 0x03);
+      out[header + 1] = length & 0xFF;
+      out[header + 2] = toc;
+    }
+  }
+
+  struct channel
+  {
+    void note_on(int note, uint8_t vel, uint16_t seq)
+    {
+      velocity[note] = vel;
+      note_seq[note] = seq;
+      note_dirty.set(note);
+    }
+
+    void note_off(int note, uint16_t seq) { note_on(note, 0, seq); }
+
+    bool dirty() const noexcept
+    {
+      return program_dirty || pitch_dirty || controller_dirty.any() || note_dirty.any();
+    }
+
+    // Chapter P
+    uint8_t program{};
+    int program_bank_msb{-1}, program_bank_lsb{-1};
+    uint16_t program_seq{};
+    bool program_dirty{};
+    int bank_msb{-1}, bank_lsb{-1};
+
+    // Chapter C
+    std::array<uint8_t, 128> controller{};
+    std::array<uint16_t, 128> controller_seq{};
+    std::bitset<128> controller_dirty;
+
+    // Chapter W
+    uint8_t pitch_lsb{}, pitch_msb{};
+    uint16_t pitch_seq{};
+    bool pitch_dirty{};
+
+    // Chapter N
+    std::array<uint8_t, 128> velocity{};
+    std::array<uint16_t, 128> note_seq{};
+    std::bitset<128> note_dirty;
+  };
+
+  static void write_notes(byte_writer& w, const channel& c, const std::bitset<128>& notes)
+  {
+    int logs = 0;
+    int low = 15, high = 0;
+    for (int i = 0; i < 128; i++)
+    {
+      if (!notes[i])
+        continue;
+      if (c.velocity[i] > 0)
+      {
+        logs++;
+      }
+      else
+      {
+        low = std::min(low, i / 8);
+        high = std::max(high, i / 8);
+      }
+    }
+
+    // Every note log is coded: LEN 127 with no OFFBITS reads as 128 logs,
+    // so 127 logs come with an empty OFFBITS octet
+    if (logs == 127 && low > high)
+      low = high = 0;
+
+    // B LEN | LOW HIGH
+    w.u8(std::min(logs, 127));
+    w.u8((low << 4) | high);
+
+    for (int i = 0; i < 128; i++)
+    {
+      if (notes[i] && c.velocity[i] > 0)
+      {
+        // S NOTENUM | Y VELOCITY
+        w.u8(i);
+        w.u8(0x80 | c.velocity[i]);
+      }
+    }
+
+    for (int byte = low; byte <= high; byte++)
+    {
+      uint8_t offbits = 0;
+      for (int bit = 0; bit < 8; bit++)
+      {
+        const int note = byte * 8 + bit;
+        if (notes[note] && c.velocity[note] == 0)
+          offbits |= 0x80 >> bit;
+      }
+      w.u8(offbits);
+    }
+  }
+
+  std::array<channel, 16> m_channels{};
+  uint16_t m_checkpoint{};
+  uint16_t m_newest{};
+  bool m_has_checkpoint{};
+};
+
+// Sending side of a RTP-MIDI stream.
+// Messages are appended to a command section with delta times and running status,
+// until the packet is full or flushed. SysEx larger than a packet are segmented.
+class stream_sender
+{
+public:
+  uint32_t ssrc{random_id()};
+  uint16_t sequence{static_cast<uint16_t>(random_id())};
+
+  //! Upper bound for the size of a packet.
+  //! The journal takes room from the command section, which keeps at least a few bytes.
+  std::size_t max_packet_size = 1472;
+
+  void acknowledge(uint16_t seq) noexcept
+  {
+    m_journal.acknowledge(seq);
+    m_journal_dirty = true;
+  }
+
+  bool empty() const noexcept { return m_commands.empty(); }
+
+  //! False when the last journal left out changes the receiver did not acknowledge
+  bool journal_complete() noexcept
+  {
+    journal();
+    return m_journal_complete;
+  }
+
+  //! timestamp is in ticks of the RTP clock.
+  //! Returns false, and sends nothing, for a message which does not start with a status byte
+  //! or is shorter than its status byte requires.
+  template <typename F>
+  bool write(std::span<const uint8_t> msg, uint32_t timestamp, F&& send_packet)
+  {
+    if (msg.empty() || !(msg[0] & 0x80)
+        || (msg[0] != 0xF0 && msg.size() < std::size_t(data_bytes(msg[0]) + 1)))
+      return false;
+
+    if (append(msg, timestamp))
+      return true;
+
+    flush(send_packet);
+    if (append(msg, timestamp))
+      return true;
+
+    // Only a SysEx can fail to fit in an empty packet
+    write_segmented(msg, timestamp, send_packet);
+    return true;
+  }
+
+  template <typename F>
+  void flush(F&& send_packet)
+  {
+    if (m_commands.empty())
+      return;
+
+    m_packet.clear();
+    byte_writer w{m_packet};
+
+    // V=2 | PT | sequence | timestamp | SSRC
+    w.u8(0x80);
+    w.u8(payload_type);
+    w.u16(sequence);
+    w.u32(m_timestamp);
+    w.u32(ssrc);
+
+    // B J Z P LEN: the first command never has a delta time, and always its status byte
+    const auto& journal_bytes = journal();
+    const bool journal = !journal_bytes.empty();
+    const std::size_t len = m_commands.size();
+    if (len <= 0x0F)
+    {
+      w.u8((journal ? 0x40 : 0) | len);
+    }
+    else
+    {
+      w.u8(0x80 | (journal ? 0x40 : 0) | (len >> 8));
+      w.u8(len & 0xFF);
+    }
+    w.bytes(m_commands);
+
+    // The journal codes the history up to the previous packet
+    w.bytes(journal_bytes);
+
+    for (auto& msg : m_voice)
+      m_journal.update({msg.data(), std::size_t(data_bytes(msg[0]) + 1)}, sequence);
+    m_journal_dirty |= !m_voice.empty();
+
+    send_packet(std::span<const uint8_t>{m_packet});
+
+    sequence++;
+    m_commands.clear();
+    m_voice.clear();
+    m_running_status = 0;
+  }
+
+private:
+  // The journal never takes these bytes from the command section
+  static constexpr std::size_t min_capacity = 16;
+
+  const std::vector<uint8_t>& journal()
+  {
+    if (m_journal_dirty)
+    {
+      m_journal_buffer.clear();
+      m_journal_complete = true;
+      if (!m_journal.empty())
+      {
+        const std::size_t room = packet_overhead + min_capacity;
+        m_journal_complete = m_journal.write(
+            m_journal_buffer, max_packet_size > room ? max_packet_size - room : 0);
+      }
+      m_journal_dirty = false;
+    }
+    return m_journal_buffer;
+  }
+
+  std::size_t command_capacity()
+  {
+    const std::size_t overhead = packet_overhead + journal().size();
+    const std::size_t capacity = max_packet_size > overhead ? max_packet_size - overhead : 0;
+    return std::clamp<std::size_t>(capacity, min_capacity, 0xFFF);
+  }
+
+  bool append(std::span<const uint8_t> msg, uint32_t timestamp)
+  {
+    const uint8_t status = msg[0];
+    const bool sysex = status == 0xF0;
+
+    // Out-of-order timestamps are sent with a null delta
+    uint8_t delta[4];
+    int delta_size = 0;
+    uint32_t d = 0;
+    if (!m_commands.empty())
+    {
+      d = std::min<int32_t>(
+          std::max<int32_t>(static_cast<int32_t>(timestamp - m_last_timestamp), 0), 0x0FFFFFFF);
+      delta_size = encode_delta(d, delta);
+    }
+
+    const bool running = status == m_running_status;
+    const std::size_t size
+        = delta_size + (sysex ? msg.size() : data_bytes(status) + (running ? 0 : 1));
+    if (m_commands.size() + size > command_capacity())
+      return false;
+
+    if (m_commands.empty())
+      m_timestamp = m_last_timestamp = timestamp;
+    else
+      m_last_timestamp += d;
+
+    m_commands.insert(m_commands.end(), delta, delta + delta_size);
+    if (sysex)
+    {
+      m_commands.insert(m_commands.end(), msg.begin(), msg.end());
+      if (m_commands.back() != 0xF7)
+        m_commands.push_back(0xF7);
+    }
+    else
+    {
+      const auto begin = msg.begin() + (running ? 1 : 0);
+      m_commands.insert(m_commands.end(), begin, msg.begin() + data_bytes(status) + 1);
+    }
+
+    // Channel messages set the running status, system common ones cancel it
+    if (status < 0xF0)
+    {
+      m_running_status = status;
+      m_voice.push_back({status, msg.size() > 1 ? msg[1] : uint8_t(0),
+                         msg.size() > 2 ? msg[2] : uint8_t(0)});
+    }
+    else if (status < 0xF8)
+    {
+      m_running_status = 0;
+    }
+    return true;
+  }
+
+  // F0 ... F0, then F7 ... F0, then F7 ... F7
+  template <typename F>
+  void write_segmented(std::span<const uint8_t> msg, uint32_t timestamp, F& send_packet)
+  {
+    auto data = msg.subspan(1);
+    if (!data.empty() && data.back() == 0xF7)
+      data = data.subspan(0, data.size() - 1);
+
+    const std::size_t capacity = command_capacity();
+    if (capacity < 3)
+      return;
+    const std::size_t segment = capacity - 2;
+
+    for (std::size_t offset = 0; offset < data.size(); offset += segment)
+    {
+      const std::size_t sz = std::min(segment, data.size() - offset);
+      const bool last = offset + sz == data.size();
+      m_commands.push_back(offset == 0 ? 0xF0 : 0xF7);
+      m_commands.insert(
+          m_commands.end(), data.begin() + offset, data.begin() + offset + sz);
+      m_commands.push_back(last ? 0xF7 : 0xF0);
+      m_timestamp = timestamp;
+      flush(send_packet);
+    }
+  }
+
+  static int encode_delta(uint32_t d, uint8_t* out) noexcept
+  {
+    int n = 1;
+    for (uint32_t v = d >> 7; v > 0; v >>= 7)
+      n++;
+    for (int i = 0; i < n; i++)
+      out[i] = ((d >> (7 * (n - 1 - i))) & 0x7F) | (i < n - 1 ? 0x80 : 0);
+    return n;
+  }
+
+  journal_writer m_journal;
+  std::vector<uint8_t> m_journal_buffer;
+  bool m_journal_dirty{};
+  bool m_journal_complete{true};
+  std::vector<uint8_t> m_packet;
+  std::vector<uint8_t> m_commands;
+  std::vector<std::array<uint8_t, 3>> m_voice;
+  uint32_t m_timestamp{};
+  uint32_t m_last_timestamp{};
+  uint8_t m_running_status{};
+};
+
+// Receiving side of a RTP-MIDI stream.
+// Decodes the command section, reassembles segmented SysEx, and after a packet loss,
+// restores the channel state from the recovery journal of the next packet.
+class stream_receiver
+{
+public:
+  //! Segmented SysEx larger than this are dropped
+  std::size_t max_sysex_size = 1024 * 1024;
+
+  uint16_t last_sequence() const noexcept { return m_sequence; }
+
+  // on_message(std::span<const uint8_t>, uint32_t timestamp) is called for each message,
+  // including the ones recovered from the journal.
+  // Returns false for a malformed, late or duplicate packet.
+  template <typename F>
+  bool read(const rtp_header& header, std::span<const uint8_t> payload, F&& on_message)
+  {
+    bool lost = false;
+    if (m_has_sequence)
+    {
+      if (!sequence_after(header.sequence, m_sequence))
+        return false;
+      lost = header.sequence != uint16_t(m_sequence + 1);
+    }
+    m_sequence = header.sequence;
+    m_has_sequence = true;
+
+    byte_reader r{payload};
+    const uint8_t flags = r.u8();
+    std::size_t len = flags & 0x0F;
+    if (flags & 0x80)
+      len = (len << 8) | r.u8();
+    const bool journal = flags & 0x40;
+    const bool z = flags & 0x20;
+
+    auto commands = r.bytes(len);
+    if (!r.ok)
+      return false;
+
+    if (lost)
+    {
+      // A missing segment makes the pending SysEx unusable
+      m_sysex.clear();
+      m_in_sysex = false;
+      m_lost_packets++;
+
+      if (journal)
+        recover(r.data.subspan(r.pos), header.timestamp, on_message);
+    }
+
+    return read_commands(commands, z, header.timestamp, on_message);
+  }
+
+  //! Number of times a gap in the sequence numbers was detected
+  int64_t lost_packets() const noexcept { return m_lost_packets; }
+
+private:
+  template <typename F>
+  bool read_commands(std::span<const uint8_t> commands, bool z, uint32_t ts, F& on_message)
+  {
+    byte_reader r{commands};
+    uint8_t running = 0;
+    bool first = true;
+    while (r.remaining() > 0)
+    {
+      if (!first || z)
+      {
+        uint32_t delta = 0;
+        for (int i = 0; i < 4; i++)
+        {
+          const uint8_t b = r.u8();
+          delta = (delta << 7) | (b & 0x7F);
+          if (!(b & 0x80))
+            break;
+        }
+        ts += delta;
+      }
+      first = false;
+
+      uint8_t status = r.peek();
+      if (!r.ok || r.remaining() == 0)
+        return false;
+
+      if (status & 0x80)
+        r.pos++;
+      else if (running)
+        status = running;
+      else
+        return false;
+
+      if (status == 0xF0 || status == 0xF7)
+      {
+        if (!read_sysex(r, status, ts, on_message))
+          return false;
+        running = 0;
+        continue;
+      }
+
+      uint8_t msg[3]{status};
+      const int n = data_bytes(status);
+      for (int i = 0; i < n; i++)
+        if ((msg[i + 1] = r.u8()) & 0x80)
+          return false;
+      if (!r.ok)
+        return false;
+
+      if (status < 0xF0)
+        running = status;
+      else if (status < 0xF8)
+        running = 0;
+
+      deliver({msg, std::size_t(n + 1)}, ts, on_message);
+    }
+    return r.ok;
+  }
+
+  template <typename F>
+  bool read_sysex(byte_reader& r, uint8_t start, uint32_t ts, F& on_message)
+  {
+    const std::size_t begin = r.pos;
+    while (r.remaining() > 0)
+    {
+      const uint8_t b = r.data[r.pos];
+      if (b < 0x80)
+      {
+        r.pos++;
+        continue;
+      }
+
+      if (b >= 0xF8)
+      {
+        // Real-time messages can be interleaved with the SysEx data
+        r.pos++;
+        deliver({&b, 1}, ts, on_message);
+        continue;
+      }
+
+      if (b != 0xF0 && b != 0xF7 && b != 0xF4)
+        return false;
+
+      r.pos++;
+      if (start == 0xF0)
+      {
+        m_sysex.assign(1, 0xF0);
+        m_in_sysex = true;
+      }
+      else if (!m_in_sysex)
+      {
+        // Continuation of a SysEx whose start was lost or dropped
+        return true;
+      }
+
+      for (std::size_t i = begin; i < r.pos - 1; i++)
+        if (r.data[i] < 0x80)
+          m_sysex.push_back(r.data[i]);
+
+      if (b == 0xF4 || m_sysex.size() > max_sysex_size)
+      {
+        // Cancelled, or too large
+        m_sysex.clear();
+        m_in_sysex = false;
+        return true;
+      }
+
+      if (b == 0xF7)
+      {
+        m_sysex.push_back(0xF7);
+        on_message(std::span<const uint8_t>{m_sysex}, ts);
+        m_sysex.clear();
+        m_in_sysex = false;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  template <typename F>
+  void deliver(std::span<const uint8_t> msg, uint32_t ts, F& on_message)
+  {
+    track(msg);
+    on_message(msg, ts);
+  }
+
+  template <typename F>
+  void emit(uint8_t status, uint8_t d1, uint8_t d2, uint32_t ts, F& on_message)
+  {
+    const uint8_t msg[3]{status, d1, d2};
+    deliver({msg, std::size_t(data_bytes(status) + 1)}, ts, on_message);
+  }
+
+  // Channel state as seen by the receiver, compared against the journal
+  void track(std::span<const uint8_t> msg)
+  {
+    if (msg.size() < 2 || msg[0] >= 0xF0)
+      return;
+
+    auto& c = m_channels[msg[0] & 0x0F];
+    const uint8_t d2 = msg.size() > 2 ? msg[2] : 0;
+    switch (msg[0] & 0xF0)
+    {
+      case 0x80:
+        c.notes.reset(msg[1]);
+        break;
+      case 0x90:
+        c.notes.set(msg[1], d2 > 0);
+        break;
+      case 0xB0:
+        c.controller[msg[1]] = d2;
+        if (msg[1] == 120 || msg[1] == 123)
+          c.notes.reset();
+        break;
+      case 0xC0:
+        c.program = msg[1];
+        break;
+      case 0xE0:
+        c.pitch = (d2 << 7) | msg[1];
+        break;
+      default:
+        break;
+    }
+  }
+
+  template <typename F>
+  void recover(std::span<const uint8_t> journal, uint32_t ts, F& on_message)
+  {
+    byte_reader r{journal};
+    const uint8_t flags = r.u8();
+    r.u16(); // checkpoint
+    if (!r.ok)
+      return;
+
+    // System journal: not coded by this implementation, skipped
+    if (flags & 0x40)
+    {
+      const uint16_t h = r.u16();
+      r.bytes(std::max<int>((h & 0x03FF) - 2, 0));
+    }
+
+    if (!(flags & 0x20))
+      return;
+
+    const int num_channels = (flags & 0x0F) + 1;
+    for (int i = 0; i < num_channels && r.ok; i++)
+    {
+      const uint8_t b0 = r.u8();
+      const uint8_t b1 = r.u8();
+      const std::size_t length = ((b0 & 0x03) << 8) | b1;
+      if (length < 3)
+        return;
+
+      byte_reader chapters{r.bytes(length - 2)};
+      recover_channel(chapters, (b0 >> 3) & 0x0F, ts, on_message);
+    }
+  }
+
+  template <typename F>
+  void recover_channel(byte_reader& r, int chan, uint32_t ts, F& on_message)
+  {
+    auto& c = m_channels[chan];
+    const uint8_t toc = r.u8();
+
+    // Chapter P
+    if (toc & 0x80)
+    {
+      const uint8_t program = r.u8() & 0x7F;
+      const uint8_t msb = r.u8();
+      const uint8_t lsb = r.u8() & 0x7F;
+      if (r.ok && c.program != program)
+      {
+        if (msb & 0x80)
+        {
+          emit(0xB0 | chan, 0, msb & 0x7F, ts, on_message);
+          emit(0xB0 | chan, 32, lsb, ts, on_message);
+        }
+        emit(0xC0 | chan, program, 0, ts, on_message);
+      }
+    }
+
+    // Chapter C
+    if (toc & 0x40)
+    {
+      const int count = (r.u8() & 0x7F) + 1;
+      for (int i = 0; i < count && r.ok; i++)
+      {
+        const uint8_t number = r.u8() & 0x7F;
+        const uint8_t value = r.u8();
+        // A=1 is the alternate encoding for toggle or count controllers, not used here
+        if (r.ok && !(value & 0x80) && c.controller[number] != value)
+          emit(0xB0 | chan, number, value, ts, on_message);
+      }
+    }
+
+    // Chapter M: skipped
+    if (toc & 0x20)
+    {
+      const uint16_t h = r.u16();
+      r.bytes(std::max<int>((h & 0x03FF) - 2, 0));
+    }
+
+    // Chapter W
+    if (toc & 0x10)
+    {
+      const uint8_t lsb = r.u8() & 0x7F;
+      const uint8_t msb = r.u8() & 0x7F;
+      if (r.ok && c.pitch != ((msb << 7) | lsb))
+        emit(0xE0 | chan, lsb, msb, ts, on_message);
+    }
+
+    // Chapter N
+    if (toc & 0x08)
+    {
+      const uint8_t h0 = r.u8();
+      const uint8_t h1 = r.u8();
+      const int low = h1 >> 4;
+      const int high = h1 & 0x0F;
+      int logs = h0 & 0x7F;
+      if (logs == 127 && low == 15 && high == 0)
+        logs = 128;
+
+      for (int i = 0; i < logs && r.ok; i++)
+      {
+        const uint8_t note = r.u8() & 0x7F;
+        const uint8_t vel = r.u8();
+        // Y: the note-on is recent enough to be worth playing
+        if (r.ok && (vel & 0x80) && (vel & 0x7F) > 0 && !c.notes[note])
+          emit(0x90 | chan, note, vel & 0x7F, ts, on_message);
+      }
+
+      for (int byte = low; byte <= high && r.ok; byte++)
+      {
+        const uint8_t offbits = r.u8();
+        for (int bit = 0; bit < 8; bit++)
+        {
+          const int note = byte * 8 + bit;
+          if (r.ok && (offbits & (0x80 >> bit)) && c.notes[note])
+            emit(0x80 | chan, note, 0, ts, on_message);
+        }
+      }
+    }
+  }
+
+  struct channel
+  {
+    int program{-1};
+    int pitch{-1};
+    std::array<int16_t, 128> controller = [] {
+      std::array<int16_t, 128> a;
+      a.fill(-1);
+      return a;
+    }();
+    std::bitset<128> notes;
+  };
+
+  std::array<channel, 16> m_channels{};
+  std::vector<uint8_t> m_sysex;
+  bool m_in_sysex{};
+  uint16_t m_sequence{};
+  bool m_has_sequence{};
+  int64_t m_lost_packets{};
+};
+
+// Binds the control and data sockets on two consecutive ports,
+// as the AppleMIDI session protocol expects.
+// With port 0, a free pair of ports is looked for.
+LIBREMIDI_STATIC boost::system::error_code bind_port_pair(
+    boost::asio::ip::udp::socket& control, boost::asio::ip::udp::socket& data,
+    const boost::asio::ip::address& address, int port)
+{
+  using boost::asio::ip::udp;
+  boost::system::error_code ec;
+  for (int attempt = 0; attempt < 32; attempt++)
+  {
+    control.open(udp::v4(), ec);
+    data.open(udp::v4(), ec);
+    if (ec)
+      return ec;
+
+    control.bind({address, static_cast<unsigned short>(port)}, ec);
+    if (!ec)
+    {
+      const int control_port = control.local_endpoint().port();
+      if (control_port < 65535)
+      {
+        data.bind({address, static_cast<unsigned short>(control_port + 1)}, ec);
+        if (!ec)
+          return ec;
+      }
+    }
+
+    control.close();
+    data.close();
+    if (port != 0)
+      return ec ? ec : boost::asio::error::address_in_use;
+  }
+  return boost::asio::error::address_in_use;
+}
+}
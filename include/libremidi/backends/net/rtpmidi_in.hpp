@@ -0,0 +1,349 @@
+#pragma once
+#include <libremidi/backends/net/config.hpp>
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/backends/net/midi_in.hpp>
+#include <libremidi/backends/net/rtpmidi.hpp>
+#include <libremidi/detail/midi_in.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::net
+{
+// Responder side of RTP-MIDI sessions: accepts the invitations of remote participants,
+// answers their clock synchronization and receives their MIDI streams.
+class rtpmidi_in final
+    : public midi1::in_api
+    , public error_handler
+{
+public:
+  using midi_api::client_open_;
+  struct
+      : input_configuration
+      , dgram_input_configuration
+  {
+  } configuration;
+
+  explicit rtpmidi_in(input_configuration&& conf, dgram_input_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_ctx{configuration.io_context}
+      , m_control{m_ctx.get()}
+      , m_data{m_ctx.get()}
+  {
+    boost::system::error_code ec;
+    const auto address = boost::asio::ip::make_address(configuration.accept, ec);
+    if (ec || configuration.port < 0 || configuration.port >= 65535)
+    {
+      client_open_ = std::errc::invalid_argument;
+      return;
+    }
+
+    if (rtpmidi::bind_port_pair(m_control, m_data, address, configuration.port))
+    {
+      client_open_ = std::errc::address_in_use;
+      return;
+    }
+
+    if (auto failed = tune_input_socket(m_data, configuration); !failed.empty())
+      libremidi_handle_warning(configuration, failed);
+
+    client_open_ = stdx::error{};
+  }
+
+  ~rtpmidi_in() override
+  {
+    close_port();
+    m_lifetime->end();
+  }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
+
+  stdx::error open_port(const input_port&, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  // The port name is the name of our session, as shown by the remote participants
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_open)
+        return std::errc::device_or_resource_busy;
+      m_open = true;
+      m_name = name;
+
+      receive(m_control, m_control_buffer, m_control_from, false);
+      receive(m_data, m_data_buffer, m_data_from, true);
+    }
+
+    if (m_ctx.is_owned() && !m_thread.joinable())
+    {
+      m_thread = std::thread{[&ctx = m_ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    {
+      std::lock_guard lock{m_mutex};
+      for (auto& p : m_participants)
+        send_session(m_control, p.control, rtpmidi::command::end, p.token);
+      m_participants.clear();
+      m_open = false;
+
+      boost::system::error_code ec;
+      m_control.cancel(ec);
+      m_data.cancel(ec);
+    }
+
+    if (m_ctx.is_owned() && m_thread.joinable())
+    {
+      m_ctx.get().stop();
+      m_thread.join();
+      m_ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  timestamp absolute_timestamp() const noexcept override
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+private:
+  struct participant
+  {
+    uint32_t ssrc{};
+    uint32_t token{};
+    boost::asio::ip::udp::endpoint control{};
+
+    rtpmidi::stream_receiver stream{};
+
+    //! Local clock minus remote clock, in RTP ticks, once a CK exchange completed
+    std::optional<int64_t> clock_offset{};
+    int unacknowledged{};
+  };
+
+  // Arbitrary limit to avoid abuse
+  static constexpr std::size_t max_participants = 16;
+
+  // Packets received before sending a RS to the sender, so that it trims its journal
+  static constexpr int feedback_interval = 8;
+
+  participant* find(uint32_t ssrc) noexcept
+  {
+    for (auto& p : m_participants)
+      if (p.ssrc == ssrc)
+        return &p;
+    return nullptr;
+  }
+
+  void write(
+      boost::asio::ip::udp::socket& socket, const boost::asio::ip::udp::endpoint& to,
+      std::span<const uint8_t> bytes)
+  {
+    boost::system::error_code ec;
+    socket.send_to(boost::asio::buffer(bytes.data(), bytes.size()), to, 0, ec);
+  }
+
+  void send_session(
+      boost::asio::ip::udp::socket& socket, const boost::asio::ip::udp::endpoint& to,
+      rtpmidi::command cmd, uint32_t token)
+  {
+    rtpmidi::session_packet p{.command = cmd, .token = token, .ssrc = m_ssrc, .name = m_name};
+    p.write(m_session_buffer);
+    write(socket, to, m_session_buffer);
+  }
+
+  void send_feedback(participant& p)
+  {
+    rtpmidi::session_packet rs{
+        .command = rtpmidi::command::feedback,
+        .ssrc = m_ssrc,
+        .sequence = p.stream.last_sequence()};
+    rs.write(m_session_buffer);
+    write(m_control, p.control, m_session_buffer);
+    p.unacknowledged = 0;
+  }
+
+  void receive(
+      boost::asio::ip::udp::socket& socket, std::vector<uint8_t>& buffer,
+      boost::asio::ip::udp::endpoint& from, bool data)
+  {
+    buffer.resize(65535);
+    socket.async_receive_from(
+        boost::asio::buffer(buffer), from,
+        [this, lifetime = m_lifetime, &socket, &buffer, &from,
+         data](boost::system::error_code ec, std::size_t sz) {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      if (!ec)
+      {
+        const std::span<const uint8_t> bytes{buffer.data(), sz};
+        if (rtpmidi::is_session_packet(bytes))
+        {
+          if (auto p = rtpmidi::session_packet::read(bytes))
+            on_session(*p, from, data);
+        }
+        else if (data)
+        {
+          on_rtp(bytes);
+        }
+      }
+
+      receive(socket, buffer, from, data);
+    });
+  }
+
+  void on_session(
+      const rtpmidi::session_packet& p, const boost::asio::ip::udp::endpoint& from, bool data)
+  {
+    auto& socket = data ? m_data : m_control;
+    using enum rtpmidi::command;
+    switch (p.command)
+    {
+      case invitation: {
+        auto part = find(p.ssrc);
+        if (!data && !part && m_participants.size() < max_participants)
+          part = &m_participants.emplace_back(participant{.ssrc = p.ssrc});
+
+        if (!part)
+        {
+          send_session(socket, from, rejected, p.token);
+          return;
+        }
+
+        if (!data)
+          part->control = from;
+        part->token = p.token;
+        part->stream.max_sysex_size = std::max(configuration.max_message_size, 0);
+        send_session(socket, from, accepted, p.token);
+        break;
+      }
+
+      case end: {
+        // Only the host which opened the session can end it
+        auto part = find(p.ssrc);
+        if (!part || part->token != p.token || part->control.address() != from.address())
+          return;
+
+        m_participants.erase(m_participants.begin() + (part - m_participants.data()));
+        break;
+      }
+
+      case sync: {
+        auto part = find(p.ssrc);
+        if (!data || !part)
+          return;
+
+        if (p.count == 0)
+        {
+          rtpmidi::session_packet ck{
+              .command = sync,
+              .ssrc = m_ssrc,
+              .count = 1,
+              .timestamps = {p.timestamps[0], uint64_t(rtpmidi::now_ticks()), 0}};
+          ck.write(m_session_buffer);
+          write(m_data, from, m_session_buffer);
+        }
+        else if (p.count == 2)
+        {
+          // Our timestamp was taken halfway through the round trip
+          const auto& ts = p.timestamps;
+          part->clock_offset = int64_t(ts[1]) - int64_t(ts[0] + ts[2]) / 2;
+          send_feedback(*part);
+        }
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  void on_rtp(std::span<const uint8_t> bytes)
+  {
+    auto packet = rtpmidi::read_rtp_packet(bytes);
+    if (!packet)
+      return;
+
+    auto& [header, payload] = *packet;
+    auto part = find(header.ssrc);
+    if (!part)
+      return;
+
+    part->stream.read(header, payload, [this, part](std::span<const uint8_t> msg, uint32_t ts) {
+      on_message(*part, msg, ts);
+    });
+
+    if (++part->unacknowledged >= feedback_interval)
+      send_feedback(*part);
+  }
+
+  void on_message(const participant& p, std::span<const uint8_t> msg, uint32_t rtp_ts)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = true,
+        .absolute_is_monotonic = true,
+        .has_samples = false,
+    };
+
+    // The RTP timestamp is in the sender's clock, on 32 bits:
+    // it is unwrapped around the current time, then moved to our clock.
+    const auto to_ns = [&p, rtp_ts] {
+      const int64_t now = rtpmidi::now_ticks();
+      if (!p.clock_offset)
+        return now * rtpmidi::ns_per_tick;
+
+      const int64_t expected = now - *p.clock_offset;
+      int64_t remote = (expected & ~int64_t(0xFFFFFFFF)) | rtp_ts;
+      if (remote - expected > 0x80000000LL)
+        remote -= 0x100000000LL;
+      else if (expected - remote > 0x80000000LL)
+        remote += 0x100000000LL;
+      return (remote + *p.clock_offset) * rtpmidi::ns_per_tick;
+    };
+
+    m_processing.on_bytes(msg, m_processing.timestamp<timestamp_info>(to_ns, 0));
+  }
+
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+
+  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
+  boost::asio::ip::udp::socket m_control;
+  boost::asio::ip::udp::socket m_data;
+  boost::asio::ip::udp::endpoint m_control_from, m_data_from;
+  std::thread m_thread;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+  bool m_open{};
+  std::string m_name;
+  uint32_t m_ssrc{rtpmidi::random_id()};
+  std::vector<participant> m_participants;
+  std::vector<uint8_t> m_control_buffer, m_data_buffer, m_session_buffer;
+};
+}
@@ -0,0 +1,431 @@
+#pragma once
+#include <libremidi/backends/net/config.hpp>
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/backends/net/midi_out.hpp>
+#include <libremidi/backends/net/rtpmidi.hpp>
+#include <libremidi/detail/midi_out.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::net
+{
+// Initiator side of a RTP-MIDI session: invites the remote host, keeps the clocks
+// synchronized and sends the MIDI stream along with its recovery journal.
+class rtpmidi_out final
+    : public midi1::out_api
+    , public error_handler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct
+      : output_configuration
+      , dgram_output_configuration
+  {
+  } configuration;
+
+  rtpmidi_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_ctx{configuration.io_context}
+      , m_control{m_ctx.get()}
+      , m_data{m_ctx.get()}
+      , m_session_timer{m_ctx.get()}
+      , m_flush_timer{m_ctx.get()}
+  {
+    boost::system::error_code ec;
+    const auto host = boost::asio::ip::make_address(configuration.host, ec);
+    if (ec || configuration.port <= 0 || configuration.port >= 65535)
+    {
+      client_open_ = std::errc::invalid_argument;
+      return;
+    }
+    m_remote_control = {host, static_cast<unsigned short>(configuration.port)};
+    m_remote_data = {host, static_cast<unsigned short>(configuration.port + 1)};
+
+    if (rtpmidi::bind_port_pair(m_control, m_data, boost::asio::ip::address_v4::any(), 0))
+    {
+      client_open_ = std::errc::address_in_use;
+      return;
+    }
+
+    m_stream.max_packet_size = std::max(configuration.max_datagram_size, 0);
+    client_open_ = stdx::error{};
+  }
+
+  ~rtpmidi_out() override
+  {
+    close_port();
+    m_lifetime->end();
+  }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
+
+  stdx::error open_port(const output_port& /* port */, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  // The port name is the name of our session, as shown by the remote participant
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_state != state::closed)
+        return std::errc::device_or_resource_busy;
+
+      m_name = name;
+      m_token = rtpmidi::random_id();
+      m_state = state::inviting_control;
+      m_attempts = 0;
+
+      receive(m_control, m_control_buffer, false);
+      receive(m_data, m_data_buffer, true);
+      invite();
+    }
+
+    if (m_ctx.is_owned() && !m_thread.joinable())
+    {
+      m_thread = std::thread{[&ctx = m_ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_state == state::connected)
+      {
+        m_stream.flush([this](auto packet) { write(m_data, m_remote_data, packet); });
+        send_session(m_control, m_remote_control, rtpmidi::command::end);
+      }
+      m_state = state::closed;
+
+      boost::system::error_code ec;
+      m_session_timer.cancel();
+      m_flush_timer.cancel();
+      m_control.cancel(ec);
+      m_data.cancel(ec);
+    }
+
+    if (m_ctx.is_owned() && m_thread.joinable())
+    {
+      m_ctx.get().stop();
+      m_thread.join();
+      m_ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  // Sending fails with not_connected until the remote participant accepts the invitation
+  stdx::error send_message(const unsigned char* message, size_t size) override
+  {
+    return write_message(rtpmidi::now_ticks(), message, size);
+  }
+
+  // The time is carried by the RTP timestamp, the receiver dates the message accordingly:
+  // the packet itself is sent right away, or coalesced as for send_message.
+  stdx::error schedule_message(int64_t ts, const unsigned char* message, size_t size) override
+  {
+    int64_t ns = current_time();
+    switch (configuration.timestamps)
+    {
+      case timestamp_mode::Relative:
+        ns += ts;
+        break;
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        ns = ts;
+        break;
+      default:
+        break;
+    }
+
+    return write_message(ns / rtpmidi::ns_per_tick, message, size);
+  }
+
+  stdx::error flush() override
+  {
+    std::lock_guard lock{m_mutex};
+    return flush_impl();
+  }
+
+  int64_t current_time() const noexcept override
+  {
+    namespace clk = std::chrono;
+    return clk::duration_cast<clk::nanoseconds>(clock::now().time_since_epoch()).count();
+  }
+
+private:
+  enum class state
+  {
+    closed,
+    inviting_control,
+    inviting_data,
+    connected,
+    rejected,
+  };
+
+  // Invitations are repeated every second, as AppleMIDI does
+  static constexpr int max_invitations = 12;
+  static constexpr auto invitation_interval = std::chrono::seconds(1);
+
+  stdx::error write_message(int64_t ticks, const unsigned char* message, size_t size)
+  {
+    if (size == 0)
+      return std::errc::message_size;
+
+    std::lock_guard lock{m_mutex};
+    if (m_state != state::connected)
+      return std::errc::not_connected;
+
+    stdx::error ret;
+    const bool valid
+        = m_stream.write({message, size}, static_cast<uint32_t>(ticks), [&](auto packet) {
+      if (auto err = write(m_data, m_remote_data, packet); err != stdx::error{})
+        ret = err;
+    });
+    if (!valid)
+      return std::errc::bad_message;
+
+    if (configuration.flush_interval.count() <= 0)
+    {
+      if (auto err = flush_impl(); err != stdx::error{})
+        ret = err;
+    }
+    else
+    {
+      arm_flush(clock::now() + configuration.flush_interval);
+    }
+    return ret;
+  }
+
+  // Must be called with m_mutex held, as all the functions below
+  stdx::error flush_impl()
+  {
+    m_flush_deadline = clock::time_point::max();
+
+    stdx::error ret;
+    m_stream.flush([&](auto packet) { ret = write(m_data, m_remote_data, packet); });
+    return ret;
+  }
+
+  void arm_flush(clock::time_point deadline)
+  {
+    if (deadline >= m_flush_deadline)
+      return;
+    m_flush_deadline = deadline;
+
+    m_flush_timer.expires_at(deadline);
+    m_flush_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (lifetime->alive && clock::now() >= m_flush_deadline)
+        flush_impl();
+    });
+  }
+
+  stdx::error write(
+      boost::asio::ip::udp::socket& socket, const boost::asio::ip::udp::endpoint& to,
+      std::span<const uint8_t> bytes)
+  {
+    boost::system::error_code ec;
+    socket.send_to(boost::asio::buffer(bytes.data(), bytes.size()), to, 0, ec);
+    if (ec)
+      return static_cast<std::errc>(ec.value());
+    return stdx::error{};
+  }
+
+  void send_session(
+      boost::asio::ip::udp::socket& socket, const boost::asio::ip::udp::endpoint& to,
+      rtpmidi::command cmd)
+  {
+    rtpmidi::session_packet p{
+        .command = cmd, .token = m_token, .ssrc = m_stream.ssrc, .name = m_name};
+    p.write(m_session_buffer);
+    write(socket, to, m_session_buffer);
+  }
+
+  void send_sync(uint8_t count, std::array<uint64_t, 3> timestamps)
+  {
+    rtpmidi::session_packet p{
+        .command = rtpmidi::command::sync,
+        .ssrc = m_stream.ssrc,
+        .count = count,
+        .timestamps = timestamps};
+    p.write(m_session_buffer);
+    write(m_data, m_remote_data, m_session_buffer);
+  }
+
+  void invite()
+  {
+    if (++m_attempts > max_invitations)
+    {
+      m_state = state::rejected;
+      return;
+    }
+
+    if (m_state == state::inviting_control)
+      send_session(m_control, m_remote_control, rtpmidi::command::invitation);
+    else
+      send_session(m_data, m_remote_data, rtpmidi::command::invitation);
+
+    arm_session(invitation_interval);
+  }
+
+  void synchronize()
+  {
+    send_sync(0, {uint64_t(rtpmidi::now_ticks()), 0, 0});
+    arm_session(configuration.clock_sync_interval);
+  }
+
+  void arm_session(clock::duration delay)
+  {
+    m_session_timer.expires_after(delay);
+    m_session_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      switch (m_state)
+      {
+        case state::inviting_control:
+        case state::inviting_data:
+          invite();
+          break;
+        case state::connected:
+          synchronize();
+          break;
+        default:
+          break;
+      }
+    });
+  }
+
+  void receive(boost::asio::ip::udp::socket& socket, std::vector<uint8_t>& buffer, bool data)
+  {
+    buffer.resize(65535);
+    socket.async_receive_from(
+        boost::asio::buffer(buffer), data ? m_data_from : m_control_from,
+        [this, lifetime = m_lifetime, &socket, &buffer,
+         data](boost::system::error_code ec, std::size_t sz) {
+      if (ec == boost::asio::error::operation_aborted)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive)
+        return;
+
+      if (!ec)
+      {
+        if (auto p = rtpmidi::session_packet::read({buffer.data(), sz}))
+          on_session(*p, data);
+      }
+
+      receive(socket, buffer, data);
+    });
+  }
+
+  void on_session(const rtpmidi::session_packet& p, bool data)
+  {
+    using enum rtpmidi::command;
+    switch (p.command)
+    {
+      case accepted:
+        if (p.token != m_token)
+          return;
+
+        if (!data && m_state == state::inviting_control)
+        {
+          m_remote_ssrc = p.ssrc;
+          m_state = state::inviting_data;
+          m_attempts = 0;
+          invite();
+        }
+        else if (data && m_state == state::inviting_data)
+        {
+          m_state = state::connected;
+          synchronize();
+        }
+        break;
+
+      case rejected:
+        if (p.token == m_token && m_state != state::connected)
+        {
+          m_state = state::rejected;
+          m_session_timer.cancel();
+        }
+        break;
+
+      case end:
+        if (p.ssrc == m_remote_ssrc && m_state == state::connected)
+        {
+          m_state = state::rejected;
+          m_session_timer.cancel();
+        }
+        break;
+
+      case sync:
+        if (!data || p.ssrc != m_remote_ssrc)
+          return;
+
+        // We normally initiate the exchange, but answer the remote if it does
+        if (p.count == 0)
+          send_sync(1, {p.timestamps[0], uint64_t(rtpmidi::now_ticks()), 0});
+        else if (p.count == 1)
+          send_sync(2, {p.timestamps[0], p.timestamps[1], uint64_t(rtpmidi::now_ticks())});
+        break;
+
+      case feedback:
+        if (p.ssrc == m_remote_ssrc)
+          m_stream.acknowledge(p.sequence);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
+  boost::asio::ip::udp::socket m_control;
+  boost::asio::ip::udp::socket m_data;
+  boost::asio::ip::udp::endpoint m_remote_control, m_remote_data;
+  boost::asio::ip::udp::endpoint m_control_from, m_data_from;
+  boost::asio::steady_timer m_session_timer;
+  boost::asio::steady_timer m_flush_timer;
+  std::thread m_thread;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+  state m_state{state::closed};
+  std::string m_name;
+  uint32_t m_token{};
+  uint32_t m_remote_ssrc{};
+  int m_attempts{};
+  clock::time_point m_flush_deadline{clock::time_point::max()};
+
+  rtpmidi::stream_sender m_stream;
+  std::vector<uint8_t> m_control_buffer, m_data_buffer, m_session_buffer;
+};
+}
@@ -0,0 +1,542 @@
+#pragma once
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/error.hpp>
+#include <libremidi/input_configuration.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Stream transport, over TCP or Unix domain sockets.
+// Each message travels in a frame: its size in bytes, as a 32-bit big-endian integer,
+// then its bytes; MIDI 1 messages as they are, UMP as big-endian 32-bit words.
+NAMESPACE_LIBREMIDI
+{
+static constexpr std::size_t stream_frame_header_size = 4;
+
+LIBREMIDI_STATIC std::array<uint8_t, 4> stream_frame_header(std::size_t size) noexcept
+{
+  return {
+      uint8_t(size >> 24), uint8_t((size >> 16) & 0xFF), uint8_t((size >> 8) & 0xFF),
+      uint8_t(size & 0xFF)};
+}
+
+//! Appends the frame of an UMP, in network byte order
+LIBREMIDI_STATIC void write_ump_frame(std::vector<uint8_t>& out, std::span<const uint32_t> ump)
+{
+  const auto header = stream_frame_header(ump.size() * 4);
+  out.insert(out.end(), header.begin(), header.end());
+  byte_writer w{out};
+  for (uint32_t word : ump)
+    w.u32(word);
+}
+
+//! Splits a byte stream into frames, which are parsed where they were received:
+//! the buffer is used as a ring whose unread part is only moved back to the start
+//! when a partial frame reaches its end.
+class stream_frame_reader
+{
+public:
+  explicit stream_frame_reader(std::size_t max_frame_size)
+      : m_max_frame_size{max_frame_size}
+      , m_buffer(initial_size)
+  {
+  }
+
+  //! Free space to receive into
+  boost::asio::mutable_buffer prepare()
+  {
+    if (m_begin == m_end)
+    {
+      m_begin = m_end = 0;
+    }
+    else if (m_end == m_buffer.size())
+    {
+      std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+      m_end -= m_begin;
+      m_begin = 0;
+    }
+    return boost::asio::buffer(m_buffer.data() + m_end, m_buffer.size() - m_end);
+  }
+
+  //! Calls on_frame(span) for every complete frame once n bytes were received.
+  //! Returns false if a frame is larger than allowed: the stream cannot be resynchronized.
+  template <typename F>
+  bool commit(std::size_t n, F&& on_frame)
+  {
+    m_end += n;
+    while (m_end - m_begin >= stream_frame_header_size)
+    {
+      const uint8_t* p = m_buffer.data() + m_begin;
+      const std::size_t size
+          = (std::size_t(p[0]) << 24) | (std::size_t(p[1]) << 16) | (p[2] << 8) | p[3];
+      if (size > m_max_frame_size)
+        return false;
+
+      const std::size_t frame = stream_frame_header_size + size;
+      if (m_end - m_begin < frame)
+      {
+        // Room for the rest of a frame larger than the buffer
+        if (frame > m_buffer.size())
+          m_buffer.resize(frame);
+        break;
+      }
+
+      on_frame(std::span<const uint8_t>{p + stream_frame_header_size, size});
+      m_begin += frame;
+    }
+    return true;
+  }
+
+private:
+  static constexpr std::size_t initial_size = 65536;
+
+  std::size_t m_max_frame_size{};
+  std::vector<uint8_t> m_buffer;
+  std::size_t m_begin{};
+  std::size_t m_end{};
+};
+
+//! TCP endpoints are an address and a port, Unix domain socket ones a path
+template <typename Protocol>
+typename Protocol::endpoint
+make_stream_endpoint(const std::string& address, int port, boost::system::error_code& ec)
+{
+  if constexpr (std::is_same_v<Protocol, boost::asio::ip::tcp>)
+  {
+    auto addr = boost::asio::ip::make_address(address, ec);
+    if (!ec && (port < 0 || port >= 65536))
+      ec = boost::asio::error::invalid_argument;
+    return {addr, static_cast<unsigned short>(port)};
+  }
+  else
+  {
+    if (address.empty())
+      ec = boost::asio::error::invalid_argument;
+    return typename Protocol::endpoint{address};
+  }
+}
+
+//! Whether the protocol of the configuration can be served with this socket type
+template <typename Protocol, typename Enum>
+constexpr bool stream_protocol_supported(Enum protocol) noexcept
+{
+  if constexpr (std::is_same_v<Protocol, boost::asio::ip::tcp>)
+    return protocol == Enum::STREAM_TCP;
+  else
+    return protocol == Enum::STREAM_UNIX;
+}
+
+//! Accepts stream connections and splits what they receive into frames.
+//! The handlers may run on any thread of the io_context: they are serialized by a mutex.
+template <typename Protocol>
+class stream_server
+{
+public:
+  // Arbitrary limit to avoid abuse
+  static constexpr std::size_t max_connections = 16;
+
+  stream_server(boost::asio::io_context& ctx, std::size_t max_frame_size)
+      : m_acceptor{ctx}
+      , m_max_frame_size{max_frame_size}
+  {
+  }
+
+  ~stream_server()
+  {
+    stop();
+    m_lifetime->end();
+    if (!m_path.empty())
+    {
+      std::error_code ec;
+      std::filesystem::remove(m_path, ec);
+    }
+  }
+
+  stdx::error listen(const typename Protocol::endpoint& endpoint)
+  {
+    boost::system::error_code ec;
+    if constexpr (!std::is_same_v<Protocol, boost::asio::ip::tcp>)
+    {
+      // Left over by a previous process if nothing listens on it anymore:
+      // the socket of a running server is kept, and binding then fails
+      std::error_code fs_ec;
+      m_path = endpoint.path();
+      if (std::filesystem::is_socket(m_path, fs_ec))
+      {
+        socket_type probe{m_acceptor.get_executor()};
+        probe.connect(endpoint, ec);
+        if (ec == boost::asio::error::connection_refused)
+          std::filesystem::remove(m_path, fs_ec);
+        probe.close(ec);
+        ec = {};
+      }
+    }
+
+    m_acceptor.open(endpoint.protocol(), ec);
+    if (!ec)
+      m_acceptor.set_option(boost::asio::socket_base::reuse_address(true), ec);
+    if (!ec)
+      m_acceptor.bind(endpoint, ec);
+    if (!ec)
+      m_acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+    if (ec)
+    {
+      m_path.clear();
+      return std::errc::address_in_use;
+    }
+    return stdx::error{};
+  }
+
+  //! Calls on_frame(span) for every frame received, with the mutex of the server held
+  template <typename F>
+  void start(F on_frame)
+  {
+    std::lock_guard lock{m_mutex};
+    m_running = true;
+    accept(std::move(on_frame));
+  }
+
+  void stop()
+  {
+    std::lock_guard lock{m_mutex};
+    m_running = false;
+
+    boost::system::error_code ec;
+    m_acceptor.cancel(ec);
+    for (auto& c : m_connections)
+      c->socket.close(ec);
+    m_connections.clear();
+  }
+
+  std::size_t connections()
+  {
+    std::lock_guard lock{m_mutex};
+    return m_connections.size();
+  }
+
+private:
+  using socket_type = typename Protocol::socket;
+  struct connection
+  {
+    connection(socket_type s, std::size_t max_frame_size)
+        : socket{std::move(s)}
+        , reader{max_frame_size}
+    {
+    }
+
+    socket_type socket;
+    stream_frame_reader reader;
+  };
+
+  // Must be called with m_mutex held, as receive
+  template <typename F>
+  void accept(F on_frame)
+  {
+    m_acceptor.async_accept(
+        [this, lifetime = m_lifetime, on_frame](boost::system::error_code ec, socket_type socket) {
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive || !m_running)
+        return;
+
+      if (!ec && m_connections.size() < max_connections)
+      {
+        if constexpr (std::is_same_v<Protocol, boost::asio::ip::tcp>)
+          socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+
+        auto c = std::make_shared<connection>(std::move(socket), m_max_frame_size);
+        m_connections.push_back(c);
+        receive(std::move(c), on_frame);
+      }
+
+      accept(on_frame);
+    });
+  }
+
+  // The handler keeps its connection alive: it may run after stop() closed it,
+  // or after the server is destroyed
+  template <typename F>
+  void receive(std::shared_ptr<connection> c, F on_frame)
+  {
+    auto buf = c->reader.prepare();
+    c->socket.async_read_some(
+        buf, [this, lifetime = m_lifetime, c,
+              on_frame](boost::system::error_code ec, std::size_t n) mutable {
+      std::lock_guard lock{lifetime->mutex};
+      if (!lifetime->alive || !c->socket.is_open())
+        return;
+
+      // Closed by the peer, or sending garbage
+      if (ec || !c->reader.commit(n, on_frame))
+      {
+        c->socket.close(ec);
+        std::erase(m_connections, c);
+        return;
+      }
+
+      receive(std::move(c), on_frame);
+    });
+  }
+
+  typename Protocol::acceptor m_acceptor;
+  std::size_t m_max_frame_size{};
+  std::string m_path;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+  bool m_running{};
+  std::vector<std::shared_ptr<connection>> m_connections;
+};
+
+//! Connects to a stream server and sends it frames.
+//! Frames are either written immediately, from the caller's memory when possible,
+//! or coalesced until the flush window elapses and written in a single call.
+template <typename Protocol, typename Configuration>
+class stream_sender
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit stream_sender(const Configuration& conf)
+      : configuration{conf}
+      , ctx{conf.io_context}
+      , m_socket{ctx.get()}
+      , m_timer{ctx.get()}
+  {
+  }
+
+  ~stream_sender()
+  {
+    close();
+    m_lifetime->end();
+  }
+
+  //! Blocks until the connection is established
+  stdx::error open()
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_socket.is_open())
+      return std::errc::device_or_resource_busy;
+
+    boost::system::error_code ec;
+    const auto endpoint
+        = make_stream_endpoint<Protocol>(configuration.host, configuration.port, ec);
+    if (ec)
+      return std::errc::invalid_argument;
+
+    m_socket.connect(endpoint, ec);
+    if (ec)
+    {
+      m_socket.close(ec);
+      return std::errc::connection_refused;
+    }
+
+    if constexpr (std::is_same_v<Protocol, boost::asio::ip::tcp>)
+      m_socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+    return stdx::error{};
+  }
+
+  stdx::error close()
+  {
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_socket.is_open())
+        flush_impl();
+      m_timer.cancel();
+
+      boost::system::error_code ec;
+      m_socket.close(ec);
+    }
+
+    if (ctx.is_owned() && m_thread.joinable())
+    {
+      ctx.get().stop();
+      m_thread.join();
+      ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  stdx::error send(std::span<const uint8_t> bytes)
+  {
+    return send_at(clock::now() + configuration.flush_interval, bytes);
+  }
+
+  stdx::error schedule(int64_t ts, std::span<const uint8_t> bytes)
+  {
+    return send_at(schedule_deadline(ts, clock::now()), bytes);
+  }
+
+  stdx::error send_ump(std::span<const uint32_t> ump)
+  {
+    return send_ump_at(clock::now() + configuration.flush_interval, ump);
+  }
+
+  stdx::error schedule_ump(int64_t ts, std::span<const uint32_t> ump)
+  {
+    return send_ump_at(schedule_deadline(ts, clock::now()), ump);
+  }
+
+  stdx::error flush()
+  {
+    std::lock_guard lock{m_mutex};
+    return flush_impl();
+  }
+
+  int64_t current_time() const noexcept
+  {
+    namespace clk = std::chrono;
+    return clk::duration_cast<clk::nanoseconds>(clock::now().time_since_epoch()).count();
+  }
+
+private:
+  // Coalesced bytes written at most in a single call
+  static constexpr std::size_t max_pending_size = 65536;
+
+  stdx::error send_at(clock::time_point deadline, std::span<const uint8_t> bytes)
+  {
+    std::lock_guard lock{m_mutex};
+    if (!m_socket.is_open())
+      return std::errc::not_connected;
+
+    const auto header = stream_frame_header(bytes.size());
+    if (m_pending.empty() && deadline <= clock::now())
+    {
+      return write(std::array<boost::asio::const_buffer, 2>{
+          boost::asio::buffer(header), boost::asio::buffer(bytes.data(), bytes.size())});
+    }
+
+    m_pending.insert(m_pending.end(), header.begin(), header.end());
+    m_pending.insert(m_pending.end(), bytes.begin(), bytes.end());
+    return commit(deadline);
+  }
+
+  stdx::error send_ump_at(clock::time_point deadline, std::span<const uint32_t> ump)
+  {
+    std::lock_guard lock{m_mutex};
+    if (!m_socket.is_open())
+      return std::errc::not_connected;
+
+    write_ump_frame(m_pending, ump);
+    return commit(deadline);
+  }
+
+  // Must be called with m_mutex held, as all the functions below
+  stdx::error commit(clock::time_point deadline)
+  {
+    if (deadline <= clock::now() || m_pending.size() >= max_pending_size)
+      return flush_impl();
+
+    arm(deadline);
+    return stdx::error{};
+  }
+
+  stdx::error flush_impl()
+  {
+    m_deadline = clock::time_point::max();
+    if (m_pending.empty())
+      return stdx::error{};
+
+    auto ret = write(boost::asio::buffer(m_pending));
+    m_pending.clear();
+    return ret;
+  }
+
+  // The connection is dropped on error: the stream would be out of sync
+  template <typename Buffers>
+  stdx::error write(const Buffers& buffers)
+  {
+    if (!m_socket.is_open())
+      return std::errc::not_connected;
+
+    boost::system::error_code ec;
+    boost::asio::write(m_socket, buffers, ec);
+    if (ec)
+    {
+      const auto err = static_cast<std::errc>(ec.value());
+      m_socket.close(ec);
+      return err;
+    }
+    return stdx::error{};
+  }
+
+  clock::time_point schedule_deadline(int64_t ts, clock::time_point now) const noexcept
+  {
+    clock::time_point deadline = now;
+    switch (configuration.timestamps)
+    {
+      case timestamp_mode::Relative:
+        deadline = now + std::chrono::nanoseconds(ts);
+        break;
+
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        deadline = clock::time_point{std::chrono::nanoseconds(ts)};
+        break;
+
+      default:
+        break;
+    }
+
+    if (configuration.flush_interval.count() > 0)
+      deadline = std::min(deadline, now + configuration.flush_interval);
+    return deadline;
+  }
+
+  void arm(clock::time_point deadline)
+  {
+    if (deadline >= m_deadline)
+      return;
+    m_deadline = deadline;
+
+    if (ctx.is_owned() && !m_thread.joinable())
+    {
+      m_thread = std::thread{[&ctx = ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+
+    m_timer.expires_at(deadline);
+    m_timer.async_wait([this, lifetime = m_lifetime](boost::system::error_code ec) {
+      if (ec)
+        return;
+
+      std::lock_guard lock{lifetime->mutex};
+      if (lifetime->alive && clock::now() >= m_deadline)
+        flush_impl();
+    });
+  }
+
+  const Configuration& configuration;
+
+public:
+  libremidi::optionally_owned<boost::asio::io_context> ctx;
+
+private:
+  typename Protocol::socket m_socket;
+  boost::asio::steady_timer m_timer;
+  std::thread m_thread;
+
+  std::shared_ptr<async_lifetime> m_lifetime{std::make_shared<async_lifetime>()};
+  std::mutex& m_mutex{m_lifetime->mutex};
+  std::vector<uint8_t> m_pending;
+  clock::time_point m_deadline{clock::time_point::max()};
+};
+}
@@ -0,0 +1,255 @@
+#pragma once
+#include <libremidi/backends/net/config.hpp>
+#include <libremidi/backends/net/helpers.hpp>
+#include <libremidi/backends/net/stream.hpp>
+#include <libremidi/detail/midi_in.hpp>
+
+#include <boost/asio/io_context.hpp>
+
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::net
+{
+// Receives the MIDI messages of the clients connected over TCP or a Unix domain socket
+template <typename Protocol>
+class stream_in final
+    : public midi1::in_api
+    , public error_handler
+{
+public:
+  using midi_api::client_open_;
+  struct
+      : input_configuration
+      , dgram_input_configuration
+  {
+  } configuration;
+
+  explicit stream_in(input_configuration&& conf, dgram_input_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_ctx{configuration.io_context}
+      , m_server{m_ctx.get(), std::size_t(std::max(configuration.max_message_size, 0))}
+  {
+    if (!stream_protocol_supported<Protocol>(configuration.protocol))
+    {
+      client_open_ = std::errc::address_family_not_supported;
+      return;
+    }
+
+    boost::system::error_code ec;
+    const auto endpoint
+        = make_stream_endpoint<Protocol>(configuration.accept, configuration.port, ec);
+    if (ec)
+    {
+      client_open_ = std::errc::invalid_argument;
+      return;
+    }
+
+    client_open_ = m_server.listen(endpoint);
+  }
+
+  ~stream_in() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
+
+  stdx::error open_port(const input_port&, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  stdx::error open_virtual_port(std::string_view) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+    if (std::exchange(m_open, true))
+      return std::errc::device_or_resource_busy;
+
+    m_server.start([this](std::span<const uint8_t> frame) { on_message(frame); });
+
+    if (m_ctx.is_owned())
+    {
+      m_thread = std::thread{[&ctx = m_ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    m_server.stop();
+    m_open = false;
+
+    if (m_ctx.is_owned() && m_thread.joinable())
+    {
+      m_ctx.get().stop();
+      m_thread.join();
+      m_ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  timestamp absolute_timestamp() const noexcept override
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+private:
+  // Each frame is a complete message
+  void on_message(std::span<const uint8_t> bytes)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = false,
+        .absolute_is_monotonic = false,
+        .has_samples = false,
+    };
+
+    static constexpr auto to_ns = []() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    };
+
+    if (!bytes.empty())
+      m_processing.on_bytes(bytes, m_processing.timestamp<timestamp_info>(to_ns, 0));
+  }
+
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+
+  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
+  stream_server<Protocol> m_server;
+  std::thread m_thread;
+  bool m_open{};
+};
+}
+
+NAMESPACE_LIBREMIDI::net_ump
+{
+// Receives the UMPs of the clients connected over TCP or a Unix domain socket
+template <typename Protocol>
+class stream_in final
+    : public midi2::in_api
+    , public error_handler
+{
+public:
+  using midi_api::client_open_;
+  struct
+      : ump_input_configuration
+      , dgram_input_configuration
+  {
+  } configuration;
+
+  explicit stream_in(ump_input_configuration&& conf, dgram_input_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_ctx{configuration.io_context}
+      , m_server{m_ctx.get(), max_frame_size}
+  {
+    if (!stream_protocol_supported<Protocol>(configuration.protocol))
+    {
+      client_open_ = std::errc::address_family_not_supported;
+      return;
+    }
+
+    boost::system::error_code ec;
+    const auto endpoint
+        = make_stream_endpoint<Protocol>(configuration.accept, configuration.port, ec);
+    if (ec)
+    {
+      client_open_ = std::errc::invalid_argument;
+      return;
+    }
+
+    client_open_ = m_server.listen(endpoint);
+  }
+
+  ~stream_in() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK_UMP; }
+
+  stdx::error open_port(const input_port&, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  stdx::error open_virtual_port(std::string_view) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+    if (std::exchange(m_open, true))
+      return std::errc::device_or_resource_busy;
+
+    m_server.start([this](std::span<const uint8_t> frame) { on_ump(frame); });
+
+    if (m_ctx.is_owned())
+    {
+      m_thread = std::thread{[&ctx = m_ctx.get(), &thread = configuration.thread] {
+        apply_thread_configuration(thread);
+        auto wg = boost::asio::make_work_guard(ctx);
+        ctx.run();
+      }};
+    }
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    m_server.stop();
+    m_open = false;
+
+    if (m_ctx.is_owned() && m_thread.joinable())
+    {
+      m_ctx.get().stop();
+      m_thread.join();
+      m_ctx.get().restart();
+    }
+    return stdx::error{};
+  }
+
+  timestamp absolute_timestamp() const noexcept override
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+private:
+  // Largest frame accepted: UMPs are at most 16 bytes, a frame may gather many of them
+  static constexpr std::size_t max_frame_size = 65536;
+
+  // The UMPs are in network byte order
+  void on_ump(std::span<const uint8_t> payload)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = false,
+        .absolute_is_monotonic = false,
+        .has_samples = false,
+    };
+
+    static constexpr auto to_ns = []() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    };
+
+    byte_reader r{payload};
+    m_words.clear();
+    while (r.remaining() >= 4)
+      m_words.push_back(r.u32());
+
+    m_processing.on_bytes_multi(m_words, m_processing.timestamp<timestamp_info>(to_ns, 0));
+  }
+
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+
+  libremidi::optionally_owned<boost::asio::io_context> m_ctx;
+  stream_server<Protocol> m_server;
+  std::thread m_thread;
+  bool m_open{};
+  std::vector<uint32_t> m_words;
+};
+}
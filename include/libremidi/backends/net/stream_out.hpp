@@ -0,0 +1,136 @@
+#pragma once
+#include <libremidi/backends/net/config.hpp>
+#include <libremidi/backends/net/stream.hpp>
+#include <libremidi/detail/midi_out.hpp>
+
+NAMESPACE_LIBREMIDI::net
+{
+// Sends MIDI messages to a server over TCP or a Unix domain socket
+template <typename Protocol>
+class stream_out final
+    : public midi1::out_api
+    , public error_handler
+{
+public:
+  struct
+      : output_configuration
+      , dgram_output_configuration
+  {
+  } configuration;
+
+  stream_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_sender{configuration}
+  {
+    if (!stream_protocol_supported<Protocol>(configuration.protocol))
+      client_open_ = std::errc::address_family_not_supported;
+    else
+      client_open_ = stdx::error{};
+  }
+
+  ~stream_out() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK; }
+
+  stdx::error open_port(const output_port& /* port */, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  // Connects to the server: fails with connection_refused if it is not listening
+  stdx::error open_virtual_port(std::string_view) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+    return m_sender.open();
+  }
+
+  stdx::error close_port() override { return m_sender.close(); }
+
+  stdx::error send_message(const unsigned char* message, size_t size) override
+  {
+    if (size == 0)
+      return std::errc::message_size;
+    return m_sender.send({message, size});
+  }
+
+  stdx::error schedule_message(int64_t ts, const unsigned char* message, size_t size) override
+  {
+    if (size == 0)
+      return std::errc::message_size;
+    return m_sender.schedule(ts, {message, size});
+  }
+
+  stdx::error flush() override { return m_sender.flush(); }
+
+  int64_t current_time() const noexcept override { return m_sender.current_time(); }
+
+  stream_sender<Protocol, decltype(configuration)> m_sender;
+};
+}
+
+NAMESPACE_LIBREMIDI::net_ump
+{
+// Sends UMPs to a server over TCP or a Unix domain socket
+template <typename Protocol>
+class stream_out final
+    : public midi2::out_api
+    , public error_handler
+{
+public:
+  struct
+      : output_configuration
+      , dgram_output_configuration
+  {
+  } configuration;
+
+  stream_out(output_configuration&& conf, dgram_output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+      , m_sender{configuration}
+  {
+    if (!stream_protocol_supported<Protocol>(configuration.protocol))
+      client_open_ = std::errc::address_family_not_supported;
+    else
+      client_open_ = stdx::error{};
+  }
+
+  ~stream_out() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override { return libremidi::API::NETWORK_UMP; }
+
+  stdx::error open_port(const output_port& /* port */, std::string_view name) override
+  {
+    return open_virtual_port(name);
+  }
+
+  // Connects to the server: fails with connection_refused if it is not listening
+  stdx::error open_virtual_port(std::string_view) override
+  {
+    if (client_open_ != stdx::error{})
+      return client_open_;
+    return m_sender.open();
+  }
+
+  stdx::error close_port() override { return m_sender.close(); }
+
+  stdx::error send_ump(const uint32_t* message, size_t size) override
+  {
+    if (size == 0 || size > 4)
+      return std::errc::message_size;
+    return m_sender.send_ump({message, size});
+  }
+
+  stdx::error schedule_ump(int64_t ts, const uint32_t* message, size_t size) override
+  {
+    if (size == 0 || size > 4)
+      return std::errc::message_size;
+    return m_sender.schedule_ump(ts, {message, size});
+  }
+
+  stdx::error flush() override { return m_sender.flush(); }
+
+  int64_t current_time() const noexcept override { return m_sender.current_time(); }
+
+  stream_sender<Protocol, decltype(configuration)> m_sender;
+};
+}
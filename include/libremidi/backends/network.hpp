@@ -4,6 +4,10 @@
 #include <libremidi/backends/net/midi_in.hpp>
 #include <libremidi/backends/net/midi_out.hpp>
 #include <libremidi/backends/net/observer.hpp>
+#include <libremidi/backends/net/rtpmidi_in.hpp>
+#include <libremidi/backends/net/rtpmidi_out.hpp>
+#include <libremidi/backends/net/stream_in.hpp>
+#include <libremidi/backends/net/stream_out.hpp>
 
 #include <string_view>
 
@@ -24,3 +28,54 @@ struct backend
   static inline bool available() noexcept { return true; }
 };
 }
+
+NAMESPACE_LIBREMIDI
+{
+// Unix domain sockets are served by the TCP implementation where they are not available,
+// which refuses them.
+template <>
+inline std::unique_ptr<midi_in_api> make<net::midi_in>(
+    libremidi::input_configuration&& conf, libremidi::net::dgram_input_configuration&& api)
+{
+  switch (api.protocol)
+  {
+    case net::protocol::RTP_MIDI:
+      return std::make_unique<net::rtpmidi_in>(std::move(conf), std::move(api));
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    case net::protocol::STREAM_UNIX:
+      return std::make_unique<net::stream_in<boost::asio::local::stream_protocol>>(
+          std::move(conf), std::move(api));
+#else
+    case net::protocol::STREAM_UNIX:
+#endif
+    case net::protocol::STREAM_TCP:
+      return std::make_unique<net::stream_in<boost::asio::ip::tcp>>(
+          std::move(conf), std::move(api));
+    default:
+      return std::make_unique<net::midi_in>(std::move(conf), std::move(api));
+  }
+}
+
+template <>
+inline std::unique_ptr<midi_out_api> make<net::midi_out>(
+    libremidi::output_configuration&& conf, libremidi::net::dgram_output_configuration&& api)
+{
+  switch (api.protocol)
+  {
+    case net::protocol::RTP_MIDI:
+      return std::make_unique<net::rtpmidi_out>(std::move(conf), std::move(api));
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    case net::protocol::STREAM_UNIX:
+      return std::make_unique<net::stream_out<boost::asio::local::stream_protocol>>(
+          std::move(conf), std::move(api));
+#else
+    case net::protocol::STREAM_UNIX:
+#endif
+    case net::protocol::STREAM_TCP:
+      return std::make_unique<net::stream_out<boost::asio::ip::tcp>>(
+          std::move(conf), std::move(api));
+    default:
+      return std::make_unique<net::midi_out>(std::move(conf), std::move(api));
+  }
+}
+}
@@ -2,7 +2,11 @@
 #include <libremidi/backends/net/config.hpp>
 #include <libremidi/backends/net/midi_in.hpp>
 #include <libremidi/backends/net/midi_out.hpp>
+#include <libremidi/backends/net/network_midi2_in.hpp>
+#include <libremidi/backends/net/network_midi2_out.hpp>
 #include <libremidi/backends/net/observer.hpp>
+#include <libremidi/backends/net/stream_in.hpp>
+#include <libremidi/backends/net/stream_out.hpp>
 
 #include <string_view>
 
@@ -23,3 +27,54 @@ struct backend
   static inline bool available() noexcept { return true; }
 };
 }
+
+NAMESPACE_LIBREMIDI
+{
+// Unix domain sockets are served by the TCP implementation where they are not available,
+// which refuses them.
+template <>
+inline std::unique_ptr<midi_in_api> make<net_ump::midi_in>(
+    libremidi::ump_input_configuration&& conf, libremidi::net_ump::dgram_input_configuration&& api)
+{
+  switch (api.protocol)
+  {
+    case net_ump::protocol::NETWORK_MIDI2_UDP:
+      return std::make_unique<net_ump::network_midi2_in>(std::move(conf), std::move(api));
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    case net_ump::protocol::STREAM_UNIX:
+      return std::make_unique<net_ump::stream_in<boost::asio::local::stream_protocol>>(
+          std::move(conf), std::move(api));
+#else
+    case net_ump::protocol::STREAM_UNIX:
+#endif
+    case net_ump::protocol::STREAM_TCP:
+      return std::make_unique<net_ump::stream_in<boost::asio::ip::tcp>>(
+          std::move(conf), std::move(api));
+    default:
+      return std::make_unique<net_ump::midi_in>(std::move(conf), std::move(api));
+  }
+}
+
+template <>
+inline std::unique_ptr<midi_out_api> make<net_ump::midi_out>(
+    libremidi::output_configuration&& conf, libremidi::net_ump::dgram_output_configuration&& api)
+{
+  switch (api.protocol)
+  {
+    case net_ump::protocol::NETWORK_MIDI2_UDP:
+      return std::make_unique<net_ump::network_midi2_out>(std::move(conf), std::move(api));
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    case net_ump::protocol::STREAM_UNIX:
+      return std::make_unique<net_ump::stream_out<boost::asio::local::stream_protocol>>(
+          std::move(conf), std::move(api));
+#else
+    case net_ump::protocol::STREAM_UNIX:
+#endif
+    case net_ump::protocol::STREAM_TCP:
+      return std::make_unique<net_ump::stream_out<boost::asio::ip::tcp>>(
+          std::move(conf), std::move(api));
+    default:
+      return std::make_unique<net_ump::midi_out>(std::move(conf), std::move(api));
+  }
+}
+}
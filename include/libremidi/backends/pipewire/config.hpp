@@ -1,5 +1,6 @@
 #pragma once
 #include <libremidi/config.hpp>
+#include <libremidi/thread_configuration.hpp>
 
 #include <cstdint>
 #include <string>
@@ -22,6 +23,10 @@ struct pipewire_input_configuration
   pw_thread_loop* thread_loop{};
   pw_main_loop* main_loop{};
   pw_core* core{};
+
+  //! Scheduling of the PipeWire loop thread started by libremidi, not of a borrowed
+  //! loop. The loop is shared: it is configured by the first port which creates it.
+  thread_configuration thread{};
 };
 
 struct pipewire_output_configuration
@@ -32,6 +37,10 @@ struct pipewire_output_configuration
   pw_main_loop* main_loop{};
   pw_core* core{};
 
+  //! Scheduling of the PipeWire loop thread started by libremidi, not of a borrowed
+  //! loop. The loop is shared: it is configured by the first port which creates it.
+  thread_configuration thread{};
+
   int64_t output_buffer_size{65536};
 };
 
@@ -42,5 +51,9 @@ struct pipewire_observer_configuration
   pw_thread_loop* thread_loop{};
   pw_main_loop* main_loop{};
   pw_core* core{};
+
+  //! Scheduling of the PipeWire loop thread started by libremidi, not of a borrowed
+  //! loop. The loop is shared: it is configured by the first port which creates it.
+  thread_configuration thread{};
 };
 }
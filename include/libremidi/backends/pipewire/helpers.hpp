@@ -77,7 +77,7 @@ struct pipewire_helpers
     }
     else
     {
-      this->ctx = libremidi::pipewire::shared_context();
+      this->ctx = libremidi::pipewire::shared_context({.thread = configuration.thread});
     }
 
     if (!this->ctx || !this->ctx->ok())
@@ -1,6 +1,7 @@
 #pragma once
 #include <libremidi/backends/pipewire/config.hpp>
 #include <libremidi/backends/pipewire/helpers.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
 
@@ -23,6 +24,10 @@ public:
   {
   } configuration;
 
+  // With coalesce_controllers in callback mode, the messages of each cycle are coalesced
+  std::unique_ptr<cycle_coalescer<message>> m_coalescer{
+      cycle_coalescer<message>::install(configuration)};
+
   explicit midi_in_pipewire(input_configuration&& conf, pipewire_input_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
   {
@@ -87,7 +92,8 @@ public:
   {
     static constexpr timestamp_backend_info timestamp_info{
         .has_absolute_timestamps = true,
-        .absolute_is_monotonic = true,
+        // The graph position, which drifts from the monotonic clock with the driver
+        .absolute_is_monotonic = false,
         .has_samples = true,
     };
 
@@ -127,9 +133,13 @@ public:
           {data, data + size}, m_processing.timestamp<timestamp_info>(to_ns, c->offset));
     }
 
+    if (m_coalescer)
+      m_coalescer->flush();
+
     pw.filter_queue_buffer(this->port.opaque, b);
   }
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <libremidi/backends/pipewire/config.hpp>
 #include <libremidi/backends/pipewire/helpers.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/detail/midi_out.hpp>
 
 #include <spa/control/control.h>
@@ -27,6 +28,9 @@ public:
       output_configuration&& conf, pipewire_output_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
   {
+    if (configuration.coalesce_controllers)
+      m_cycle = std::make_unique<cycle_batch<libremidi::message>>();
+
     if (auto ret = create_context(*this); ret != stdx::error{})
     {
       client_open_ = ret;
@@ -86,6 +90,33 @@ public:
 
   stdx::error set_port_name(std::string_view port_name) override { return rename_port(port_name); }
 
+  // With coalesce_controllers: takes the messages of the cycle out of the queue before
+  // deciding which are sent. The ones which do not fit in the buffer go first next cycle.
+  void write_coalesced(spa_pod_builder& build)
+  {
+    auto& batch = *m_cycle;
+    while (!batch.full() && m_queue.try_dequeue(batch.next()))
+      batch.push();
+
+    std::size_t written = 0;
+    for (auto& m : batch.coalesce())
+    {
+      if (!m.empty() && m.bytes[0] != 0xff)
+      {
+        spa_pod_builder_control(&build, static_cast<int32_t>(m.timestamp), SPA_CONTROL_Midi);
+        int res = spa_pod_builder_bytes(
+            &build, m.bytes.data(), static_cast<uint32_t>(m.bytes.size()));
+        if (res == -ENOSPC)
+        {
+          this->counters.overrun(this->configuration.on_overrun);
+          break;
+        }
+      }
+      written++;
+    }
+    batch.consume(written);
+  }
+
   int process(spa_io_position* pos)
   {
     m_process_clock.store(pos->clock.nsec, std::memory_order_relaxed);
@@ -106,34 +137,42 @@ public:
     spa_pod_frame f;
     spa_pod_builder_push_sequence(&build, &f, 0);
 
-    // for all events
-    while (auto m_ptr = m_queue.peek())
+    if (m_cycle)
+      write_coalesced(build);
+    else
     {
-      auto& m = *m_ptr;
-      if (m.empty())
-      {
-        m_queue.pop();
-        continue;
-      }
-
-      // TODO why
-      if (m.bytes[0] == 0xff)
+      // for all events
+      while (auto m_ptr = m_queue.peek())
       {
+        auto& m = *m_ptr;
+        if (m.empty())
+        {
+          m_queue.pop();
+          continue;
+        }
+
+        // TODO why
+        if (m.bytes[0] == 0xff)
+        {
+          m_queue.pop();
+          continue;
+        }
+
+        spa_pod_builder_control(&build, static_cast<int32_t>(m.timestamp), SPA_CONTROL_Midi);
+        int res
+            = spa_pod_builder_bytes(&build, m.bytes.data(), static_cast<uint32_t>(m.bytes.size()));
+
+        // Try again next buffer
+        if (res == -ENOSPC)
+        {
+          this->counters.overrun(this->configuration.on_overrun);
+          break;
+        }
+
+        // Recycle the memory
+        m_gcqueue.enqueue(std::move(m));
         m_queue.pop();
-        continue;
       }
-
-      spa_pod_builder_control(&build, static_cast<int32_t>(m.timestamp), SPA_CONTROL_Midi);
-      int res
-          = spa_pod_builder_bytes(&build, m.bytes.data(), static_cast<uint32_t>(m.bytes.size()));
-
-      // Try again next buffer
-      if (res == -ENOSPC)
-        break;
-
-      // Recycle the memory
-      m_gcqueue.enqueue(std::move(m));
-      m_queue.pop();
     }
     spa_pod_builder_pop(&build, &f);
 
@@ -187,5 +226,6 @@ public:
   moodycamel::ReaderWriterQueue<libremidi::message> m_queue;
   moodycamel::ReaderWriterQueue<libremidi::message> m_gcqueue;
   std::atomic_int64_t m_process_clock = 0;
+  std::unique_ptr<cycle_batch<libremidi::message>> m_cycle;
 };
 }
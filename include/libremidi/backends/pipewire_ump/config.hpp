@@ -12,6 +12,10 @@ struct input_configuration
   pw_thread_loop* thread_loop{};
   pw_main_loop* main_loop{};
   pw_core* core{};
+
+  //! Scheduling of the PipeWire loop thread started by libremidi, not of a borrowed
+  //! loop. The loop is shared: it is configured by the first port which creates it.
+  thread_configuration thread{};
 };
 
 struct output_configuration
@@ -22,6 +26,10 @@ struct output_configuration
   pw_main_loop* main_loop{};
   pw_core* core{};
 
+  //! Scheduling of the PipeWire loop thread started by libremidi, not of a borrowed
+  //! loop. The loop is shared: it is configured by the first port which creates it.
+  thread_configuration thread{};
+
   int64_t output_buffer_size{65536};
 };
 
@@ -32,5 +40,9 @@ struct observer_configuration
   pw_thread_loop* thread_loop{};
   pw_main_loop* main_loop{};
   pw_core* core{};
+
+  //! Scheduling of the PipeWire loop thread started by libremidi, not of a borrowed
+  //! loop. The loop is shared: it is configured by the first port which creates it.
+  thread_configuration thread{};
 };
 }
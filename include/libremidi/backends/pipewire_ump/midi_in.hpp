@@ -1,6 +1,7 @@
 #pragma once
 #include <libremidi/backends/pipewire/helpers.hpp>
 #include <libremidi/backends/pipewire_ump/config.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/detail/midi_in.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
 
@@ -23,6 +24,9 @@ public:
   {
   } configuration;
 
+  // With coalesce_controllers in callback mode, the messages of each cycle are coalesced
+  std::unique_ptr<cycle_coalescer<ump>> m_coalescer{cycle_coalescer<ump>::install(configuration)};
+
   explicit midi_in_pipewire(
       ump_input_configuration&& conf, libremidi::pipewire_ump::input_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
@@ -94,7 +98,8 @@ public:
   {
     static constexpr timestamp_backend_info timestamp_info{
         .has_absolute_timestamps = true,
-        .absolute_is_monotonic = true,
+        // The graph position, which drifts from the monotonic clock with the driver
+        .absolute_is_monotonic = false,
         .has_samples = true,
     };
 
@@ -130,14 +135,18 @@ public:
         return 1e9 * ((clk.position + c->offset) / (double)clk.rate.denom);
       };
 
-      m_processing.on_bytes(
+      m_processing.on_bytes_multi(
           {(uint32_t*)data, (uint32_t*)(data + size)},
           m_processing.timestamp<timestamp_info>(to_ns, c->offset));
     }
 
+    if (m_coalescer)
+      m_coalescer->flush();
+
     pw.filter_queue_buffer(this->port.opaque, b);
   }
 
-  midi2::input_state_machine m_processing{this->configuration};
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <libremidi/backends/pipewire/helpers.hpp>
 #include <libremidi/backends/pipewire_ump/config.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/detail/midi_out.hpp>
 
 #include <spa/control/control.h>
@@ -28,6 +29,9 @@ public:
       libremidi::pipewire_ump::output_configuration&& apiconf)
       : configuration{std::move(conf), std::move(apiconf)}
   {
+    if (configuration.coalesce_controllers)
+      m_cycle = std::make_unique<cycle_batch<libremidi::ump>>();
+
     if (auto ret = create_context(*this); ret != stdx::error{})
     {
       client_open_ = ret;
@@ -93,6 +97,29 @@ public:
     return rename_port(port_name);
   }
 
+  // With coalesce_controllers: takes the messages of the cycle out of the queue before
+  // deciding which are sent. The ones which do not fit in the buffer go first next cycle.
+  void write_coalesced(spa_pod_builder& build)
+  {
+    auto& batch = *m_cycle;
+    while (!batch.full() && m_queue.try_dequeue(batch.next()))
+      batch.push();
+
+    std::size_t written = 0;
+    for (auto& m : batch.coalesce())
+    {
+      spa_pod_builder_control(&build, static_cast<int32_t>(m.timestamp), SPA_CONTROL_UMP);
+      if (spa_pod_builder_bytes(&build, m.data, cmidi2_ump_get_message_size_bytes(m.data))
+          == -ENOSPC)
+      {
+        this->counters.overrun(this->configuration.on_overrun);
+        break;
+      }
+      written++;
+    }
+    batch.consume(written);
+  }
+
   int process(spa_io_position* pos)
   {
     m_process_clock.store(pos->clock.nsec, std::memory_order_relaxed);
@@ -113,20 +140,28 @@ public:
     spa_pod_frame f;
     spa_pod_builder_push_sequence(&build, &f, 0);
 
-    // for all events
-    while (auto m_ptr = m_queue.peek())
+    if (m_cycle)
+      write_coalesced(build);
+    else
     {
-      auto& m = *m_ptr;
-
-      spa_pod_builder_control(&build, static_cast<int32_t>(m.timestamp), SPA_CONTROL_UMP);
-      int res = spa_pod_builder_bytes(&build, m.data, cmidi2_ump_get_message_size_bytes(m.data));
-
-      // Try again next buffer
-      if (res == -ENOSPC)
-        break;
-
-      // Recycle the memory
-      m_queue.pop();
+      // for all events
+      while (auto m_ptr = m_queue.peek())
+      {
+        auto& m = *m_ptr;
+
+        spa_pod_builder_control(&build, static_cast<int32_t>(m.timestamp), SPA_CONTROL_UMP);
+        int res = spa_pod_builder_bytes(&build, m.data, cmidi2_ump_get_message_size_bytes(m.data));
+
+        // Try again next buffer
+        if (res == -ENOSPC)
+        {
+          this->counters.overrun(this->configuration.on_overrun);
+          break;
+        }
+
+        // Recycle the memory
+        m_queue.pop();
+      }
     }
     spa_pod_builder_pop(&build, &f);
 
@@ -188,5 +223,6 @@ public:
 
   moodycamel::ReaderWriterQueue<libremidi::ump> m_queue;
   std::atomic_int64_t m_process_clock = 0;
+  std::unique_ptr<cycle_batch<libremidi::ump>> m_cycle;
 };
 }
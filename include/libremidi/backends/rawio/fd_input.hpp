@@ -0,0 +1,112 @@
+#pragma once
+#include <libremidi/backends/linux/epoll_reactor.hpp>
+#include <libremidi/backends/linux/io_uring_reader.hpp>
+#include <libremidi/backends/rawio/config.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+NAMESPACE_LIBREMIDI
+{
+namespace rawio
+{
+// Reads a descriptor from the thread shared by the devices of the process
+struct fd_reader
+{
+  int fd{-1};
+  bool use_io_uring{};
+
+  std::mutex mutex;
+#if LIBREMIDI_HAS_IO_URING
+  std::shared_ptr<io_uring_reader> uring;
+#endif
+  std::shared_ptr<epoll_reactor> reactor;
+  int64_t id{-1};
+
+  ~fd_reader() { stop(); }
+
+  static int64_t now() noexcept
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+  void start(rawio_input_configuration::receive_callback cb)
+  {
+    stop();
+
+    std::lock_guard lock{mutex};
+    if (int flags = ::fcntl(fd, F_GETFL); flags >= 0 && !(flags & O_NONBLOCK))
+      ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+#if LIBREMIDI_HAS_IO_URING
+    if (use_io_uring)
+    {
+      if ((uring = io_uring_reader::instance()))
+      {
+        id = uring->add(fd, [cb = std::move(cb)](std::span<const uint8_t> bytes) {
+          cb(bytes, now());
+          return true;
+        });
+        return;
+      }
+    }
+#endif
+
+    if ((reactor = epoll_reactor::instance()))
+    {
+      id = reactor->add(fd, [fd = fd, cb = std::move(cb)](uint32_t) {
+        uint8_t bytes[1024];
+        for (;;)
+        {
+          const ssize_t n = ::read(fd, bytes, sizeof(bytes));
+          if (n > 0)
+            cb({bytes, static_cast<std::size_t>(n)}, now());
+          else if (n < 0 && errno == EINTR)
+            continue;
+          else
+            return n < 0 && errno == EAGAIN;
+        }
+      });
+      if (id < 0)
+        reactor.reset();
+    }
+  }
+
+  void stop()
+  {
+    std::lock_guard lock{mutex};
+#if LIBREMIDI_HAS_IO_URING
+    if (uring)
+      uring->remove(id);
+    uring.reset();
+#endif
+    if (reactor)
+      reactor->remove(id);
+    reactor.reset();
+    id = -1;
+  }
+};
+}
+
+//! Input configuration reading the MIDI bytes from a file descriptor owned by the caller,
+//! e.g. a serial port or a pipe. The descriptor is set to non-blocking and is read from a
+//! thread shared by all the devices of the process: through io_uring if requested and
+//! supported by the kernel, through epoll otherwise.
+//! The descriptor must stay open until the input is closed.
+inline rawio_input_configuration rawio_fd_input_configuration(int fd, bool use_io_uring = true)
+{
+  auto reader = std::make_shared<rawio::fd_reader>();
+  reader->fd = fd;
+  reader->use_io_uring = use_io_uring;
+
+  return rawio_input_configuration{
+      .set_receive_callback
+      = [reader](rawio_input_configuration::receive_callback cb) { reader->start(std::move(cb)); },
+      .stop_receive = [reader] { reader->stop(); }};
+}
+}
@@ -79,6 +79,7 @@ private:
         bytes, m_processing.timestamp<timestamp_info>(to_ns, 0));
   }
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
@@ -77,6 +77,7 @@ private:
         words, m_processing.timestamp<timestamp_info>(to_ns, 0));
   }
 
-  midi2::input_state_machine m_processing{this->configuration};
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
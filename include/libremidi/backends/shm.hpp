@@ -0,0 +1,25 @@
+#pragma once
+#include <libremidi/backends/shm/config.hpp>
+#include <libremidi/backends/shm/midi_in.hpp>
+#include <libremidi/backends/shm/midi_out.hpp>
+#include <libremidi/backends/shm/observer.hpp>
+
+#include <string_view>
+
+NAMESPACE_LIBREMIDI::shm
+{
+struct backend
+{
+  using midi_in = shm::midi_in;
+  using midi_out = shm::midi_out;
+  using midi_observer = shm::observer;
+  using midi_in_configuration = shm::input_configuration;
+  using midi_out_configuration = shm::output_configuration;
+  using midi_observer_configuration = shm::observer_configuration;
+  static const constexpr auto API = libremidi::API::SHARED_MEMORY;
+  static const constexpr std::string_view name = "shared_memory";
+  static const constexpr std::string_view display_name = "Shared memory";
+
+  static inline bool available() noexcept { return true; }
+};
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/thread_configuration.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+NAMESPACE_LIBREMIDI::shm
+{
+//! Rings are files of this directory, which should be on a tmpfs mount
+inline constexpr const char* default_directory = "/dev/shm/libremidi";
+
+struct input_configuration
+{
+  std::string client_name = "libremidi client";
+
+  std::string directory = default_directory;
+
+  //! Size of the ring created by a virtual port, in bytes. Rounded up to a power of two.
+  std::size_t capacity = 1 << 20;
+
+  //! File mode of the ring created by a virtual port. By default, only the processes of the
+  //! same user can attach to it. Any process which can write the ring can also corrupt it.
+  uint32_t permissions = 0600;
+
+  //! Time spent polling the ring before sleeping on the futex when it is empty.
+  //! Trades a busy core for wake-up latency.
+  std::chrono::microseconds busy_wait{};
+
+  //! Scheduling of the thread reading the ring
+  thread_configuration thread{};
+};
+
+struct output_configuration
+{
+  std::string client_name = "libremidi client";
+
+  std::string directory = default_directory;
+
+  //! Size of the ring created by a virtual port, in bytes. Rounded up to a power of two.
+  std::size_t capacity = 1 << 20;
+
+  //! File mode of the ring created by a virtual port. By default, only the processes of the
+  //! same user can attach to it. Any process which can write the ring can also corrupt it.
+  uint32_t permissions = 0600;
+};
+
+struct observer_configuration
+{
+  std::string client_name = "libremidi client";
+
+  std::string directory = default_directory;
+
+  //! Period at which the directory is scanned when callbacks are set
+  std::chrono::milliseconds poll_period{100};
+
+  //! Scheduling of the thread scanning the directory
+  thread_configuration thread{};
+};
+}
+
+NAMESPACE_LIBREMIDI::shm_ump
+{
+struct input_configuration
+{
+  std::string client_name = "libremidi client";
+
+  std::string directory = shm::default_directory;
+
+  //! Size of the ring created by a virtual port, in bytes. Rounded up to a power of two.
+  std::size_t capacity = 1 << 20;
+
+  //! File mode of the ring created by a virtual port. By default, only the processes of the
+  //! same user can attach to it. Any process which can write the ring can also corrupt it.
+  uint32_t permissions = 0600;
+
+  //! Time spent polling the ring before sleeping on the futex when it is empty.
+  //! Trades a busy core for wake-up latency.
+  std::chrono::microseconds busy_wait{};
+
+  //! Scheduling of the thread reading the ring
+  thread_configuration thread{};
+};
+
+struct output_configuration
+{
+  std::string client_name = "libremidi client";
+
+  std::string directory = shm::default_directory;
+
+  //! Size of the ring created by a virtual port, in bytes. Rounded up to a power of two.
+  std::size_t capacity = 1 << 20;
+
+  //! File mode of the ring created by a virtual port. By default, only the processes of the
+  //! same user can attach to it. Any process which can write the ring can also corrupt it.
+  uint32_t permissions = 0600;
+};
+
+struct observer_configuration
+{
+  std::string client_name = "libremidi client";
+
+  std::string directory = shm::default_directory;
+
+  //! Period at which the directory is scanned when callbacks are set
+  std::chrono::milliseconds poll_period{100};
+
+  //! Scheduling of the thread scanning the directory
+  thread_configuration thread{};
+};
+}
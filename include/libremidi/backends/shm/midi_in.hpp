@@ -0,0 +1,205 @@
+#pragma once
+#include <libremidi/backends/shm/config.hpp>
+#include <libremidi/backends/shm/ring.hpp>
+#include <libremidi/detail/midi_in.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+
+#include <chrono>
+
+NAMESPACE_LIBREMIDI::shm
+{
+// Reads the messages of a ring: either its own, created by a virtual port
+// which other processes write to, or the source ring of another process.
+class midi_in final
+    : public midi1::in_api
+    , public error_handler
+{
+public:
+  using midi_api::client_open_;
+  struct
+      : libremidi::input_configuration
+      , shm::input_configuration
+  {
+  } configuration;
+
+  explicit midi_in(libremidi::input_configuration&& conf, shm::input_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override
+  {
+    return libremidi::API::SHARED_MEMORY;
+  }
+
+  stdx::error open_port(const input_port& port, std::string_view) override
+  {
+    auto path = ring_path(port);
+    if (!path)
+      return std::errc::invalid_argument;
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    if (auto err = m_ring.attach(*path, ring_kind::midi1, ring_direction::source);
+        err != stdx::error{})
+      return err;
+    start();
+    return stdx::error{};
+  }
+
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    if (auto err = m_ring.create(
+            configuration.directory, configuration.client_name, name, ring_kind::midi1,
+            ring_direction::sink, configuration.capacity, configuration.permissions);
+        err != stdx::error{})
+      return err;
+    start();
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    m_reader.stop();
+    m_ring.close();
+    return stdx::error{};
+  }
+
+  timestamp absolute_timestamp() const noexcept override
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+private:
+  void start()
+  {
+    m_reader.start(
+        m_ring, configuration.busy_wait, configuration.thread,
+        [this](int64_t ts, auto bytes) { on_message(ts, bytes); });
+  }
+
+  // Each record is a complete message, stamped by the writer on the monotonic clock
+  void on_message(int64_t ts, std::span<const uint8_t> bytes)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = true,
+        .absolute_is_monotonic = true,
+        .has_samples = false,
+    };
+
+    if (!bytes.empty())
+      m_processing.on_bytes(
+          bytes, m_processing.timestamp<timestamp_info>([ts] { return ts; }, 0));
+  }
+
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+  ring m_ring;
+  ring_reader m_reader;
+};
+}
+
+NAMESPACE_LIBREMIDI::shm_ump
+{
+class midi_in final
+    : public midi2::in_api
+    , public error_handler
+{
+public:
+  using midi_api::client_open_;
+  struct
+      : libremidi::ump_input_configuration
+      , shm_ump::input_configuration
+  {
+  } configuration;
+
+  explicit midi_in(
+      libremidi::ump_input_configuration&& conf, shm_ump::input_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_in() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override
+  {
+    return libremidi::API::SHARED_MEMORY_UMP;
+  }
+
+  stdx::error open_port(const input_port& port, std::string_view) override
+  {
+    auto path = shm::ring_path(port);
+    if (!path)
+      return std::errc::invalid_argument;
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    if (auto err = m_ring.attach(*path, shm::ring_kind::ump, shm::ring_direction::source);
+        err != stdx::error{})
+      return err;
+    start();
+    return stdx::error{};
+  }
+
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    if (auto err = m_ring.create(
+            configuration.directory, configuration.client_name, name, shm::ring_kind::ump,
+            shm::ring_direction::sink, configuration.capacity, configuration.permissions);
+        err != stdx::error{})
+      return err;
+    start();
+    return stdx::error{};
+  }
+
+  stdx::error close_port() override
+  {
+    m_reader.stop();
+    m_ring.close();
+    return stdx::error{};
+  }
+
+  timestamp absolute_timestamp() const noexcept override
+  {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+private:
+  void start()
+  {
+    m_reader.start(
+        m_ring, configuration.busy_wait, configuration.thread,
+        [this](int64_t ts, auto bytes) { on_ump(ts, bytes); });
+  }
+
+  // The UMP words are in native byte order: both ends run on the same host
+  void on_ump(int64_t ts, std::span<const uint8_t> bytes)
+  {
+    static constexpr timestamp_backend_info timestamp_info{
+        .has_absolute_timestamps = true,
+        .absolute_is_monotonic = true,
+        .has_samples = false,
+    };
+
+    const std::span<const uint32_t> words{
+        reinterpret_cast<const uint32_t*>(bytes.data()), bytes.size() / 4};
+    m_processing.on_bytes_multi(
+        words, m_processing.timestamp<timestamp_info>([ts] { return ts; }, 0));
+  }
+
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
+  shm::ring m_ring;
+  shm::ring_reader m_reader;
+};
+}
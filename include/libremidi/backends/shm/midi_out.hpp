@@ -0,0 +1,174 @@
+#pragma once
+#include <libremidi/backends/shm/config.hpp>
+#include <libremidi/backends/shm/ring.hpp>
+#include <libremidi/detail/midi_out.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+
+NAMESPACE_LIBREMIDI::shm
+{
+//! Timestamp carried by a record: the monotonic time at which the message is due
+LIBREMIDI_STATIC int64_t record_timestamp(uint32_t timestamps, int64_t ts) noexcept
+{
+  switch (timestamps)
+  {
+    case timestamp_mode::Relative:
+      return system_ns() + ts;
+    case timestamp_mode::Absolute:
+    case timestamp_mode::SystemMonotonic:
+      return ts;
+    default:
+      return system_ns();
+  }
+}
+
+// Writes messages to a ring: either its own, created by a virtual port
+// which other processes read, or the sink ring of another process.
+// Writing never blocks: messages that do not fit are dropped with no_buffer_space.
+class midi_out final
+    : public midi1::out_api
+    , public error_handler
+{
+public:
+  struct
+      : libremidi::output_configuration
+      , shm::output_configuration
+  {
+  } configuration;
+
+  midi_out(libremidi::output_configuration&& conf, shm::output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_out() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override
+  {
+    return libremidi::API::SHARED_MEMORY;
+  }
+
+  stdx::error open_port(const output_port& port, std::string_view) override
+  {
+    auto path = ring_path(port);
+    if (!path)
+      return std::errc::invalid_argument;
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    return m_ring.attach(*path, ring_kind::midi1, ring_direction::sink);
+  }
+
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    return m_ring.create(
+        configuration.directory, configuration.client_name, name, ring_kind::midi1,
+        ring_direction::source, configuration.capacity, configuration.permissions);
+  }
+
+  stdx::error close_port() override
+  {
+    m_ring.close();
+    return stdx::error{};
+  }
+
+  stdx::error send_message(const unsigned char* message, size_t size) override
+  {
+    if (!m_ring.is_open())
+      return std::errc::not_connected;
+    return m_ring.write(system_ns(), {message, size});
+  }
+
+  // The message is delivered right away, stamped with the time at which it is due
+  stdx::error schedule_message(int64_t ts, const unsigned char* message, size_t size) override
+  {
+    if (!m_ring.is_open())
+      return std::errc::not_connected;
+    return m_ring.write(record_timestamp(configuration.timestamps, ts), {message, size});
+  }
+
+  int64_t current_time() const noexcept override { return system_ns(); }
+
+private:
+  ring m_ring;
+};
+}
+
+NAMESPACE_LIBREMIDI::shm_ump
+{
+class midi_out final
+    : public midi2::out_api
+    , public error_handler
+{
+public:
+  struct
+      : libremidi::output_configuration
+      , shm_ump::output_configuration
+  {
+  } configuration;
+
+  midi_out(libremidi::output_configuration&& conf, shm_ump::output_configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+  {
+    client_open_ = stdx::error{};
+  }
+
+  ~midi_out() override { close_port(); }
+
+  libremidi::API get_current_api() const noexcept override
+  {
+    return libremidi::API::SHARED_MEMORY_UMP;
+  }
+
+  stdx::error open_port(const output_port& port, std::string_view) override
+  {
+    auto path = shm::ring_path(port);
+    if (!path)
+      return std::errc::invalid_argument;
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    return m_ring.attach(*path, shm::ring_kind::ump, shm::ring_direction::sink);
+  }
+
+  stdx::error open_virtual_port(std::string_view name) override
+  {
+    if (m_ring.is_open())
+      return std::errc::device_or_resource_busy;
+
+    return m_ring.create(
+        configuration.directory, configuration.client_name, name, shm::ring_kind::ump,
+        shm::ring_direction::source, configuration.capacity, configuration.permissions);
+  }
+
+  stdx::error close_port() override
+  {
+    m_ring.close();
+    return stdx::error{};
+  }
+
+  stdx::error send_ump(const uint32_t* message, size_t size) override
+  {
+    if (!m_ring.is_open())
+      return std::errc::not_connected;
+    return m_ring.write(system_ns(), {reinterpret_cast<const uint8_t*>(message), size * 4});
+  }
+
+  stdx::error schedule_ump(int64_t ts, const uint32_t* message, size_t size) override
+  {
+    if (!m_ring.is_open())
+      return std::errc::not_connected;
+    return m_ring.write(
+        shm::record_timestamp(configuration.timestamps, ts),
+        {reinterpret_cast<const uint8_t*>(message), size * 4});
+  }
+
+  int64_t current_time() const noexcept override { return system_ns(); }
+
+private:
+  shm::ring m_ring;
+};
+}
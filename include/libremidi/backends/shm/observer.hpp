@@ -0,0 +1,141 @@
+#pragma once
+#include <libremidi/backends/linux/helpers.hpp>
+#include <libremidi/backends/linux/thread.hpp>
+#include <libremidi/backends/shm/config.hpp>
+#include <libremidi/backends/shm/ring.hpp>
+#include <libremidi/detail/observer.hpp>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+NAMESPACE_LIBREMIDI::shm
+{
+// Lists the rings of the directory: the sources of other processes are inputs,
+// their sinks outputs. The directory is scanned periodically to notify of changes.
+template <typename Configuration, libremidi::API Api, ring_kind Kind>
+class observer_impl final
+    : public observer_api
+    , public error_handler
+{
+public:
+  struct
+      : libremidi::observer_configuration
+      , Configuration
+  {
+  } configuration;
+
+  explicit observer_impl(libremidi::observer_configuration&& conf, Configuration&& apiconf)
+      : configuration{std::move(conf), std::move(apiconf)}
+  {
+    if (!configuration.has_callbacks() || !tracked())
+      return;
+
+    check_rings(configuration.notify_in_constructor);
+    m_thread = std::thread{[this] { run(); }};
+  }
+
+  ~observer_impl()
+  {
+    m_termination_event.notify();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  libremidi::API get_current_api() const noexcept override { return Api; }
+
+  std::vector<libremidi::input_port> get_input_ports() const noexcept override
+  {
+    std::vector<libremidi::input_port> ret;
+    if (tracked())
+      for (auto& r : list_rings(configuration.directory, Kind, ring_direction::source))
+        ret.push_back({to_port_info(r)});
+    return ret;
+  }
+
+  std::vector<libremidi::output_port> get_output_ports() const noexcept override
+  {
+    std::vector<libremidi::output_port> ret;
+    if (tracked())
+      for (auto& r : list_rings(configuration.directory, Kind, ring_direction::sink))
+        ret.push_back({to_port_info(r)});
+    return ret;
+  }
+
+private:
+  // Rings are software ports
+  bool tracked() const noexcept { return configuration.track_virtual || configuration.track_any; }
+
+  port_information to_port_info(const ring_info& r) const
+  {
+    return {
+        .api = Api,
+        .client = 0,
+        .device = r.path,
+        .port = r.inode,
+        .device_name = r.client_name,
+        .port_name = r.port_name,
+        .display_name = r.port_name,
+        .type = libremidi::transport_type::software};
+  }
+
+  void run()
+  {
+    apply_thread_configuration(configuration.thread);
+    pollfd fd = m_termination_event;
+    const int timeout = static_cast<int>(std::max<int64_t>(configuration.poll_period.count(), 1));
+    for (;;)
+    {
+      if (::poll(&fd, 1, timeout) > 0 && eventfd_notifier::ready(fd))
+        break;
+      check_rings(true);
+    }
+  }
+
+  template <typename Port, typename Callback>
+  static void diff(
+      const std::vector<ring_info>& prev, const std::vector<ring_info>& next,
+      const Callback& cb, auto&& to_port)
+  {
+    if (!cb)
+      return;
+    for (auto& r : prev)
+    {
+      auto same = [&](const ring_info& n) { return n.path == r.path && n.inode == r.inode; };
+      if (std::ranges::none_of(next, same))
+        cb(Port{to_port(r)});
+    }
+  }
+
+  void check_rings(bool notify)
+  {
+    auto inputs = list_rings(configuration.directory, Kind, ring_direction::source);
+    auto outputs = list_rings(configuration.directory, Kind, ring_direction::sink);
+    auto to_port = [this](const ring_info& r) { return to_port_info(r); };
+
+    diff<input_port>(m_inputs, inputs, configuration.input_removed, to_port);
+    diff<output_port>(m_outputs, outputs, configuration.output_removed, to_port);
+    if (notify)
+    {
+      diff<input_port>(inputs, m_inputs, configuration.input_added, to_port);
+      diff<output_port>(outputs, m_outputs, configuration.output_added, to_port);
+    }
+
+    m_inputs = std::move(inputs);
+    m_outputs = std::move(outputs);
+  }
+
+  eventfd_notifier m_termination_event{};
+  std::thread m_thread;
+  std::vector<ring_info> m_inputs, m_outputs;
+};
+
+using observer
+    = observer_impl<shm::observer_configuration, libremidi::API::SHARED_MEMORY, ring_kind::midi1>;
+}
+
+NAMESPACE_LIBREMIDI::shm_ump
+{
+using observer = shm::observer_impl<
+    shm_ump::observer_configuration, libremidi::API::SHARED_MEMORY_UMP, shm::ring_kind::ump>;
+}
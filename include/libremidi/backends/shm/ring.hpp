@@ -0,0 +1,573 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/error.hpp>
+#include <libremidi/port_information.hpp>
+#include <libremidi/backends/linux/thread.hpp>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Single-producer, single-consumer ring of timestamped messages in a shared memory file.
+// The process creating the ring is one end of it, the process attaching to it the other:
+// a "source" ring is written by its creator, a "sink" ring is read by its creator.
+NAMESPACE_LIBREMIDI::shm
+{
+enum class ring_kind : uint32_t
+{
+  midi1 = 1,
+  ump = 2,
+};
+
+enum class ring_direction : uint32_t
+{
+  source = 1,
+  sink = 2,
+};
+
+struct ring_header
+{
+  static constexpr uint32_t magic_value = 0x4C524D53; // "LRMS"
+  static constexpr uint32_t current_version = 1;
+
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  ring_kind kind;
+  ring_direction direction;
+  uint64_t capacity;
+  int32_t creator_pid;
+  char client_name[128];
+  char port_name[128];
+
+  // Written by the producer only
+  alignas(64) std::atomic<uint64_t> write_index;
+  std::atomic<uint64_t> dropped;
+
+  // Written by the consumer only
+  alignas(64) std::atomic<uint64_t> read_index;
+
+  // Futex word, bumped after every write, and the sleeping consumers
+  alignas(64) std::atomic<uint32_t> sequence;
+  std::atomic<uint32_t> waiting;
+
+  std::atomic<int32_t> peer_pid;
+  std::atomic<uint32_t> closed;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(std::is_standard_layout_v<ring_header>);
+
+//! The fields of a ring header read from its file without mapping it,
+//! as plain values instead of through the atomics of the mapped header
+struct ring_file_header
+{
+  uint32_t magic{};
+  ring_kind kind{};
+  ring_direction direction{};
+  int32_t creator_pid{};
+  uint32_t closed{};
+  std::string client_name;
+  std::string port_name;
+
+  static std::optional<ring_file_header> read(int fd)
+  {
+    alignas(ring_header) unsigned char bytes[sizeof(ring_header)];
+    if (::pread(fd, bytes, sizeof(bytes), 0) != sizeof(bytes))
+      return std::nullopt;
+
+    const auto field = [&bytes]<typename T>(std::size_t offset, T& value) {
+      std::memcpy(&value, bytes + offset, sizeof(T));
+    };
+    const auto text = [&bytes](std::size_t offset, std::size_t size) {
+      const auto begin = reinterpret_cast<const char*>(bytes + offset);
+      return std::string(begin, ::strnlen(begin, size));
+    };
+
+    ring_file_header h;
+    field(offsetof(ring_header, magic), h.magic);
+    field(offsetof(ring_header, kind), h.kind);
+    field(offsetof(ring_header, direction), h.direction);
+    field(offsetof(ring_header, creator_pid), h.creator_pid);
+    field(offsetof(ring_header, closed), h.closed);
+    h.client_name = text(offsetof(ring_header, client_name), sizeof(ring_header::client_name));
+    h.port_name = text(offsetof(ring_header, port_name), sizeof(ring_header::port_name));
+    return h;
+  }
+};
+
+//! Every message is preceded by its size and timestamp, and padded to 8 bytes
+struct record_header
+{
+  static constexpr uint32_t wrap = UINT32_MAX;
+
+  uint32_t size;
+  uint32_t reserved;
+  int64_t timestamp;
+};
+
+LIBREMIDI_STATIC constexpr std::size_t record_size(std::size_t payload) noexcept
+{
+  return sizeof(record_header) + ((payload + 7) & ~std::size_t(7));
+}
+
+LIBREMIDI_STATIC void futex_wake(std::atomic<uint32_t>& word) noexcept
+{
+  ::syscall(
+      SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+LIBREMIDI_STATIC void futex_wait(
+    std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) noexcept
+{
+  timespec ts{
+      .tv_sec = static_cast<time_t>(timeout.count() / 1'000'000'000),
+      .tv_nsec = static_cast<long>(timeout.count() % 1'000'000'000)};
+  ::syscall(
+      SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+LIBREMIDI_STATIC bool process_alive(int32_t pid) noexcept
+{
+  return pid > 0 && (::kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+LIBREMIDI_STATIC std::string_view ring_suffix(ring_kind kind, ring_direction dir) noexcept
+{
+  if (kind == ring_kind::midi1)
+    return dir == ring_direction::source ? ".midi1.source" : ".midi1.sink";
+  else
+    return dir == ring_direction::source ? ".ump.source" : ".ump.sink";
+}
+
+//! A mapped ring, either end of it
+class ring
+{
+public:
+  ring() = default;
+  ring(const ring&) = delete;
+  ring& operator=(const ring&) = delete;
+  ~ring() { close(); }
+
+  //! Creates the file of a new ring and becomes its source or sink.
+  //! permissions is the mode of the file: see input_configuration::permissions.
+  stdx::error create(
+      const std::string& directory, std::string_view client_name, std::string_view port_name,
+      ring_kind kind, ring_direction dir, std::size_t capacity, uint32_t permissions = 0600)
+  {
+    if (port_name.empty() || port_name.size() >= sizeof(ring_header::port_name))
+      return std::errc::invalid_argument;
+
+    std::error_code fs_ec;
+    std::filesystem::create_directories(directory, fs_ec);
+
+    // Slashes would escape the directory
+    std::string file{port_name};
+    std::ranges::replace(file, '/', '_');
+    const auto path = directory + "/" + file + std::string{ring_suffix(kind, dir)};
+
+    capacity = std::bit_ceil(std::max<std::size_t>(capacity, 4096));
+    const auto size = sizeof(ring_header) + capacity;
+
+    const auto mode = static_cast<mode_t>(permissions & 0666);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (fd < 0 && errno == EEXIST && remove_stale(path))
+      fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (fd < 0)
+      return errno == EEXIST ? std::errc::address_in_use : static_cast<std::errc>(errno);
+
+    // The mode asked for, regardless of our umask
+    ::fchmod(fd, mode);
+    if (::ftruncate(fd, static_cast<off_t>(size)) < 0 || !map(fd, size))
+    {
+      const auto err = static_cast<std::errc>(errno);
+      ::close(fd);
+      ::unlink(path.c_str());
+      return err;
+    }
+    ::close(fd);
+
+    // The header is constructed here: the other process only maps it once it is published
+    m_header = ::new (static_cast<void*>(m_header)) ring_header{};
+    auto& h = *m_header;
+    h.version = ring_header::current_version;
+    h.kind = kind;
+    h.direction = dir;
+    h.capacity = capacity;
+    m_capacity = capacity;
+    h.creator_pid = ::getpid();
+    client_name = client_name.substr(0, sizeof(h.client_name) - 1);
+    std::copy(client_name.begin(), client_name.end(), h.client_name);
+    std::copy(port_name.begin(), port_name.end(), h.port_name);
+
+    // Published last: a ring is only valid once its header is complete
+    h.magic.store(ring_header::magic_value, std::memory_order_release);
+
+    m_path = path;
+    m_creator = true;
+    m_producer = dir == ring_direction::source;
+    return stdx::error{};
+  }
+
+  //! Attaches to the other end of an existing ring: a single process may do so at a time
+  stdx::error attach(const std::string& path, ring_kind kind, ring_direction dir)
+  {
+    const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+      return std::errc::no_such_device;
+
+    struct stat st{};
+    if (::fstat(fd, &st) < 0 || std::size_t(st.st_size) < sizeof(ring_header)
+        || !map(fd, st.st_size))
+    {
+      ::close(fd);
+      return std::errc::no_such_device;
+    }
+    ::close(fd);
+
+    auto& h = *m_header;
+    if (h.magic.load(std::memory_order_acquire) != ring_header::magic_value
+        || h.version != ring_header::current_version || h.kind != kind || h.direction != dir
+        || h.capacity + sizeof(ring_header) > m_size || !std::has_single_bit(h.capacity)
+        || h.closed.load())
+    {
+      unmap();
+      return std::errc::no_such_device;
+    }
+
+    int32_t peer = h.peer_pid.load();
+    const int32_t self = ::getpid();
+    do
+    {
+      if (peer != 0 && process_alive(peer))
+      {
+        unmap();
+        return std::errc::device_or_resource_busy;
+      }
+    } while (!h.peer_pid.compare_exchange_weak(peer, self));
+
+    m_creator = false;
+    m_producer = dir == ring_direction::sink;
+    m_capacity = h.capacity;
+
+    // What was written before is not for us
+    if (!m_producer)
+      h.read_index.store(h.write_index.load());
+    return stdx::error{};
+  }
+
+  //! Detaches; the creator also removes the file and lets its peer know
+  void close() noexcept
+  {
+    if (!m_header)
+      return;
+
+    if (m_creator)
+    {
+      m_header->closed.store(1);
+      m_header->sequence.fetch_add(1);
+      futex_wake(m_header->sequence);
+      ::unlink(m_path.c_str());
+    }
+    else
+    {
+      m_header->peer_pid.store(0);
+    }
+    unmap();
+    m_path.clear();
+  }
+
+  bool is_open() const noexcept { return m_header != nullptr; }
+  ring_header* header() const noexcept { return m_header; }
+  const std::string& path() const noexcept { return m_path; }
+
+  //! Producer: appends a message, or counts it as dropped if the consumer is behind
+  stdx::error write(int64_t timestamp, std::span<const uint8_t> payload) noexcept
+  {
+    auto& h = *m_header;
+    if (h.closed.load(std::memory_order_relaxed))
+      return std::errc::not_connected;
+
+    // Nobody listens to our source yet
+    if (m_creator && h.peer_pid.load(std::memory_order_relaxed) == 0)
+      return stdx::error{};
+
+    const auto cap = m_capacity;
+    const auto need = record_size(payload.size());
+    if (need > cap / 2)
+      return std::errc::message_size;
+
+    uint64_t w = h.write_index.load(std::memory_order_relaxed);
+    const uint64_t r = h.read_index.load(std::memory_order_acquire);
+    auto offset = w & (cap - 1);
+    const auto contiguous = cap - offset;
+    const auto total = need + (contiguous < need ? contiguous : 0);
+    if (w - r > cap || cap - (w - r) < total)
+    {
+      h.dropped.fetch_add(1, std::memory_order_relaxed);
+      return std::errc::no_buffer_space;
+    }
+
+    if (contiguous < need)
+    {
+      // Records do not span the end of the ring. An end too short for the marker is
+      // skipped without it.
+      if (contiguous >= sizeof(record_header))
+      {
+        record_header wrap{.size = record_header::wrap, .reserved = 0, .timestamp = 0};
+        std::memcpy(data() + offset, &wrap, sizeof(wrap));
+      }
+      w += contiguous;
+      offset = 0;
+    }
+
+    record_header rec{
+        .size = static_cast<uint32_t>(payload.size()), .reserved = 0, .timestamp = timestamp};
+    std::memcpy(data() + offset, &rec, sizeof(rec));
+    if (!payload.empty())
+      std::memcpy(data() + offset + sizeof(rec), payload.data(), payload.size());
+
+    h.write_index.store(w + need, std::memory_order_seq_cst);
+    h.sequence.fetch_add(1, std::memory_order_seq_cst);
+    if (h.waiting.load(std::memory_order_seq_cst) != 0)
+      futex_wake(h.sequence);
+    return stdx::error{};
+  }
+
+  //! Consumer: calls f(timestamp, payload) for every available message, read in place.
+  //! Returns the number of messages read.
+  //! The other process can write anything in the ring: if its indices or records do not
+  //! make sense, what it wrote is skipped.
+  template <typename F>
+  std::size_t read(F&& f)
+  {
+    auto& h = *m_header;
+    const auto cap = m_capacity;
+    uint64_t r = h.read_index.load(std::memory_order_relaxed);
+    const uint64_t w = h.write_index.load(std::memory_order_acquire);
+    if (w - r > cap)
+      r = w;
+
+    std::size_t count = 0;
+    while (r != w)
+    {
+      const auto offset = r & (cap - 1);
+      const auto contiguous = cap - offset;
+      // An end of the ring too short for a header is skipped like a wrap marker
+      record_header rec{.size = record_header::wrap, .reserved = 0, .timestamp = 0};
+      if (contiguous >= sizeof(record_header))
+        std::memcpy(&rec, data() + offset, sizeof(rec));
+
+      // A record past what was written, or past the end of the ring, is corrupted
+      const auto size = rec.size == record_header::wrap ? contiguous : record_size(rec.size);
+      if (size > w - r || size > contiguous)
+      {
+        r = w;
+        break;
+      }
+      if (rec.size == record_header::wrap)
+      {
+        r += size;
+        continue;
+      }
+
+      f(rec.timestamp, std::span<const uint8_t>{data() + offset + sizeof(rec), rec.size});
+      r += size;
+      count++;
+    }
+
+    h.read_index.store(r, std::memory_order_release);
+    return count;
+  }
+
+  bool empty() const noexcept
+  {
+    return m_header->read_index.load(std::memory_order_relaxed)
+           == m_header->write_index.load(std::memory_order_seq_cst);
+  }
+
+  bool is_producer() const noexcept { return m_producer; }
+
+private:
+  bool map(int fd, std::size_t size) noexcept
+  {
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return false;
+    m_header = static_cast<ring_header*>(p);
+    m_size = size;
+    return true;
+  }
+
+  void unmap() noexcept
+  {
+    ::munmap(m_header, m_size);
+    m_header = nullptr;
+    m_size = 0;
+  }
+
+  // A ring left over by a process which does not exist anymore
+  static bool remove_stale(const std::string& path) noexcept
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+
+    const auto h = ring_file_header::read(fd);
+    ::close(fd);
+    if (h && h->magic == ring_header::magic_value && process_alive(h->creator_pid))
+      return false;
+    return ::unlink(path.c_str()) == 0;
+  }
+
+  uint8_t* data() const noexcept { return reinterpret_cast<uint8_t*>(m_header + 1); }
+
+  ring_header* m_header{};
+  std::size_t m_size{};
+
+  // Validated when mapped: the header of the ring can be changed by the other process
+  std::size_t m_capacity{};
+  std::string m_path;
+  bool m_creator{};
+  bool m_producer{};
+};
+
+//! Thread consuming a ring: polls it for busy_wait, then sleeps on its futex
+class ring_reader
+{
+public:
+  ~ring_reader() { stop(); }
+
+  template <typename F>
+  void start(
+      ring& r, std::chrono::microseconds busy_wait, const thread_configuration& thread,
+      F on_message)
+  {
+    m_ring = &r;
+    m_stop.store(false);
+    m_thread = std::thread{[this, busy_wait, thread, f = std::move(on_message)]() mutable {
+      apply_thread_configuration(thread);
+      run(busy_wait, f);
+    }};
+  }
+
+  void stop()
+  {
+    if (!m_thread.joinable())
+      return;
+
+    m_stop.store(true);
+    auto& h = *m_ring->header();
+    h.sequence.fetch_add(1);
+    futex_wake(h.sequence);
+    m_thread.join();
+  }
+
+private:
+  template <typename F>
+  void run(std::chrono::microseconds busy_wait, F& on_message)
+  {
+    using clock = std::chrono::steady_clock;
+    auto& h = *m_ring->header();
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+      const uint32_t seq = h.sequence.load(std::memory_order_acquire);
+      if (m_ring->read(on_message) > 0)
+        continue;
+
+      if (busy_wait.count() > 0)
+      {
+        const auto until = clock::now() + busy_wait;
+        while (m_ring->empty() && clock::now() < until && !m_stop.load(std::memory_order_relaxed))
+          std::this_thread::yield();
+        if (!m_ring->empty())
+          continue;
+      }
+
+      h.waiting.fetch_add(1, std::memory_order_seq_cst);
+      if (m_ring->empty() && !m_stop.load())
+        futex_wait(h.sequence, seq, std::chrono::milliseconds(100));
+      h.waiting.fetch_sub(1, std::memory_order_seq_cst);
+    }
+  }
+
+  ring* m_ring{};
+  std::atomic_bool m_stop{};
+  std::thread m_thread;
+};
+
+//! The ring of a port, as listed by the observer
+LIBREMIDI_STATIC const std::string* ring_path(const port_information& port) noexcept
+{
+  return get_if<std::string>(&port.device);
+}
+
+struct ring_info
+{
+  std::string path;
+  uint64_t inode{};
+  std::string client_name;
+  std::string port_name;
+};
+
+//! The valid rings of a directory, whose creator still runs
+LIBREMIDI_STATIC std::vector<ring_info>
+list_rings(const std::string& directory, ring_kind kind, ring_direction dir)
+{
+  std::vector<ring_info> res;
+  std::error_code ec;
+  const auto suffix = ring_suffix(kind, dir);
+  for (auto& entry : std::filesystem::directory_iterator{directory, ec})
+  {
+    auto path = entry.path().string();
+    if (!path.ends_with(suffix))
+      continue;
+
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    auto h = ring_file_header::read(fd);
+    struct stat st{};
+    const bool complete = h && ::fstat(fd, &st) == 0;
+    ::close(fd);
+
+    if (!complete || h->magic != ring_header::magic_value || h->kind != kind
+        || h->direction != dir || h->closed || !process_alive(h->creator_pid))
+      continue;
+
+    res.push_back(
+        {.path = std::move(path),
+         .inode = static_cast<uint64_t>(st.st_ino),
+         .client_name = std::move(h->client_name),
+         .port_name = std::move(h->port_name)});
+  }
+
+  std::ranges::sort(res, {}, &ring_info::path);
+  return res;
+}
+}
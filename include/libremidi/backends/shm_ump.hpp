@@ -0,0 +1,25 @@
+#pragma once
+#include <libremidi/backends/shm/config.hpp>
+#include <libremidi/backends/shm/midi_in.hpp>
+#include <libremidi/backends/shm/midi_out.hpp>
+#include <libremidi/backends/shm/observer.hpp>
+
+#include <string_view>
+
+NAMESPACE_LIBREMIDI::shm_ump
+{
+struct backend
+{
+  using midi_in = shm_ump::midi_in;
+  using midi_out = shm_ump::midi_out;
+  using midi_observer = shm_ump::observer;
+  using midi_in_configuration = shm_ump::input_configuration;
+  using midi_out_configuration = shm_ump::output_configuration;
+  using midi_observer_configuration = shm_ump::observer_configuration;
+  static const constexpr auto API = libremidi::API::SHARED_MEMORY_UMP;
+  static const constexpr std::string_view name = "shared_memory_ump";
+  static const constexpr std::string_view display_name = "Shared memory (UMP)";
+
+  static inline bool available() noexcept { return true; }
+};
+}
@@ -280,7 +280,8 @@ private:
 #if LIBREMIDI_WINMIDI_HAS_VIRTUAL_DEVICE
   winrt::Microsoft::Windows::Devices::Midi2::Endpoints::Virtual::MidiVirtualDevice m_virtual{nullptr};
 #endif
-  midi2::input_state_machine m_processing{this->configuration};
+  midi2::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
   int m_group_filter = -1;
 };
 }
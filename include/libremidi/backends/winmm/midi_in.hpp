@@ -465,7 +465,8 @@ private:
 
   std::chrono::steady_clock::time_point midi_start_timestamp;
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 
 }
@@ -93,6 +93,7 @@ private:
   winrt::Windows::Devices::Midi::IMidiInPort port_{nullptr};
   std::chrono::steady_clock::time_point midi_start_timestamp;
 
-  midi1::input_state_machine m_processing{this->configuration};
+  midi1::input_state_machine m_processing{
+      this->configuration, &this->counters, &this->clock_tracker, &this->timecode_assembler};
 };
 }
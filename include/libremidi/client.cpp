@@ -14,14 +14,16 @@ NAMESPACE_LIBREMIDI
 {
 LIBREMIDI_INLINE
 shared_configurations
-create_shared_context(const libremidi::API api, [[maybe_unused]] std::string_view client_name)
+create_shared_context(
+    const libremidi::API api, [[maybe_unused]] std::string_view client_name,
+    [[maybe_unused]] const thread_configuration& thread)
 {
   switch (api)
   {
 #if __has_include(<boost/lockfree/spsc_queue.hpp>)
   #if defined(LIBREMIDI_ALSA)
     case libremidi::API::ALSA_SEQ:
-      return alsa_seq::shared_handler::make(client_name);
+      return alsa_seq::shared_handler::make(client_name, thread);
   #endif
 
   #if defined(LIBREMIDI_JACK)
@@ -56,13 +56,17 @@ struct client_configuration
 
   //! Observe software (virtual) ports if the API provides it
   uint32_t track_virtual : 1 = false;
+
+  //! Scheduling of the thread which reads the events of the shared client,
+  //! for the backends where libremidi starts one (ALSA sequencer)
+  thread_configuration thread{};
 };
 
 class client
 {
 public:
   explicit client(const client_configuration& conf)
-      : client{conf, create_shared_context(conf.api, conf.client_name)}
+      : client{conf, create_shared_context(conf.api, conf.client_name, conf.thread)}
   {
   }
 
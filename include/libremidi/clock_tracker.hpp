@@ -0,0 +1,243 @@
+#pragma once
+#include <libremidi/config.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numbers>
+
+NAMESPACE_LIBREMIDI
+{
+//! Tempo and transport of a MIDI clock source, as estimated by midi_clock_tracker
+struct clock_state
+{
+  //! Between Start or Continue and Stop
+  bool running{};
+
+  //! Whether enough clock ticks were received to estimate the tempo
+  bool locked{};
+
+  //! Quarter notes per minute
+  double bpm{};
+
+  //! Song position at the last tick, in quarter notes: Song Position Pointer and ticks
+  //! received while running, 24 per quarter note
+  double beats{};
+
+  //! Timestamp of the last tick, in nanoseconds, on the clock of the input timestamps
+  int64_t last_tick{};
+
+  //! Position in the current quarter note, in [0, 1)
+  [[nodiscard]] double phase() const noexcept { return beats - std::floor(beats); }
+
+  //! Song position extrapolated at a later time, while running
+  [[nodiscard]] double beats_at(int64_t time_ns) const noexcept
+  {
+    if (!running || !locked)
+      return beats;
+    return beats + static_cast<double>(time_ns - last_tick) * bpm / 60e9;
+  }
+};
+
+//! A low-rate notification of the clock tracker: transport changes, and one per beat
+struct clock_event
+{
+  enum kind_t : uint8_t
+  {
+    //! A quarter note started, while running
+    beat,
+
+    //! The tempo, once per quarter note worth of ticks, while stopped
+    tempo,
+
+    start,
+    stop,
+
+    //! Continue
+    resume,
+
+    //! Song Position Pointer
+    position,
+  } kind{};
+
+  clock_state state;
+};
+
+using clock_callback = std::function<void(const clock_event&)>;
+
+//! Follows the MIDI clock (0xF8), Start, Stop, Continue and Song Position Pointer
+//! messages of an input, to give a tempo and a song position instead of 24 ticks per
+//! quarter note.
+//!
+//! The tick period is smoothed with a second-order delay-locked loop, which rejects the
+//! jitter of the transport and of the sender while following tempo changes.
+//! The input thread updates the state without locking, state() can be called from any thread.
+class midi_clock_tracker
+{
+public:
+  static constexpr int ticks_per_beat = 24;
+
+  //! Bandwidth of the loop, in Hz: lower is smoother, higher follows tempo changes faster
+  static constexpr double bandwidth_hz = 1.0;
+
+  //! A tick this far from the expected time, in periods, restarts the estimation
+  static constexpr double max_error = 4.0;
+
+  //! Ticks before the estimate is considered locked
+  static constexpr int lock_ticks = ticks_per_beat;
+
+  //! Processes a message received at time_ns, if it is a clock or transport message
+  void process(
+      uint8_t status, uint8_t data1, uint8_t data2, int64_t time_ns, const clock_callback& cb)
+  {
+    switch (status)
+    {
+      case 0xF8:
+        return tick(time_ns, cb);
+      case 0xFA:
+        m_ticks = 0;
+        m_first_tick = true;
+        m_running = true;
+        return notify(clock_event::start, cb);
+      case 0xFB:
+        m_first_tick = true;
+        m_running = true;
+        return notify(clock_event::resume, cb);
+      case 0xFC:
+        m_running = false;
+        return notify(clock_event::stop, cb);
+      case 0xF2:
+        // In MIDI beats: sixteenth notes, i.e. 6 ticks
+        m_ticks = 6 * ((data1 & 0x7F) | ((data2 & 0x7F) << 7));
+        return notify(clock_event::position, cb);
+      default:
+        return;
+    }
+  }
+
+  //! A consistent snapshot of the state
+  [[nodiscard]] clock_state state() const noexcept
+  {
+    clock_state s;
+    uint32_t seq0{}, seq1{};
+    do
+    {
+      seq0 = m_seq.load(std::memory_order_acquire);
+      s.running = m_shared_running.load(std::memory_order_relaxed);
+      s.locked = m_shared_locked.load(std::memory_order_relaxed);
+      s.bpm = m_shared_bpm.load(std::memory_order_relaxed);
+      s.beats = m_shared_beats.load(std::memory_order_relaxed);
+      s.last_tick = m_shared_last_tick.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      seq1 = m_seq.load(std::memory_order_relaxed);
+    } while (seq0 != seq1 || (seq0 & 1));
+    return s;
+  }
+
+private:
+  void tick(int64_t t, const clock_callback& cb)
+  {
+    m_last_tick = t;
+    if (m_count == 0)
+    {
+      m_count = 1;
+    }
+    else if (m_count == 1)
+    {
+      // Second tick: the first period initializes the loop
+      m_period = static_cast<double>(t - m_t0);
+      if (m_period > 0.)
+      {
+        m_t1 = static_cast<double>(t) + m_period;
+        m_count = 2;
+      }
+    }
+    else
+    {
+      const double error = static_cast<double>(t) - m_t1;
+      if (std::abs(error) > max_error * m_period)
+      {
+        // The clock was stopped, or jumped: start again from this tick
+        m_count = 1;
+        m_period = 0.;
+      }
+      else
+      {
+        // Loop coefficients for an update every tick
+        const double omega = 2. * std::numbers::pi * bandwidth_hz * m_period * 1e-9;
+        const double b = std::numbers::sqrt2 * omega;
+        const double c = omega * omega;
+
+        m_t1 += b * error + m_period;
+        m_period += c * error;
+        m_count++;
+      }
+    }
+    m_t0 = t;
+
+    bool boundary = false;
+    if (m_running)
+    {
+      if (m_first_tick)
+        m_first_tick = false;
+      else
+        m_ticks++;
+      boundary = m_ticks % ticks_per_beat == 0;
+    }
+    else
+    {
+      boundary = ++m_stopped_ticks % ticks_per_beat == 0;
+    }
+
+    if (boundary)
+      notify(m_running ? clock_event::beat : clock_event::tempo, cb);
+    else
+      publish();
+  }
+
+  void notify(clock_event::kind_t kind, const clock_callback& cb)
+  {
+    publish();
+    if (cb)
+      cb(clock_event{.kind = kind, .state = state()});
+  }
+
+  void publish() noexcept
+  {
+    const bool locked = m_count > lock_ticks;
+    const uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_shared_running.store(m_running, std::memory_order_relaxed);
+    m_shared_locked.store(locked, std::memory_order_relaxed);
+    m_shared_bpm.store(
+        locked ? 60e9 / (m_period * ticks_per_beat) : 0., std::memory_order_relaxed);
+    m_shared_beats.store(
+        static_cast<double>(m_ticks) / ticks_per_beat, std::memory_order_relaxed);
+    m_shared_last_tick.store(m_last_tick, std::memory_order_relaxed);
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  // Input thread
+  int64_t m_ticks{};
+  int64_t m_stopped_ticks{};
+  int64_t m_last_tick{};
+  bool m_running{};
+  bool m_first_tick{};
+
+  // Loop filter: time of the last tick, expected time of the next one, tick period
+  int64_t m_t0{};
+  double m_t1{};
+  double m_period{};
+  int m_count{};
+
+  // Published state
+  std::atomic<uint32_t> m_seq{};
+  std::atomic<bool> m_shared_running{};
+  std::atomic<bool> m_shared_locked{};
+  std::atomic<double> m_shared_bpm{};
+  std::atomic<double> m_shared_beats{};
+  std::atomic<int64_t> m_shared_last_tick{};
+};
+}
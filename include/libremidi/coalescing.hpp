@@ -0,0 +1,338 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/message.hpp>
+#include <libremidi/ump.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+NAMESPACE_LIBREMIDI
+{
+//! Whether only the latest value of a control change matters.
+//! Bank select, RPN / NRPN selection and data entry, switch pedals and channel mode
+//! messages have effects which depend on every value, in order: they are never coalesced.
+constexpr bool is_continuous_controller(int cc) noexcept
+{
+  switch (cc)
+  {
+    case 0:  // Bank select
+    case 6:  // Data entry
+    case 32: // Bank select LSB
+    case 38: // Data entry LSB
+      return false;
+    default:
+      if (cc >= 64 && cc <= 69) // Sustain, portamento, sostenuto, soft, legato, hold 2
+        return false;
+      if (cc >= 96 && cc <= 101) // Data increment / decrement, NRPN, RPN
+        return false;
+      return cc < 120; // Channel mode messages
+  }
+}
+
+//! The messages of a batch (a call to dispatch(), a read from the queue, a JACK cycle...)
+//! of which only the latest value per (group, channel, controller or note) is kept:
+//! control changes, pitch bend, channel and polyphonic pressure, MIDI 2 per-note pitch bend.
+//! Notes, SysEx and the other channel and system messages are kept in order: the values
+//! before them are never replaced by the ones after. Realtime messages pass through.
+class coalescing_table
+{
+public:
+  //! The message is kept, and separates the values before it from the ones after
+  static constexpr int barrier = -1;
+
+  //! The message is kept, and does not interact with the others
+  static constexpr int pass = -2;
+
+  //! CC, polyphonic pressure and per-note pitch bend per note, pitch bend, channel pressure
+  static constexpr int keys_per_channel = 128 + 128 + 128 + 1 + 1;
+  static constexpr int midi1_keys = 16 * keys_per_channel;
+  static constexpr int ump_keys = 16 * midi1_keys;
+
+  //! The key of a MIDI 1 message
+  static constexpr int key(uint8_t status, uint8_t data1) noexcept
+  {
+    if (status >= 0xF8)
+      return pass;
+    if (status < 0x80 || status >= 0xF0)
+      return barrier;
+
+    const int channel = (status & 0x0F) * keys_per_channel;
+    const int note = data1 & 0x7F;
+    switch (status >> 4)
+    {
+      case 0xA:
+        return channel + 128 + note;
+      case 0xB:
+        return is_continuous_controller(note) ? channel + note : barrier;
+      case 0xD:
+        return channel + 385;
+      case 0xE:
+        return channel + 384;
+      default:
+        return barrier;
+    }
+  }
+
+  //! The key of a UMP, from its first word
+  static constexpr int key(uint32_t word) noexcept
+  {
+    const int group = static_cast<int>((word >> 24) & 0x0F) * midi1_keys;
+    const auto status = static_cast<uint8_t>(word >> 16);
+    const auto index = static_cast<uint8_t>(word >> 8);
+    switch (word >> 28)
+    {
+      case 0x0: // Utility: NOOP, JR clock and timestamps
+        return pass;
+      case 0x1: // System
+        return status >= 0xF8 ? pass : barrier;
+      case 0x2: { // MIDI 1 channel voice
+        const int k = key(status, index);
+        return k >= 0 ? group + k : k;
+      }
+      case 0x4: { // MIDI 2 channel voice
+        if ((status >> 4) == 0x6) // Per-note pitch bend
+          return group + (status & 0x0F) * keys_per_channel + 256 + (index & 0x7F);
+        const int k = key(status, index);
+        return k >= 0 ? group + k : k;
+      }
+      default:
+        return barrier;
+    }
+  }
+
+  static int key(const message& msg) noexcept
+  {
+    if (msg.bytes.empty())
+      return pass;
+    return key(msg.bytes[0], msg.bytes.size() > 1 ? msg.bytes[1] : 0);
+  }
+
+  static int key(const ump& msg) noexcept { return key(msg.data[0]); }
+
+  explicit coalescing_table(int keys)
+      : m_slots{std::make_unique<uint32_t[]>(static_cast<std::size_t>(keys))}
+      , m_keys{keys}
+  {
+  }
+
+  //! Starts a batch, which is then scanned from its end with keep()
+  void begin() noexcept
+  {
+    // The slots are compared with sequence numbers: restart them long before they wrap
+    if (m_seq >= std::numeric_limits<uint32_t>::max() / 2)
+    {
+      std::fill_n(m_slots.get(), m_keys, 0);
+      m_seq = 0;
+    }
+    m_segment = ++m_seq;
+  }
+
+  //! Whether the message with this key is kept: it is, unless it is followed by a
+  //! message with the same key before the next barrier
+  bool keep(int key) noexcept
+  {
+    if (key == barrier)
+    {
+      m_segment = ++m_seq;
+      return true;
+    }
+    if (key < 0)
+      return true;
+
+    auto& slot = m_slots[key];
+    if (slot > m_segment)
+      return false;
+    slot = ++m_seq;
+    return true;
+  }
+
+  //! Coalesces msgs in place, keeping their order. Returns the number of messages kept,
+  //! moved at the start of msgs.
+  template <typename T>
+  std::size_t coalesce(std::span<T> msgs) noexcept
+  {
+    begin();
+    std::size_t first = msgs.size();
+    for (std::size_t i = msgs.size(); i-- > 0;)
+    {
+      if (keep(key(msgs[i])) && --first != i)
+        msgs[first] = std::move(msgs[i]);
+    }
+    std::move(msgs.begin() + first, msgs.end(), msgs.begin());
+    return msgs.size() - first;
+  }
+
+private:
+  std::unique_ptr<uint32_t[]> m_slots;
+  int m_keys{};
+
+  uint32_t m_seq{};
+  uint32_t m_segment{};
+};
+
+//! Null unless enabled
+template <typename T>
+inline std::unique_ptr<coalescing_table> make_coalescing_table(bool enabled)
+{
+  if (!enabled)
+    return {};
+  if constexpr (std::is_same_v<T, ump>)
+    return std::make_unique<coalescing_table>(coalescing_table::ump_keys);
+  else
+    return std::make_unique<coalescing_table>(coalescing_table::midi1_keys);
+}
+
+//! The messages of a process cycle, coalesced before being written (PipeWire outputs) or
+//! passed to on_message (JACK and PipeWire inputs). Preallocated: no allocation in the cycle.
+template <typename T>
+class cycle_batch
+{
+public:
+  static constexpr std::size_t capacity = 1024;
+
+  cycle_batch()
+      : m_table{make_coalescing_table<T>(true)}
+      , m_messages(capacity)
+  {
+  }
+
+  [[nodiscard]] bool full() const noexcept { return m_size == capacity; }
+
+  //! Where the next message is stored, see push()
+  T& next() noexcept { return m_messages[m_size]; }
+
+  //! Adds the message stored in next()
+  void push() noexcept { m_size++; }
+
+  void push(T&& msg) noexcept
+  {
+    next() = std::move(msg);
+    push();
+  }
+
+  //! Coalesces the messages, and returns the kept ones
+  std::span<T> coalesce() noexcept
+  {
+    m_size = m_table->coalesce(std::span<T>{m_messages}.first(m_size));
+    return std::span<T>{m_messages}.first(m_size);
+  }
+
+  //! Removes the first n messages, once they are handled
+  void consume(std::size_t n) noexcept
+  {
+    std::move(m_messages.begin() + n, m_messages.begin() + m_size, m_messages.begin());
+    m_size -= n;
+  }
+
+private:
+  std::unique_ptr<coalescing_table> m_table;
+  std::vector<T> m_messages;
+  std::size_t m_size{};
+};
+
+//! For the inputs read from a queue with coalesce_controllers: midi_in::try_read reads what
+//! is queued as one batch, coalesced like the ones of midi_in::poll, and hands it out a
+//! message at a time. Preallocated: reading does not allocate.
+template <typename T>
+class read_ahead_batch
+{
+public:
+  static constexpr std::size_t capacity = 1024;
+
+  read_ahead_batch()
+      : m_messages(capacity)
+  {
+  }
+
+  //! read(std::span<T>) moves queued messages into the span and returns their count
+  template <typename Read>
+  bool try_read(coalescing_table& table, T& msg, Read&& read) noexcept
+  {
+    if (m_first == m_size)
+    {
+      const std::span<T> batch{m_messages};
+      m_first = 0;
+      m_size = table.coalesce(batch.first(read(batch)));
+      if (m_size == 0)
+        return false;
+    }
+    msg = std::move(m_messages[m_first++]);
+    return true;
+  }
+
+  //! Moves the messages read ahead and not handed out yet, which come before the queued ones
+  std::size_t take(std::span<T> msgs) noexcept
+  {
+    const auto n = std::min(msgs.size(), m_size - m_first);
+    std::move(m_messages.begin() + m_first, m_messages.begin() + m_first + n, msgs.begin());
+    m_first += n;
+    return n;
+  }
+
+private:
+  std::vector<T> m_messages;
+  std::size_t m_first{};
+  std::size_t m_size{};
+};
+
+//! Null unless enabled
+template <typename T>
+inline std::unique_ptr<read_ahead_batch<T>> make_read_ahead_batch(bool enabled)
+{
+  return enabled ? std::make_unique<read_ahead_batch<T>>() : nullptr;
+}
+
+//! For the inputs which receive their messages a process cycle at a time (JACK, PipeWire)
+//! and pass them to on_message: the messages of each cycle are collected, and flush() passes
+//! the kept ones at the end of the cycle.
+template <typename T>
+class cycle_coalescer
+{
+public:
+  //! Null unless conf has coalesce_controllers and neither a queue nor manual dispatch,
+  //! which coalesce their own batches. Otherwise, takes over conf.on_message.
+  template <typename Configuration>
+  static std::unique_ptr<cycle_coalescer> install(Configuration& conf)
+  {
+    if (!conf.coalesce_controllers || conf.queue_size != 0 || conf.manual_dispatch
+        || !conf.on_message)
+      return {};
+
+    auto self = std::make_unique<cycle_coalescer>(std::move(conf.on_message));
+    conf.on_message = [self = self.get()](T&& msg) { self->collect(std::move(msg)); };
+    return self;
+  }
+
+  explicit cycle_coalescer(std::function<void(T&&)> on_message)
+      : m_on_message{std::move(on_message)}
+  {
+  }
+
+  void collect(T&& msg)
+  {
+    if (m_batch.full())
+      flush();
+    m_batch.push(std::move(msg));
+  }
+
+  void flush()
+  {
+    auto kept = m_batch.coalesce();
+    for (auto& msg : kept)
+      m_on_message(std::move(msg));
+    m_batch.consume(kept.size());
+  }
+
+private:
+  std::function<void(T&&)> m_on_message;
+  cycle_batch<T> m_batch;
+};
+}
@@ -17,6 +17,7 @@
 #include <libremidi/backends/pipewire/config.hpp>
 #include <libremidi/backends/pipewire_ump/config.hpp>
 #include <libremidi/backends/rawio/config.hpp>
+#include <libremidi/backends/shm/config.hpp>
 #include <libremidi/backends/winmidi/config.hpp>
 #include <libremidi/backends/winmm/config.hpp>
 #include <libremidi/backends/winuwp/config.hpp>
@@ -42,7 +43,8 @@ using input_api_configuration = libremidi_variant_alias::variant<
     pipewire_input_configuration, rawio_input_configuration, rawio_ump_input_configuration,
     winmidi::input_configuration, winmm_input_configuration,
     winuwp_input_configuration, jack_ump::input_configuration, pipewire_ump::input_configuration,
-    android::input_configuration, libremidi::API>;
+    android::input_configuration, shm::input_configuration, shm_ump::input_configuration,
+    libremidi::API>;
 
 using output_api_configuration = libremidi_variant_alias::variant<
     unspecified_configuration, dummy_configuration, alsa_raw_output_configuration,
@@ -54,7 +56,8 @@ using output_api_configuration = libremidi_variant_alias::variant<
     rawio_output_configuration, rawio_ump_output_configuration,
     winmidi::output_configuration, winmm_output_configuration, winuwp_output_configuration,
     jack_ump::output_configuration, pipewire_ump::output_configuration,
-    android::output_configuration, libremidi::API>;
+    android::output_configuration, shm::output_configuration, shm_ump::output_configuration,
+    libremidi::API>;
 
 using observer_api_configuration = libremidi_variant_alias::variant<
     unspecified_configuration, dummy_configuration, alsa_raw_observer_configuration,
@@ -67,7 +70,8 @@ using observer_api_configuration = libremidi_variant_alias::variant<
     rawio_ump_observer_configuration, winmidi::observer_configuration,
     winmm_observer_configuration,
     winuwp_observer_configuration, jack_ump::observer_configuration,
-    pipewire_ump::observer_configuration, android::observer_configuration, libremidi::API>;
+    pipewire_ump::observer_configuration, android::observer_configuration,
+    shm::observer_configuration, shm_ump::observer_configuration, libremidi::API>;
 
 LIBREMIDI_EXPORT
 libremidi::API midi_api(const input_api_configuration& conf);
@@ -0,0 +1,237 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/coalescing.hpp>
+#include <libremidi/input_queue.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <span>
+
+NAMESPACE_LIBREMIDI
+{
+namespace coro
+{
+//! A coroutine to resume. It lives in the frame of the coroutine,
+//! so that scheduling it does not allocate.
+struct resumption
+{
+  std::coroutine_handle<> handle;
+  resumption* next{};
+};
+
+//! Something which resumes coroutines, from any thread
+template <typename T>
+concept scheduler = requires(T& s, resumption& r) { s.schedule(r); };
+
+//! Resumes the coroutine right away, on the thread of the backend which received the
+//! message, as on_message would be called
+struct inline_scheduler
+{
+  void schedule(resumption& r) const noexcept { r.handle.resume(); }
+};
+
+//! Resumes the coroutines from the thread which calls poll() or run().
+//! Scheduling does not lock nor allocate: the backend threads push the coroutines
+//! to a lock-free list, and only wake up run() through a futex.
+class single_thread_executor
+{
+public:
+  single_thread_executor() = default;
+  single_thread_executor(const single_thread_executor&) = delete;
+  single_thread_executor(single_thread_executor&&) = delete;
+  single_thread_executor& operator=(const single_thread_executor&) = delete;
+  single_thread_executor& operator=(single_thread_executor&&) = delete;
+
+  void schedule(resumption& r) noexcept
+  {
+    r.next = m_head.load(std::memory_order_relaxed);
+    while (!m_head.compare_exchange_weak(
+        r.next, &r, std::memory_order_release, std::memory_order_relaxed))
+      ;
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+  }
+
+  //! Resumes the coroutines scheduled so far, in order, and returns their count
+  std::size_t poll()
+  {
+    resumption* lifo = m_head.exchange(nullptr, std::memory_order_acquire);
+    resumption* fifo = nullptr;
+    while (lifo)
+    {
+      auto next = lifo->next;
+      lifo->next = fifo;
+      fifo = lifo;
+      lifo = next;
+    }
+
+    std::size_t n = 0;
+    while (fifo)
+    {
+      // The resumption is destroyed once the coroutine runs
+      auto handle = fifo->handle;
+      fifo = fifo->next;
+      handle.resume();
+      n++;
+    }
+    return n;
+  }
+
+  //! Resumes the coroutines as they are scheduled, until stop() is called
+  void run()
+  {
+    while (!m_stop.load(std::memory_order_acquire))
+    {
+      const uint32_t signal = m_signal.load(std::memory_order_acquire);
+      if (poll() == 0 && !m_stop.load(std::memory_order_acquire))
+        m_signal.wait(signal, std::memory_order_acquire);
+    }
+  }
+
+  //! Makes run() return. Can be called from any thread, or from a coroutine.
+  void stop() noexcept
+  {
+    m_stop.store(true, std::memory_order_release);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_all();
+  }
+
+private:
+  std::atomic<resumption*> m_head{};
+  std::atomic<uint32_t> m_signal{};
+  std::atomic_bool m_stop{};
+};
+
+//! Resumes the coroutines on an Asio executor, e.g. the one of an io_context or of a
+//! Boost.Cobalt coroutine: co_await cobalt::this_coro::executor.
+//! Posting a coroutine allocates its handler through the executor.
+template <typename Executor>
+struct asio_scheduler
+{
+  Executor executor;
+
+  // Found through ADL: Asio is not included here
+  void schedule(resumption& r) const { post(executor, [h = r.handle] { h.resume(); }); }
+};
+
+template <typename Executor>
+asio_scheduler(Executor) -> asio_scheduler<Executor>;
+
+//! A coroutine which starts right away and is destroyed when it finishes
+struct detached
+{
+  struct promise_type
+  {
+    detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept { }
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+// Suspends the coroutine until the queue has messages
+template <typename T, typename Scheduler>
+class input_awaitable_base : input_queue_waiter
+{
+public:
+  input_awaitable_base(input_queue<T>* queue, Scheduler&& sched) noexcept
+      : input_queue_waiter{&input_awaitable_base::on_wake}
+      , m_queue{queue}
+      , m_scheduler{static_cast<Scheduler&&>(sched)}
+  {
+  }
+
+  input_awaitable_base(const input_awaitable_base&) = delete;
+  input_awaitable_base& operator=(const input_awaitable_base&) = delete;
+
+  ~input_awaitable_base()
+  {
+    // The coroutine was destroyed while waiting
+    if (m_waiting)
+      m_queue->cancel_wait(*this);
+  }
+
+  bool await_ready() const noexcept { return !m_queue || !m_queue->empty(); }
+
+  bool await_suspend(std::coroutine_handle<> h) noexcept
+  {
+    m_resumption.handle = h;
+    m_waiting = true;
+
+    // Once registered, the coroutine may already be running on another thread:
+    // this must not be accessed anymore
+    if (m_queue->wait(*this))
+      return true;
+
+    m_waiting = false;
+    return false;
+  }
+
+protected:
+  input_queue<T>* m_queue{};
+  bool m_waiting{};
+
+private:
+  static void on_wake(input_queue_waiter& w) noexcept
+  {
+    auto& self = static_cast<input_awaitable_base&>(w);
+    self.m_scheduler.schedule(self.m_resumption);
+  }
+
+  Scheduler m_scheduler;
+  resumption m_resumption;
+};
+
+//! co_await resumes with the next message of the queue.
+//! Without a queue, resumes right away with an empty message.
+template <typename T, typename Scheduler>
+class input_awaitable : public input_awaitable_base<T, Scheduler>
+{
+public:
+  using input_awaitable_base<T, Scheduler>::input_awaitable_base;
+
+  T await_resume() noexcept
+  {
+    this->m_waiting = false;
+    T msg{};
+    if (this->m_queue)
+      this->m_queue->try_read(msg);
+    return msg;
+  }
+};
+
+//! co_await resumes once the queue has messages, with the number of messages
+//! moved into the buffer, after coalescing if enabled. Without a queue, resumes right away
+//! with zero.
+template <typename T, typename Scheduler>
+class input_batch_awaitable : public input_awaitable_base<T, Scheduler>
+{
+public:
+  input_batch_awaitable(
+      input_queue<T>* queue, std::span<T> batch, coalescing_table* coalescing,
+      Scheduler&& sched) noexcept
+      : input_awaitable_base<T, Scheduler>{queue, static_cast<Scheduler&&>(sched)}
+      , m_batch{batch}
+      , m_coalescing{coalescing}
+  {
+  }
+
+  std::size_t await_resume() noexcept
+  {
+    this->m_waiting = false;
+    if (!this->m_queue)
+      return 0;
+    const auto n = this->m_queue->poll(m_batch);
+    return m_coalescing ? m_coalescing->coalesce(m_batch.first(n)) : n;
+  }
+
+private:
+  std::span<T> m_batch;
+  coalescing_table* m_coalescing{};
+};
+}
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <libremidi/config.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+NAMESPACE_LIBREMIDI
+{
+//! Maps the timestamps of a backend clock (ALSA sequencer queue time, PipeWire graph
+//! position, network peer time...) onto the monotonic clock of the process,
+//! from pairs of (backend timestamp, monotonic time at which the event was seen).
+//!
+//! The observation times are late by the varying delivery latency, never early:
+//! each window of backend time only keeps its least delayed observation, and a linear
+//! regression over the last windows gives the offset and drift between the clocks.
+//! A jump of the backend clock (queue restart, xrun...) restarts the estimation.
+class clock_correlator
+{
+public:
+  //! Duration of the windows, in backend time
+  static constexpr int64_t window_ns = 100'000'000;
+
+  //! Windows in the regression: a few seconds of history
+  static constexpr int windows = 32;
+
+  //! Mismatch from the estimate above which the backend clock is considered to have jumped
+  static constexpr int64_t reset_threshold_ns = 500'000'000;
+
+  //! Bound on the estimated drift, against short or degenerate histories
+  static constexpr double max_drift = 1e-3;
+
+  //! Records an event stamped backend_ns by the backend, and seen at monotonic_ns
+  void observe(int64_t backend_ns, int64_t monotonic_ns) noexcept
+  {
+    if (m_valid)
+    {
+      const int64_t error = monotonic_ns - to_monotonic(backend_ns);
+      if (error > reset_threshold_ns || error < -reset_threshold_ns)
+        reset();
+    }
+
+    const point p{backend_ns, monotonic_ns - backend_ns};
+    if (!m_valid)
+    {
+      m_current = p;
+      m_valid = true;
+    }
+    else if (backend_ns - m_current.x >= window_ns || backend_ns < m_current.x)
+    {
+      // Close the window, and start the next one with this event
+      m_points[m_head] = m_current;
+      m_head = (m_head + 1) % windows;
+      m_count = std::min(m_count + 1, windows);
+      m_current = p;
+    }
+    else if (p.delay < m_current.delay)
+    {
+      m_current = p;
+      if (m_count > 0)
+        return;
+    }
+    else
+    {
+      return;
+    }
+
+    fit();
+  }
+
+  //! The monotonic time corresponding to a backend timestamp.
+  //! Without observations, the timestamp is returned as is.
+  [[nodiscard]] int64_t to_monotonic(int64_t backend_ns) const noexcept
+  {
+    if (!m_valid)
+      return backend_ns;
+    const double dx = static_cast<double>(backend_ns - m_origin);
+    return backend_ns + m_offset + static_cast<int64_t>(std::llround(m_drift * dx));
+  }
+
+  //! Whether some events were observed since the start or the last jump
+  [[nodiscard]] bool valid() const noexcept { return m_valid; }
+
+  //! Monotonic time minus backend time, at the last observation
+  [[nodiscard]] int64_t offset_ns() const noexcept
+  {
+    return m_valid ? to_monotonic(m_current.x) - m_current.x : 0;
+  }
+
+  //! Rate difference of the monotonic clock against the backend clock,
+  //! in parts per million: positive when the backend clock runs slow
+  [[nodiscard]] double drift_ppm() const noexcept { return m_drift * 1e6; }
+
+  void reset() noexcept
+  {
+    m_head = 0;
+    m_count = 0;
+    m_valid = false;
+    m_origin = 0;
+    m_offset = 0;
+    m_drift = 0.;
+  }
+
+private:
+  struct point
+  {
+    int64_t x{};     // backend time
+    int64_t delay{}; // monotonic time - backend time
+  };
+
+  // Least squares of the delays against the backend time, over the closed windows:
+  // the current one may only have seen a few late events yet.
+  void fit() noexcept
+  {
+    if (m_count == 0)
+    {
+      m_origin = m_current.x;
+      m_offset = m_current.delay;
+      m_drift = 0.;
+      return;
+    }
+
+    // Centered on the last closed window
+    const point& last = m_points[(m_head + windows - 1) % windows];
+    m_origin = last.x;
+
+    double mx = 0., my = 0.;
+    for (int i = 0; i < m_count; i++)
+    {
+      mx += static_cast<double>(m_points[i].x - last.x);
+      my += static_cast<double>(m_points[i].delay - last.delay);
+    }
+    mx /= m_count;
+    my /= m_count;
+
+    double sxx = 0., sxy = 0.;
+    for (int i = 0; i < m_count; i++)
+    {
+      const double dx = static_cast<double>(m_points[i].x - last.x) - mx;
+      const double dy = static_cast<double>(m_points[i].delay - last.delay) - my;
+      sxx += dx * dx;
+      sxy += dx * dy;
+    }
+
+    m_drift = sxx > 0. ? std::clamp(sxy / sxx, -max_drift, max_drift) : 0.;
+    m_offset = last.delay + static_cast<int64_t>(std::llround(my - m_drift * mx));
+  }
+
+  std::array<point, windows> m_points{};
+  int m_head{};
+  int m_count{};
+
+  // Least delayed observation of the current window
+  point m_current{};
+  bool m_valid{};
+
+  // monotonic = backend + offset + drift * (backend - origin)
+  int64_t m_origin{};
+  int64_t m_offset{};
+  double m_drift{};
+};
+}
@@ -2,6 +2,7 @@
 #include <libremidi/api.hpp>
 #include <libremidi/config.hpp>
 #include <libremidi/error.hpp>
+#include <libremidi/port_counters.hpp>
 
 #include <string_view>
 
@@ -31,6 +32,9 @@ public:
   bool is_port_open() const noexcept { return port_open_; }
   bool is_port_connected() const noexcept { return connected_; }
 
+  //! Updated by the backend and its input state machine
+  atomic_port_counters counters;
+
 protected:
   friend class midi_in;
   friend class midi_out;
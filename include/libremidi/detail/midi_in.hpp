@@ -1,8 +1,10 @@
 #pragma once
+#include <libremidi/clock_tracker.hpp>
 #include <libremidi/detail/midi_api.hpp>
 #include <libremidi/error_handler.hpp>
 #include <libremidi/input_configuration.hpp>
 #include <libremidi/observer_configuration.hpp>
+#include <libremidi/protocols/mtc.hpp>
 
 NAMESPACE_LIBREMIDI
 {
@@ -20,6 +22,17 @@ public:
   open_port(const input_port& pt, std::string_view local_port_name)
       = 0;
   [[nodiscard]] virtual timestamp absolute_timestamp() const noexcept = 0;
+
+  //! With manual_dispatch, for the backends driven by the application: a descriptor
+  //! readable when dispatch() has events to process. -1 for the other backends.
+  [[nodiscard]] virtual int descriptor() const noexcept { return -1; }
+
+  //! Processes the pending events without blocking
+  virtual stdx::error dispatch() { return std::errc::operation_not_supported; }
+
+  //! Fed by the input state machine when track_clock and track_timecode are set
+  midi_clock_tracker clock_tracker;
+  mtc_assembler timecode_assembler;
 };
 
 namespace midi1
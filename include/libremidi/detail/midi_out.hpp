@@ -37,6 +37,8 @@ public:
   {
     return send_ump(ump, size);
   }
+
+  virtual stdx::error flush() { return stdx::error{}; }
 };
 
 namespace midi1
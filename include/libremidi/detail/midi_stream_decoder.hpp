@@ -1,9 +1,15 @@
 #pragma once
 
+#include <libremidi/clock_tracker.hpp>
 #include <libremidi/cmidi2.hpp>
+#include <libremidi/detail/clock_correlator.hpp>
 #include <libremidi/detail/conversion.hpp>
 #include <libremidi/detail/midi_in.hpp>
+#include <libremidi/detail/ump_stream.hpp>
+#include <libremidi/jr_timestamps.hpp>
+#include <libremidi/protocols/mtc.hpp>
 
+#include <algorithm>
 #include <cmath>
 
 #include <chrono>
@@ -36,11 +42,58 @@ struct input_state_machine_base
 {
   const Configuration& configuration;
 
-  explicit input_state_machine_base(const Configuration& conf)
+  //! The events dropped by the parser are counted in the counters of the backend, if given.
+  //! With track_clock and track_timecode, the clock, transport and MTC messages are passed
+  //! to the clock tracker and MTC assembler.
+  explicit input_state_machine_base(
+      const Configuration& conf, atomic_port_counters* counters = nullptr,
+      midi_clock_tracker* clock = nullptr, mtc_assembler* timecode = nullptr)
       : configuration{conf}
+      , counters{counters}
+      , clock{clock}
+      , timecode{timecode}
   {
   }
 
+  //! Before the filtering: the clock is tracked even if ignore_timing discards it
+  void track_clock(uint8_t status, uint8_t data1, uint8_t data2, int64_t timestamp)
+  {
+    if (!clock || !configuration.track_clock)
+      return;
+    if (status != 0xF8 && status != 0xFA && status != 0xFB && status != 0xFC && status != 0xF2)
+      return;
+    clock->process(status, data1, data2, tracking_time(timestamp), configuration.on_clock);
+  }
+
+  //! A quarter frame, or a SysEx which may be a full frame message
+  void track_timecode(std::span<const uint8_t> bytes, int64_t timestamp)
+  {
+    if (!timecode || !configuration.track_timecode)
+      return;
+    timecode->process(bytes, tracking_time(timestamp), configuration.on_timecode);
+  }
+
+  //! The trackers need a time in nanoseconds
+  int64_t tracking_time(int64_t timestamp) const noexcept
+  {
+    switch (configuration.timestamps)
+    {
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        if (timestamp != 0)
+          return timestamp;
+        [[fallthrough]];
+      default:
+        return system_ns();
+    }
+  }
+
+  void count(std::atomic<uint64_t> atomic_port_counters::* counter) const noexcept
+  {
+    if (counters)
+      atomic_port_counters::add(counters->*counter);
+  }
+
   template <timestamp_backend_info info>
   int64_t timestamp(auto to_ns, int64_t samples)
   {
@@ -82,6 +135,8 @@ struct input_state_machine_base
       case timestamp_mode::SystemMonotonic:
         if constexpr (info.absolute_is_monotonic)
           return to_ns();
+        else if constexpr (info.has_absolute_timestamps)
+          return correlated_ns(to_ns());
         else
           return system_ns();
 
@@ -95,8 +150,24 @@ struct input_state_machine_base
         return configuration.get_timestamp(to_ns());
     }
   }
+
+  // The backend clock mapped onto the monotonic clock: an event cannot have happened
+  // after it was received. 0 is an event the backend could not stamp, e.g. with raw I/O.
+  int64_t correlated_ns(int64_t backend_ns) noexcept
+  {
+    const int64_t now = system_ns();
+    if (backend_ns == 0)
+      return now;
+    clock_correlation.observe(backend_ns, now);
+    return std::min(clock_correlation.to_monotonic(backend_ns), now);
+  }
+
+  atomic_port_counters* counters{};
+  midi_clock_tracker* clock{};
+  mtc_assembler* timecode{};
   int64_t last_time_ns = 0;
   bool first_message = true;
+  clock_correlator clock_correlation;
 };
 
 namespace midi1
@@ -118,11 +189,11 @@ struct input_state_machine : input_state_machine_base<input_configuration>
   }
 
   // Function to process a byte stream which may contain multiple successive
-  // MIDI events (CoreMIDI, ALSA Sequencer can work like this)
+  // MIDI events (CoreMIDI, ALSA Sequencer can work like this).
+  // The stream is segmented even without on_message: it drives the trackers and counters.
   void on_bytes_multi(std::span<const uint8_t> bytes, int64_t timestamp)
   {
-    if (this->configuration.on_message)
-      on_bytes_multi_segmented(this->configuration.on_message, bytes, timestamp);
+    on_bytes_multi_segmented(this->configuration.on_message, bytes, timestamp);
     if (this->configuration.on_raw_data)
       this->configuration.on_raw_data(bytes, timestamp);
   }
@@ -131,8 +202,7 @@ struct input_state_machine : input_state_machine_base<input_configuration>
   // e.g. a midi channel event or a single sysex
   void on_bytes(std::span<const uint8_t> bytes, int64_t timestamp)
   {
-    if (this->configuration.on_message)
-      on_bytes_segmented(this->configuration.on_message, bytes, timestamp);
+    on_bytes_segmented(this->configuration.on_message, bytes, timestamp);
     if (this->configuration.on_raw_data)
       this->configuration.on_raw_data(bytes, timestamp);
   }
@@ -158,7 +228,12 @@ private:
           // byte.
           const auto status = bytes[i_byte];
           if (!(status & 0x80))
+          {
+            count(&atomic_port_counters::malformed);
             break;
+          }
+          if (status >= 0xF0)
+            track(bytes.subspan(i_byte), timestamp);
 
           // Determine the number of bytes in the MIDI message.
           if (status < 0xC0)
@@ -171,6 +246,7 @@ private:
           {
             if (configuration.ignore_sysex)
             {
+              count(&atomic_port_counters::filtered);
               size = 0;
               i_byte = n_bytes;
             }
@@ -193,8 +269,10 @@ private:
             // A MIDI time code message
             if (configuration.ignore_timing)
             {
-              size = 0;
-              i_byte += 2;
+              // Dropped whole, even when the packet ends before its data byte
+              count(&atomic_port_counters::filtered);
+              i_byte = std::min<int64_t>(i_byte + 2, n_bytes);
+              continue;
             }
             else
             {
@@ -210,6 +288,7 @@ private:
             // A MIDI timing tick message
             if (configuration.ignore_timing)
             {
+              count(&atomic_port_counters::filtered);
               size = 0;
               i_byte += 1;
             }
@@ -223,6 +302,7 @@ private:
             // A MIDI active sensing message
             if (configuration.ignore_sensing)
             {
+              count(&atomic_port_counters::filtered);
               size = 0;
               i_byte += 1;
             }
@@ -237,6 +317,13 @@ private:
             size = 1;
           }
 
+          // The packet ends before the data bytes of the message
+          if (i_byte + size > n_bytes)
+          {
+            count(&atomic_port_counters::truncated);
+            break;
+          }
+
           // Now process the actual bytes of the message
           if (size > 0)
           {
@@ -244,9 +331,7 @@ private:
             message.assign(begin, begin + size);
             message.timestamp = timestamp;
 
-            cb(std::move(message));
-            message.clear();
-
+            deliver(cb);
             i_byte += size;
           }
         }
@@ -268,10 +353,7 @@ private:
     {
       message.insert(message.end(), bytes.begin(), bytes.end());
       if (finished_sysex)
-      {
-        cb(std::move(message));
-        message.clear();
-      }
+        deliver(cb);
     }
     return;
   }
@@ -280,6 +362,7 @@ private:
       const message_callback& cb, std::span<const uint8_t> bytes, int64_t timestamp,
       bool finished_sysex)
   {
+    track(bytes, timestamp);
     switch (bytes[0])
     {
       // SYSEX start
@@ -287,15 +370,16 @@ private:
         if (!finished_sysex)
           m_state = in_sysex;
 
-        if (!this->configuration.ignore_sysex)
+        if (this->configuration.ignore_sysex)
+        {
+          count(&atomic_port_counters::filtered);
+        }
+        else
         {
           message.assign(bytes.begin(), bytes.end());
           message.timestamp = timestamp;
           if (finished_sysex)
-          {
-            cb(std::move(message));
-            message.clear();
-          }
+            deliver(cb);
         }
 
         return;
@@ -304,12 +388,12 @@ private:
       case 0xF1:
       case 0xF8:
         if (this->configuration.ignore_timing)
-          return;
+          return count(&atomic_port_counters::filtered);
         break;
 
       case 0xFE:
         if (this->configuration.ignore_sensing)
-          return;
+          return count(&atomic_port_counters::filtered);
         break;
 
       default:
@@ -318,11 +402,25 @@ private:
 
     message.assign(bytes.begin(), bytes.end());
     message.timestamp = timestamp;
+    deliver(cb);
+  }
 
-    cb(std::move(message));
+  void deliver(const message_callback& cb)
+  {
+    if (cb)
+      cb(std::move(message));
     message.clear();
   }
 
+  void track(std::span<const uint8_t> bytes, int64_t timestamp)
+  {
+    if (bytes[0] == 0xF0 || bytes[0] == 0xF1)
+      return track_timecode(bytes, timestamp);
+
+    const auto at = [bytes](std::size_t i) -> uint8_t { return i < bytes.size() ? bytes[i] : 0; };
+    track_clock(bytes[0], at(1), at(2), timestamp);
+  }
+
   void
   on_bytes_segmented(const message_callback& cb, std::span<const uint8_t> bytes, int64_t timestamp)
   {
@@ -366,18 +464,19 @@ public:
     return on_bytes_multi({ptr, sz}, timestamp);
   }
 
+  // The stream is segmented even without on_message: it drives the trackers and counters
   void on_bytes_multi(std::span<const uint32_t> bytes, int64_t timestamp)
   {
-    if (this->configuration.on_message)
-      on_bytes_multi_segmented(this->configuration.on_message, bytes, timestamp);
+    m_jr.begin();
+    on_bytes_multi_segmented(this->configuration.on_message, bytes, timestamp);
     if (this->configuration.on_raw_data)
       this->configuration.on_raw_data(bytes, timestamp);
   }
 
   void on_bytes(std::span<const uint32_t> bytes, int64_t timestamp)
   {
-    if (this->configuration.on_message)
-      on_bytes_segmented(this->configuration.on_message, bytes, timestamp);
+    m_jr.begin();
+    on_bytes_segmented(this->configuration.on_message, bytes, timestamp);
     if (this->configuration.on_raw_data)
       this->configuration.on_raw_data(bytes, timestamp);
   }
@@ -388,26 +487,34 @@ private:
   void on_bytes_multi_segmented(
       const ump_callback& cb, std::span<const uint32_t> bytes, int64_t timestamp)
   {
-    auto count = bytes.size();
-    auto ump_stream = bytes.data();
-    while (count > 0)
-    {
-      // Handle NOOP (or padding)
-      while (count > 0 && ump_stream[0] == 0)
-      {
-        count--;
-        ump_stream++;
-      }
-
-      if (count == 0)
-        break;
-
-      const auto ump_uints = cmidi2_ump_get_num_bytes(ump_stream[0]) / 4;
-      on_bytes_segmented(cb, {ump_stream, ump_stream + ump_uints}, timestamp);
+    // The message types which are dropped whole are filtered while walking the stream
+    const uint32_t dropped = filtered_types();
+    const auto read = for_each_ump_packet(bytes, [&](const uint32_t* packet, uint32_t words) {
+      if ((dropped >> (packet[0] >> 28)) & 1)
+        this->count(&atomic_port_counters::filtered);
+      else
+        on_bytes_segmented(cb, {packet, words}, timestamp);
+      return true;
+    });
+
+    if (read < bytes.size())
+      this->count(&atomic_port_counters::truncated);
+  }
 
-      ump_stream += ump_uints;
-      count -= ump_uints;
+  uint32_t filtered_types() const noexcept
+  {
+    uint32_t types = 0;
+    // Still looked at for the JR Clock and JR Timestamp messages
+    if (this->configuration.ignore_timing && !this->configuration.jr_timestamps)
+      types |= 1 << CMIDI2_MESSAGE_TYPE_UTILITY;
+    if (this->configuration.ignore_sysex)
+    {
+      types |= 1 << CMIDI2_MESSAGE_TYPE_SYSEX8_MDS;
+      // Still looked at for the MTC full frame messages
+      if (!this->configuration.track_timecode)
+        types |= 1 << CMIDI2_MESSAGE_TYPE_SYSEX7;
     }
+    return types;
   }
 
   // Function to process bytes corresponding to at most one midi event
@@ -418,14 +525,26 @@ private:
     switch (cmidi2_ump_get_message_type(bytes.data()))
     {
       case CMIDI2_MESSAGE_TYPE_UTILITY: {
+        if (this->configuration.jr_timestamps)
+          m_jr.process(bytes[0], this->tracking_time(timestamp));
+
         // All the utility messages are about timing
         if (this->configuration.ignore_timing)
-          return;
+          return count(&atomic_port_counters::filtered);
         break;
       }
 
       case CMIDI2_MESSAGE_TYPE_SYSTEM: {
         auto status = cmidi2_ump_get_status_byte(bytes.data());
+        if (status == CMIDI2_SYSTEM_STATUS_MIDI_TIME_CODE)
+        {
+          const uint8_t qf[2]{status, static_cast<uint8_t>((bytes[0] >> 8) & 0x7F)};
+          track_timecode(qf, timestamp);
+        }
+        else
+        {
+          track_clock(status, (bytes[0] >> 8) & 0x7F, bytes[0] & 0x7F, timestamp);
+        }
         if (this->configuration.ignore_timing)
         {
           switch (status)
@@ -433,22 +552,24 @@ private:
             case CMIDI2_SYSTEM_STATUS_MIDI_TIME_CODE:
             case CMIDI2_SYSTEM_STATUS_SONG_POSITION:
             case CMIDI2_SYSTEM_STATUS_TIMING_CLOCK:
-              return;
+              return count(&atomic_port_counters::filtered);
           }
         }
 
         if (this->configuration.ignore_sensing)
         {
           if (status == CMIDI2_SYSTEM_STATUS_ACTIVE_SENSING)
-            return;
+            return count(&atomic_port_counters::filtered);
         }
         break;
       }
 
       case CMIDI2_MESSAGE_TYPE_SYSEX7:
+        track_sysex7(bytes, timestamp);
+        [[fallthrough]];
       case CMIDI2_MESSAGE_TYPE_SYSEX8_MDS: {
         if (this->configuration.ignore_sysex)
-          return;
+          return count(&atomic_port_counters::filtered);
         break;
       }
 
@@ -457,8 +578,9 @@ private:
         {
           libremidi::ump msg;
           cmidi2_ump_upgrade_midi1_channel_voice_to_midi2(bytes.data(), msg.data);
-          msg.timestamp = timestamp;
-          cb(std::move(msg));
+          msg.timestamp = sender_time(bytes[0], timestamp);
+          if (cb)
+            cb(std::move(msg));
           return;
         }
         break;
@@ -466,10 +588,70 @@ private:
     }
 
     libremidi::ump msg;
-    std::copy(bytes.begin(), bytes.end(), msg.data);
-    msg.timestamp = timestamp;
-    cb(std::move(msg));
+    std::copy_n(bytes.begin(), std::min<std::size_t>(bytes.size(), 4), msg.data);
+    msg.timestamp = sender_time(bytes[0], timestamp);
+    if (cb)
+      cb(std::move(msg));
+  }
+
+  // The time stamped by the sender with a JR Timestamp, if any, in place of the arrival time.
+  // The utility messages keep theirs: the JR Timestamp is for the messages which follow.
+  int64_t sender_time(uint32_t word, int64_t timestamp) noexcept
+  {
+    if (!this->configuration.jr_timestamps || (word >> 28) == CMIDI2_MESSAGE_TYPE_UTILITY)
+      return timestamp;
+    switch (this->configuration.timestamps)
+    {
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        return m_jr.time(this->tracking_time(timestamp));
+      default:
+        return timestamp;
+    }
+  }
+
+  // MTC full frame messages span two SysEx7 packets: they are reassembled with F0 / F7
+  void track_sysex7(std::span<const uint32_t> bytes, int64_t timestamp)
+  {
+    if (!this->timecode || !this->configuration.track_timecode || bytes.size() < 2)
+      return;
+
+    const auto status = (bytes[0] >> 16) & 0xF0;
+    const auto count = std::min<uint32_t>((bytes[0] >> 16) & 0x0F, 6);
+    if (status == CMIDI2_SYSEX_IN_ONE_UMP || status == CMIDI2_SYSEX_START)
+    {
+      m_sysex[0] = 0xF0;
+      m_sysex_size = 1;
+    }
+    else if (m_sysex_size == 0)
+    {
+      return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      if (m_sysex_size + 1 >= std::size(m_sysex))
+      {
+        // Longer than a full frame message
+        m_sysex_size = 0;
+        return;
+      }
+      const int shift = i < 2 ? 8 * (1 - i) : 8 * (5 - i);
+      m_sysex[m_sysex_size++] = (bytes[i < 2 ? 0 : 1] >> shift) & 0x7F;
+    }
+
+    if (status == CMIDI2_SYSEX_IN_ONE_UMP || status == CMIDI2_SYSEX_END)
+    {
+      m_sysex[m_sysex_size++] = 0xF7;
+      this->track_timecode({m_sysex, m_sysex_size}, timestamp);
+      m_sysex_size = 0;
+    }
   }
+
+  uint8_t m_sysex[10]{};
+  std::size_t m_sysex_size{};
+
+  jr_timestamp_decoder m_jr;
 };
 }
 }
@@ -17,6 +17,13 @@ public:
   virtual libremidi::API get_current_api() const noexcept = 0;
   virtual std::vector<libremidi::input_port> get_input_ports() const noexcept = 0;
   virtual std::vector<libremidi::output_port> get_output_ports() const noexcept = 0;
+
+  //! With manual_dispatch, for the backends driven by the application: a descriptor
+  //! readable when dispatch() has events to process. -1 for the other backends.
+  [[nodiscard]] virtual int descriptor() const noexcept { return -1; }
+
+  //! Processes the pending events without blocking
+  virtual stdx::error dispatch() { return std::errc::operation_not_supported; }
 };
 
 template <typename T, typename Arg>
@@ -2,7 +2,10 @@
 #include <libremidi/cmidi2.hpp>
 #include <libremidi/error.hpp>
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 
 NAMESPACE_LIBREMIDI
 {
@@ -13,49 +16,110 @@ enum class segmentation_error
   other
 };
 
+//! Words in a UMP packet, from its message type: the top nibble of its first word.
+//! Packed two bits per type (words - 1) so that it is computed without branches nor
+//! memory lookups, and vectorizes. The reserved message types have the sizes the UMP
+//! specification gives them, so that a stream can be walked past them.
+inline constexpr uint32_t ump_packet_words_table = [] {
+  constexpr uint8_t words[16]{1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+  uint32_t table = 0;
+  for (int type = 0; type < 16; type++)
+    table |= uint32_t(words[type] - 1) << (2 * type);
+  return table;
+}();
+
+constexpr uint32_t ump_packet_words(uint32_t first_word) noexcept
+{
+  return ((ump_packet_words_table >> ((first_word >> 28) * 2)) & 3) + 1;
+}
+
 /**
- * Utility function to segment an ump stream into individual messages.
- * Used to send a stream to APIs that work message-by-message.
+ * Calls func(const uint32_t* packet, uint32_t words) for each packet of a UMP stream,
+ * skipping the NOOP words used as padding, until func returns false.
+ *
+ * The packet sizes of a block of words are computed at once, then the block is walked
+ * with them, instead of decoding the type of each packet between two calls.
+ * Returns the size of the stream, or the offset of the packet func stopped at, or of a
+ * truncated packet at its end.
  */
-inline stdx::error
-segment_ump_stream(const uint32_t* ump_stream, int64_t count, auto write_func, auto realloc_func)
+template <typename F>
+inline std::size_t for_each_ump_packet(std::span<const uint32_t> stream, F&& func)
 {
-  while (count > 0)
+  static constexpr std::size_t block = 64;
+  const std::size_t count = stream.size();
+  const uint32_t* words = stream.data();
+  uint8_t sizes[block];
+
+  std::size_t i = 0;
+  while (i < count)
   {
-    // Handle NOOP (or padding)
-    while (count > 0 && ump_stream[0] == 0)
+    const std::size_t base = i;
+    const std::size_t n = std::min(block, count - base);
+
+    // The size of a packet starting at each word, 0 for NOOP
+    for (std::size_t k = 0; k < n; k++)
+    {
+      const uint32_t w = words[base + k];
+      sizes[k] = static_cast<uint8_t>(w == 0 ? 0 : ump_packet_words(w));
+    }
+
+    std::size_t k = 0;
+    while (k < n)
     {
-      count--;
-      ump_stream++;
+      const uint32_t size = sizes[k];
+      if (size == 0)
+      {
+        k++;
+        continue;
+      }
+      if (base + k + size > count)
+        return base + k;
+      if (!func(words + base + k, size))
+        return base + k;
+      k += size;
     }
 
-    if (count == 0)
-      break;
+    // The last packet may end in the next block
+    i = base + k;
+  }
+  return count;
+}
 
-    const auto ump_bytes = cmidi2_ump_get_num_bytes(ump_stream[0]);
+/**
+ * Utility function to segment an ump stream into individual messages.
+ * Used to send a stream to APIs that work message-by-message.
+ * A truncated packet at the end of the stream is not sent.
+ */
+inline stdx::error
+segment_ump_stream(const uint32_t* ump_stream, int64_t count, auto write_func, auto realloc_func)
+{
+  stdx::error ret{};
+  const std::span<const uint32_t> stream{ump_stream, static_cast<std::size_t>(count)};
+  for_each_ump_packet(stream, [&](const uint32_t* packet, uint32_t words) {
+    const auto ump_bytes = static_cast<int>(words * 4);
 
     // FIXME std::expected, propagate the error back to caller?
-    switch (int err = static_cast<int>(write_func(ump_stream, ump_bytes)))
+    switch (int err = static_cast<int>(write_func(packet, ump_bytes)))
     {
       case 0:
-        break;
+        return true;
       case -ENOMEM:
       case ENOMEM:
         // Try again if we didn't have enough space in the OS queue
         realloc_func();
-        if (auto err = write_func(ump_stream, ump_bytes); err != std::errc{})
-          return std::make_error_code(err);
-        break;
+        if (auto err = write_func(packet, ump_bytes); err != std::errc{})
+        {
+          ret = std::make_error_code(err);
+          return false;
+        }
+        return true;
       default:
-        return from_errc(err);
+        ret = from_errc(err);
+        return false;
     }
+  });
 
-    const auto ump_uints = ump_bytes / 4;
-    ump_stream += ump_uints;
-    count -= ump_uints;
-  }
-
-  return stdx::error{};
+  return ret;
 }
 
 }
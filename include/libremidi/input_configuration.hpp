@@ -1,7 +1,10 @@
 #pragma once
+#include <libremidi/clock_tracker.hpp>
 #include <libremidi/config.hpp>
 #include <libremidi/error.hpp>
 #include <libremidi/message.hpp>
+#include <libremidi/port_counters.hpp>
+#include <libremidi/protocols/mtc.hpp>
 #include <libremidi/ump.hpp>
 
 #include <functional>
@@ -66,6 +69,18 @@ struct input_configuration
   midi_error_callback on_error{};
   midi_warning_callback on_warning{};
 
+  //! Called from the thread of the backend when the MIDI API reports that input was lost,
+  //! e.g. an ALSA sequencer FIFO overflow. See midi_in::counters.
+  overrun_callback on_overrun{};
+
+  //! With track_clock: called from the thread of the backend on transport changes and
+  //! once per beat. See midi_clock_tracker.
+  clock_callback on_clock{};
+
+  //! With track_timecode: called from the thread of the backend when the MTC position is
+  //! locked, unlocked, located by a full frame message, and once per frame while locked.
+  mtc_callback on_timecode{};
+
   //! Specify whether certain MIDI message types should be queued or ignored
   //! during input.
   /*!
@@ -81,6 +96,33 @@ struct input_configuration
 
   //! Timestamp mode. See @libremidi::timestamp_mode
   uint32_t timestamps : 3 = timestamp_mode::Absolute;
+
+  //! If non-zero, the messages are stored in a queue of this many messages instead of being
+  //! passed to on_message, and read with midi_in::poll / midi_in::try_read.
+  //! Messages which arrive while the queue is full are dropped.
+  uint32_t queue_size{};
+
+  //! The messages are passed to on_message from midi_in::dispatch, called by the application
+  //! when midi_in::descriptor is readable, instead of from a thread of the backend.
+  //! The backends which can be driven by the application then start no thread at all.
+  bool manual_dispatch{};
+
+  //! With queue_size or manual_dispatch: in each batch of messages read with midi_in::poll,
+  //! next_batch or dispatch, only the latest value of each continuous controller, pitch bend
+  //! and pressure is kept per channel. Notes and SysEx stay ordered with the values around
+  //! them. See coalescing_table.
+  //! The JACK and PipeWire inputs otherwise coalesce each process cycle before calling
+  //! on_message. The other backends have no batch: a warning is reported.
+  bool coalesce_controllers{};
+
+  //! The tempo and song position are estimated from the MIDI clock, Start, Stop, Continue
+  //! and Song Position Pointer messages, even if ignore_timing discards them: see
+  //! midi_in::clock and on_clock. Works best with Absolute or SystemMonotonic timestamps.
+  bool track_clock{};
+
+  //! MTC quarter frames and full frame messages are assembled into a position, even if
+  //! ignore_timing or ignore_sysex discard them: see midi_in::timecode and on_timecode.
+  bool track_timecode{};
 };
 
 using ump_callback = std::function<void(ump&&)>;
@@ -109,6 +151,18 @@ struct ump_input_configuration
   midi_error_callback on_error{};
   midi_warning_callback on_warning{};
 
+  //! Called from the thread of the backend when the MIDI API reports that input was lost,
+  //! e.g. an ALSA sequencer FIFO overflow. See midi_in::counters.
+  overrun_callback on_overrun{};
+
+  //! With track_clock: called from the thread of the backend on transport changes and
+  //! once per beat. See midi_clock_tracker.
+  clock_callback on_clock{};
+
+  //! With track_timecode: called from the thread of the backend when the MTC position is
+  //! locked, unlocked, located by a full frame message, and once per frame while locked.
+  mtc_callback on_timecode{};
+
   //! Specify whether certain MIDI message types should be queued or ignored
   //! during input.
   /*!
@@ -128,5 +182,38 @@ struct ump_input_configuration
   //! Note that this only has an effect on Windows with MIDI Services
   //! as other platforms already do this by default.
   uint32_t midi1_channel_events_to_midi2 : 1 = true;
+
+  //! If non-zero, the messages are stored in a queue of this many messages instead of being
+  //! passed to on_message, and read with midi_in::poll / midi_in::try_read.
+  //! Messages which arrive while the queue is full are dropped.
+  uint32_t queue_size{};
+
+  //! The messages are passed to on_message from midi_in::dispatch, called by the application
+  //! when midi_in::descriptor is readable, instead of from a thread of the backend.
+  //! The backends which can be driven by the application then start no thread at all.
+  bool manual_dispatch{};
+
+  //! With queue_size or manual_dispatch: in each batch of messages read with midi_in::poll,
+  //! next_batch or dispatch, only the latest value of each continuous controller, pitch bend
+  //! and pressure is kept per channel. Notes and SysEx stay ordered with the values around
+  //! them. See coalescing_table.
+  //! The JACK and PipeWire inputs otherwise coalesce each process cycle before calling
+  //! on_message. The other backends have no batch: a warning is reported.
+  bool coalesce_controllers{};
+
+  //! The tempo and song position are estimated from the MIDI clock, Start, Stop, Continue
+  //! and Song Position Pointer messages, even if ignore_timing discards them: see
+  //! midi_in::clock and on_clock. Works best with Absolute or SystemMonotonic timestamps.
+  bool track_clock{};
+
+  //! MTC quarter frames and full frame messages are assembled into a position, even if
+  //! ignore_timing or ignore_sysex discard them: see midi_in::timecode and on_timecode.
+  bool track_timecode{};
+
+  //! With Absolute or SystemMonotonic timestamps: the messages preceded by a JR Timestamp
+  //! are given the time stamped by the sender, mapped onto the input clock with its
+  //! JR Clock messages, instead of their arrival time. See jr_timestamp_decoder.
+  //! The JR messages are still passed to on_message unless ignore_timing is set.
+  bool jr_timestamps{};
 };
 }
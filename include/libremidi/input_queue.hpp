@@ -0,0 +1,169 @@
+#pragma once
+#include <libremidi/config.hpp>
+
+#if defined(__linux__)
+  #include <libremidi/backends/linux/helpers.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+NAMESPACE_LIBREMIDI
+{
+//! Woken once, from the thread of the producer, when a message is pushed after
+//! input_queue::wait. Used to resume a coroutine waiting for input.
+struct input_queue_waiter
+{
+  void (*wake)(input_queue_waiter&) noexcept = nullptr;
+};
+
+//! Single-producer single-consumer queue of received messages, allocated once.
+//! The backend thread pushes, a single consumer thread reads: pushing never locks,
+//! and only makes a system call when the queue was empty, to wake up the consumer.
+//! With std::vector-based messages, the message buffers themselves are still allocated
+//! by the backend: build with LIBREMIDI_SLIM_MESSAGE for a queue which never allocates.
+template <typename T>
+class input_queue
+{
+public:
+  //! The capacity is rounded up to a power of two
+  explicit input_queue(std::size_t capacity)
+      : m_capacity{std::bit_ceil(std::max<std::size_t>(capacity, 2))}
+      , m_mask{m_capacity - 1}
+      , m_slots{std::make_unique<T[]>(m_capacity)}
+  {
+  }
+
+  input_queue(const input_queue&) = delete;
+  input_queue(input_queue&&) = delete;
+  input_queue& operator=(const input_queue&) = delete;
+  input_queue& operator=(input_queue&&) = delete;
+
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  //! Producer side. Returns false, and counts the message as dropped, if the queue is full.
+  bool push(T&& msg) noexcept
+  {
+    const std::size_t w = m_write.load(std::memory_order_relaxed);
+    if (w - m_read.load(std::memory_order_acquire) == m_capacity)
+    {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    m_slots[w & m_mask] = std::move(msg);
+    m_write.store(w + 1, std::memory_order_seq_cst);
+
+    // Everything before was read: the consumer may be waiting on the descriptor
+    if (m_read.load(std::memory_order_seq_cst) == w)
+      notify();
+
+    if (m_waiter.load(std::memory_order_seq_cst))
+      if (auto waiter = m_waiter.exchange(nullptr, std::memory_order_acq_rel))
+        waiter->wake(*waiter);
+    return true;
+  }
+
+  //! Consumer side. Moves the oldest message into msg, if there is one.
+  bool try_read(T& msg) noexcept { return poll({&msg, 1}) == 1; }
+
+  //! Consumer side. Moves up to msgs.size() messages into msgs, in order,
+  //! and returns their count.
+  std::size_t poll(std::span<T> msgs) noexcept
+  {
+    const std::size_t r = m_read.load(std::memory_order_relaxed);
+    const std::size_t w = m_write.load(std::memory_order_acquire);
+    const std::size_t n = std::min(w - r, msgs.size());
+    if (n == 0)
+      return 0;
+
+    for (std::size_t i = 0; i < n; i++)
+      msgs[i] = std::move(m_slots[(r + i) & m_mask]);
+    m_read.store(r + n, std::memory_order_seq_cst);
+
+    if (m_write.load(std::memory_order_seq_cst) == r + n)
+      rearm();
+    return n;
+  }
+
+  //! Consumer side. Registers a waiter, to be woken by the next push.
+  //! Returns false without registering it if messages are already queued.
+  bool wait(input_queue_waiter& waiter) noexcept
+  {
+    m_waiter.store(&waiter, std::memory_order_seq_cst);
+    if (m_write.load(std::memory_order_seq_cst) != m_read.load(std::memory_order_relaxed))
+    {
+      // Unless the producer took it in the meantime, in which case it wakes it
+      auto expected = &waiter;
+      return !m_waiter.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    }
+    return true;
+  }
+
+  //! Consumer side. Deregisters a waiter if it was not woken yet.
+  void cancel_wait(input_queue_waiter& waiter) noexcept
+  {
+    auto expected = &waiter;
+    m_waiter.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+  }
+
+  //! Approximate when called concurrently with push
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return m_read.load(std::memory_order_acquire) == m_write.load(std::memory_order_acquire);
+  }
+
+  //! Messages which did not fit in the queue since its creation
+  [[nodiscard]] uint64_t dropped() const noexcept
+  {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  //! Readable while messages are queued, for poll, epoll or select.
+  //! An eventfd on Linux, -1 on other platforms.
+  [[nodiscard]] int descriptor() const noexcept
+  {
+#if defined(__linux__)
+    return m_event;
+#else
+    return -1;
+#endif
+  }
+
+private:
+  void notify() noexcept
+  {
+#if defined(__linux__)
+    m_event.notify();
+#endif
+  }
+
+  // The queue was just emptied: reset the descriptor, unless a message arrived meanwhile
+  void rearm() noexcept
+  {
+#if defined(__linux__)
+    m_event.consume();
+    if (!empty())
+      m_event.notify();
+#endif
+  }
+
+  std::size_t m_capacity{};
+  std::size_t m_mask{};
+  std::unique_ptr<T[]> m_slots;
+
+  alignas(64) std::atomic<std::size_t> m_write{};
+  alignas(64) std::atomic<std::size_t> m_read{};
+  std::atomic<uint64_t> m_dropped{};
+  std::atomic<input_queue_waiter*> m_waiter{};
+
+#if defined(__linux__)
+  eventfd_notifier m_event{false};
+#endif
+};
+}
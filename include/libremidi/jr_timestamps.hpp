@@ -0,0 +1,203 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/detail/clock_correlator.hpp>
+#include <libremidi/input_configuration.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+NAMESPACE_LIBREMIDI
+{
+//! UMP Jitter Reduction timestamps: the sender stamps its messages with its own clock,
+//! a 16-bit counter of 1/31250 s which wraps every 2.1 seconds, and sends that clock
+//! regularly in JR Clock messages so that the receiver can map it onto its own.
+namespace jr
+{
+//! Duration of a JR clock tick
+inline constexpr int64_t tick_ns = 32'000;
+
+//! Utility messages: JR Clock and JR Timestamp, without group as of UMP 1.1
+inline constexpr uint32_t clock_status = 0x1;
+inline constexpr uint32_t timestamp_status = 0x2;
+
+constexpr uint16_t ticks(int64_t time_ns) noexcept
+{
+  return static_cast<uint16_t>((time_ns / tick_ns) & 0xFFFF);
+}
+
+constexpr uint32_t make_clock(int64_t time_ns) noexcept
+{
+  return (clock_status << 20) | ticks(time_ns);
+}
+
+constexpr uint32_t make_timestamp(int64_t time_ns) noexcept
+{
+  return (timestamp_status << 20) | ticks(time_ns);
+}
+
+//! The status of a JR Clock or JR Timestamp message, 0 for the other UMPs
+constexpr uint32_t status(uint32_t word) noexcept
+{
+  if ((word >> 28) != 0)
+    return 0;
+  const uint32_t s = (word >> 20) & 0x0F;
+  return s == clock_status || s == timestamp_status ? s : 0;
+}
+}
+
+//! Stamps the messages of an output with the JR clock of the process: its monotonic clock.
+//! A JR Clock message is due at most every clock_period_ns.
+class jr_timestamp_encoder
+{
+public:
+  static constexpr int64_t clock_period_ns = 250'000'000;
+
+  //! The timestamp mode of the scheduled messages: see output_configuration::timestamps
+  explicit jr_timestamp_encoder(uint32_t timestamps = timestamp_mode::SystemMonotonic) noexcept
+      : m_timestamps{timestamps}
+  {
+  }
+
+  //! The JR Clock message to send now if one is due, else 0.
+  //! Can be called from several threads: only one of them gets it.
+  uint32_t clock(int64_t now_ns) noexcept
+  {
+    int64_t last = m_last_clock.load(std::memory_order_relaxed);
+    if (now_ns - last < clock_period_ns)
+      return 0;
+    if (!m_last_clock.compare_exchange_strong(last, now_ns, std::memory_order_relaxed))
+      return 0;
+    return jr::make_clock(now_ns);
+  }
+
+  //! The JR Timestamp message of a message scheduled at timestamp.
+  //! Absolute timestamps are taken as monotonic times, zero meaning now.
+  [[nodiscard]] uint32_t timestamp(int64_t timestamp, int64_t now_ns) const noexcept
+  {
+    switch (m_timestamps)
+    {
+      case timestamp_mode::Relative:
+        return jr::make_timestamp(now_ns + timestamp);
+      case timestamp_mode::Absolute:
+      case timestamp_mode::SystemMonotonic:
+        return jr::make_timestamp(timestamp != 0 ? timestamp : now_ns);
+      default:
+        return jr::make_timestamp(now_ns);
+    }
+  }
+
+private:
+  uint32_t m_timestamps{};
+  std::atomic<int64_t> m_last_clock{std::numeric_limits<int64_t>::min() / 2};
+};
+
+//! Gives the messages of an input the time their sender stamped them with, on the
+//! clock of the input timestamps, instead of their arrival time.
+//!
+//! The JR Clock messages are correlated with their arrival times, keeping the least
+//! delayed of every few ones, which removes the jitter of the transport (network, USB,
+//! bridges).
+//! A JR Timestamp applies to the messages which follow it in the same buffer, or to the
+//! next buffer if it was received alone.
+class jr_timestamp_decoder
+{
+public:
+  //! JR Clock messages per observation given to the clock correlation: about a second
+  static constexpr int clocks_per_observation = 4;
+
+  //! Processes a JR Clock or JR Timestamp utility message, received at arrival_ns
+  void process(uint32_t word, int64_t arrival_ns) noexcept
+  {
+    switch (jr::status(word))
+    {
+      case jr::clock_status:
+        clock(unwrap(word & 0xFFFF, arrival_ns), arrival_ns);
+        break;
+      case jr::timestamp_status:
+        m_pending = unwrap(word & 0xFFFF, arrival_ns);
+        m_has_pending = true;
+        m_used = false;
+        break;
+      default:
+        break;
+    }
+  }
+
+  //! Starts a buffer of messages: the timestamp already applied to a previous one is done
+  void begin() noexcept
+  {
+    if (m_used)
+      m_has_pending = false;
+    m_used = false;
+  }
+
+  //! The time of a message which arrived at arrival_ns
+  int64_t time(int64_t arrival_ns) noexcept
+  {
+    if (!m_has_pending || !m_correlation.valid())
+      return arrival_ns;
+    m_used = true;
+    return m_correlation.to_monotonic(m_pending);
+  }
+
+  //! Whether JR Clock messages were received
+  [[nodiscard]] bool synchronized() const noexcept { return m_correlation.valid(); }
+
+  void reset() noexcept
+  {
+    m_correlation.reset();
+    m_clocks = 0;
+    m_has_pending = false;
+    m_used = false;
+    m_started = false;
+  }
+
+private:
+  void clock(int64_t sender_ns, int64_t arrival_ns) noexcept
+  {
+    if (m_clocks == 0 || arrival_ns - sender_ns < m_best_arrival - m_best_sender)
+    {
+      m_best_sender = sender_ns;
+      m_best_arrival = arrival_ns;
+    }
+
+    if (++m_clocks == clocks_per_observation)
+    {
+      m_correlation.observe(m_best_sender, m_best_arrival);
+      m_clocks = 0;
+    }
+  }
+
+  // The sender time in nanoseconds, from its 16-bit tick counter, which wraps every 2.1 s.
+  // The counter is first advanced by the time elapsed since the previous JR message, as
+  // seen by the receiver: the closest value with these 16 bits is then within a second.
+  int64_t unwrap(uint32_t ticks, int64_t arrival_ns) noexcept
+  {
+    const auto t = static_cast<uint16_t>(ticks);
+    if (!m_started)
+    {
+      m_started = true;
+      m_ticks = t;
+    }
+    else
+    {
+      const int64_t expected = m_ticks + (arrival_ns - m_last_arrival) / jr::tick_ns;
+      m_ticks = expected + static_cast<int16_t>(static_cast<uint16_t>(t - expected));
+    }
+    m_last_arrival = arrival_ns;
+    return m_ticks * jr::tick_ns;
+  }
+
+  clock_correlator m_correlation;
+  int64_t m_best_sender{};
+  int64_t m_best_arrival{};
+  int m_clocks{};
+  int64_t m_ticks{};
+  int64_t m_pending{};
+  int64_t m_last_arrival{};
+  bool m_started{};
+  bool m_has_pending{};
+  bool m_used{};
+};
+}
@@ -58,12 +58,21 @@
 */
 
 #include <libremidi/api.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/configurations.hpp>
 #include <libremidi/defaults.hpp>
 #include <libremidi/input_configuration.hpp>
+#include <libremidi/input_queue.hpp>
+#include <libremidi/jr_timestamps.hpp>
+#include <libremidi/manual_dispatch.hpp>
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+  #include <libremidi/coroutines.hpp>
+#endif
 #include <libremidi/message.hpp>
 #include <libremidi/observer_configuration.hpp>
 #include <libremidi/output_configuration.hpp>
+#include <libremidi/port_counters.hpp>
+#include <libremidi/port_stats.hpp>
 
 #if LIBREMIDI_NI_MIDI2_COMPAT
   #include <midi/sysex.h>
@@ -97,7 +106,19 @@ public:
   [[nodiscard]] std::vector<libremidi::input_port> get_input_ports() const noexcept;
   [[nodiscard]] std::vector<libremidi::output_port> get_output_ports() const noexcept;
 
+  //! With manual_dispatch set in the configuration: a descriptor readable when dispatch()
+  //! has notifications to make, to wait on it with poll, epoll, select...
+  //! -1 without manual_dispatch, and on platforms without eventfd unless the backend
+  //! provides one: dispatch() must then be called periodically.
+  [[nodiscard]] int descriptor() const noexcept;
+
+  //! With manual_dispatch set in the configuration: calls the callbacks for the changes
+  //! which happened since the last call, from the calling thread. Does not block.
+  stdx::error dispatch();
+
 private:
+  // Declared first: the backend, which calls its callbacks, is destroyed before it
+  std::unique_ptr<deferred_observer> m_deferred;
   std::unique_ptr<class observer_api> m_impl;
 };
 
@@ -156,7 +177,106 @@ public:
   //! Returns the current timestamp for absolute ticks.
   timestamp absolute_timestamp() const noexcept;
 
+  //! With queue_size set in the configuration, moves up to messages.size() received messages
+  //! into messages, oldest first, and returns their count. Must be called from a single thread.
+  //! MIDI 1 messages are read with a MIDI 1 configuration, UMP with a UMP configuration.
+  std::size_t poll(std::span<message> messages) noexcept;
+  std::size_t poll(std::span<ump> messages) noexcept;
+
+  //! With queue_size set in the configuration, moves the oldest received message
+  //! into msg if there is one.
+  //! With coalesce_controllers, the queued messages are read and coalesced as a batch,
+  //! as with poll, and handed out by the following calls to try_read and poll.
+  bool try_read(message& msg) noexcept;
+  bool try_read(ump& msg) noexcept;
+
+  //! A descriptor readable while messages are queued, to wait for them with poll, epoll,
+  //! select... It is an eventfd on Linux, and -1 on other platforms or without queue_size.
+  [[nodiscard]] int queue_descriptor() const noexcept;
+
+  //! Messages dropped since the creation of the input because the queue was full
+  [[nodiscard]] uint64_t queue_dropped() const noexcept;
+
+  //! With manual_dispatch set in the configuration: a descriptor readable when dispatch()
+  //! has messages to process, to wait on it with poll, epoll, select...
+  //! The descriptor of the device for the backends driven by the application, such as ALSA,
+  //! else an eventfd signalled by the threads of the backend. -1 without manual_dispatch,
+  //! and on platforms without eventfd unless the backend provides one: dispatch() must
+  //! then be called periodically.
+  [[nodiscard]] int descriptor() const noexcept;
+
+  //! With manual_dispatch set in the configuration: passes the messages received since
+  //! the last call to on_message, from the calling thread. Does not block.
+  //! With queue_size also set, the messages are moved to the queue instead.
+  stdx::error dispatch();
+
+  //! Counters and latency histograms of the input, when libremidi is built with
+  //! LIBREMIDI_STATS (see port_stats_enabled), else an empty snapshot.
+  //! Can be called from any thread.
+  [[nodiscard]] port_stats stats() const noexcept;
+
+  //! Events dropped, filtered or discarded by the backend, and overruns it reported.
+  //! Can be called from any thread.
+  [[nodiscard]] port_counters counters() const noexcept;
+
+  //! With track_clock set in the configuration: the tempo and song position of the MIDI
+  //! clock received on the port. Can be called from any thread.
+  [[nodiscard]] clock_state clock() const noexcept;
+
+  //! With track_timecode set in the configuration: the position of the MIDI time code
+  //! received on the port. Can be called from any thread.
+  [[nodiscard]] mtc_state timecode() const noexcept;
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+  //! With queue_size set in the configuration, `co_await in.next()` returns the next
+  //! message, suspending the coroutine until one arrives: `in.next<libremidi::ump>()`
+  //! with a UMP configuration. By default the coroutine is resumed on the thread of the
+  //! backend; a scheduler such as coro::single_thread_executor or coro::asio_scheduler
+  //! resumes it elsewhere. A single coroutine may wait on an input at a time, and it
+  //! must not be destroyed while waiting, unless the port is closed.
+  template <typename T = message, coro::scheduler Scheduler = coro::inline_scheduler>
+  [[nodiscard]] auto next(Scheduler&& sched = {}) noexcept
+  {
+    return coro::input_awaitable<T, Scheduler>{queue<T>(), static_cast<Scheduler&&>(sched)};
+  }
+
+  //! `co_await in.next_batch(messages)` suspends until messages arrive,
+  //! moves as many as fit into messages and returns their count
+  template <coro::scheduler Scheduler = coro::inline_scheduler>
+  [[nodiscard]] auto next_batch(std::span<message> messages, Scheduler&& sched = {}) noexcept
+  {
+    return coro::input_batch_awaitable<message, Scheduler>{
+        m_queue.get(), messages, m_coalescing.get(), static_cast<Scheduler&&>(sched)};
+  }
+
+  template <coro::scheduler Scheduler = coro::inline_scheduler>
+  [[nodiscard]] auto next_batch(std::span<ump> messages, Scheduler&& sched = {}) noexcept
+  {
+    return coro::input_batch_awaitable<ump, Scheduler>{
+        m_ump_queue.get(), messages, m_coalescing.get(), static_cast<Scheduler&&>(sched)};
+  }
+#endif
+
 private:
+  template <typename T>
+  input_queue<T>* queue() const noexcept
+  {
+    if constexpr (std::is_same_v<T, ump>)
+      return m_ump_queue.get();
+    else
+      return m_queue.get();
+  }
+
+  // Declared first: the backend, which pushes to the queues and records the statistics,
+  // is destroyed before them
+  std::unique_ptr<port_statistics> m_stats;
+  std::unique_ptr<input_queue<message>> m_queue;
+  std::unique_ptr<input_queue<ump>> m_ump_queue;
+  std::unique_ptr<coalescing_table> m_coalescing;
+  std::unique_ptr<read_ahead_batch<message>> m_read_ahead;
+  std::unique_ptr<read_ahead_batch<ump>> m_ump_read_ahead;
+  std::unique_ptr<deferred_input<message>> m_deferred;
+  std::unique_ptr<deferred_input<ump>> m_ump_deferred;
   std::unique_ptr<class midi_in_api> m_impl;
 };
 
@@ -263,7 +383,22 @@ public:
   //! (currently not implemented anywhere)
   stdx::error schedule_ump(int64_t timestamp, const uint32_t* message, size_t size) const;
 
+  //! Send immediately the messages buffered by the back-end, if any,
+  //! e.g. when the network back-end coalesces multiple messages per datagram.
+  stdx::error flush() const;
+
+  //! Counters and send time histogram of the output, when libremidi is built with
+  //! LIBREMIDI_STATS (see port_stats_enabled), else an empty snapshot.
+  //! Can be called from any thread.
+  [[nodiscard]] port_stats stats() const noexcept;
+
+  //! Events dropped, filtered or discarded by the backend, and overruns it reported.
+  //! Can be called from any thread.
+  [[nodiscard]] port_counters counters() const noexcept;
+
 private:
+  std::unique_ptr<port_statistics> m_stats;
+  std::unique_ptr<jr_timestamp_encoder> m_jr;
   std::unique_ptr<class midi_out_api> m_impl;
 };
 }
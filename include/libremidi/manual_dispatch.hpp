@@ -0,0 +1,191 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/coalescing.hpp>
+#include <libremidi/input_queue.hpp>
+#include <libremidi/observer_configuration.hpp>
+
+#if defined(__linux__)
+  #include <libremidi/backends/linux/helpers.hpp>
+#endif
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+NAMESPACE_LIBREMIDI
+{
+//! With manual_dispatch, for the backends whose threads call on_message: the messages are
+//! queued, and passed to on_message from the thread calling dispatch().
+//! The backends driven by the application call on_message directly from their dispatch().
+//! With coalesce_controllers, the messages of each dispatch() are coalesced before.
+template <typename T>
+class deferred_input
+{
+public:
+  static constexpr std::size_t capacity = 1024;
+
+  explicit deferred_input(std::function<void(T&&)> on_message, bool coalesce = false)
+      : m_on_message{std::move(on_message)}
+      , m_queue{std::make_unique<input_queue<T>>(capacity)}
+      , m_coalescing{make_coalescing_table<T>(coalesce)}
+  {
+    if (m_coalescing)
+      m_batch.resize(capacity);
+  }
+
+  //! The callback to give to the backend
+  std::function<void(T&&)> callback()
+  {
+    return [this](T&& msg) {
+      if (m_queue)
+        m_queue->push(std::move(msg));
+      else if (m_coalescing)
+        collect(std::move(msg));
+      else
+        m_on_message(std::move(msg));
+    };
+  }
+
+  //! Called once the backend is created, if it is driven by the application:
+  //! it does not have threads which could call the callback concurrently.
+  void set_direct() noexcept { m_queue.reset(); }
+
+  int descriptor() const noexcept { return m_queue ? m_queue->descriptor() : -1; }
+
+  //! Passes the queued messages to on_message. Stops after a full queue worth of messages,
+  //! so that a flood of input does not keep the caller there.
+  //! In direct mode, passes the messages collected for coalescing during the dispatch()
+  //! of the backend.
+  std::size_t dispatch()
+  {
+    if (!m_queue)
+      return flush();
+
+    if (m_coalescing)
+    {
+      m_pending = m_queue->poll(m_batch);
+      return flush();
+    }
+
+    std::size_t n = 0;
+    for (T msg; n < capacity && m_queue->try_read(msg); n++)
+      m_on_message(std::move(msg));
+    return n;
+  }
+
+  [[nodiscard]] uint64_t dropped() const noexcept { return m_queue ? m_queue->dropped() : 0; }
+
+private:
+  void collect(T&& msg)
+  {
+    if (m_pending == m_batch.size())
+      flush();
+    m_batch[m_pending++] = std::move(msg);
+  }
+
+  std::size_t flush()
+  {
+    if (!m_coalescing)
+      return 0;
+
+    const auto n = m_coalescing->coalesce(std::span<T>{m_batch}.first(m_pending));
+    m_pending = 0;
+    for (std::size_t i = 0; i < n; i++)
+      m_on_message(std::move(m_batch[i]));
+    return n;
+  }
+
+  std::function<void(T&&)> m_on_message;
+  std::unique_ptr<input_queue<T>> m_queue;
+
+  std::unique_ptr<coalescing_table> m_coalescing;
+  std::vector<T> m_batch;
+  std::size_t m_pending{};
+};
+
+//! With manual_dispatch, for the backends whose threads call the observer callbacks:
+//! the notifications are queued, and made from the thread calling dispatch().
+//! They are rare enough for a locked queue.
+class deferred_observer
+{
+public:
+  //! Replaces the callbacks of conf by ones which queue the notifications
+  explicit deferred_observer(observer_configuration& conf)
+      : m_callbacks{conf}
+  {
+    wrap(conf.input_added, m_callbacks.input_added);
+    wrap(conf.input_removed, m_callbacks.input_removed);
+    wrap(conf.output_added, m_callbacks.output_added);
+    wrap(conf.output_removed, m_callbacks.output_removed);
+  }
+
+  deferred_observer(const deferred_observer&) = delete;
+  deferred_observer(deferred_observer&&) = delete;
+  deferred_observer& operator=(const deferred_observer&) = delete;
+  deferred_observer& operator=(deferred_observer&&) = delete;
+
+  //! Called once the backend is created, if it is driven by the application
+  void set_direct() noexcept { m_direct = true; }
+
+  int descriptor() const noexcept
+  {
+#if defined(__linux__)
+    return m_direct ? -1 : m_event.fd;
+#else
+    return -1;
+#endif
+  }
+
+  std::size_t dispatch()
+  {
+    std::vector<std::function<void()>> events;
+    {
+      std::lock_guard lock{m_mutex};
+      events.swap(m_events);
+#if defined(__linux__)
+      m_event.consume();
+#endif
+    }
+
+    for (auto& ev : events)
+      ev();
+    return events.size();
+  }
+
+private:
+  template <typename Port>
+  void wrap(std::function<void(const Port&)>& cb, const std::function<void(const Port&)>& user)
+  {
+    if (!user)
+      return;
+
+    cb = [this, &user](const Port& p) {
+      if (m_direct)
+        user(p);
+      else
+        post([&user, p] { user(p); });
+    };
+  }
+
+  void post(std::function<void()> ev)
+  {
+    std::lock_guard lock{m_mutex};
+    m_events.push_back(std::move(ev));
+#if defined(__linux__)
+    m_event.notify();
+#endif
+  }
+
+  observer_configuration m_callbacks;
+  bool m_direct{};
+
+  std::mutex m_mutex;
+  std::vector<std::function<void()>> m_events;
+#if defined(__linux__)
+  eventfd_notifier m_event{false};
+#endif
+};
+}
@@ -25,10 +25,16 @@ convert_midi1_to_midi2_input_configuration(const input_configuration& base_conf)
   c2.get_timestamp = base_conf.get_timestamp;
   c2.on_error = base_conf.on_error;
   c2.on_warning = base_conf.on_warning;
+  c2.on_overrun = base_conf.on_overrun;
+  c2.on_clock = base_conf.on_clock;
+  c2.on_timecode = base_conf.on_timecode;
   c2.ignore_sysex = base_conf.ignore_sysex;
   c2.ignore_timing = base_conf.ignore_timing;
   c2.ignore_sensing = base_conf.ignore_sensing;
   c2.timestamps = base_conf.timestamps;
+  c2.manual_dispatch = base_conf.manual_dispatch;
+  c2.track_clock = base_conf.track_clock;
+  c2.track_timecode = base_conf.track_timecode;
   return c2;
 }
 
@@ -52,13 +58,147 @@ convert_midi2_to_midi1_input_configuration(const ump_input_configuration& base_c
   c2.get_timestamp = base_conf.get_timestamp;
   c2.on_error = base_conf.on_error;
   c2.on_warning = base_conf.on_warning;
+  c2.on_overrun = base_conf.on_overrun;
+  c2.on_clock = base_conf.on_clock;
+  c2.on_timecode = base_conf.on_timecode;
   c2.ignore_sysex = base_conf.ignore_sysex;
   c2.ignore_timing = base_conf.ignore_timing;
   c2.ignore_sensing = base_conf.ignore_sensing;
   c2.timestamps = base_conf.timestamps;
+  c2.manual_dispatch = base_conf.manual_dispatch;
+  c2.track_clock = base_conf.track_clock;
+  c2.track_timecode = base_conf.track_timecode;
   return c2;
 }
 
+template <typename T>
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::unique_ptr<input_queue<T>>
+make_input_queue(uint32_t size)
+{
+  if (size == 0)
+    return {};
+  return std::make_unique<input_queue<T>>(size);
+}
+
+#if defined(LIBREMIDI_STATS)
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::size_t message_bytes(const message& msg) noexcept
+{
+  return msg.bytes.size();
+}
+
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::size_t message_bytes(const ump& msg) noexcept
+{
+  return msg.size() * 4;
+}
+#endif
+
+// Times on_message, and the latency of the messages stamped on the monotonic clock
+template <typename T, typename Configuration>
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION Configuration
+with_callback_stats(const Configuration& base_conf, [[maybe_unused]] port_statistics* stats)
+{
+  Configuration conf = base_conf;
+#if defined(LIBREMIDI_STATS)
+  if (!stats || !conf.on_message)
+    return conf;
+
+  const bool monotonic = conf.timestamps == timestamp_mode::SystemMonotonic;
+  conf.on_message = [stats, monotonic, cb = std::move(conf.on_message)](T&& msg) {
+    const int64_t t0 = system_ns();
+    if (monotonic)
+      stats->latency.record(t0 - msg.timestamp);
+    cb(std::move(msg));
+    stats->callback.record(system_ns() - t0);
+  };
+#endif
+  return conf;
+}
+
+// Counts the messages as the backend passes them on
+template <typename T, typename Configuration>
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION Configuration with_delivery_stats(
+    const Configuration& base_conf, [[maybe_unused]] port_statistics* stats,
+    [[maybe_unused]] bool queued)
+{
+  Configuration conf = base_conf;
+#if defined(LIBREMIDI_STATS)
+  if (!stats || !conf.on_message)
+    return conf;
+
+  const bool latency = queued && conf.timestamps == timestamp_mode::SystemMonotonic;
+  conf.on_message = [stats, latency, cb = std::move(conf.on_message)](T&& msg) {
+    const int64_t now = system_ns();
+    stats->record_event(message_bytes(msg));
+    stats->record_arrival(now);
+    if (latency)
+      stats->latency.record(now - msg.timestamp);
+    cb(std::move(msg));
+  };
+#endif
+  return conf;
+}
+
+// In queued mode, the queue already defers the messages until the application reads them
+template <typename T>
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::unique_ptr<deferred_input<T>>
+make_deferred_input(const auto& conf, port_statistics* stats)
+{
+  if (!conf.manual_dispatch || conf.queue_size != 0 || !conf.on_message)
+    return {};
+  return std::make_unique<deferred_input<T>>(
+      with_callback_stats<T>(conf, stats).on_message, conf.coalesce_controllers);
+}
+
+// In queued mode, the backend pushes the messages to the queue instead of calling the user
+template <typename Configuration, typename T>
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION Configuration with_queue(
+    const Configuration& base_conf, input_queue<T>* queue, deferred_input<T>* deferred,
+    port_statistics* stats)
+{
+  Configuration conf = base_conf;
+  if (queue)
+    conf.on_message = [queue](T&& msg) { queue->push(std::move(msg)); };
+  else if (deferred)
+    conf.on_message = deferred->callback();
+  else
+    conf = with_callback_stats<T>(conf, stats);
+  return with_delivery_stats<T>(conf, stats, queue != nullptr);
+}
+
+// The backends driven by the application call on_message from their own dispatch()
+template <typename T>
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION void
+finish_deferred_input(deferred_input<T>* deferred, const midi_in_api* impl)
+{
+  if (deferred && impl && impl->descriptor() >= 0)
+    deferred->set_direct();
+}
+
+// Only the queue, manual dispatch and the backends with a process cycle have batches to
+// coalesce: the other backends pass each message to on_message as soon as it arrives
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION void
+check_coalescing(const auto& conf, const midi_in_api* impl)
+{
+  if (!conf.coalesce_controllers || conf.queue_size != 0 || conf.manual_dispatch || !impl)
+    return;
+
+  switch (impl->get_current_api())
+  {
+    case libremidi::API::JACK_MIDI:
+    case libremidi::API::JACK_UMP:
+    case libremidi::API::PIPEWIRE:
+    case libremidi::API::PIPEWIRE_UMP:
+    case libremidi::API::DUMMY:
+      return;
+    default: {
+      error_handler e;
+      e.libremidi_handle_warning(
+          conf, "coalesce_controllers has no effect on the callbacks of this backend");
+      return;
+    }
+  }
+}
+
 LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::unique_ptr<midi_in_api>
 make_midi_in(auto base_conf, input_api_configuration api_conf, auto backends)
 {
@@ -161,13 +301,27 @@ make_midi1_in(const input_configuration& base_conf, const input_api_configuratio
 
 /// MIDI 1 constructors
 LIBREMIDI_INLINE midi_in::midi_in(const input_configuration& base_conf) noexcept
-    : m_impl{make_midi1_in(base_conf)}
+    : m_stats{make_port_statistics()}
+    , m_queue{make_input_queue<message>(base_conf.queue_size)}
+    , m_coalescing{make_coalescing_table<message>(m_queue && base_conf.coalesce_controllers)}
+    , m_read_ahead{make_read_ahead_batch<message>(m_coalescing != nullptr)}
+    , m_deferred{make_deferred_input<message>(base_conf, m_stats.get())}
+    , m_impl{make_midi1_in(
+          with_queue(base_conf, m_queue.get(), m_deferred.get(), m_stats.get()))}
 {
+  finish_deferred_input(m_deferred.get(), m_impl.get());
+  check_coalescing(base_conf, m_impl.get());
 }
 
 LIBREMIDI_INLINE
 midi_in::midi_in(const input_configuration& base_conf, const input_api_configuration& api_conf)
-    : m_impl{make_midi1_in(base_conf, api_conf)}
+    : m_stats{make_port_statistics()}
+    , m_queue{make_input_queue<message>(base_conf.queue_size)}
+    , m_coalescing{make_coalescing_table<message>(m_queue && base_conf.coalesce_controllers)}
+    , m_read_ahead{make_read_ahead_batch<message>(m_coalescing != nullptr)}
+    , m_deferred{make_deferred_input<message>(base_conf, m_stats.get())}
+    , m_impl{make_midi1_in(
+          with_queue(base_conf, m_queue.get(), m_deferred.get(), m_stats.get()), api_conf)}
 {
   if (!m_impl)
   {
@@ -175,6 +329,8 @@ midi_in::midi_in(const input_configuration& base_conf, const input_api_configura
     e.libremidi_handle_error(base_conf, "Could not open midi in for the given api");
     m_impl = std::make_unique<midi_in_dummy>(input_configuration{}, dummy_configuration{});
   }
+  finish_deferred_input(m_deferred.get(), m_impl.get());
+  check_coalescing(base_conf, m_impl.get());
 }
 
 /// MIDI 2 helpers
@@ -259,13 +415,28 @@ make_midi2_in(const ump_input_configuration& base_conf, const input_api_configur
 
 /// MIDI 2 constructors
 LIBREMIDI_INLINE midi_in::midi_in(const ump_input_configuration& base_conf) noexcept
-    : m_impl{make_midi2_in(base_conf)}
+    : m_stats{make_port_statistics()}
+    , m_ump_queue{make_input_queue<ump>(base_conf.queue_size)}
+    , m_coalescing{make_coalescing_table<ump>(m_ump_queue && base_conf.coalesce_controllers)}
+    , m_ump_read_ahead{make_read_ahead_batch<ump>(m_coalescing != nullptr)}
+    , m_ump_deferred{make_deferred_input<ump>(base_conf, m_stats.get())}
+    , m_impl{make_midi2_in(
+          with_queue(base_conf, m_ump_queue.get(), m_ump_deferred.get(), m_stats.get()))}
 {
+  finish_deferred_input(m_ump_deferred.get(), m_impl.get());
+  check_coalescing(base_conf, m_impl.get());
 }
 
 LIBREMIDI_INLINE
 midi_in::midi_in(const ump_input_configuration& base_conf, const input_api_configuration& api_conf)
-    : m_impl{make_midi2_in(base_conf, api_conf)}
+    : m_stats{make_port_statistics()}
+    , m_ump_queue{make_input_queue<ump>(base_conf.queue_size)}
+    , m_coalescing{make_coalescing_table<ump>(m_ump_queue && base_conf.coalesce_controllers)}
+    , m_ump_read_ahead{make_read_ahead_batch<ump>(m_coalescing != nullptr)}
+    , m_ump_deferred{make_deferred_input<ump>(base_conf, m_stats.get())}
+    , m_impl{make_midi2_in(
+          with_queue(base_conf, m_ump_queue.get(), m_ump_deferred.get(), m_stats.get()),
+          api_conf)}
 {
   if (!m_impl)
   {
@@ -273,12 +444,22 @@ midi_in::midi_in(const ump_input_configuration& base_conf, const input_api_confi
     e.libremidi_handle_error(base_conf, "Could not open midi in for the given api");
     m_impl = std::make_unique<midi_in_dummy>(input_configuration{}, dummy_configuration{});
   }
+  finish_deferred_input(m_ump_deferred.get(), m_impl.get());
+  check_coalescing(base_conf, m_impl.get());
 }
 
 LIBREMIDI_INLINE midi_in::~midi_in() = default;
 
 LIBREMIDI_INLINE midi_in::midi_in(midi_in&& other) noexcept
-    : m_impl{std::move(other.m_impl)}
+    : m_stats{std::move(other.m_stats)}
+    , m_queue{std::move(other.m_queue)}
+    , m_ump_queue{std::move(other.m_ump_queue)}
+    , m_coalescing{std::move(other.m_coalescing)}
+    , m_read_ahead{std::move(other.m_read_ahead)}
+    , m_ump_read_ahead{std::move(other.m_ump_read_ahead)}
+    , m_deferred{std::move(other.m_deferred)}
+    , m_ump_deferred{std::move(other.m_ump_deferred)}
+    , m_impl{std::move(other.m_impl)}
 {
   other.m_impl
       = std::make_unique<libremidi::midi_in_dummy>(input_configuration{}, dummy_configuration{});
@@ -295,7 +476,16 @@ stdx::error midi_in::set_port_name(std::string_view portName)
 
 LIBREMIDI_INLINE midi_in& midi_in::operator=(midi_in&& other) noexcept
 {
+  // The previous backend is destroyed before the queues it was pushing to
   this->m_impl = std::move(other.m_impl);
+  this->m_queue = std::move(other.m_queue);
+  this->m_ump_queue = std::move(other.m_ump_queue);
+  this->m_coalescing = std::move(other.m_coalescing);
+  this->m_read_ahead = std::move(other.m_read_ahead);
+  this->m_ump_read_ahead = std::move(other.m_ump_read_ahead);
+  this->m_deferred = std::move(other.m_deferred);
+  this->m_ump_deferred = std::move(other.m_ump_deferred);
+  this->m_stats = std::move(other.m_stats);
   other.m_impl
       = std::make_unique<libremidi::midi_in_dummy>(input_configuration{}, dummy_configuration{});
   return *this;
@@ -375,4 +565,141 @@ int64_t midi_in::absolute_timestamp() const noexcept
 {
   return m_impl->absolute_timestamp();
 }
+
+LIBREMIDI_INLINE
+std::size_t midi_in::poll(std::span<message> messages) noexcept
+{
+  if (!m_queue)
+    return 0;
+  if (m_read_ahead)
+    if (const auto n = m_read_ahead->take(messages))
+      return n;
+  const auto n = m_queue->poll(messages);
+  return m_coalescing ? m_coalescing->coalesce(messages.first(n)) : n;
+}
+
+LIBREMIDI_INLINE
+std::size_t midi_in::poll(std::span<ump> messages) noexcept
+{
+  if (!m_ump_queue)
+    return 0;
+  if (m_ump_read_ahead)
+    if (const auto n = m_ump_read_ahead->take(messages))
+      return n;
+  const auto n = m_ump_queue->poll(messages);
+  return m_coalescing ? m_coalescing->coalesce(messages.first(n)) : n;
+}
+
+LIBREMIDI_INLINE
+bool midi_in::try_read(message& msg) noexcept
+{
+  if (m_read_ahead)
+    return m_read_ahead->try_read(
+        *m_coalescing, msg, [this](std::span<message> batch) { return m_queue->poll(batch); });
+  return m_queue && m_queue->try_read(msg);
+}
+
+LIBREMIDI_INLINE
+bool midi_in::try_read(ump& msg) noexcept
+{
+  if (m_ump_read_ahead)
+    return m_ump_read_ahead->try_read(
+        *m_coalescing, msg, [this](std::span<ump> batch) { return m_ump_queue->poll(batch); });
+  return m_ump_queue && m_ump_queue->try_read(msg);
+}
+
+LIBREMIDI_INLINE
+int midi_in::queue_descriptor() const noexcept
+{
+  if (m_queue)
+    return m_queue->descriptor();
+  if (m_ump_queue)
+    return m_ump_queue->descriptor();
+  return -1;
+}
+
+LIBREMIDI_INLINE
+uint64_t midi_in::queue_dropped() const noexcept
+{
+  if (m_queue)
+    return m_queue->dropped();
+  if (m_ump_queue)
+    return m_ump_queue->dropped();
+  if (m_deferred)
+    return m_deferred->dropped();
+  if (m_ump_deferred)
+    return m_ump_deferred->dropped();
+  return 0;
+}
+
+LIBREMIDI_INLINE
+int midi_in::descriptor() const noexcept
+{
+  if (int fd = m_impl->descriptor(); fd >= 0)
+    return fd;
+  if (m_deferred)
+    return m_deferred->descriptor();
+  if (m_ump_deferred)
+    return m_ump_deferred->descriptor();
+  return queue_descriptor();
+}
+
+LIBREMIDI_INLINE
+stdx::error midi_in::dispatch()
+{
+  if (m_impl->descriptor() >= 0)
+  {
+    // Passes the messages collected for coalescing, if any
+    auto err = m_impl->dispatch();
+    if (m_deferred)
+      m_deferred->dispatch();
+    else if (m_ump_deferred)
+      m_ump_deferred->dispatch();
+    return err;
+  }
+
+  if (m_deferred)
+    m_deferred->dispatch();
+  else if (m_ump_deferred)
+    m_ump_deferred->dispatch();
+  else if (!m_queue && !m_ump_queue)
+    return std::errc::operation_not_supported;
+  return stdx::error{};
+}
+
+LIBREMIDI_INLINE
+port_stats midi_in::stats() const noexcept
+{
+  return m_stats ? m_stats->snapshot() : port_stats{};
+}
+
+LIBREMIDI_INLINE
+port_counters midi_in::counters() const noexcept
+{
+  if (!m_impl)
+    return {};
+
+  auto c = m_impl->counters.load();
+  if (m_queue)
+    c.dropped += m_queue->dropped();
+  if (m_ump_queue)
+    c.dropped += m_ump_queue->dropped();
+  if (m_deferred)
+    c.dropped += m_deferred->dropped();
+  if (m_ump_deferred)
+    c.dropped += m_ump_deferred->dropped();
+  return c;
+}
+
+LIBREMIDI_INLINE
+clock_state midi_in::clock() const noexcept
+{
+  return m_impl ? m_impl->clock_tracker.state() : clock_state{};
+}
+
+LIBREMIDI_INLINE
+mtc_state midi_in::timecode() const noexcept
+{
+  return m_impl ? m_impl->timecode_assembler.state() : mtc_state{};
+}
 }
@@ -85,14 +85,27 @@ make_midi_out(const output_configuration& base_conf, const output_api_configurat
   }
 }
 
+//! Null unless jr_timestamps is set
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::unique_ptr<jr_timestamp_encoder>
+make_jr_timestamp_encoder(const output_configuration& conf)
+{
+  if (!conf.jr_timestamps)
+    return {};
+  return std::make_unique<jr_timestamp_encoder>(conf.timestamps);
+}
+
 LIBREMIDI_INLINE midi_out::midi_out(const output_configuration& base_conf) noexcept
-    : m_impl{make_midi_out(base_conf)}
+    : m_stats{make_port_statistics()}
+    , m_jr{make_jr_timestamp_encoder(base_conf)}
+    , m_impl{make_midi_out(base_conf)}
 {
 }
 
 LIBREMIDI_INLINE
 midi_out::midi_out(const output_configuration& base_conf, const output_api_configuration& api_conf)
-    : m_impl{make_midi_out(base_conf, api_conf)}
+    : m_stats{make_port_statistics()}
+    , m_jr{make_jr_timestamp_encoder(base_conf)}
+    , m_impl{make_midi_out(base_conf, api_conf)}
 {
   if (!m_impl)
   {
@@ -105,7 +118,9 @@ midi_out::midi_out(const output_configuration& base_conf, const output_api_confi
 LIBREMIDI_INLINE midi_out::~midi_out() = default;
 
 LIBREMIDI_INLINE midi_out::midi_out(midi_out&& other) noexcept
-    : m_impl{std::move(other.m_impl)}
+    : m_stats{std::move(other.m_stats)}
+    , m_jr{std::move(other.m_jr)}
+    , m_impl{std::move(other.m_impl)}
 {
   other.m_impl
       = std::make_unique<libremidi::midi_out_dummy>(output_configuration{}, dummy_configuration{});
@@ -114,6 +129,8 @@ LIBREMIDI_INLINE midi_out::midi_out(midi_out&& other) noexcept
 LIBREMIDI_INLINE midi_out& midi_out::operator=(midi_out&& other) noexcept
 {
   this->m_impl = std::move(other.m_impl);
+  this->m_stats = std::move(other.m_stats);
+  this->m_jr = std::move(other.m_jr);
   other.m_impl
       = std::make_unique<libremidi::midi_out_dummy>(output_configuration{}, dummy_configuration{});
   return *this;
@@ -270,6 +287,16 @@ stdx::error midi_out::send_message(const unsigned char* message, size_t size) co
   assert(size > 0);
 #endif
 
+#if defined(LIBREMIDI_STATS)
+  if (m_stats)
+  {
+    const int64_t t0 = system_ns();
+    auto ret = m_impl->send_message(message, size);
+    m_stats->send.record(system_ns() - t0);
+    m_stats->record_event(size);
+    return ret;
+  }
+#endif
   return m_impl->send_message(message, size);
 }
 
@@ -309,6 +336,16 @@ stdx::error midi_out::send_ump(const uint32_t* message, size_t size) const
   assert(size <= 4);
 #endif
 
+#if defined(LIBREMIDI_STATS)
+  if (m_stats)
+  {
+    const int64_t t0 = system_ns();
+    auto ret = m_impl->send_ump(message, size);
+    m_stats->send.record(system_ns() - t0);
+    m_stats->record_event(size * 4);
+    return ret;
+  }
+#endif
   return m_impl->send_ump(message, size);
 }
 LIBREMIDI_INLINE
@@ -436,6 +473,40 @@ stdx::error midi_out::schedule_ump(int64_t ts, const uint32_t* message, size_t s
   assert(size > 0);
 #endif
 
+  if (m_jr)
+  {
+    const int64_t now = system_ns();
+    if (const uint32_t clock = m_jr->clock(now))
+      m_impl->send_ump(&clock, 1);
+    const uint32_t stamp = m_jr->timestamp(ts, now);
+    if (auto ret = m_impl->schedule_ump(ts, &stamp, 1); ret != stdx::error{})
+      return ret;
+  }
+
   return m_impl->schedule_ump(ts, message, size);
 }
+
+LIBREMIDI_INLINE
+stdx::error midi_out::flush() const
+{
+  if (!m_impl->port_open_) {
+    [[unlikely]];
+    return std::errc::not_connected;
+  }
+  [[likely]];
+
+  return m_impl->flush();
+}
+
+LIBREMIDI_INLINE
+port_stats midi_out::stats() const noexcept
+{
+  return m_stats ? m_stats->snapshot() : port_stats{};
+}
+
+LIBREMIDI_INLINE
+port_counters midi_out::counters() const noexcept
+{
+  return m_impl ? m_impl->counters.load() : port_counters{};
+}
 }
@@ -83,25 +83,55 @@ make_observer(const auto& base_conf, observer_api_configuration api_conf)
   }
 }
 
+// With manual_dispatch, the callbacks of the configuration are replaced by ones which queue
+// the notifications: conf is the copy given to the backend
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION std::unique_ptr<deferred_observer>
+make_deferred_observer(observer_configuration& conf)
+{
+  if (!conf.manual_dispatch || !conf.has_callbacks())
+    return {};
+  return std::make_unique<deferred_observer>(conf);
+}
+
+// The backends driven by the application call the callbacks from their own dispatch().
+// The notifications made while the backend was created are made right away,
+// as notify_in_constructor requires.
+LIBREMIDI_STATIC_INLINE_IMPLEMENTATION void
+finish_deferred_observer(deferred_observer* deferred, const observer_api* impl)
+{
+  if (!deferred || !impl)
+    return;
+  if (impl->descriptor() >= 0)
+    deferred->set_direct();
+  deferred->dispatch();
+}
+
 LIBREMIDI_INLINE observer::observer(const observer_configuration& base_conf) noexcept
-    : m_impl{make_observer(base_conf)}
 {
+  auto conf = base_conf;
+  m_deferred = make_deferred_observer(conf);
+  m_impl = make_observer(conf);
+  finish_deferred_observer(m_deferred.get(), m_impl.get());
 }
 
 LIBREMIDI_INLINE
 observer::observer(const observer_configuration& base_conf, observer_api_configuration api_conf)
-    : m_impl{make_observer(base_conf, std::move(api_conf))}
 {
+  auto conf = base_conf;
+  m_deferred = make_deferred_observer(conf);
+  m_impl = make_observer(conf, std::move(api_conf));
   if (!m_impl)
   {
     error_handler e;
     e.libremidi_handle_error(base_conf, "Could not open observer for the given api");
     m_impl = std::make_unique<observer_dummy>(observer_configuration{}, dummy_configuration{});
   }
+  finish_deferred_observer(m_deferred.get(), m_impl.get());
 }
 
 LIBREMIDI_INLINE observer::observer(observer&& other) noexcept
-    : m_impl{std::move(other.m_impl)}
+    : m_deferred{std::move(other.m_deferred)}
+    , m_impl{std::move(other.m_impl)}
 {
   other.m_impl = std::make_unique<libremidi::observer_dummy>(
       observer_configuration{}, dummy_configuration{});
@@ -109,7 +139,9 @@ LIBREMIDI_INLINE observer::observer(observer&& other) noexcept
 
 LIBREMIDI_INLINE observer& observer::operator=(observer&& other) noexcept
 {
+  // The previous backend is destroyed before the queue it was posting to
   this->m_impl = std::move(other.m_impl);
+  this->m_deferred = std::move(other.m_deferred);
   other.m_impl = std::make_unique<libremidi::observer_dummy>(
       observer_configuration{}, dummy_configuration{});
   return *this;
@@ -135,4 +167,24 @@ std::vector<libremidi::output_port> observer::get_output_ports() const noexcept
 {
   return m_impl->get_output_ports();
 }
+
+LIBREMIDI_INLINE
+int observer::descriptor() const noexcept
+{
+  if (int fd = m_impl->descriptor(); fd >= 0)
+    return fd;
+  return m_deferred ? m_deferred->descriptor() : -1;
+}
+
+LIBREMIDI_INLINE
+stdx::error observer::dispatch()
+{
+  if (m_impl->descriptor() >= 0)
+    return m_impl->dispatch();
+  if (!m_deferred)
+    return std::errc::operation_not_supported;
+
+  m_deferred->dispatch();
+  return stdx::error{};
+}
 }
@@ -30,6 +30,11 @@ struct observer_configuration
   // Notify of the existing ports in the observer constructor
   uint32_t notify_in_constructor : 1 = true;
 
+  //! The callbacks are called from observer::dispatch, called by the application when
+  //! observer::descriptor is readable, instead of from a thread of the backend.
+  //! The backends which can be driven by the application then start no thread at all.
+  bool manual_dispatch{};
+
   bool has_callbacks() const noexcept
   {
     return input_added || input_removed || output_added || output_removed;
@@ -15,7 +15,23 @@ struct output_configuration
   midi_error_callback on_error{};
   midi_warning_callback on_warning{};
 
+  //! Called from the thread of the backend when the MIDI API reports that output was lost
+  //! or delayed, e.g. a PipeWire buffer too small for the events of a cycle.
+  //! See midi_out::counters.
+  overrun_callback on_overrun{};
+
   //! Timestamp mode for the timestamps passed to schedule_message
   uint32_t timestamps : 3 = timestamp_mode::Absolute;
+
+  //! For the backends which queue the messages until their next process cycle (JACK,
+  //! PipeWire): only the latest value of each continuous controller, pitch bend and
+  //! pressure is sent per channel and cycle. See coalescing_table.
+  bool coalesce_controllers{};
+
+  //! The UMP passed to schedule_ump are preceded by a JR Timestamp of their time on the
+  //! monotonic clock, for the receivers to remove the jitter of the transport. A JR Clock
+  //! message is sent before them when none was in the last quarter of a second: there is
+  //! no timer, an idle output sends none. See jr_timestamp_encoder.
+  bool jr_timestamps{};
 };
 }
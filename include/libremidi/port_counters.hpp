@@ -0,0 +1,68 @@
+#pragma once
+#include <libremidi/config.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+NAMESPACE_LIBREMIDI
+{
+//! Events lost, discarded or altered on an input or output since it was created
+struct port_counters
+{
+  //! Events lost because a buffer was full: the queue of a queued or manually dispatched
+  //! input, the JACK port buffer of the cycle, the events JACK reports as lost...
+  uint64_t dropped{};
+
+  //! Overruns reported by the MIDI API, each of which may have lost several events:
+  //! ALSA sequencer FIFO overflows, ALSA raw MIDI xruns, lost JACK events, PipeWire output
+  //! buffers too small for the events of a cycle (the rest is sent on the next cycle).
+  uint64_t overruns{};
+
+  //! Events discarded on purpose, with ignore_sysex, ignore_timing or ignore_sensing
+  uint64_t filtered{};
+
+  //! Events cut short, e.g. a message whose data bytes are missing from the packet
+  uint64_t truncated{};
+
+  //! Invalid data discarded by the parser, e.g. data bytes without a status byte
+  uint64_t malformed{};
+};
+
+//! Called from the thread of the backend when the MIDI API reports an overrun
+using overrun_callback = std::function<void()>;
+
+//! The counters as the backends update them, readable from any thread
+struct atomic_port_counters
+{
+  std::atomic<uint64_t> dropped{};
+  std::atomic<uint64_t> overruns{};
+  std::atomic<uint64_t> filtered{};
+  std::atomic<uint64_t> truncated{};
+  std::atomic<uint64_t> malformed{};
+
+  static void add(std::atomic<uint64_t>& counter, uint64_t n = 1) noexcept
+  {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  //! Counts an overrun reported by the API, and notifies it
+  void overrun(const overrun_callback& on_overrun)
+  {
+    add(overruns);
+    if (on_overrun)
+      on_overrun();
+  }
+
+  [[nodiscard]] port_counters load() const noexcept
+  {
+    return {
+        .dropped = dropped.load(std::memory_order_relaxed),
+        .overruns = overruns.load(std::memory_order_relaxed),
+        .filtered = filtered.load(std::memory_order_relaxed),
+        .truncated = truncated.load(std::memory_order_relaxed),
+        .malformed = malformed.load(std::memory_order_relaxed),
+    };
+  }
+};
+}
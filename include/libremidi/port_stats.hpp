@@ -0,0 +1,209 @@
+#pragma once
+#include <libremidi/config.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+NAMESPACE_LIBREMIDI
+{
+//! Whether the statistics are collected: libremidi must be built with LIBREMIDI_STATS.
+//! Without it, no measurement is made and the snapshots are empty.
+#if defined(LIBREMIDI_STATS)
+inline constexpr bool port_stats_enabled = true;
+#else
+inline constexpr bool port_stats_enabled = false;
+#endif
+
+//! A distribution of durations in log-linear buckets, as in HdrHistogram: exact below 8ns,
+//! then 8 buckets per power of two, i.e. with a precision of 12.5%.
+//! Durations above 2^36 ns (about a minute) are counted in the last bucket.
+struct duration_histogram
+{
+  static constexpr int sub_bucket_bits = 3;
+  static constexpr int sub_buckets = 1 << sub_bucket_bits;
+  static constexpr int max_bits = 36;
+  static constexpr int buckets = (max_bits - sub_bucket_bits + 1) * sub_buckets;
+
+  static constexpr int bucket(uint64_t ns) noexcept
+  {
+    if (ns < sub_buckets)
+      return static_cast<int>(ns);
+    if (ns >= (uint64_t(1) << max_bits))
+      return buckets - 1;
+
+    const int e = std::bit_width(ns) - 1;
+    const int mantissa = static_cast<int>(ns >> (e - sub_bucket_bits)) & (sub_buckets - 1);
+    return ((e - sub_bucket_bits + 1) << sub_bucket_bits) + mantissa;
+  }
+
+  //! Smallest duration counted in a bucket
+  static constexpr uint64_t lowest(int bucket) noexcept
+  {
+    if (bucket < sub_buckets)
+      return static_cast<uint64_t>(bucket);
+    const int e = (bucket >> sub_bucket_bits) + sub_bucket_bits - 1;
+    const uint64_t mantissa = sub_buckets + (bucket & (sub_buckets - 1));
+    return mantissa << (e - sub_bucket_bits);
+  }
+
+  //! Largest duration counted in a bucket
+  static constexpr uint64_t highest(int bucket) noexcept
+  {
+    if (bucket < sub_buckets)
+      return static_cast<uint64_t>(bucket);
+    const int e = (bucket >> sub_bucket_bits) + sub_bucket_bits - 1;
+    return lowest(bucket) + (uint64_t(1) << (e - sub_bucket_bits)) - 1;
+  }
+
+  std::array<uint64_t, buckets> counts{};
+  uint64_t count{};
+  uint64_t sum_ns{};
+  uint64_t max_ns{};
+
+  [[nodiscard]] double mean_ns() const noexcept
+  {
+    return count > 0 ? static_cast<double>(sum_ns) / static_cast<double>(count) : 0.;
+  }
+
+  //! Upper bound of the bucket of the given quantile, e.g. 0.99 for the 99th percentile
+  [[nodiscard]] uint64_t quantile_ns(double q) const noexcept
+  {
+    if (count == 0)
+      return 0;
+
+    const auto rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < buckets; i++)
+    {
+      seen += counts[i];
+      if (seen >= rank)
+        return std::min(highest(i), max_ns);
+    }
+    return max_ns;
+  }
+};
+
+//! A snapshot of the statistics of an input or output
+struct port_stats
+{
+  //! Messages received or sent
+  uint64_t events{};
+
+  //! Their size: MIDI 1 bytes, or 4 bytes per UMP word
+  uint64_t bytes{};
+
+  //! Input: from the timestamp of a message to the call of on_message, or to its push
+  //! in the queue with queue_size. Only measured with timestamp_mode::SystemMonotonic.
+  duration_histogram latency;
+
+  //! Input: difference between two consecutive inter-arrival intervals
+  duration_histogram jitter;
+
+  //! Input: time spent in on_message
+  duration_histogram callback;
+
+  //! Output: time spent in the backend to send a message, until it is handed to the driver,
+  //! server or socket. How close this is to the wire depends on the backend.
+  duration_histogram send;
+};
+
+//! The statistics of an input or output, as they are recorded: the backend thread records
+//! without locking, and snapshot() can be called from any thread.
+class port_statistics
+{
+public:
+  class recorder
+  {
+  public:
+    void record(int64_t ns) noexcept
+    {
+      const auto v = static_cast<uint64_t>(ns > 0 ? ns : 0);
+      m_counts[duration_histogram::bucket(v)].fetch_add(1, std::memory_order_relaxed);
+      m_sum.fetch_add(v, std::memory_order_relaxed);
+
+      uint64_t max = m_max.load(std::memory_order_relaxed);
+      while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed))
+        ;
+    }
+
+    void snapshot(duration_histogram& h) const noexcept
+    {
+      h.count = 0;
+      for (int i = 0; i < duration_histogram::buckets; i++)
+      {
+        h.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        h.count += h.counts[i];
+      }
+      h.sum_ns = m_sum.load(std::memory_order_relaxed);
+      h.max_ns = m_max.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, duration_histogram::buckets> m_counts{};
+    std::atomic<uint64_t> m_sum{};
+    std::atomic<uint64_t> m_max{};
+  };
+
+  //! A message went through the port
+  void record_event(std::size_t bytes) noexcept
+  {
+    m_events.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  //! A message was received at now_ns: only called from the thread of the backend
+  void record_arrival(int64_t now_ns) noexcept
+  {
+    if (m_last_arrival != 0)
+    {
+      const int64_t interval = now_ns - m_last_arrival;
+      if (m_last_interval >= 0)
+      {
+        const int64_t variation = interval - m_last_interval;
+        jitter.record(variation >= 0 ? variation : -variation);
+      }
+      m_last_interval = interval;
+    }
+    m_last_arrival = now_ns;
+  }
+
+  [[nodiscard]] port_stats snapshot() const noexcept
+  {
+    port_stats s;
+    s.events = m_events.load(std::memory_order_relaxed);
+    s.bytes = m_bytes.load(std::memory_order_relaxed);
+    latency.snapshot(s.latency);
+    jitter.snapshot(s.jitter);
+    callback.snapshot(s.callback);
+    send.snapshot(s.send);
+    return s;
+  }
+
+  recorder latency;
+  recorder jitter;
+  recorder callback;
+  recorder send;
+
+private:
+  std::atomic<uint64_t> m_events{};
+  std::atomic<uint64_t> m_bytes{};
+
+  int64_t m_last_arrival{};
+  int64_t m_last_interval{-1};
+};
+
+//! Null unless built with LIBREMIDI_STATS
+inline std::unique_ptr<port_statistics> make_port_statistics()
+{
+#if defined(LIBREMIDI_STATS)
+  return std::make_unique<port_statistics>();
+#else
+  return {};
+#endif
+}
+}
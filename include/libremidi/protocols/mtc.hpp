@@ -0,0 +1,380 @@
+#pragma once
+
+#include <libremidi/config.hpp>
+#include <libremidi/detail/polyfill.hpp>
+#include <libremidi/message.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+// MIDI Time Code (MTC)
+// MMA MIDI 1.0 Detailed Specification, MIDI Time Code: quarter frames (0xF1) and
+// full frame messages (F0 7F <device> 01 01 hr mn sc fr F7)
+NAMESPACE_LIBREMIDI
+{
+struct mtc_protocol
+{
+  // Bits 5-6 of the hours byte, as in the MMC locate command
+  enum class frame_rate : uint8_t
+  {
+    fps_24 = 0,
+    fps_25 = 1,
+    fps_30_drop = 2, // 29.97 fps, drop frame
+    fps_30 = 3,
+  };
+
+  struct timecode
+  {
+    uint8_t hours{}, minutes{}, seconds{}, frames{};
+    frame_rate rate{};
+
+    bool operator==(const timecode&) const noexcept = default;
+  };
+
+  // Frames per second of the timecode numbering
+  static constexpr int nominal_fps(frame_rate r) noexcept
+  {
+    switch (r)
+    {
+      case frame_rate::fps_24:
+        return 24;
+      case frame_rate::fps_25:
+        return 25;
+      default:
+        return 30;
+    }
+  }
+
+  // Frames per second of real time
+  static constexpr double fps(frame_rate r) noexcept
+  {
+    return r == frame_rate::fps_30_drop ? 30000. / 1001. : nominal_fps(r);
+  }
+
+  static constexpr int64_t frames_per_day(frame_rate r) noexcept
+  {
+    // Drop frame: 2 frame numbers skipped every minute, except every tenth minute
+    if (r == frame_rate::fps_30_drop)
+      return 24 * 6 * 17982;
+    return 24 * 3600 * nominal_fps(r);
+  }
+
+  // Frames since 00:00:00:00
+  static constexpr int64_t to_frames(const timecode& tc) noexcept
+  {
+    const int64_t fps = nominal_fps(tc.rate);
+    const int64_t minutes = tc.hours * 60 + tc.minutes;
+    int64_t frames = (minutes * 60 + tc.seconds) * fps + tc.frames;
+    if (tc.rate == frame_rate::fps_30_drop)
+      frames -= 2 * (minutes - minutes / 10);
+    return frames;
+  }
+
+  // The timecode of a frame, wrapped around midnight
+  static constexpr timecode from_frames(int64_t frames, frame_rate r) noexcept
+  {
+    const int64_t day = frames_per_day(r);
+    frames = ((frames % day) + day) % day;
+
+    if (r == frame_rate::fps_30_drop)
+    {
+      const int64_t tens = frames / 17982;
+      const int64_t rest = frames % 17982;
+      frames += 18 * tens;
+      if (rest > 1)
+        frames += 2 * ((rest - 2) / 1798);
+    }
+
+    const int64_t fps = nominal_fps(r);
+    return timecode{
+        .hours = static_cast<uint8_t>(frames / (fps * 3600)),
+        .minutes = static_cast<uint8_t>((frames / (fps * 60)) % 60),
+        .seconds = static_cast<uint8_t>((frames / fps) % 60),
+        .frames = static_cast<uint8_t>(frames % fps),
+        .rate = r};
+  }
+
+  // Data byte of the quarter frame message piece (0-7) of a timecode: 0nnndddd
+  static constexpr uint8_t quarter_frame_data(const timecode& tc, int piece) noexcept
+  {
+    uint8_t value{};
+    switch (piece & 7)
+    {
+      case 0:
+      case 1:
+        value = tc.frames;
+        break;
+      case 2:
+      case 3:
+        value = tc.seconds;
+        break;
+      case 4:
+      case 5:
+        value = tc.minutes;
+        break;
+      default:
+        value = static_cast<uint8_t>(tc.hours | (to_underlying(tc.rate) << 5));
+        break;
+    }
+    const uint8_t nibble = (piece & 1) ? (value >> 4) : (value & 0x0F);
+    return static_cast<uint8_t>(((piece & 7) << 4) | (nibble & 0x0F));
+  }
+
+  // F1 0nnndddd
+  static libremidi::message make_quarter_frame(const timecode& tc, int piece)
+  {
+    return libremidi::message{0xF1, quarter_frame_data(tc, piece)};
+  }
+
+  // F0 7F <device_id> 01 01 hr mn sc fr F7
+  static libremidi::message make_full_frame(const timecode& tc, uint8_t device_id = 0x7F)
+  {
+    const auto hr = static_cast<uint8_t>((tc.hours & 0x1F) | (to_underlying(tc.rate) << 5));
+    return libremidi::message{
+        0xF0, 0x7F, device_id, 0x01, 0x01, hr, tc.minutes, tc.seconds, tc.frames, 0xF7};
+  }
+
+  static constexpr timecode decode_hours_byte(uint8_t hr, timecode tc) noexcept
+  {
+    tc.hours = hr & 0x1F;
+    tc.rate = static_cast<frame_rate>((hr >> 5) & 0x03);
+    return tc;
+  }
+};
+
+// Position of an MTC source, as assembled by mtc_assembler
+struct mtc_state
+{
+  // Whether a full sequence of quarter frames was received and they keep arriving in order
+  bool locked{};
+
+  // 1 when playing, -1 when playing backwards, 0 until known or after a full frame message
+  int8_t direction{};
+
+  mtc_protocol::frame_rate rate{};
+
+  // Position in quarter frames since 00:00:00:00
+  int64_t quarter_frames{};
+
+  // Timestamp of the last quarter frame or full frame message, in nanoseconds
+  int64_t time{};
+
+  [[nodiscard]] mtc_protocol::timecode timecode() const noexcept
+  {
+    return mtc_protocol::from_frames(quarter_frames / 4, rate);
+  }
+
+  [[nodiscard]] double seconds() const noexcept
+  {
+    return static_cast<double>(quarter_frames) / (4. * mtc_protocol::fps(rate));
+  }
+
+  // Position interpolated at a later time while locked. Bounded to one frame after the
+  // last quarter frame, as they stop being sent when the source stops.
+  [[nodiscard]] double seconds_at(int64_t time_ns) const noexcept
+  {
+    if (!locked)
+      return seconds();
+    const double frame = 1. / mtc_protocol::fps(rate);
+    const double elapsed = std::clamp(static_cast<double>(time_ns - time) * 1e-9, 0., frame);
+    return seconds() + direction * elapsed;
+  }
+};
+
+struct mtc_event
+{
+  enum kind_t : uint8_t
+  {
+    // A new frame, while locked
+    position,
+
+    // Quarter frames are assembled: the position is known
+    locked,
+
+    // The quarter frames stopped, changed direction or skipped
+    unlocked,
+
+    // A full frame message located the source
+    full_frame,
+  } kind{};
+
+  mtc_state state;
+};
+
+using mtc_callback = std::function<void(const mtc_event&)>;
+
+// Gathers MTC quarter frames into positions.
+// The 8 quarter frames of a timecode span 2 frames: the assembled position is that of the
+// quarter frame which completes the sequence, and advances by a quarter frame with each
+// of the following ones. Positions are only notified once per frame.
+// The input thread updates the state without locking, state() can be called from any thread.
+struct mtc_assembler
+{
+  // Quarter frames this far apart, in nanoseconds, are not part of the same sequence:
+  // about 4 frames at 24 fps
+  static constexpr int64_t max_gap_ns = 160'000'000;
+
+  // Processes a message received at time_ns, if it is a quarter frame or a full frame
+  void process(std::span<const uint8_t> bytes, int64_t time_ns, const mtc_callback& cb)
+  {
+    if (bytes.size() >= 2 && bytes[0] == 0xF1)
+      quarter_frame(bytes[1], time_ns, cb);
+    else if (
+        bytes.size() >= 10 && bytes[0] == 0xF0 && bytes[1] == 0x7F && bytes[3] == 0x01
+        && bytes[4] == 0x01 && bytes[9] == 0xF7)
+      full_frame(bytes.subspan(5, 4), time_ns, cb);
+  }
+
+  void process(const libremidi::message& msg, const mtc_callback& cb)
+  {
+    process({msg.bytes.data(), msg.bytes.size()}, msg.timestamp, cb);
+  }
+
+  // A consistent snapshot of the state
+  [[nodiscard]] mtc_state state() const noexcept
+  {
+    mtc_state s;
+    uint32_t seq0{}, seq1{};
+    do
+    {
+      seq0 = m_seq.load(std::memory_order_acquire);
+      s.locked = m_shared_locked.load(std::memory_order_relaxed);
+      s.direction = m_shared_direction.load(std::memory_order_relaxed);
+      s.rate = m_shared_rate.load(std::memory_order_relaxed);
+      s.quarter_frames = m_shared_position.load(std::memory_order_relaxed);
+      s.time = m_shared_time.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      seq1 = m_seq.load(std::memory_order_relaxed);
+    } while (seq0 != seq1 || (seq0 & 1));
+    return s;
+  }
+
+private:
+  void quarter_frame(uint8_t data, int64_t t, const mtc_callback& cb)
+  {
+    const int piece = (data >> 4) & 7;
+
+    int8_t direction = 0;
+    if (m_count > 0 && t - m_time <= max_gap_ns)
+    {
+      if (piece == ((m_piece + 1) & 7))
+        direction = 1;
+      else if (piece == ((m_piece + 7) & 7))
+        direction = -1;
+    }
+    m_time = t;
+    m_piece = piece;
+    m_nibbles[piece] = data & 0x0F;
+
+    if (direction == 0 || (m_direction != 0 && direction != m_direction))
+    {
+      // Start assembling again from this quarter frame
+      m_count = 1;
+      m_direction = 0;
+      if (m_locked)
+      {
+        m_locked = false;
+        notify(mtc_event::unlocked, cb);
+      }
+      return;
+    }
+
+    m_direction = direction;
+    m_count++;
+
+    if (m_locked)
+    {
+      const int64_t day = 4 * mtc_protocol::frames_per_day(m_rate);
+      m_position = (m_position + m_direction + day) % day;
+    }
+
+    // The last quarter frame of a sequence in this direction: the timecode is complete
+    if (m_count >= 8 && piece == (m_direction > 0 ? 7 : 0))
+    {
+      const auto frames = [this](int lo) { return m_nibbles[lo] | (m_nibbles[lo + 1] << 4); };
+      const auto tc = mtc_protocol::decode_hours_byte(
+          static_cast<uint8_t>(frames(6)),
+          {.minutes = static_cast<uint8_t>(frames(4) & 0x3F),
+           .seconds = static_cast<uint8_t>(frames(2) & 0x3F),
+           .frames = static_cast<uint8_t>(frames(0) & 0x1F)});
+      const int64_t position = 4 * mtc_protocol::to_frames(tc) + piece;
+
+      if (!m_locked)
+      {
+        m_locked = true;
+        m_rate = tc.rate;
+        m_position = position;
+        return notify(mtc_event::locked, cb);
+      }
+      if (position != m_position || tc.rate != m_rate)
+      {
+        // The source jumped: follow it
+        m_rate = tc.rate;
+        m_position = position;
+        return notify(mtc_event::position, cb);
+      }
+    }
+
+    if (m_locked && m_position % 4 == 0)
+      notify(mtc_event::position, cb);
+    else
+      publish();
+  }
+
+  void full_frame(std::span<const uint8_t> data, int64_t t, const mtc_callback& cb)
+  {
+    const auto tc = mtc_protocol::decode_hours_byte(
+        data[0], {.minutes = static_cast<uint8_t>(data[1] & 0x3F),
+                  .seconds = static_cast<uint8_t>(data[2] & 0x3F),
+                  .frames = static_cast<uint8_t>(data[3] & 0x1F)});
+    m_rate = tc.rate;
+    m_position = 4 * mtc_protocol::to_frames(tc);
+    m_time = t;
+    m_locked = false;
+    m_direction = 0;
+    m_count = 0;
+    notify(mtc_event::full_frame, cb);
+  }
+
+  void notify(mtc_event::kind_t kind, const mtc_callback& cb)
+  {
+    publish();
+    if (cb)
+      cb(mtc_event{.kind = kind, .state = state()});
+  }
+
+  void publish() noexcept
+  {
+    const uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_shared_locked.store(m_locked, std::memory_order_relaxed);
+    m_shared_direction.store(m_locked ? m_direction : int8_t{}, std::memory_order_relaxed);
+    m_shared_rate.store(m_rate, std::memory_order_relaxed);
+    m_shared_position.store(m_position, std::memory_order_relaxed);
+    m_shared_time.store(m_time, std::memory_order_relaxed);
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  // Input thread
+  uint8_t m_nibbles[8]{};
+  int m_piece{};
+  int m_count{};
+  int8_t m_direction{};
+  bool m_locked{};
+  mtc_protocol::frame_rate m_rate{};
+  int64_t m_position{};
+  int64_t m_time{};
+
+  // Published state
+  std::atomic<uint32_t> m_seq{};
+  std::atomic<bool> m_shared_locked{};
+  std::atomic<int8_t> m_shared_direction{};
+  std::atomic<mtc_protocol::frame_rate> m_shared_rate{};
+  std::atomic<int64_t> m_shared_position{};
+  std::atomic<int64_t> m_shared_time{};
+};
+}
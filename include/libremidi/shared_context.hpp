@@ -1,6 +1,7 @@
 #pragma once
 #include <libremidi/api.hpp>
 #include <libremidi/configurations.hpp>
+#include <libremidi/thread_configuration.hpp>
 
 NAMESPACE_LIBREMIDI
 {
@@ -28,6 +29,7 @@ struct shared_configurations
 };
 
 LIBREMIDI_EXPORT
-shared_configurations create_shared_context(libremidi::API api, std::string_view client_name);
+shared_configurations create_shared_context(
+    libremidi::API api, std::string_view client_name, const thread_configuration& thread = {});
 
 }
@@ -0,0 +1,67 @@
+#pragma once
+#include <libremidi/config.hpp>
+#include <libremidi/error.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+NAMESPACE_LIBREMIDI
+{
+//! Scheduling policy of a thread
+enum class thread_policy
+{
+  //! The policy of the process, e.g. SCHED_OTHER
+  Default,
+
+  //! SCHED_FIFO
+  Fifo,
+
+  //! SCHED_RR
+  RoundRobin
+};
+
+//! What could actually be applied to a thread
+struct thread_report
+{
+  thread_policy policy{thread_policy::Default};
+  int priority{};
+
+  bool affinity_applied{};
+  bool memory_locked{};
+  bool name_applied{};
+
+  //! The first failure, e.g. std::errc::operation_not_permitted when the process
+  //! lacks the privileges for real-time scheduling. The thread then runs anyway,
+  //! with what could be applied.
+  stdx::error error{};
+};
+
+//! Configuration of the threads created by the library to read MIDI input or
+//! to watch for devices
+struct thread_configuration
+{
+  thread_policy policy{thread_policy::Default};
+
+  //! Real-time priority, from 1 to 99 with Fifo and RoundRobin.
+  //! Clamped to RLIMIT_RTPRIO when the process cannot use a higher one.
+  int priority{};
+
+  //! Indices of the CPUs on which the thread may run. Empty for no restriction.
+  std::vector<int> cpu_affinity{};
+
+  //! Lock the current and future memory of the process with mlockall,
+  //! so that the thread does not wait for pages to be swapped in.
+  bool lock_memory{};
+
+  //! Bytes of stack touched when the thread starts, so that it does not page-fault later
+  std::size_t stack_prefault{};
+
+  //! Name of the thread, truncated to 15 characters on Linux
+  std::string name{};
+
+  //! Called from the thread once it is configured, with what could be applied
+  std::function<void(const thread_report&)> on_started{};
+};
+}
@@ -56,6 +56,7 @@ module;
 #if defined(LIBREMIDI_NETWORK)
   #include <boost/asio/io_context.hpp>
   #include <boost/asio/ip/udp.hpp>
+  #include <boost/asio/steady_timer.hpp>
   #include <boost/container/small_vector.hpp>
   #include <boost/container/static_vector.hpp>
   #include <boost/endian.hpp>
@@ -138,6 +139,9 @@ module;
 #include <cinttypes>
 #include <compare>
 #include <condition_variable>
+#if __has_include(<coroutine>)
+#include <coroutine>
+#endif
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -207,9 +211,13 @@ export module libremidi;
 #include <libremidi/api-c.h>
 #include <libremidi/api.hpp>
 #include <libremidi/backends.hpp>
+#include <libremidi/clock_tracker.hpp>
 #include <libremidi/cmidi2.hpp>
+#include <libremidi/coalescing.hpp>
 #include <libremidi/configurations.hpp>
+#include <libremidi/coroutines.hpp>
 #include <libremidi/defaults.hpp>
+#include <libremidi/detail/clock_correlator.hpp>
 #include <libremidi/detail/conversion.hpp>
 #include <libremidi/detail/memory.hpp>
 #include <libremidi/detail/midi_api.hpp>
@@ -222,11 +230,16 @@ export module libremidi;
 #include <libremidi/error.hpp>
 #include <libremidi/error_handler.hpp>
 #include <libremidi/input_configuration.hpp>
+#include <libremidi/input_queue.hpp>
+#include <libremidi/jr_timestamps.hpp>
+#include <libremidi/manual_dispatch.hpp>
 #include <libremidi/libremidi-c.h>
 #include <libremidi/libremidi.hpp>
 #include <libremidi/message.hpp>
 #include <libremidi/observer_configuration.hpp>
 #include <libremidi/output_configuration.hpp>
+#include <libremidi/port_counters.hpp>
+#include <libremidi/port_stats.hpp>
 #include <libremidi/reader.hpp>
 #include <libremidi/shared_context.hpp>
 #include <libremidi/system_error2.hpp>
@@ -0,0 +1,128 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/detail/clock_correlator.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+// A backend clock running `drift` slower than the monotonic clock, and events received
+// after a delivery latency of at least 20µs, usually a few hundred µs, sometimes milliseconds
+struct simulated_backend
+{
+  double drift{};
+  int64_t offset{};
+  std::mt19937_64 rng{1234};
+  std::exponential_distribution<double> latency{1. / 300'000.};
+
+  int64_t backend_time(int64_t monotonic) const
+  {
+    return static_cast<int64_t>((monotonic - offset) / (1. + drift));
+  }
+
+  int64_t arrival(int64_t monotonic) { return monotonic + 20'000 + int64_t(latency(rng)); }
+};
+}
+
+TEST_CASE("clock correlation without observations", "[clock_correlator]")
+{
+  libremidi::clock_correlator clk;
+  REQUIRE_FALSE(clk.valid());
+  REQUIRE(clk.to_monotonic(1234) == 1234);
+  REQUIRE(clk.offset_ns() == 0);
+}
+
+TEST_CASE("clock correlation with drift and jitter", "[clock_correlator]")
+{
+  simulated_backend backend{.drift = 50e-6, .offset = 3'000'000'000};
+  libremidi::clock_correlator clk;
+
+  // Ten seconds of events every 5ms
+  int64_t t = 10'000'000'000;
+  for (int i = 0; i < 2000; i++, t += 5'000'000)
+    clk.observe(backend.backend_time(t), backend.arrival(t));
+
+  REQUIRE(clk.valid());
+  REQUIRE(clk.drift_ppm() > 48.);
+  REQUIRE(clk.drift_ppm() < 52.);
+
+  // The events are placed near their emission time, not ~300µs later at their arrival time
+  std::vector<int64_t> errors;
+  for (int i = 0; i < 200; i++, t += 5'000'000)
+  {
+    const int64_t b = backend.backend_time(t);
+    clk.observe(b, backend.arrival(t));
+    const int64_t error = clk.to_monotonic(b) - t;
+    REQUIRE(error > -5'000);
+    REQUIRE(error < 60'000);
+  }
+}
+
+TEST_CASE("clock correlation after a jump of the backend clock", "[clock_correlator]")
+{
+  simulated_backend backend{.drift = 0., .offset = 1'000'000'000};
+  libremidi::clock_correlator clk;
+
+  int64_t t = 0;
+  for (int i = 0; i < 1000; i++, t += 5'000'000)
+    clk.observe(backend.backend_time(t), backend.arrival(t));
+  REQUIRE(std::abs(clk.offset_ns() - 1'000'000'000) < 50'000);
+
+  // e.g. the ALSA sequencer queue was restarted
+  backend.offset = t;
+  for (int i = 0; i < 100; i++, t += 5'000'000)
+    clk.observe(backend.backend_time(t), backend.arrival(t));
+  REQUIRE(std::abs(clk.offset_ns() - backend.offset) < 50'000);
+}
+
+TEST_CASE("system monotonic timestamps of a backend clock", "[clock_correlator]")
+{
+  libremidi::input_configuration conf;
+  conf.timestamps = libremidi::timestamp_mode::SystemMonotonic;
+  libremidi::midi1::input_state_machine sm{conf};
+
+  static constexpr libremidi::timestamp_backend_info info{
+      .has_absolute_timestamps = true,
+      .absolute_is_monotonic = false,
+      .has_samples = false,
+  };
+
+  // A backend clock which started 42 seconds ago
+  const int64_t start = libremidi::system_ns() - 42'000'000'000;
+  for (int i = 0; i < 10; i++)
+  {
+    const int64_t now = libremidi::system_ns();
+    const int64_t ts = sm.timestamp<info>([=] { return now - start; }, 0);
+    REQUIRE(ts <= libremidi::system_ns());
+    REQUIRE(ts >= now);
+  }
+}
+
+TEST_CASE("system monotonic timestamps of unstamped events", "[clock_correlator]")
+{
+  libremidi::input_configuration conf;
+  conf.timestamps = libremidi::timestamp_mode::SystemMonotonic;
+  libremidi::midi1::input_state_machine sm{conf};
+
+  static constexpr libremidi::timestamp_backend_info info{
+      .has_absolute_timestamps = true,
+      .absolute_is_monotonic = false,
+      .has_samples = false,
+  };
+
+  // e.g. raw I/O, where the transport passes 0 when it does not know
+  int64_t previous = 0;
+  for (int i = 0; i < 10; i++)
+  {
+    const int64_t now = libremidi::system_ns();
+    const int64_t ts = sm.timestamp<info>([] { return int64_t{0}; }, 0);
+    REQUIRE(ts >= now);
+    REQUIRE(ts >= previous);
+    previous = ts;
+  }
+  REQUIRE_FALSE(sm.clock_correlation.valid());
+}
@@ -0,0 +1,227 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/coalescing.hpp>
+#include <libremidi/configurations.hpp>
+#include <libremidi/libremidi.hpp>
+#include <libremidi/ump_events.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
+using libremidi::message;
+using ce = libremidi::channel_events;
+
+static bool same(const libremidi::ump& a, const libremidi::ump& b)
+{
+  return std::equal(std::begin(a.data), std::end(a.data), std::begin(b.data));
+}
+
+TEST_CASE("controller keys", "[coalescing]")
+{
+  using t = libremidi::coalescing_table;
+  REQUIRE(t::key(0xB0, 1) == t::key(0xB0, 1));
+  REQUIRE(t::key(0xB0, 1) != t::key(0xB1, 1));
+  REQUIRE(t::key(0xB0, 1) != t::key(0xB0, 7));
+  REQUIRE(t::key(0xA0, 60) != t::key(0xA0, 61));
+  REQUIRE(t::key(0xE3, 0) >= 0);
+  REQUIRE(t::key(0xD3, 0) >= 0);
+
+  REQUIRE(t::key(0x90, 60) == t::barrier);
+  REQUIRE(t::key(0xC0, 1) == t::barrier);
+  REQUIRE(t::key(0xF0, 0x7E) == t::barrier);
+  REQUIRE(t::key(0xB0, 64) == t::barrier);
+  REQUIRE(t::key(0xB0, 101) == t::barrier);
+  REQUIRE(t::key(0xB0, 123) == t::barrier);
+  REQUIRE(t::key(0xF8, 0) == t::pass);
+
+  for (int status = 0x80; status < 0xF0; status++)
+    for (int data = 0; data < 128; data++)
+      REQUIRE(t::key(uint8_t(status), uint8_t(data)) < t::midi1_keys);
+}
+
+TEST_CASE("coalesce MIDI 1 messages", "[coalescing]")
+{
+  std::vector<message> msgs{
+      ce::control_change(1, 1, 1),
+      ce::control_change(1, 7, 10),
+      ce::control_change(1, 1, 2),
+      ce::pitch_bend(1, 100),
+      ce::control_change(1, 1, 3),
+      ce::note_on(1, 60, 100),
+      ce::control_change(1, 1, 4),
+      ce::control_change(2, 1, 40),
+      ce::control_change(1, 1, 5),
+      ce::control_change(1, 64, 127),
+      ce::control_change(1, 64, 0),
+      message{0xF8},
+      ce::control_change(1, 1, 6),
+  };
+
+  libremidi::coalescing_table table{libremidi::coalescing_table::midi1_keys};
+  const auto n = table.coalesce(std::span<message>{msgs});
+
+  const std::vector<message> expected{
+      ce::control_change(1, 7, 10),
+      ce::pitch_bend(1, 100),
+      ce::control_change(1, 1, 3),
+      ce::note_on(1, 60, 100),
+      ce::control_change(2, 1, 40),
+      ce::control_change(1, 1, 5),
+      ce::control_change(1, 64, 127),
+      ce::control_change(1, 64, 0),
+      message{0xF8},
+      ce::control_change(1, 1, 6),
+  };
+  REQUIRE(n == expected.size());
+  for (std::size_t i = 0; i < n; i++)
+    REQUIRE(msgs[i].bytes == expected[i].bytes);
+
+  // The previous batches do not interfere
+  std::vector<message> next{ce::control_change(1, 1, 7)};
+  REQUIRE(table.coalesce(std::span<message>{next}) == 1);
+}
+
+TEST_CASE("coalesce UMP", "[coalescing]")
+{
+  namespace ev = libremidi::ump_events;
+  const auto cc_100 = ev::control_change(0, 0, 1, 100);
+  const auto cc_200 = ev::control_change(0, 0, 1, 200);
+  const auto cc_group_1 = ev::control_change(1, 0, 1, 100);
+  const auto bend_1 = ev::pitch_bend(0, 0, 1);
+  const auto bend_2 = ev::pitch_bend(0, 0, 2);
+  const libremidi::ump per_note_bend_60{0x40603C00, 0x80000000};
+  const libremidi::ump per_note_bend_61{0x40603D00, 0x80000000};
+  const libremidi::ump jr_timestamp{0x00200010};
+
+  std::vector<libremidi::ump> msgs{
+      cc_100, cc_group_1, per_note_bend_60, per_note_bend_61, jr_timestamp,
+      cc_200, per_note_bend_60, bend_1, bend_2,
+  };
+
+  libremidi::coalescing_table table{libremidi::coalescing_table::ump_keys};
+  const auto n = table.coalesce(std::span<libremidi::ump>{msgs});
+  REQUIRE(n == 6);
+  REQUIRE(same(msgs[0], cc_group_1));
+  REQUIRE(same(msgs[1], per_note_bend_61));
+  REQUIRE(same(msgs[2], jr_timestamp));
+  REQUIRE(same(msgs[3], cc_200));
+  REQUIRE(same(msgs[4], per_note_bend_60));
+  REQUIRE(same(msgs[5], bend_2));
+}
+
+TEST_CASE("coalesced queued input", "[coalescing]")
+{
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{.queue_size = 256, .coalesce_controllers = true},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+
+  for (uint8_t v = 0; v < 100; v++)
+  {
+    const uint8_t cc[3]{0xB0, 1, v};
+    on_receive(cc, 0);
+  }
+  const uint8_t note[3]{0x90, 60, 100};
+  on_receive(note, 0);
+
+  SECTION("poll")
+  {
+    std::vector<message> msgs(256);
+    REQUIRE(midiin.poll(msgs) == 2);
+    REQUIRE(msgs[0].bytes == ce::control_change(1, 1, 99).bytes);
+    REQUIRE(msgs[1].bytes == ce::note_on(1, 60, 100).bytes);
+  }
+
+  SECTION("try_read")
+  {
+    message msg;
+    REQUIRE(midiin.try_read(msg));
+    REQUIRE(msg.bytes == ce::control_change(1, 1, 99).bytes);
+
+    // Read ahead: handed out before what is queued afterwards
+    const uint8_t note_off[3]{0x80, 60, 0};
+    on_receive(note_off, 0);
+    std::vector<message> msgs(256);
+    REQUIRE(midiin.poll(msgs) == 1);
+    REQUIRE(msgs[0].bytes == ce::note_on(1, 60, 100).bytes);
+    REQUIRE(midiin.try_read(msg));
+    REQUIRE(msg.bytes == ce::note_off(1, 60, 0).bytes);
+    REQUIRE(!midiin.try_read(msg));
+  }
+}
+
+TEST_CASE("coalesced manual dispatch", "[coalescing]")
+{
+  std::vector<message> received;
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .on_message = [&](message&& m) { received.push_back(std::move(m)); },
+          .manual_dispatch = true,
+          .coalesce_controllers = true},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+
+  for (int v = 0; v < 100; v++)
+  {
+    const uint8_t bend[3]{0xE0, 0, uint8_t(v)};
+    on_receive(bend, 0);
+  }
+  REQUIRE(received.empty());
+
+  REQUIRE(midiin.dispatch() == stdx::error{});
+  REQUIRE(received.size() == 1);
+  REQUIRE(received[0].bytes == ce::pitch_bend(1, 0, 99).bytes);
+}
+
+TEST_CASE("coalesced process cycle", "[coalescing]")
+{
+  std::vector<message> received;
+  libremidi::input_configuration conf{
+      .on_message = [&](message&& m) { received.push_back(std::move(m)); },
+      .coalesce_controllers = true};
+  auto coalescer = libremidi::cycle_coalescer<message>::install(conf);
+  REQUIRE(coalescer);
+
+  // A cycle larger than the batch is passed in several parts
+  const auto n = libremidi::cycle_batch<message>::capacity + 10;
+  for (std::size_t i = 0; i < n; i++)
+    conf.on_message(ce::control_change(1, 7, uint8_t(i % 128)));
+  conf.on_message(ce::note_on(1, 60, 100));
+  REQUIRE(received.size() == 1);
+  REQUIRE(received[0].bytes == ce::control_change(1, 7, (n - 11) % 128).bytes);
+
+  coalescer->flush();
+  REQUIRE(received.size() == 3);
+  REQUIRE(received[1].bytes == ce::control_change(1, 7, (n - 1) % 128).bytes);
+  REQUIRE(received[2].bytes == ce::note_on(1, 60, 100).bytes);
+
+  coalescer->flush();
+  REQUIRE(received.size() == 3);
+
+  // The queue and manual dispatch coalesce their own batches
+  libremidi::input_configuration queued{.queue_size = 16, .coalesce_controllers = true};
+  queued.on_message = [](message&&) { };
+  REQUIRE_FALSE(libremidi::cycle_coalescer<message>::install(queued));
+}
+
+TEST_CASE("coalesce_controllers without a batch", "[coalescing]")
+{
+  int warnings = 0;
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .on_message = [](message&&) { },
+          .on_warning = [&](std::string_view, const libremidi::source_location&) { warnings++; },
+          .coalesce_controllers = true},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [](auto) { }, .stop_receive = [] { }}};
+  REQUIRE(warnings == 1);
+}
@@ -0,0 +1,171 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/configurations.hpp>
+#include <libremidi/coroutines.hpp>
+#include <libremidi/libremidi.hpp>
+
+#if __has_include(<boost/asio/io_context.hpp>)
+  #include <boost/asio/io_context.hpp>
+  #include <boost/asio/post.hpp>
+#endif
+
+#include <array>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct rawio_input
+{
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  libremidi::midi_in in{
+      libremidi::input_configuration{
+          .timestamps = libremidi::timestamp_mode::NoTimestamp, .queue_size = 64},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [this](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [this] { on_receive = nullptr; }}};
+
+  rawio_input() { in.open_virtual_port("test"); }
+
+  void note(uint8_t n)
+  {
+    const uint8_t bytes[3]{0x90, n, 100};
+    on_receive(bytes, 0);
+  }
+};
+
+// Lambdas with captures are not used as coroutines: the captures would not outlive
+// the first suspension
+libremidi::coro::detached
+receive(libremidi::midi_in& in, std::vector<int>& notes, int count, auto... sched)
+{
+  while (std::ssize(notes) < count)
+  {
+    auto msg = co_await in.next(sched...);
+    notes.push_back(msg.bytes[1]);
+  }
+}
+
+libremidi::coro::detached receive_then_stop(
+    libremidi::midi_in& in, std::vector<int>& notes, int count,
+    libremidi::coro::single_thread_executor& executor)
+{
+  while (std::ssize(notes) < count)
+    notes.push_back((co_await in.next(executor)).bytes[1]);
+  executor.stop();
+}
+
+libremidi::coro::detached receive_batches(
+    libremidi::midi_in& in, std::span<libremidi::message> batch, std::vector<std::size_t>& sizes,
+    libremidi::coro::single_thread_executor& executor)
+{
+  sizes.push_back(co_await in.next_batch(batch, executor));
+  sizes.push_back(co_await in.next_batch(batch, executor));
+}
+
+libremidi::coro::detached receive_ump(libremidi::midi_in& in, uint32_t& word)
+{
+  word = (co_await in.next<libremidi::ump>()).data[0];
+}
+}
+
+TEST_CASE("co_await next message", "[coroutines]")
+{
+  rawio_input input;
+  REQUIRE(input.on_receive);
+
+  SECTION("resumed on the backend thread")
+  {
+    std::vector<int> notes;
+    input.note(60);
+    receive(input.in, notes, 3);
+
+    // The queued message is read without suspending
+    REQUIRE(notes == std::vector{60});
+
+    input.note(61);
+    REQUIRE(notes == std::vector{60, 61});
+    input.note(62);
+    REQUIRE(notes == std::vector{60, 61, 62});
+  }
+
+  SECTION("resumed by a single-threaded executor")
+  {
+    libremidi::coro::single_thread_executor executor;
+    std::vector<int> notes;
+    constexpr int count = 1000;
+    receive_then_stop(input.in, notes, count, executor);
+
+    std::thread producer{[&] {
+      for (int i = 0; i < count; i++)
+      {
+        input.note(i % 128);
+        if (i % 16 == 0)
+          std::this_thread::yield();
+      }
+    }};
+    executor.run();
+    producer.join();
+
+    REQUIRE(notes.size() == count);
+    for (int i = 0; i < count; i++)
+      REQUIRE(notes[i] == i % 128);
+  }
+
+  SECTION("batches")
+  {
+    libremidi::coro::single_thread_executor executor;
+    std::array<libremidi::message, 8> batch;
+    std::vector<std::size_t> sizes;
+    receive_batches(input.in, batch, sizes, executor);
+
+    REQUIRE(executor.poll() == 0);
+    input.note(1);
+    input.note(2);
+    input.note(3);
+    REQUIRE(executor.poll() == 1);
+
+    // Resumed once for the three messages, which were queued before it ran
+    REQUIRE(sizes == std::vector<std::size_t>{3});
+    REQUIRE(batch[2].bytes[1] == 3);
+
+    input.note(4);
+    REQUIRE(executor.poll() == 1);
+    REQUIRE(sizes == std::vector<std::size_t>{3, 1});
+  }
+
+#if __has_include(<boost/asio/io_context.hpp>)
+  SECTION("resumed by an asio executor")
+  {
+    boost::asio::io_context ctx;
+    std::vector<int> notes;
+    receive(input.in, notes, 2, libremidi::coro::asio_scheduler{ctx.get_executor()});
+
+    input.note(10);
+    input.note(11);
+    REQUIRE(notes.empty());
+    ctx.run();
+    REQUIRE(notes == std::vector{10, 11});
+  }
+#endif
+}
+
+TEST_CASE("co_await next UMP", "[coroutines]")
+{
+  libremidi::rawio_ump_input_configuration::receive_callback on_receive;
+  libremidi::midi_in in{
+      libremidi::ump_input_configuration{
+          .timestamps = libremidi::timestamp_mode::NoTimestamp, .queue_size = 16},
+      libremidi::rawio_ump_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(in.open_virtual_port("test") == stdx::error{});
+
+  uint32_t word{};
+  receive_ump(in, word);
+  REQUIRE(word == 0);
+
+  const uint32_t note_on[2]{0x40903C00, 0xFFFF0000};
+  on_receive(note_on, 0);
+  REQUIRE(word == note_on[0]);
+}
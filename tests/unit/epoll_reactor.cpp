@@ -0,0 +1,202 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/linux/epoll_reactor.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct nonblocking_pipe
+{
+  int fds[2]{-1, -1};
+  nonblocking_pipe() { REQUIRE(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0); }
+  ~nonblocking_pipe()
+  {
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+
+  void write(int count)
+  {
+    std::vector<char> bytes(count, 'x');
+    REQUIRE(::write(fds[1], bytes.data(), count) == count);
+  }
+
+  // Edge-triggered: everything must be read
+  int drain()
+  {
+    int total = 0;
+    char buf[16];
+    for (ssize_t n; (n = ::read(fds[0], buf, sizeof(buf))) > 0;)
+      total += n;
+    return total;
+  }
+};
+
+bool wait_until(const auto& pred)
+{
+  for (int i = 0; i < 300 && !pred(); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  return pred();
+}
+}
+
+TEST_CASE("epoll reactor", "[epoll_reactor]")
+{
+  auto reactor = libremidi::epoll_reactor::instance();
+  REQUIRE(reactor);
+  REQUIRE(libremidi::epoll_reactor::instance() == reactor);
+
+  SECTION("many descriptors on a single thread")
+  {
+    constexpr int count = 32;
+    std::vector<nonblocking_pipe> pipes(count);
+    std::vector<std::atomic_int> received(count);
+    std::atomic<std::thread::id> thread_id{};
+    std::atomic_bool single_thread{true};
+
+    std::vector<int64_t> ids;
+    for (int i = 0; i < count; i++)
+    {
+      ids.push_back(reactor->add(pipes[i].fds[0], [&, i](uint32_t) {
+        auto expected = std::thread::id{};
+        if (!thread_id.compare_exchange_strong(expected, std::this_thread::get_id())
+            && expected != std::this_thread::get_id())
+          single_thread = false;
+        received[i] += pipes[i].drain();
+        return true;
+      }));
+      REQUIRE(ids.back() > 0);
+    }
+
+    for (int round = 1; round <= 3; round++)
+    {
+      for (int i = 0; i < count; i++)
+        pipes[i].write(i + 1);
+      for (int i = 0; i < count; i++)
+        REQUIRE(wait_until([&] { return received[i] == round * (i + 1); }));
+    }
+    REQUIRE(single_thread);
+    REQUIRE(thread_id.load() != std::this_thread::get_id());
+
+    // Nothing is delivered after removal
+    for (auto id : ids)
+      reactor->remove(id);
+    pipes[0].write(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(received[0] == 3);
+  }
+
+  SECTION("data already available when registering")
+  {
+    nonblocking_pipe p;
+    p.write(10);
+    std::atomic_int received{};
+    auto id = reactor->add(p.fds[0], [&](uint32_t) {
+      received += p.drain();
+      return true;
+    });
+    REQUIRE(wait_until([&] { return received == 10; }));
+    reactor->remove(id);
+  }
+
+  SECTION("handlers deregister and register from the reactor thread")
+  {
+    nonblocking_pipe first, second;
+    std::atomic_int first_calls{}, second_calls{};
+    reactor->add(first.fds[0], [&](uint32_t) {
+      first.drain();
+      first_calls++;
+      reactor->add(second.fds[0], [&](uint32_t) {
+        second.drain();
+        second_calls++;
+        return true;
+      });
+      return false;
+    });
+
+    first.write(1);
+    REQUIRE(wait_until([&] { return first_calls == 1; }));
+    first.write(1);
+    second.write(1);
+    REQUIRE(wait_until([&] { return second_calls == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(first_calls == 1);
+  }
+}
+
+TEST_CASE("epoll reactor handlers run outside of its lock", "[epoll_reactor]")
+{
+  auto reactor = libremidi::epoll_reactor::instance();
+  REQUIRE(reactor);
+
+  nonblocking_pipe slow, other;
+  std::promise<void> entered, release;
+  auto released = release.get_future().share();
+  std::atomic_bool done{};
+  const auto slow_id = reactor->add(slow.fds[0], [&](uint32_t) {
+    slow.drain();
+    entered.set_value();
+    released.wait();
+    done = true;
+    return true;
+  });
+
+  slow.write(1);
+  entered.get_future().wait();
+
+  // Other devices are opened and closed while the handler runs
+  const auto other_id = reactor->add(other.fds[0], [](uint32_t) { return true; });
+  REQUIRE(other_id > 0);
+  reactor->remove(other_id);
+
+  // Removing the running handler waits for it
+  auto removed = std::async(std::launch::async, [&] {
+    reactor->remove(slow_id);
+    return done.load();
+  });
+  REQUIRE(removed.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+  release.set_value();
+  REQUIRE(removed.get());
+}
+
+TEST_CASE("epoll reactor released by a handler", "[epoll_reactor]")
+{
+  // A handler closes the last user: the reactor is destroyed on its own thread
+  nonblocking_pipe p;
+  std::atomic_bool released{};
+  {
+    auto reactor = libremidi::epoll_reactor::instance();
+    REQUIRE(reactor);
+    auto shared = std::make_shared<std::shared_ptr<libremidi::epoll_reactor>>(reactor);
+    reactor->add(p.fds[0], [&, shared](uint32_t) {
+      p.drain();
+      shared->reset();
+      released = true;
+      return true;
+    });
+  }
+
+  p.write(1);
+  REQUIRE(wait_until([&] { return released.load(); }));
+
+  // A new reactor is started for the next user
+  auto reactor = libremidi::epoll_reactor::instance();
+  REQUIRE(reactor);
+  std::atomic_int received{};
+  auto id = reactor->add(p.fds[0], [&](uint32_t) {
+    received += p.drain();
+    return true;
+  });
+  p.write(3);
+  REQUIRE(wait_until([&] { return received == 3; }));
+  reactor->remove(id);
+}
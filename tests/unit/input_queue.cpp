@@ -0,0 +1,193 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/configurations.hpp>
+#include <libremidi/input_queue.hpp>
+#include <libremidi/libremidi.hpp>
+
+#if defined(__linux__)
+  #include <poll.h>
+#endif
+
+#include <array>
+#include <thread>
+
+namespace
+{
+[[maybe_unused]] bool readable(int fd)
+{
+#if defined(__linux__)
+  pollfd p{.fd = fd, .events = POLLIN, .revents = 0};
+  return ::poll(&p, 1, 0) == 1;
+#else
+  return fd >= 0;
+#endif
+}
+}
+
+TEST_CASE("input queue", "[input_queue]")
+{
+  libremidi::input_queue<libremidi::ump> queue{3};
+  REQUIRE(queue.capacity() == 4);
+  REQUIRE(queue.empty());
+
+  libremidi::ump u;
+  REQUIRE_FALSE(queue.try_read(u));
+
+  SECTION("full queue")
+  {
+    for (uint32_t i = 0; i < 6; i++)
+      REQUIRE(queue.push(libremidi::ump{i}) == (i < 4));
+    REQUIRE(queue.dropped() == 2);
+
+    // Oldest first, in batches
+    std::array<libremidi::ump, 3> batch;
+    REQUIRE(queue.poll(batch) == 3);
+    REQUIRE(batch[0].data[0] == 0);
+    REQUIRE(batch[2].data[0] == 2);
+    REQUIRE(queue.poll(batch) == 1);
+    REQUIRE(batch[0].data[0] == 3);
+    REQUIRE(queue.poll(batch) == 0);
+  }
+
+  SECTION("wrap around")
+  {
+    for (uint32_t i = 0; i < 100; i++)
+    {
+      REQUIRE(queue.push(libremidi::ump{i}));
+      REQUIRE(queue.push(libremidi::ump{i + 1000}));
+      REQUIRE(queue.try_read(u));
+      REQUIRE(u.data[0] == i);
+      REQUIRE(queue.try_read(u));
+      REQUIRE(u.data[0] == i + 1000);
+    }
+    REQUIRE(queue.empty());
+    REQUIRE(queue.dropped() == 0);
+  }
+
+#if defined(__linux__)
+  SECTION("descriptor")
+  {
+    REQUIRE(queue.descriptor() >= 0);
+    REQUIRE_FALSE(readable(queue.descriptor()));
+
+    queue.push(libremidi::ump{1});
+    queue.push(libremidi::ump{2});
+    REQUIRE(readable(queue.descriptor()));
+
+    // Still readable until the queue is drained
+    REQUIRE(queue.try_read(u));
+    REQUIRE(readable(queue.descriptor()));
+    REQUIRE(queue.try_read(u));
+    REQUIRE_FALSE(readable(queue.descriptor()));
+  }
+#endif
+}
+
+TEST_CASE("input queue between threads", "[input_queue]")
+{
+  libremidi::input_queue<libremidi::message> queue{64};
+  constexpr int count = 100000;
+
+  std::thread producer{[&] {
+    for (int i = 0; i < count;)
+    {
+      libremidi::message m{0x90, uint8_t(i % 128), 64};
+      m.timestamp = i;
+      if (queue.push(std::move(m)))
+        i++;
+      else
+        std::this_thread::yield();
+    }
+  }};
+
+  std::array<libremidi::message, 16> batch;
+  int64_t expected = 0;
+  while (expected < count)
+  {
+#if defined(__linux__)
+    pollfd p{.fd = queue.descriptor(), .events = POLLIN, .revents = 0};
+    REQUIRE(::poll(&p, 1, 1000) == 1);
+#endif
+    for (std::size_t n = queue.poll(batch); n > 0; n = queue.poll(batch))
+    {
+      for (std::size_t i = 0; i < n; i++)
+      {
+        REQUIRE(batch[i].timestamp == expected);
+        REQUIRE(batch[i].bytes[1] == expected % 128);
+        expected++;
+      }
+    }
+  }
+  producer.join();
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("midi_in queued mode", "[input_queue]")
+{
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  const auto api_conf = libremidi::rawio_input_configuration{
+      .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+      .stop_receive = [&] { on_receive = nullptr; }};
+
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .timestamps = libremidi::timestamp_mode::NoTimestamp, .queue_size = 2},
+      api_conf};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+  REQUIRE(on_receive);
+
+  libremidi::message m;
+  REQUIRE_FALSE(midiin.try_read(m));
+#if defined(__linux__)
+  REQUIRE_FALSE(readable(midiin.queue_descriptor()));
+#endif
+
+  const uint8_t notes[9]{0x90, 60, 100, 0x90, 62, 100, 0x90, 64, 100};
+  on_receive(std::span{notes}.first(3), 0);
+  on_receive(std::span{notes}.subspan(3, 3), 0);
+  on_receive(std::span{notes}.subspan(6, 3), 0);
+#if defined(__linux__)
+  REQUIRE(readable(midiin.queue_descriptor()));
+#endif
+  REQUIRE(midiin.queue_dropped() == 1);
+
+  std::array<libremidi::message, 4> batch;
+  REQUIRE(midiin.poll(batch) == 2);
+  REQUIRE(batch[0].bytes[1] == 60);
+  REQUIRE(batch[1].bytes[1] == 62);
+  REQUIRE(midiin.poll(batch) == 0);
+
+  // The queue is for MIDI 1 messages
+  libremidi::ump u;
+  REQUIRE_FALSE(midiin.try_read(u));
+
+  // Moving the input keeps the queue
+  libremidi::midi_in moved = std::move(midiin);
+  on_receive(std::span{notes}.first(3), 0);
+  REQUIRE(moved.try_read(m));
+  REQUIRE(m.bytes[1] == 60);
+}
+
+TEST_CASE("midi_in queued mode with UMP", "[input_queue]")
+{
+  libremidi::rawio_ump_input_configuration::receive_callback on_receive;
+  libremidi::midi_in midiin{
+      libremidi::ump_input_configuration{
+          .timestamps = libremidi::timestamp_mode::NoTimestamp, .queue_size = 16},
+      libremidi::rawio_ump_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+  REQUIRE(on_receive);
+
+  // MIDI 2 note on, group 0, channel 0, note 60
+  const uint32_t note_on[2]{0x40903C00, 0xFFFF0000};
+  on_receive(note_on, 0);
+
+  libremidi::ump u;
+  REQUIRE(midiin.try_read(u));
+  REQUIRE(u.data[0] == note_on[0]);
+  REQUIRE(u.data[1] == note_on[1]);
+  REQUIRE_FALSE(midiin.try_read(u));
+  REQUIRE(midiin.queue_dropped() == 0);
+}
@@ -0,0 +1,236 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/configurations.hpp>
+#include <libremidi/detail/midi_stream_decoder.hpp>
+#include <libremidi/jr_timestamps.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+static constexpr int64_t ms = 1'000'000;
+
+TEST_CASE("JR messages", "[jr_timestamps]")
+{
+  REQUIRE(libremidi::jr::make_clock(0) == 0x00100000);
+  REQUIRE(libremidi::jr::make_timestamp(int64_t{32'000} * 0x1234) == 0x00201234);
+  REQUIRE(libremidi::jr::make_timestamp(int64_t{32'000} * 0x11234 + 31'999) == 0x00201234);
+
+  REQUIRE(libremidi::jr::status(0x00100010) == libremidi::jr::clock_status);
+  REQUIRE(libremidi::jr::status(0x00200010) == libremidi::jr::timestamp_status);
+  REQUIRE(libremidi::jr::status(0x00000000) == 0);
+  REQUIRE(libremidi::jr::status(0x00300010) == 0);
+  REQUIRE(libremidi::jr::status(0x10F80000) == 0);
+}
+
+TEST_CASE("JR clock period", "[jr_timestamps]")
+{
+  libremidi::jr_timestamp_encoder enc;
+  const int64_t t0 = 10'000 * ms;
+  REQUIRE(enc.clock(t0) == libremidi::jr::make_clock(t0));
+  REQUIRE(enc.clock(t0 + 100 * ms) == 0);
+  REQUIRE(enc.clock(t0 + 249 * ms) == 0);
+  REQUIRE(enc.clock(t0 + 250 * ms) == libremidi::jr::make_clock(t0 + 250 * ms));
+  REQUIRE(enc.clock(t0 + 251 * ms) == 0);
+}
+
+TEST_CASE("JR timestamps of scheduled messages", "[jr_timestamps]")
+{
+  const int64_t now = 10'000 * ms;
+  {
+    libremidi::jr_timestamp_encoder enc{libremidi::timestamp_mode::Absolute};
+    REQUIRE(enc.timestamp(now + 5 * ms, now) == libremidi::jr::make_timestamp(now + 5 * ms));
+    REQUIRE(enc.timestamp(0, now) == libremidi::jr::make_timestamp(now));
+  }
+  {
+    libremidi::jr_timestamp_encoder enc{libremidi::timestamp_mode::Relative};
+    REQUIRE(enc.timestamp(5 * ms, now) == libremidi::jr::make_timestamp(now + 5 * ms));
+  }
+  {
+    libremidi::jr_timestamp_encoder enc{libremidi::timestamp_mode::NoTimestamp};
+    REQUIRE(enc.timestamp(5 * ms, now) == libremidi::jr::make_timestamp(now));
+  }
+}
+
+TEST_CASE("JR timestamps remove the transport jitter", "[jr_timestamps]")
+{
+  // The sender clock is 3.7 s behind the receiver one, the transport usually takes
+  // 20 µs and sometimes 3 ms, also for the JR Clock messages. Over 10 seconds, the
+  // 16-bit JR time wraps several times.
+  const int64_t offset = 3'700 * ms;
+  auto transport = [](int i) { return i % 5 == 0 ? 3 * ms : 20'000; };
+
+  libremidi::jr_timestamp_decoder dec;
+  REQUIRE_FALSE(dec.synchronized());
+
+  // The latency of the fastest messages cannot be known: only its variation is removed
+  int64_t min_error = INT64_MAX, max_error = INT64_MIN;
+  int64_t min_arrival = INT64_MAX, max_arrival = INT64_MIN;
+  int i = 0;
+  for (int64_t sent = 1'000 * ms; sent < 11'000 * ms; sent += 10 * ms, i++)
+  {
+    const int64_t arrival = sent + offset + transport(i);
+    dec.begin();
+    if (i % 26 == 0)
+      dec.process(libremidi::jr::make_clock(sent), arrival);
+    dec.process(libremidi::jr::make_timestamp(sent), arrival);
+    const int64_t t = dec.time(arrival);
+
+    // Ignore the first second, while the correlation builds up
+    if (sent >= 2'000 * ms)
+    {
+      min_error = std::min(min_error, t - (sent + offset));
+      max_error = std::max(max_error, t - (sent + offset));
+      min_arrival = std::min(min_arrival, arrival - (sent + offset));
+      max_arrival = std::max(max_arrival, arrival - (sent + offset));
+    }
+  }
+
+  REQUIRE(dec.synchronized());
+  REQUIRE(max_arrival - min_arrival == 3 * ms - 20'000);
+  REQUIRE(max_error - min_error < 200'000);
+  REQUIRE(std::abs(min_error) < 3 * ms);
+}
+
+TEST_CASE("JR timestamps after an idle sender", "[jr_timestamps]")
+{
+  // As sent by midi_out: a JR Clock only when a message is scheduled, so none while idle.
+  // The pause is longer than the 2.1 s period of the 16-bit JR time.
+  const int64_t offset = 700 * ms;
+  libremidi::jr_timestamp_encoder enc;
+  libremidi::jr_timestamp_decoder dec;
+
+  auto send = [&](int64_t sent) {
+    const int64_t arrival = sent + offset + 20'000;
+    dec.begin();
+    if (const uint32_t clock = enc.clock(sent))
+      dec.process(clock, arrival);
+    dec.process(enc.timestamp(sent, sent), arrival);
+    return dec.time(arrival) - (sent + offset);
+  };
+
+  int64_t sent = 1'000 * ms;
+  for (; sent < 4'000 * ms; sent += 50 * ms)
+    send(sent);
+  REQUIRE(dec.synchronized());
+  REQUIRE(std::abs(send(sent - 50 * ms + 20 * ms)) < 1 * ms);
+
+  for (int64_t pause : {3'000 * ms, 2'097 * ms, 10'000 * ms})
+  {
+    sent += pause;
+    REQUIRE(std::abs(send(sent)) < 1 * ms);
+  }
+}
+
+TEST_CASE("JR timestamps in the MIDI 2 input state machine", "[jr_timestamps]")
+{
+  std::vector<libremidi::ump> received;
+  libremidi::ump_input_configuration conf{
+      .on_message = [&](libremidi::ump&& m) { received.push_back(m); },
+      .ignore_timing = true,
+      .timestamps = libremidi::timestamp_mode::Absolute,
+      .jr_timestamps = true};
+  libremidi::midi2::input_state_machine sm{conf};
+
+  // The sender clock is 1 s behind. The correlation needs a few JR Clock messages.
+  const int64_t offset = 1'000 * ms;
+  int64_t sent = 50'000 * ms;
+  for (int i = 0; i < libremidi::jr_timestamp_decoder::clocks_per_observation; i++)
+  {
+    const uint32_t clock[1]{libremidi::jr::make_clock(sent)};
+    sm.on_bytes_multi(std::span<const uint32_t>{clock}, sent + offset);
+    sent += libremidi::jr_timestamp_encoder::clock_period_ns;
+  }
+  REQUIRE(received.empty());
+
+  // A note stamped 2 ms later, arriving 5 ms late
+  const int64_t note_time = sent + 2 * ms;
+  const uint32_t buffer[3]{libremidi::jr::make_timestamp(note_time), 0x40903C00, 0xC0000000};
+  sm.on_bytes_multi(std::span<const uint32_t>{buffer}, note_time + offset + 5 * ms);
+  REQUIRE(received.size() == 1);
+  REQUIRE(std::abs(received[0].timestamp - (note_time + offset)) < 32'000);
+
+  // A JR Timestamp alone in its buffer applies to the next one
+  const int64_t next_time = sent + 10 * ms;
+  const uint32_t stamp[1]{libremidi::jr::make_timestamp(next_time)};
+  sm.on_bytes_multi(std::span<const uint32_t>{stamp}, next_time + offset + 3 * ms);
+  const uint32_t note[2]{0x40903D00, 0xC0000000};
+  sm.on_bytes_multi(std::span<const uint32_t>{note}, next_time + offset + 4 * ms);
+  REQUIRE(received.size() == 2);
+  REQUIRE(std::abs(received[1].timestamp - (next_time + offset)) < 32'000);
+
+  // Without a new JR Timestamp, the arrival time is used
+  const int64_t arrival = next_time + offset + 20 * ms;
+  sm.on_bytes_multi(std::span<const uint32_t>{note}, arrival);
+  REQUIRE(received.size() == 3);
+  REQUIRE(received[2].timestamp == arrival);
+}
+
+TEST_CASE("JR messages are passed along without ignore_timing", "[jr_timestamps]")
+{
+  std::vector<libremidi::ump> received;
+  libremidi::ump_input_configuration conf{
+      .on_message = [&](libremidi::ump&& m) { received.push_back(m); },
+      .ignore_timing = false,
+      .timestamps = libremidi::timestamp_mode::Absolute,
+      .jr_timestamps = true};
+  libremidi::midi2::input_state_machine sm{conf};
+
+  const uint32_t buffer[4]{
+      libremidi::jr::make_clock(0), libremidi::jr::make_timestamp(0), 0x40903C00, 0xC0000000};
+  sm.on_bytes_multi(std::span<const uint32_t>{buffer}, 1'000 * ms);
+  REQUIRE(received.size() == 3);
+  REQUIRE(received[0].data[0] == buffer[0]);
+  REQUIRE(received[0].timestamp == 1'000 * ms);
+  REQUIRE(received[1].data[0] == buffer[1]);
+  REQUIRE(received[2].data[0] == buffer[2]);
+}
+
+TEST_CASE("midi_out prepends JR timestamps to scheduled UMP", "[jr_timestamps]")
+{
+  std::vector<uint32_t> written;
+  libremidi::midi_out midiout{
+      libremidi::output_configuration{.jr_timestamps = true},
+      libremidi::rawio_ump_output_configuration{
+          .write_ump = [&](std::span<const uint32_t> words) -> stdx::error {
+    written.insert(written.end(), words.begin(), words.end());
+    return {};
+  }}};
+  REQUIRE(midiout.open_virtual_port("test") == stdx::error{});
+
+  const int64_t ts = libremidi::system_ns() + 5 * ms;
+  const uint32_t note[2]{0x40903C00, 0xC0000000};
+  REQUIRE(midiout.schedule_ump(ts, note, 2) == stdx::error{});
+
+  // A JR Clock first, then the JR Timestamp and the message
+  REQUIRE(written.size() == 4);
+  REQUIRE(libremidi::jr::status(written[0]) == libremidi::jr::clock_status);
+  REQUIRE(written[1] == libremidi::jr::make_timestamp(ts));
+  REQUIRE(written[2] == note[0]);
+  REQUIRE(written[3] == note[1]);
+
+  // The clock is not sent again right away
+  REQUIRE(midiout.schedule_ump(ts + ms, note, 2) == stdx::error{});
+  REQUIRE(written.size() == 7);
+  REQUIRE(written[4] == libremidi::jr::make_timestamp(ts + ms));
+
+  // send_ump is left alone
+  REQUIRE(midiout.send_ump(note, 2) == stdx::error{});
+  REQUIRE(written.size() == 9);
+
+  // Without jr_timestamps, schedule_ump is unchanged
+  std::vector<uint32_t> plain;
+  libremidi::midi_out other{
+      libremidi::output_configuration{},
+      libremidi::rawio_ump_output_configuration{
+          .write_ump = [&](std::span<const uint32_t> words) -> stdx::error {
+    plain.insert(plain.end(), words.begin(), words.end());
+    return {};
+  }}};
+  REQUIRE(other.open_virtual_port("test") == stdx::error{});
+  REQUIRE(other.schedule_ump(ts, note, 2) == stdx::error{});
+  REQUIRE(plain.size() == 2);
+}
@@ -0,0 +1,168 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/configurations.hpp>
+#include <libremidi/libremidi.hpp>
+#include <libremidi/manual_dispatch.hpp>
+
+#if defined(__linux__)
+  #include <libremidi/backends/linux/epoll_dispatcher.hpp>
+  #include <libremidi/backends/linux/helpers.hpp>
+
+  #include <poll.h>
+#endif
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+[[maybe_unused]] bool readable(int fd)
+{
+#if defined(__linux__)
+  pollfd p{.fd = fd, .events = POLLIN, .revents = 0};
+  return ::poll(&p, 1, 0) == 1;
+#else
+  return fd >= 0;
+#endif
+}
+}
+
+#if defined(__linux__)
+TEST_CASE("epoll dispatcher", "[manual_dispatch]")
+{
+  libremidi::epoll_dispatcher dispatcher;
+  REQUIRE(dispatcher.descriptor() >= 0);
+  REQUIRE_FALSE(readable(dispatcher.descriptor()));
+
+  libremidi::eventfd_notifier a{false}, b{false};
+  int a_count = 0, b_count = 0;
+  const auto a_id = dispatcher.add(a, [&](uint32_t) {
+    a.consume();
+    a_count++;
+    return true;
+  });
+  REQUIRE(a_id > 0);
+
+  // Deregisters itself on its first call
+  REQUIRE(dispatcher.add(b, [&](uint32_t) {
+    b_count++;
+    return false;
+  }) > 0);
+
+  REQUIRE(dispatcher.dispatch() == 0);
+
+  a.notify();
+  b.notify();
+  REQUIRE(readable(dispatcher.descriptor()));
+  REQUIRE(dispatcher.dispatch() == 2);
+  REQUIRE(a_count == 1);
+  REQUIRE(b_count == 1);
+
+  // b was not read, but is not watched anymore
+  REQUIRE_FALSE(readable(dispatcher.descriptor()));
+  REQUIRE(dispatcher.dispatch() == 0);
+
+  dispatcher.remove(a_id);
+  a.notify();
+  REQUIRE_FALSE(readable(dispatcher.descriptor()));
+}
+#endif
+
+TEST_CASE("midi_in manual dispatch", "[manual_dispatch]")
+{
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  std::vector<int> notes;
+  std::vector<std::thread::id> threads;
+
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .on_message =
+              [&](libremidi::message&& m) {
+    notes.push_back(m.bytes[1]);
+    threads.push_back(std::this_thread::get_id());
+  },
+          .timestamps = libremidi::timestamp_mode::NoTimestamp,
+          .manual_dispatch = true},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+  REQUIRE(on_receive);
+
+#if defined(__linux__)
+  REQUIRE(midiin.descriptor() >= 0);
+  REQUIRE_FALSE(readable(midiin.descriptor()));
+#endif
+
+  // The backend thread does not call on_message
+  std::thread backend{[&] {
+    for (uint8_t n = 0; n < 100; n++)
+    {
+      const uint8_t bytes[3]{0x90, n, 100};
+      on_receive(bytes, 0);
+    }
+  }};
+  backend.join();
+  REQUIRE(notes.empty());
+
+#if defined(__linux__)
+  REQUIRE(readable(midiin.descriptor()));
+#endif
+  REQUIRE(midiin.dispatch() == stdx::error{});
+  REQUIRE(notes.size() == 100);
+  for (int i = 0; i < 100; i++)
+  {
+    REQUIRE(notes[i] == i);
+    REQUIRE(threads[i] == std::this_thread::get_id());
+  }
+
+#if defined(__linux__)
+  REQUIRE_FALSE(readable(midiin.descriptor()));
+#endif
+  REQUIRE(midiin.dispatch() == stdx::error{});
+  REQUIRE(notes.size() == 100);
+}
+
+TEST_CASE("midi_in without manual dispatch", "[manual_dispatch]")
+{
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{.on_message = [](libremidi::message&&) { }},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [](auto) { }, .stop_receive = [] { }}};
+
+  REQUIRE(midiin.descriptor() == -1);
+  REQUIRE(midiin.dispatch() == std::errc::operation_not_supported);
+}
+
+TEST_CASE("deferred observer", "[manual_dispatch]")
+{
+  std::vector<std::string> added;
+  libremidi::observer_configuration conf{
+      .input_added = [&](const libremidi::input_port& p) { added.push_back(p.port_name); }};
+
+  libremidi::deferred_observer deferred{conf};
+  REQUIRE(conf.input_added);
+  REQUIRE_FALSE(conf.output_added);
+
+  std::thread backend{[&] {
+    conf.input_added(libremidi::input_port{{.port_name = "a"}});
+    conf.input_added(libremidi::input_port{{.port_name = "b"}});
+  }};
+  backend.join();
+  REQUIRE(added.empty());
+
+#if defined(__linux__)
+  REQUIRE(readable(deferred.descriptor()));
+#endif
+  REQUIRE(deferred.dispatch() == 2);
+  REQUIRE(added == std::vector<std::string>{"a", "b"});
+#if defined(__linux__)
+  REQUIRE_FALSE(readable(deferred.descriptor()));
+#endif
+
+  // A backend driven by the application notifies from its own dispatch
+  deferred.set_direct();
+  REQUIRE(deferred.descriptor() == -1);
+  conf.input_added(libremidi::input_port{{.port_name = "c"}});
+  REQUIRE(added.back() == "c");
+}
@@ -148,3 +148,63 @@ TEST_CASE("poly aftertouch", "[midi_in]")
   }
 #endif
 }
+
+#if defined(LIBREMIDI_ALSA)
+  #include <libremidi/backends/alsa_seq.hpp>
+
+TEST_CASE("shared alsa sequencer client", "[midi_in]")
+{
+  #if defined(LIBREMIDI_CI)
+  SKIP("GH runners do not have MIDI support");
+  #endif
+  if (!libremidi::alsa_seq::backend::available())
+    SKIP("No ALSA sequencer");
+
+  constexpr int count = 16;
+  std::mutex qmtx;
+  std::vector<std::vector<libremidi::message>> queues(count);
+
+  // All the inputs are ports of a single client
+  std::vector<std::unique_ptr<libremidi::midi_in>> inputs;
+  for (int i = 0; i < count; i++)
+  {
+    inputs.push_back(std::make_unique<libremidi::midi_in>(
+        libremidi::input_configuration{
+            .on_message =
+                [&, i](libremidi::message&& msg) {
+      std::lock_guard _{qmtx};
+      queues[i].push_back(std::move(msg));
+    }},
+        libremidi::alsa_seq::input_configuration{.client_name = "libremidi-shared-test"}));
+    REQUIRE(inputs.back()->open_virtual_port("shared " + std::to_string(i)) == stdx::error{});
+  }
+
+  libremidi::observer obs{
+      {.track_virtual = true}, libremidi::alsa_seq::observer_configuration{}};
+  std::vector<libremidi::output_port> ports;
+  for (auto& p : obs.get_output_ports())
+    if (p.device_name == "libremidi-shared-test")
+      ports.push_back(p);
+  REQUIRE(ports.size() == count);
+  const auto client = libremidi::alsa_seq::seq_from_port_handle(ports.front().port).first;
+  for (auto& p : ports)
+    REQUIRE(libremidi::alsa_seq::seq_from_port_handle(p.port).first == client);
+
+  // Each port only receives its own events
+  for (auto& p : ports)
+  {
+    const int index = std::stoi(p.port_name.substr(7));
+    libremidi::midi_out out{{}, libremidi::alsa_seq::output_configuration{}};
+    REQUIRE(out.open_port(p) == stdx::error{});
+    REQUIRE(out.send_message(0xB0, 1, index) == stdx::error{});
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::lock_guard _{qmtx};
+  for (int i = 0; i < count; i++)
+  {
+    REQUIRE(queues[i].size() == 1);
+    REQUIRE(queues[i][0].bytes == libremidi::midi_bytes{0xB0, 1, uint8_t(i)});
+  }
+}
+#endif
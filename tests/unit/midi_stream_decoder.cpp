@@ -1,6 +1,7 @@
 #include "../include_catch.hpp"
 
 #include <libremidi/detail/midi_stream_decoder.hpp>
+#include <libremidi/detail/ump_stream.hpp>
 
 #include <vector>
 
@@ -626,3 +627,123 @@ TEST_CASE("midi2: raw_data callback", "[midi2][state_machine]")
   REQUIRE(raw_received.size() == 1);
   REQUIRE(raw_received[0].size() == 2);
 }
+
+// ============================================================================
+// UMP stream segmentation
+// ============================================================================
+
+TEST_CASE("ump: packet sizes", "[midi2][ump_stream]")
+{
+  // The defined message types match cmidi2
+  for (uint32_t type : {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0xD, 0xF})
+    REQUIRE(libremidi::ump_packet_words(type << 28) * 4 == cmidi2_ump_get_num_bytes(type << 28));
+
+  // Reserved message types
+  REQUIRE(libremidi::ump_packet_words(0x60000000) == 1);
+  REQUIRE(libremidi::ump_packet_words(0x70000000) == 1);
+  REQUIRE(libremidi::ump_packet_words(0x80000000) == 2);
+  REQUIRE(libremidi::ump_packet_words(0xA0000000) == 2);
+  REQUIRE(libremidi::ump_packet_words(0xB0000000) == 3);
+  REQUIRE(libremidi::ump_packet_words(0xC0000000) == 3);
+  REQUIRE(libremidi::ump_packet_words(0xE0000000) == 4);
+}
+
+TEST_CASE("ump: stream segmentation", "[midi2][ump_stream]")
+{
+  // Packets of every size, NOOP padding, and packets across the 64-word blocks
+  std::vector<uint32_t> stream;
+  std::vector<std::vector<uint32_t>> expected;
+  for (int i = 0; i < 100; i++)
+  {
+    std::vector<uint32_t> packet;
+    switch (i % 5)
+    {
+      case 0:
+        packet = {0x20903C40};
+        break;
+      case 1:
+        packet = {0x40903C00, 0xFFFF0000};
+        break;
+      case 2:
+        packet = {0x50000000u | uint32_t(i), 1, 2, 3};
+        break;
+      case 3:
+        packet = {0xB0000000u | uint32_t(i), 4, 5};
+        break;
+      case 4:
+        stream.push_back(0);
+        packet = {0x10FA0000};
+        break;
+    }
+    stream.insert(stream.end(), packet.begin(), packet.end());
+    expected.push_back(packet);
+  }
+
+  std::vector<std::vector<uint32_t>> packets;
+  const auto read = libremidi::for_each_ump_packet(stream, [&](const uint32_t* p, uint32_t n) {
+    packets.emplace_back(p, p + n);
+    return true;
+  });
+  REQUIRE(read == stream.size());
+  REQUIRE(packets == expected);
+
+  SECTION("truncated packet")
+  {
+    stream.push_back(0x40903C00);
+    packets.clear();
+    const auto read = libremidi::for_each_ump_packet(stream, [&](const uint32_t* p, uint32_t n) {
+      packets.emplace_back(p, p + n);
+      return true;
+    });
+    REQUIRE(read == stream.size() - 1);
+    REQUIRE(packets == expected);
+  }
+
+  SECTION("stopped")
+  {
+    int n = 0;
+    const auto read = libremidi::for_each_ump_packet(
+        stream, [&](const uint32_t*, uint32_t) { return ++n < 3; });
+    REQUIRE(n == 3);
+    REQUIRE(read == 1 + 2);
+  }
+
+  SECTION("segment_ump_stream")
+  {
+    packets.clear();
+    auto err = libremidi::segment_ump_stream(
+        stream.data(), stream.size(),
+        [&](const uint32_t* p, int bytes) {
+      packets.emplace_back(p, p + bytes / 4);
+      return std::errc{};
+    }, [] { });
+    REQUIRE(err == stdx::error{});
+    REQUIRE(packets == expected);
+  }
+}
+
+TEST_CASE("midi2: filtering in multi-packet buffers", "[midi2][state_machine]")
+{
+  midi2_collector c;
+  c.configuration.ignore_sysex = true;
+  c.configuration.ignore_timing = true;
+  libremidi::atomic_port_counters counters;
+  libremidi::midi2::input_state_machine sm{c.configuration, &counters};
+
+  const uint32_t words[] = {
+      0x00200010,             // JR timestamp
+      0x30160102, 0x03040506, // SysEx7
+      0x40903C00, 0xFFFF0000, // Note on
+      0x50000000, 1, 2, 3,    // SysEx8
+      0x10F80000,             // Clock
+      0x10FA0000,             // Start
+      0x40903C00,             // Truncated
+  };
+  sm.on_bytes_multi(std::span<const uint32_t>(words), 0);
+
+  REQUIRE(c.messages.size() == 2);
+  REQUIRE(c.messages[0].data[0] == 0x40903C00);
+  REQUIRE(c.messages[1].data[0] == 0x10FA0000);
+  REQUIRE(counters.filtered == 4);
+  REQUIRE(counters.truncated == 1);
+}
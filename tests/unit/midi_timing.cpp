@@ -1,8 +1,12 @@
 #include "../include_catch.hpp"
 
+#include <libremidi/clock_tracker.hpp>
 #include <libremidi/detail/conversion.hpp>
 #include <libremidi/detail/midi_stream_decoder.hpp>
+#include <libremidi/protocols/mtc.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 // Round-trip test: build a MIDI timing message, feed it through the
@@ -598,3 +602,337 @@ TEST_CASE("Full pipeline: MIDI 1 bytes -> decode -> UMP -> decode -> MIDI 1", "[
       REQUIRE(final_messages[i][j] == c.messages[i][j]);
   }
 }
+
+// ============================================================================
+// Clock tracking: tempo and song position from the clock and transport messages
+// ============================================================================
+
+namespace
+{
+struct clock_collector : midi1_collector
+{
+  libremidi::midi_clock_tracker tracker;
+  std::vector<libremidi::clock_event> events;
+  int64_t time = 1'000'000'000;
+
+  clock_collector()
+  {
+    configuration.timestamps = libremidi::timestamp_mode::Absolute;
+    configuration.track_clock = true;
+    configuration.on_clock = [this](const libremidi::clock_event& e) { events.push_back(e); };
+  }
+
+  auto make_state_machine()
+  {
+    return libremidi::midi1::input_state_machine{configuration, nullptr, &tracker};
+  }
+
+  // Ticks at the given tempo, with a deterministic jitter of up to jitter_ns
+  void ticks(auto& sm, int count, double bpm, int64_t jitter_ns = 0)
+  {
+    const auto period = static_cast<int64_t>(60e9 / (bpm * 24));
+    for (int i = 0; i < count; i++)
+    {
+      const int64_t jitter = jitter_ns * ((i * 7) % 5 - 2) / 2;
+      sm.on_bytes({std::vector<uint8_t>{0xF8}}, time + jitter);
+      time += period;
+    }
+  }
+
+  int count(libremidi::clock_event::kind_t kind) const
+  {
+    return static_cast<int>(
+        std::count_if(events.begin(), events.end(), [=](auto& e) { return e.kind == kind; }));
+  }
+};
+}
+
+TEST_CASE("Clock tracking: tempo", "[timing][clock][tracker]")
+{
+  clock_collector c;
+  auto sm = c.make_state_machine();
+
+  SECTION("not locked before a quarter note worth of ticks")
+  {
+    c.ticks(sm, 10, 120.);
+    REQUIRE(!c.tracker.state().locked);
+    REQUIRE(c.tracker.state().bpm == 0.);
+  }
+
+  SECTION("steady tempo with jitter")
+  {
+    c.ticks(sm, 24 * 16, 120., 1'000'000);
+    const auto s = c.tracker.state();
+    REQUIRE(s.locked);
+    REQUIRE(!s.running);
+    REQUIRE(std::abs(s.bpm - 120.) < 0.5);
+  }
+
+  SECTION("follows tempo changes")
+  {
+    c.ticks(sm, 24 * 8, 120.);
+    c.ticks(sm, 24 * 16, 140.);
+    REQUIRE(std::abs(c.tracker.state().bpm - 140.) < 0.5);
+  }
+
+  SECTION("restarts after the clock was interrupted")
+  {
+    c.ticks(sm, 24 * 4, 120.);
+    REQUIRE(c.tracker.state().locked);
+    c.time += 2'000'000'000;
+    c.ticks(sm, 4, 90.);
+    REQUIRE(!c.tracker.state().locked);
+    c.ticks(sm, 24 * 16, 90.);
+    REQUIRE(std::abs(c.tracker.state().bpm - 90.) < 0.5);
+  }
+
+  SECTION("tempo events once per quarter note while stopped")
+  {
+    c.ticks(sm, 24 * 4, 120.);
+    REQUIRE(c.count(libremidi::clock_event::tempo) == 4);
+    REQUIRE(c.count(libremidi::clock_event::beat) == 0);
+  }
+}
+
+TEST_CASE("Clock tracking: transport and position", "[timing][clock][tracker]")
+{
+  clock_collector c;
+  auto sm = c.make_state_machine();
+
+  SECTION("start, then one beat event per quarter note")
+  {
+    sm.on_bytes({std::vector<uint8_t>{0xFA}}, c.time);
+    c.ticks(sm, 24 * 2 + 1, 120.);
+
+    const auto s = c.tracker.state();
+    REQUIRE(s.running);
+    REQUIRE(s.beats == 2.);
+    REQUIRE(s.phase() == 0.);
+    REQUIRE(c.count(libremidi::clock_event::start) == 1);
+    REQUIRE(c.count(libremidi::clock_event::beat) == 3);
+    REQUIRE(c.events.back().state.beats == 2.);
+  }
+
+  SECTION("song position pointer and continue")
+  {
+    c.ticks(sm, 24 * 2, 120.);
+    sm.on_bytes({std::vector<uint8_t>{0xFC}}, c.time);
+    // 16 MIDI beats: 4 quarter notes
+    sm.on_bytes({std::vector<uint8_t>{0xF2, 16, 0}}, c.time);
+    REQUIRE(c.tracker.state().beats == 4.);
+    REQUIRE(!c.tracker.state().running);
+
+    sm.on_bytes({std::vector<uint8_t>{0xFB}}, c.time);
+    c.ticks(sm, 13, 120.);
+    const auto s = c.tracker.state();
+    REQUIRE(s.running);
+    REQUIRE(s.beats == 4.5);
+    REQUIRE(s.phase() == 0.5);
+    REQUIRE(c.count(libremidi::clock_event::position) == 1);
+    REQUIRE(c.count(libremidi::clock_event::resume) == 1);
+    REQUIRE(c.count(libremidi::clock_event::stop) == 1);
+  }
+
+  SECTION("stop freezes the position")
+  {
+    sm.on_bytes({std::vector<uint8_t>{0xFA}}, c.time);
+    c.ticks(sm, 24 * 2 + 1, 120.);
+    sm.on_bytes({std::vector<uint8_t>{0xFC}}, c.time);
+    c.ticks(sm, 24 * 2, 120.);
+    REQUIRE(!c.tracker.state().running);
+    REQUIRE(c.tracker.state().beats == 2.);
+    REQUIRE(c.tracker.state().beats_at(c.time) == 2.);
+  }
+
+  SECTION("extrapolated position while running")
+  {
+    sm.on_bytes({std::vector<uint8_t>{0xFA}}, c.time);
+    c.ticks(sm, 24 * 8 + 1, 120.);
+    const auto s = c.tracker.state();
+    // 120 BPM: a quarter note every 500 ms
+    REQUIRE(std::abs(s.beats_at(s.last_tick + 250'000'000) - 8.5) < 0.01);
+  }
+
+  SECTION("multi-message packets")
+  {
+    const uint8_t bytes[] = {0xFA, 0xF8, 0xF2, 0x08, 0x00, 0xFB, 0xF8};
+    sm.on_bytes_multi(bytes, c.time);
+    REQUIRE(c.tracker.state().running);
+    REQUIRE(c.tracker.state().beats == 2.);
+    REQUIRE(c.count(libremidi::clock_event::position) == 1);
+  }
+}
+
+TEST_CASE("Clock tracking with ignore_timing", "[timing][clock][tracker][filter]")
+{
+  clock_collector c;
+  c.configuration.ignore_timing = true;
+  auto sm = c.make_state_machine();
+
+  sm.on_bytes({std::vector<uint8_t>{0xFA}}, c.time);
+  c.ticks(sm, 24 * 8 + 1, 120.);
+
+  // The ticks are tracked, but not passed to on_message
+  REQUIRE(c.messages.size() == 1);
+  REQUIRE(c.messages[0][0] == 0xFA);
+  REQUIRE(c.tracker.state().beats == 8.);
+  REQUIRE(std::abs(c.tracker.state().bpm - 120.) < 0.5);
+}
+
+TEST_CASE("Clock tracking is disabled by default", "[timing][clock][tracker]")
+{
+  midi1_collector c;
+  libremidi::midi_clock_tracker tracker;
+  libremidi::midi1::input_state_machine sm{c.configuration, nullptr, &tracker};
+
+  sm.on_bytes({std::vector<uint8_t>{0xFA}}, 0);
+  REQUIRE(!tracker.state().running);
+}
+
+TEST_CASE("Clock tracking without on_message", "[timing][clock][tracker]")
+{
+  // Only the raw data is delivered: the tracker and the counters still see the messages
+  libremidi::midi_clock_tracker tracker;
+  libremidi::atomic_port_counters counters;
+  libremidi::input_configuration conf;
+  int raw = 0;
+  conf.on_raw_data = [&](std::span<const uint8_t>, int64_t) { raw++; };
+  conf.timestamps = libremidi::timestamp_mode::Absolute;
+  conf.ignore_sensing = true;
+  conf.track_clock = true;
+  libremidi::midi1::input_state_machine sm{conf, &counters, &tracker};
+
+  sm.on_bytes({std::vector<uint8_t>{0xFA}}, 1'000'000'000);
+  sm.on_bytes_multi({std::vector<uint8_t>{0xFE, 0x90, 60}}, 1'000'000'000);
+  REQUIRE(raw == 2);
+  REQUIRE(tracker.state().running);
+  REQUIRE(counters.filtered == 1);
+  REQUIRE(counters.truncated == 1);
+}
+
+TEST_CASE("Clock tracking from UMP", "[timing][clock][tracker][midi2]")
+{
+  libremidi::midi_clock_tracker tracker;
+  libremidi::ump_input_configuration conf;
+  conf.on_message = [](libremidi::ump&&) { };
+  conf.timestamps = libremidi::timestamp_mode::Absolute;
+  conf.track_clock = true;
+  libremidi::midi2::input_state_machine sm{conf, nullptr, &tracker};
+
+  int64_t time = 1'000'000'000;
+  const uint32_t start[] = {0x10FA0000};
+  sm.on_bytes(start, time);
+  // Song position: 8 MIDI beats, i.e. 2 quarter notes
+  const uint32_t spp[] = {0x10F20800};
+  sm.on_bytes(spp, time);
+  const uint32_t resume[] = {0x10FB0000};
+  sm.on_bytes(resume, time);
+
+  for (int i = 0; i < 24 * 4 + 1; i++)
+  {
+    const uint32_t tick[] = {0x10F80000};
+    sm.on_bytes(tick, time);
+    time += 20'833'333;
+  }
+
+  const auto s = tracker.state();
+  REQUIRE(s.running);
+  REQUIRE(s.beats == 6.);
+  REQUIRE(std::abs(s.bpm - 120.) < 0.5);
+}
+
+// ============================================================================
+// MTC assembling in the input state machines
+// ============================================================================
+
+TEST_CASE("MTC assembling from MIDI 1", "[timing][mtc][tracker]")
+{
+  using mtc = libremidi::mtc_protocol;
+  const mtc::timecode tc{1, 23, 45, 12, mtc::frame_rate::fps_25};
+
+  midi1_collector c;
+  libremidi::mtc_assembler assembler;
+  std::vector<libremidi::mtc_event> events;
+  c.configuration.timestamps = libremidi::timestamp_mode::Absolute;
+  c.configuration.ignore_timing = true;
+  c.configuration.ignore_sysex = true;
+  c.configuration.track_timecode = true;
+  c.configuration.on_timecode = [&](const libremidi::mtc_event& e) { events.push_back(e); };
+  libremidi::midi1::input_state_machine sm{c.configuration, nullptr, nullptr, &assembler};
+
+  SECTION("quarter frames, even if ignore_timing discards them")
+  {
+    int64_t time = 1'000'000'000;
+    for (int i = 0; i < 8; i++, time += 10'000'000)
+    {
+      const auto qf = mtc::make_quarter_frame(tc, i);
+      sm.on_bytes({qf.bytes.data(), qf.bytes.size()}, time);
+    }
+    REQUIRE(c.messages.empty());
+    REQUIRE(assembler.state().locked);
+    REQUIRE(assembler.state().timecode() == mtc::timecode{1, 23, 45, 13, tc.rate});
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].kind == libremidi::mtc_event::locked);
+  }
+
+  SECTION("quarter frames in multi-message packets")
+  {
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < 8; i++)
+    {
+      const auto qf = mtc::make_quarter_frame(tc, i);
+      bytes.insert(bytes.end(), qf.bytes.begin(), qf.bytes.end());
+      bytes.push_back(0xF8);
+    }
+    sm.on_bytes_multi(bytes, 1'000'000'000);
+    REQUIRE(assembler.state().locked);
+  }
+
+  SECTION("full frame, even if ignore_sysex discards it")
+  {
+    const auto ff = mtc::make_full_frame(tc);
+    sm.on_bytes({ff.bytes.data(), ff.bytes.size()}, 1'000'000'000);
+    REQUIRE(c.messages.empty());
+    REQUIRE(assembler.state().timecode() == tc);
+    REQUIRE(assembler.state().time == 1'000'000'000);
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].kind == libremidi::mtc_event::full_frame);
+  }
+}
+
+TEST_CASE("MTC assembling from UMP", "[timing][mtc][tracker][midi2]")
+{
+  using mtc = libremidi::mtc_protocol;
+  const mtc::timecode tc{10, 0, 0, 0, mtc::frame_rate::fps_30_drop};
+
+  libremidi::mtc_assembler assembler;
+  libremidi::ump_input_configuration conf;
+  conf.on_message = [](libremidi::ump&&) { };
+  conf.timestamps = libremidi::timestamp_mode::Absolute;
+  conf.track_timecode = true;
+  libremidi::midi2::input_state_machine sm{conf, nullptr, nullptr, &assembler};
+
+  SECTION("quarter frames")
+  {
+    int64_t time = 1'000'000'000;
+    for (int i = 0; i < 8; i++, time += 10'000'000)
+    {
+      const uint32_t qf[] = {0x10F10000u | (uint32_t(mtc::quarter_frame_data(tc, i)) << 8)};
+      sm.on_bytes(qf, time);
+    }
+    REQUIRE(assembler.state().locked);
+    REQUIRE(assembler.state().timecode() == mtc::timecode{10, 0, 0, 1, tc.rate});
+  }
+
+  SECTION("full frame in two SysEx7 packets")
+  {
+    // 7F 7F 01 01 hr mn | sc fr
+    const uint8_t hr = 10 | (2 << 5);
+    const uint32_t start[] = {0x30167F7Fu, 0x0101'0000u | (uint32_t(hr) << 8)};
+    const uint32_t end[] = {0x30320000u, 0};
+    sm.on_bytes(start, 1'000'000'000);
+    REQUIRE(!assembler.state().locked);
+    sm.on_bytes(end, 1'000'000'000);
+    REQUIRE(assembler.state().timecode() == tc);
+  }
+}
@@ -0,0 +1,734 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/network.hpp>
+#include <libremidi/backends/network_ump.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include <array>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// A plain UDP socket to look at the datagrams the way they go on the wire
+struct udp_listener
+{
+  boost::asio::io_context ctx;
+  boost::asio::ip::udp::socket socket{ctx};
+  int port{};
+
+  udp_listener()
+  {
+    socket.open(boost::asio::ip::udp::v4());
+    socket.bind({boost::asio::ip::make_address("127.0.0.1"), 0});
+    port = socket.local_endpoint().port();
+  }
+
+  std::vector<std::vector<char>> receive_all()
+  {
+    std::vector<std::vector<char>> res;
+    boost::asio::ip::udp::endpoint from;
+    while (socket.available() > 0)
+    {
+      std::vector<char> dgram(65535);
+      auto sz = socket.receive_from(boost::asio::buffer(dgram), from);
+      dgram.resize(sz);
+      res.push_back(std::move(dgram));
+    }
+    return res;
+  }
+};
+
+std::vector<libremidi::message> parse_midi1(
+    const std::vector<char>& dgram, std::string_view pattern,
+    libremidi::osc_fragment_reassembler* reassembly = nullptr)
+{
+  std::vector<libremidi::message> res;
+  const auto on_msg = [&](std::span<const uint8_t> bytes) {
+    res.push_back(libremidi::message{{bytes.begin(), bytes.end()}, 0});
+  };
+  libremidi::osc_parser<libremidi::net::osc_parser_midi1, decltype(on_msg)> parser{
+      {reassembly}, on_msg, pattern};
+  REQUIRE(parser.parse_packet(dgram.data(), dgram.size()) == stdx::error{});
+  return res;
+}
+}
+
+TEST_CASE("one datagram per message without coalescing", "[network]")
+{
+  udp_listener listener;
+
+  libremidi::midi_out out{
+      {}, libremidi::net::dgram_output_configuration{.port = listener.port}};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+  REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+  REQUIRE(out.send_message(0x80, 60, 0) == stdx::error{});
+  REQUIRE(out.send_message(0xF8) == stdx::error{});
+  REQUIRE(out.send_message(nullptr, 0) != stdx::error{});
+
+  auto dgrams = listener.receive_all();
+  REQUIRE(dgrams.size() == 3);
+  REQUIRE(parse_midi1(dgrams[0], "/midi").size() == 1);
+  REQUIRE(parse_midi1(dgrams[1], "/midi").size() == 1);
+
+  auto clock = parse_midi1(dgrams[2], "/midi");
+  REQUIRE(clock.size() == 1);
+  REQUIRE(clock[0].bytes == libremidi::midi_bytes{0xF8});
+}
+
+TEST_CASE("coalescing multiple messages per datagram", "[network]")
+{
+  udp_listener listener;
+  boost::asio::io_context ctx;
+
+  libremidi::net::dgram_output_configuration conf{
+      .port = listener.port,
+      .io_context = &ctx,
+      .flush_interval = std::chrono::milliseconds(10)};
+
+  SECTION("explicit flush")
+  {
+    libremidi::midi_out out{{}, conf};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    for (int i = 0; i < 5; i++)
+      REQUIRE(out.send_message(0xB0, i, 127 - i) == stdx::error{});
+    REQUIRE(listener.receive_all().empty());
+
+    REQUIRE(out.flush() == stdx::error{});
+
+    auto dgrams = listener.receive_all();
+    REQUIRE(dgrams.size() == 1);
+
+    auto msgs = parse_midi1(dgrams[0], "/midi");
+    REQUIRE(msgs.size() == 5);
+    for (int i = 0; i < 5; i++)
+    {
+      REQUIRE(msgs[i].bytes[0] == 0xB0);
+      REQUIRE(msgs[i].bytes[1] == i);
+      REQUIRE(msgs[i].bytes[2] == 127 - i);
+    }
+  }
+
+  SECTION("flush window")
+  {
+    libremidi::midi_out out{{}, conf};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+    REQUIRE(out.send_message(0x90, 64, 100) == stdx::error{});
+    ctx.run_one();
+
+    auto dgrams = listener.receive_all();
+    REQUIRE(dgrams.size() == 1);
+    REQUIRE(parse_midi1(dgrams[0], "/midi").size() == 2);
+  }
+
+  SECTION("datagram size bound")
+  {
+    // 8 bytes of pattern, then the type tags and 4 bytes per message
+    conf.max_datagram_size = 8 + 8 + 4 * 4;
+    libremidi::midi_out out{{}, conf};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    for (int i = 0; i < 10; i++)
+      REQUIRE(out.send_message(0x90, i, 100) == stdx::error{});
+
+    // The full datagrams wait for the flush, to be sent together
+    REQUIRE(listener.receive_all().empty());
+    REQUIRE(out.flush() == stdx::error{});
+
+    auto dgrams = listener.receive_all();
+    REQUIRE(dgrams.size() == 3);
+
+    int count = 0;
+    for (auto& dgram : dgrams)
+    {
+      REQUIRE(dgram.size() <= 32);
+      for (auto& msg : parse_midi1(dgram, "/midi"))
+        REQUIRE(msg.bytes[1] == count++);
+    }
+    REQUIRE(count == 10);
+  }
+
+  SECTION("scheduled messages bound the flush time")
+  {
+    conf.flush_interval = std::chrono::seconds(10);
+    libremidi::midi_out out{{}, conf};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+    const auto now = out.current_time();
+    REQUIRE(out.schedule_message(now - 1, std::array<unsigned char, 3>{0x80, 60, 0}.data(), 3)
+            == stdx::error{});
+
+    auto dgrams = listener.receive_all();
+    REQUIRE(dgrams.size() == 1);
+    REQUIRE(parse_midi1(dgrams[0], "/midi").size() == 2);
+  }
+
+  SECTION("destroyed with a queued flush")
+  {
+    // The flush is due, and its handler queued behind another one as the output is destroyed
+    std::promise<void> blocked, release;
+    boost::asio::steady_timer blocker{ctx};
+    blocker.expires_after(std::chrono::milliseconds(0));
+    blocker.async_wait([&](boost::system::error_code) {
+      blocked.set_value();
+      release.get_future().wait();
+    });
+
+    auto out = std::make_unique<libremidi::midi_out>(libremidi::output_configuration{}, conf);
+    REQUIRE(out->open_virtual_port("/midi") == stdx::error{});
+    REQUIRE(out->send_message(0x90, 60, 100) == stdx::error{});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::thread runner{[&] { ctx.run(); }};
+    blocked.get_future().wait();
+    out.reset();
+    release.set_value();
+    runner.join();
+
+    REQUIRE(listener.receive_all().size() == 1);
+  }
+}
+
+TEST_CASE("sysex over OSC", "[network]")
+{
+  udp_listener listener;
+  boost::asio::io_context ctx;
+
+  libremidi::midi_bytes sysex(1000);
+  for (std::size_t i = 0; i < sysex.size(); i++)
+    sysex[i] = i % 0x80;
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+
+  libremidi::net::dgram_output_configuration conf{
+      .port = listener.port,
+      .io_context = &ctx,
+      .flush_interval = std::chrono::milliseconds(10)};
+
+  SECTION("in a single blob, coalesced with short messages")
+  {
+    libremidi::midi_out out{{}, conf};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+    REQUIRE(out.send_message(sysex.data(), sysex.size()) == stdx::error{});
+    REQUIRE(out.send_message(0x80, 60, 0) == stdx::error{});
+    REQUIRE(out.flush() == stdx::error{});
+
+    auto dgrams = listener.receive_all();
+    REQUIRE(dgrams.size() == 1);
+
+    auto msgs = parse_midi1(dgrams[0], "/midi");
+    REQUIRE(msgs.size() == 3);
+    REQUIRE(msgs[0].bytes == libremidi::midi_bytes{0x90, 60, 100});
+    REQUIRE(msgs[1].bytes == sysex);
+    REQUIRE(msgs[2].bytes == libremidi::midi_bytes{0x80, 60, 0});
+  }
+
+  SECTION("fragmented across datagrams")
+  {
+    conf.max_datagram_size = 128;
+    libremidi::midi_out out{{}, conf};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    REQUIRE(out.send_message(sysex.data(), sysex.size()) == stdx::error{});
+    REQUIRE(out.send_message(sysex.data(), sysex.size()) == stdx::error{});
+
+    auto dgrams = listener.receive_all();
+    REQUIRE(dgrams.size() > 2 * sysex.size() / 128);
+
+    libremidi::osc_fragment_reassembler reassembly{4096};
+    std::vector<libremidi::message> msgs;
+    for (auto& dgram : dgrams)
+    {
+      REQUIRE(dgram.size() <= 128);
+      for (auto& msg : parse_midi1(dgram, "/midi", &reassembly))
+        msgs.push_back(std::move(msg));
+    }
+    REQUIRE(msgs.size() == 2);
+    REQUIRE(msgs[0].bytes == sysex);
+    REQUIRE(msgs[1].bytes == sysex);
+
+    SECTION("lost fragment")
+    {
+      dgrams.erase(dgrams.begin() + 1);
+      msgs.clear();
+      for (auto& dgram : dgrams)
+        for (auto& msg : parse_midi1(dgram, "/midi", &reassembly))
+          msgs.push_back(std::move(msg));
+      REQUIRE(msgs.size() == 1);
+      REQUIRE(msgs[0].bytes == sysex);
+    }
+
+    SECTION("message too large")
+    {
+      reassembly.max_size = 512;
+      msgs.clear();
+      for (auto& dgram : dgrams)
+        for (auto& msg : parse_midi1(dgram, "/midi", &reassembly))
+          msgs.push_back(std::move(msg));
+      REQUIRE(msgs.empty());
+    }
+  }
+}
+
+TEST_CASE("coalescing UMP", "[network]")
+{
+  udp_listener listener;
+  boost::asio::io_context ctx;
+
+  libremidi::midi_out out{
+      {}, libremidi::net_ump::dgram_output_configuration{
+              .port = listener.port,
+              .io_context = &ctx,
+              .flush_interval = std::chrono::milliseconds(10)}};
+  REQUIRE(out.open_virtual_port("/ump") == stdx::error{});
+
+  REQUIRE(out.send_ump(cmidi2_ump_midi2_note_on(0, 0, 60, 0, 1000, 0)) == stdx::error{});
+  REQUIRE(out.send_ump(cmidi2_ump_system_message(0, 0xF8, 0, 0)) == stdx::error{});
+  REQUIRE(out.send_ump(nullptr, 0) == std::errc::message_size);
+  REQUIRE(out.flush() == stdx::error{});
+
+  auto dgrams = listener.receive_all();
+  REQUIRE(dgrams.size() == 1);
+
+  std::vector<std::size_t> sizes;
+  const auto on_msg = [&](const uint32_t*, std::size_t n) { sizes.push_back(n); };
+  libremidi::osc_parser<libremidi::net_ump::osc_parser_midi2, decltype(on_msg)> parser{
+      {}, on_msg, "/ump"};
+  REQUIRE(parser.parse_packet(dgrams[0].data(), dgrams[0].size()) == stdx::error{});
+  REQUIRE(sizes == std::vector<std::size_t>{2, 1});
+}
+
+TEST_CASE("batched receive", "[network]")
+{
+  // Arbitrary fixed port
+  const int port = 21950;
+
+  std::mutex mtx;
+  std::vector<libremidi::message> received;
+  libremidi::midi_in in{
+      {.on_message =
+           [&](libremidi::message&& m) {
+    std::lock_guard lock{mtx};
+    received.push_back(std::move(m));
+  },
+       .ignore_sysex = false},
+      libremidi::net::dgram_input_configuration{
+          .port = port, .receive_batch = 8, .receive_buffer_size = 1 << 20}};
+  REQUIRE(in.open_virtual_port("/midi") == stdx::error{});
+
+  libremidi::midi_out out{
+      {}, libremidi::net::dgram_output_configuration{.port = port, .max_datagram_size = 256}};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+  // More datagrams than a batch at once: the sysex fragments
+  libremidi::midi_bytes sysex(5000, 0x12);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+
+  const int count = 300;
+  for (int i = 0; i < count; i++)
+  {
+    REQUIRE(out.send_message(0xB0, i % 128, i / 128) == stdx::error{});
+    if (i % 100 == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  REQUIRE(out.send_message(sysex.data(), sysex.size()) == stdx::error{});
+
+  for (int i = 0; i < 200; i++)
+  {
+    {
+      std::lock_guard lock{mtx};
+      if (received.size() == count + 1)
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard lock{mtx};
+  REQUIRE(received.size() == count + 1);
+  for (int i = 0; i < count; i++)
+    REQUIRE(received[i].bytes == libremidi::midi_bytes{0xB0, uint8_t(i % 128), uint8_t(i / 128)});
+  REQUIRE(received.back().bytes == sysex);
+}
+
+TEST_CASE("datagrams too small for a fragment", "[network]")
+{
+  // "/midi" takes 8 bytes: room for a short message, not for a fragment header
+  for (int size : {16, 20, 23})
+  {
+    libremidi::midi_out out{
+        {}, libremidi::net::dgram_output_configuration{.port = 21953, .max_datagram_size = size}};
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+    libremidi::midi_bytes sysex(64, 0x12);
+    sysex.front() = 0xF0;
+    sysex.back() = 0xF7;
+    REQUIRE(out.send_message(sysex.data(), sysex.size()) == std::errc::message_size);
+  }
+}
+
+TEST_CASE("sharded receive", "[network]")
+{
+  const int port = 21952;
+
+  std::mutex mtx;
+  std::vector<libremidi::message> received;
+  libremidi::midi_in in{
+      {.on_message =
+           [&](libremidi::message&& m) {
+    std::lock_guard lock{mtx};
+    received.push_back(std::move(m));
+  }},
+      libremidi::net::dgram_input_configuration{
+          .accept = "127.0.0.1",
+          .port = port,
+          .receive_buffer_size = 1024 * 1024,
+          .receive_threads = 4}};
+  REQUIRE(in.open_virtual_port("/midi") == stdx::error{});
+
+  // Each output has its own source port, that the kernel hashes to one of the sockets
+  const int senders = 8, count = 100;
+  std::vector<std::unique_ptr<libremidi::midi_out>> outs;
+  for (int s = 0; s < senders; s++)
+  {
+    auto& out = *outs.emplace_back(std::make_unique<libremidi::midi_out>(
+        libremidi::output_configuration{},
+        libremidi::net::dgram_output_configuration{.port = port}));
+    REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+  }
+
+  // Paced, so that the receive threads keep up
+  for (int i = 0; i < count; i++)
+  {
+    for (int s = 0; s < senders; s++)
+      REQUIRE(outs[s]->send_message(0x90 + s, i, 100) == stdx::error{});
+    if (i % 10 == 9)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  for (int i = 0; i < 200; i++)
+  {
+    {
+      std::lock_guard lock{mtx};
+      if (received.size() == senders * count)
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  // Loopback UDP may still drop a few datagrams under load: every sender gets through,
+  // and the order is kept for each sender
+  std::lock_guard lock{mtx};
+  REQUIRE(received.size() >= senders * count * 9 / 10);
+
+  std::array<int, senders> next{};
+  for (auto& m : received)
+  {
+    const int s = m.bytes[0] - 0x90;
+    REQUIRE(m.bytes[1] >= next[s]);
+    next[s] = m.bytes[1] + 1;
+  }
+  for (int s = 0; s < senders; s++)
+    REQUIRE(next[s] > 0);
+}
+
+TEST_CASE("multicast", "[network]")
+{
+  const int port = 21954;
+  const std::string group = "239.255.77.1";
+
+  std::mutex mtx;
+  std::vector<libremidi::message> received;
+  libremidi::midi_in in{
+      {.on_message =
+           [&](libremidi::message&& m) {
+    std::lock_guard lock{mtx};
+    received.push_back(std::move(m));
+  }},
+      libremidi::net::dgram_input_configuration{
+          .port = port, .multicast_group = group, .multicast_interface = "127.0.0.1"}};
+  REQUIRE(in.open_virtual_port("/midi") == stdx::error{});
+
+  libremidi::midi_out out{
+      {}, libremidi::net::dgram_output_configuration{
+              .host = group, .port = port, .multicast_interface = "127.0.0.1"}};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+  REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+
+  for (int i = 0; i < 100; i++)
+  {
+    {
+      std::lock_guard lock{mtx};
+      if (!received.empty())
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard lock{mtx};
+  REQUIRE(received.size() == 1);
+  REQUIRE(received[0].bytes == libremidi::midi_bytes{0x90, 60, 100});
+}
+
+TEST_CASE("clock sync estimation", "[network]")
+{
+  // Remote clock 5 s ahead, running 50 ppm faster
+  const int64_t offset = 5'000'000'000;
+  const double drift = 50e-6;
+  const auto remote = [&](int64_t local) {
+    return local + offset + static_cast<int64_t>(drift * static_cast<double>(local));
+  };
+
+  libremidi::clock_sync_estimator est;
+  REQUIRE(!est.valid());
+
+  // One exchange every 500 ms, with a 200 µs round trip and every third one queued for 5 ms
+  int64_t t = 1'000'000'000;
+  for (int i = 0; i < 32; i++)
+  {
+    const int64_t queued = (i % 3 == 0) ? 5'000'000 : 0;
+    const int64_t t0 = t;
+    const int64_t t1 = remote(t0 + 100'000 + queued);
+    const int64_t t2 = t1 + 10'000;
+    const int64_t t3 = t0 + 210'000 + queued;
+    est.add(t0, t1, t2, t3);
+    t += 500'000'000;
+  }
+
+  REQUIRE(est.valid());
+  REQUIRE(est.round_trip() == 200'000);
+  REQUIRE(std::abs(est.drift() - drift) < 1e-6);
+  REQUIRE(std::abs(est.to_remote(t) - remote(t)) < 20'000);
+  REQUIRE(std::abs(est.to_remote(t + 1'000'000'000) - remote(t + 1'000'000'000)) < 20'000);
+
+  SECTION("clock messages")
+  {
+    const int64_t times[3]{-1, 1'234'567'890'123, 42};
+    auto req = libremidi::write_osc_clock(std::span{times, 1});
+    auto msg = libremidi::parse_osc_clock(reinterpret_cast<const char*>(req.data()), req.size());
+    REQUIRE(msg);
+    REQUIRE(msg->count == 1);
+    REQUIRE(msg->times[0] == -1);
+
+    auto rep = libremidi::write_osc_clock(times);
+    REQUIRE(rep.size() % 4 == 0);
+    msg = libremidi::parse_osc_clock(reinterpret_cast<const char*>(rep.data()), rep.size());
+    REQUIRE(msg);
+    REQUIRE(msg->count == 3);
+    REQUIRE(msg->times == std::array<int64_t, 3>{-1, 1'234'567'890'123, 42});
+
+    REQUIRE(!libremidi::parse_osc_clock("/midi\0\0\0,m\0\0\0\0\0\0", 16));
+  }
+}
+
+TEST_CASE("timed delivery after its owner is destroyed", "[network]")
+{
+  boost::asio::io_context ctx;
+  auto lifetime = std::make_shared<libremidi::async_lifetime>();
+  int delivered = 0;
+  auto delivery = std::make_unique<libremidi::timed_delivery<int>>(
+      ctx, lifetime, [&](int64_t, int&) { delivered++; });
+
+  // The message is due, and its handler queued behind another one as the owner is destroyed
+  std::promise<void> blocked, release;
+  boost::asio::steady_timer blocker{ctx};
+  blocker.expires_after(std::chrono::milliseconds(0));
+  blocker.async_wait([&](boost::system::error_code) {
+    blocked.set_value();
+    release.get_future().wait();
+  });
+
+  {
+    std::lock_guard lock{lifetime->mutex};
+    delivery->push(libremidi::system_ns(), 1);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  std::thread runner{[&] { ctx.run(); }};
+  blocked.get_future().wait();
+  lifetime->end();
+  delivery.reset();
+  release.set_value();
+  runner.join();
+
+  REQUIRE(delivered == 0);
+}
+
+TEST_CASE("input destroyed while receiving", "[network]")
+{
+  const int port = 21984;
+  boost::asio::io_context ctx;
+
+  // The input is destroyed from another thread while a datagram is being delivered
+  std::promise<void> inside, release;
+  auto in = std::make_unique<libremidi::midi_in>(
+      libremidi::input_configuration{.on_message = [&](libremidi::message&&) {
+        inside.set_value();
+        release.get_future().wait();
+      }},
+      libremidi::net::dgram_input_configuration{
+          .accept = "127.0.0.1", .port = port, .io_context = &ctx});
+  REQUIRE(in->open_virtual_port("/midi") == stdx::error{});
+
+  libremidi::midi_out out{
+      {}, libremidi::net::dgram_output_configuration{.host = "127.0.0.1", .port = port}};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+  REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+
+  std::thread runner{[&] { ctx.run(); }};
+  inside.get_future().wait();
+  std::thread destroyer{[&] { in.reset(); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  release.set_value();
+  destroyer.join();
+  runner.join();
+}
+
+TEST_CASE("thread configuration of the sockets", "[network]")
+{
+  const int port = 21985;
+  std::promise<void> in_started, out_started;
+  libremidi::net::dgram_input_configuration in_conf{.accept = "127.0.0.1", .port = port};
+  in_conf.thread.on_started = [&](const libremidi::thread_report&) { in_started.set_value(); };
+  libremidi::net::dgram_output_configuration out_conf{
+      .host = "127.0.0.1", .port = port, .flush_interval = std::chrono::milliseconds(1)};
+  out_conf.thread.on_started = [&](const libremidi::thread_report&) { out_started.set_value(); };
+
+  libremidi::midi_in in{
+      libremidi::input_configuration{.on_message = [](libremidi::message&&) {}}, in_conf};
+  REQUIRE(in.open_virtual_port("/midi") == stdx::error{});
+  REQUIRE(in_started.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+  libremidi::midi_out out{{}, out_conf};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+  REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+  REQUIRE(out_started.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+}
+
+TEST_CASE("clock sync between peers", "[network]")
+{
+  const int port = 21960;
+  const auto latency = std::chrono::milliseconds(30);
+
+  std::mutex mtx;
+  std::vector<std::pair<libremidi::message, int64_t>> received;
+  libremidi::midi_in in{
+      {.on_message =
+           [&](libremidi::message&& m) {
+    std::lock_guard lock{mtx};
+    received.emplace_back(std::move(m), libremidi::system_ns());
+  },
+       .timestamps = libremidi::timestamp_mode::SystemMonotonic},
+      libremidi::net::dgram_input_configuration{
+          .accept = "127.0.0.1", .port = port, .latency = latency}};
+  REQUIRE(in.open_virtual_port("/midi") == stdx::error{});
+
+  libremidi::net::midi_out out{
+      {.timestamps = libremidi::timestamp_mode::SystemMonotonic},
+      {.host = "127.0.0.1",
+       .port = port,
+       .clock_sync = true,
+       .clock_sync_interval = std::chrono::milliseconds(50)}};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+  for (int i = 0; i < 200 && !out.m_sender.clock_estimate().valid(); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  const auto est = out.m_sender.clock_estimate();
+  REQUIRE(est.valid());
+
+  // Same host, same clock
+  REQUIRE(std::abs(est.offset()) < 1'000'000);
+
+  const unsigned char on[3]{0x90, 60, 100}, off[3]{0x80, 60, 0}, on2[3]{0x90, 61, 100};
+  const int64_t sent = libremidi::system_ns();
+  REQUIRE(out.send_message(on, 3) == stdx::error{});
+
+  // Scheduled 20 ms ahead: delivered after the latency, in order
+  REQUIRE(out.schedule_message(sent + 20'000'000, off, 3) == stdx::error{});
+  REQUIRE(out.send_message(on2, 3) == stdx::error{});
+
+  for (int i = 0; i < 100; i++)
+  {
+    {
+      std::lock_guard lock{mtx};
+      if (received.size() == 3)
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard lock{mtx};
+  REQUIRE(received.size() == 3);
+  REQUIRE(received[0].first.bytes == libremidi::midi_bytes{0x90, 60, 100});
+  REQUIRE(received[1].first.bytes == libremidi::midi_bytes{0x90, 61, 100});
+  REQUIRE(received[2].first.bytes == libremidi::midi_bytes{0x80, 60, 0});
+
+  const int64_t lat = std::chrono::nanoseconds(latency).count();
+  for (auto& [msg, arrival] : received)
+  {
+    // Not delivered before its time, and timestamped with it
+    REQUIRE(arrival >= msg.timestamp);
+    REQUIRE(arrival - msg.timestamp < 10'000'000);
+  }
+  REQUIRE(std::abs(received[0].first.timestamp - (sent + lat)) < 2'000'000);
+  REQUIRE(std::abs(received[2].first.timestamp - (sent + 20'000'000 + lat)) < 2'000'000);
+}
+
+TEST_CASE("clock sync with UMP", "[network]")
+{
+  const int port = 21962;
+
+  std::mutex mtx;
+  std::vector<libremidi::ump> received;
+  libremidi::midi_in in{
+      libremidi::ump_input_configuration{
+          .on_message =
+              [&](libremidi::ump&& m) {
+    std::lock_guard lock{mtx};
+    received.push_back(m);
+  },
+          .timestamps = libremidi::timestamp_mode::SystemMonotonic},
+      libremidi::net_ump::dgram_input_configuration{
+          .accept = "127.0.0.1", .port = port, .latency = std::chrono::milliseconds(10)}};
+  REQUIRE(in.open_virtual_port("/midi") == stdx::error{});
+
+  libremidi::net_ump::midi_out out{
+      {}, {.host = "127.0.0.1", .port = port, .clock_sync = true}};
+  REQUIRE(out.open_virtual_port("/midi") == stdx::error{});
+
+  for (int i = 0; i < 200 && !out.m_sender.clock_estimate().valid(); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  REQUIRE(out.m_sender.clock_estimate().valid());
+
+  const int64_t sent = libremidi::system_ns();
+  const uint32_t ump[2]{0x40903C00, 0xFFFF0000};
+  REQUIRE(out.send_ump(ump, 2) == stdx::error{});
+
+  for (int i = 0; i < 100; i++)
+  {
+    {
+      std::lock_guard lock{mtx};
+      if (!received.empty())
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard lock{mtx};
+  REQUIRE(received.size() == 1);
+  REQUIRE(received[0].data[0] == 0x40903C00);
+  REQUIRE(std::abs(received[0].timestamp - (sent + 10'000'000)) < 2'000'000);
+}
@@ -0,0 +1,377 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/network_ump.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using datagram = std::vector<uint8_t>;
+
+struct sender
+{
+  libremidi::network_midi2::ump_sender stream{};
+  std::vector<datagram> datagrams{};
+
+  void on_datagram(const std::vector<boost::asio::const_buffer>& buffers)
+  {
+    auto& d = datagrams.emplace_back();
+    for (auto& b : buffers)
+    {
+      auto p = static_cast<const uint8_t*>(b.data());
+      d.insert(d.end(), p, p + b.size());
+    }
+  }
+
+  void send(uint32_t word)
+  {
+    auto f = [this](const auto& buffers) { on_datagram(buffers); };
+    stream.write(std::span{&word, 1}, f);
+    stream.flush(f);
+  }
+};
+
+std::vector<uint32_t>
+receive(libremidi::network_midi2::ump_receiver& receiver, const std::vector<datagram>& datagrams)
+{
+  std::vector<uint32_t> res;
+  for (auto& d : datagrams)
+  {
+    REQUIRE(libremidi::network_midi2::read_datagram(d, [&](const auto& header, auto payload) {
+      REQUIRE(header.command == libremidi::network_midi2::command::ump_data);
+      receiver.on_data(header.specific, payload, [&](std::span<const uint8_t> ump) {
+        libremidi::byte_reader r{ump};
+        while (r.remaining() >= 4)
+          res.push_back(r.u32());
+      });
+    }));
+  }
+  return res;
+}
+}
+
+TEST_CASE("network midi2 commands", "[network_midi2]")
+{
+  using namespace libremidi::network_midi2;
+  datagram d{'M', 'I', 'D', 'I'};
+  write_identity(d, command::invitation, "endpoint", "product");
+  write_command(d, command::ping, 0, std::vector<uint8_t>{1, 2, 3});
+  REQUIRE(d.size() == 4 + 4 + 8 + 8 + 4 + 4);
+
+  std::vector<command> commands;
+  REQUIRE(read_datagram(d, [&](const command_header& header, std::span<const uint8_t> payload) {
+    commands.push_back(header.command);
+    if (header.command == command::invitation)
+      REQUIRE(read_identity(header, payload) == "endpoint");
+    else
+      REQUIRE(payload.size() == 4);
+  }));
+  REQUIRE(commands == std::vector{command::invitation, command::ping});
+
+  d.pop_back();
+  REQUIRE(!read_datagram(d, [](auto&&...) { }));
+  d[0] = 'X';
+  REQUIRE(!read_datagram(d, [](auto&&...) { }));
+}
+
+TEST_CASE("network midi2 forward error correction", "[network_midi2]")
+{
+  sender s;
+  s.stream.fec_count = 2;
+  for (uint32_t i = 0; i < 5; i++)
+    s.send(0x20903C00 + i);
+
+  // The previous commands precede the new one
+  REQUIRE(s.datagrams[0].size() == 4 + 8);
+  REQUIRE(s.datagrams[1].size() == 4 + 8 * 2);
+  REQUIRE(s.datagrams[4].size() == 4 + 8 * 3);
+
+  libremidi::network_midi2::ump_receiver receiver;
+  SECTION("no loss")
+  {
+    auto res = receive(receiver, s.datagrams);
+    REQUIRE(
+        res == std::vector<uint32_t>{0x20903C00, 0x20903C01, 0x20903C02, 0x20903C03, 0x20903C04});
+  }
+
+  SECTION("two lost datagrams")
+  {
+    s.datagrams.erase(s.datagrams.begin() + 1, s.datagrams.begin() + 3);
+    auto res = receive(receiver, s.datagrams);
+    REQUIRE(
+        res == std::vector<uint32_t>{0x20903C00, 0x20903C01, 0x20903C02, 0x20903C03, 0x20903C04});
+    REQUIRE(!receiver.missing());
+  }
+
+  SECTION("the redundancy fits in the datagram")
+  {
+    s.datagrams.clear();
+    s.stream.max_datagram_size = 4 + 8 * 2;
+    s.send(0x10F80000);
+    REQUIRE(s.datagrams[0].size() == 4 + 8 * 2);
+  }
+}
+
+TEST_CASE("network midi2 retransmission", "[network_midi2]")
+{
+  sender s{.stream = libremidi::network_midi2::ump_sender{8}};
+  s.stream.fec_count = 0;
+  for (uint32_t i = 0; i < 5; i++)
+    s.send(i);
+
+  libremidi::network_midi2::ump_receiver receiver;
+  auto res = receive(receiver, {s.datagrams[0], s.datagrams[3], s.datagrams[4]});
+  REQUIRE(res == std::vector<uint32_t>{0});
+
+  auto gap = receiver.missing();
+  REQUIRE(gap);
+  REQUIRE(gap->first == 1);
+  REQUIRE(gap->count == 2);
+
+  SECTION("retransmitted")
+  {
+    s.datagrams.clear();
+    REQUIRE(s.stream.retransmit(gap->first, gap->count, [&](const auto& b) { s.on_datagram(b); }));
+    REQUIRE(s.datagrams.size() == 1);
+    res = receive(receiver, s.datagrams);
+    REQUIRE(res == std::vector<uint32_t>{1, 2, 3, 4});
+    REQUIRE(!receiver.missing());
+  }
+
+  SECTION("no longer available")
+  {
+    for (uint32_t i = 5; i < 20; i++)
+      s.send(i);
+    REQUIRE(!s.stream.retransmit(gap->first, gap->count, [](const auto&) { }));
+
+    std::vector<uint32_t> skipped;
+    receiver.skip([&](std::span<const uint8_t> ump) { skipped.push_back(ump[3]); });
+    REQUIRE(skipped == std::vector<uint32_t>{3, 4});
+    REQUIRE(receiver.skipped() == 2);
+  }
+}
+
+namespace
+{
+// Forwards the datagrams between a client and a host, dropping the first transmission
+// of some UMP data commands to exercise retransmissions.
+struct lossy_proxy
+{
+  boost::asio::io_context ctx;
+  boost::asio::ip::udp::socket client_side{ctx}, host_side{ctx};
+  boost::asio::ip::udp::endpoint client, host, from;
+  std::vector<uint8_t> client_buffer = std::vector<uint8_t>(65535),
+                       host_buffer = std::vector<uint8_t>(65535);
+  std::set<uint16_t> dropped;
+  std::thread thread;
+
+  lossy_proxy(int port, int host_port)
+      : host{boost::asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(host_port)}
+  {
+    client_side.open(boost::asio::ip::udp::v4());
+    client_side.bind(
+        {boost::asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(port)});
+    host_side.open(boost::asio::ip::udp::v4());
+    host_side.bind({boost::asio::ip::make_address("127.0.0.1"), 0});
+    from_client();
+    from_host();
+    thread = std::thread{[this] { ctx.run(); }};
+  }
+
+  ~lossy_proxy()
+  {
+    ctx.stop();
+    thread.join();
+  }
+
+  bool drop(std::span<const uint8_t> d)
+  {
+    // Signature, then the first command
+    if (d.size() < 8 || d[4] != 0xFF)
+      return false;
+    const uint16_t seq = (d[6] << 8) | d[7];
+    return seq % 5 == 2 && dropped.insert(seq).second;
+  }
+
+  void from_client()
+  {
+    client_side.async_receive_from(
+        boost::asio::buffer(client_buffer), client, [this](auto ec, std::size_t sz) {
+      if (ec)
+        return;
+      if (!drop({client_buffer.data(), sz}))
+        host_side.send_to(boost::asio::buffer(client_buffer.data(), sz), host);
+      from_client();
+    });
+  }
+
+  void from_host()
+  {
+    host_side.async_receive_from(
+        boost::asio::buffer(host_buffer), from, [this](auto ec, std::size_t sz) {
+      if (ec)
+        return;
+      client_side.send_to(boost::asio::buffer(host_buffer.data(), sz), client);
+      from_host();
+    });
+  }
+};
+
+libremidi::net_ump::dgram_output_configuration
+with_protocol(libremidi::net_ump::dgram_output_configuration conf, int port)
+{
+  conf.protocol = libremidi::net_ump::protocol::NETWORK_MIDI2_UDP;
+  conf.port = port;
+  return conf;
+}
+
+struct session
+{
+  std::mutex mtx;
+  std::vector<uint32_t> received;
+
+  libremidi::midi_in in;
+  libremidi::midi_out out;
+
+  session(int in_port, int out_port, libremidi::net_ump::dgram_output_configuration conf)
+      : in{libremidi::ump_input_configuration{.on_message =
+                                                  [this](libremidi::ump&& m) {
+    std::lock_guard lock{mtx};
+    received.push_back(m.data[1]);
+  }},
+           libremidi::net_ump::dgram_input_configuration{
+               .protocol = libremidi::net_ump::protocol::NETWORK_MIDI2_UDP, .port = in_port}}
+      , out{{}, with_protocol(conf, out_port)}
+  {
+    REQUIRE(in.open_virtual_port("libremidi in") == stdx::error{});
+    REQUIRE(out.open_virtual_port("libremidi out") == stdx::error{});
+
+    // The invitation has to be accepted first
+    bool connected = false;
+    for (int i = 0; i < 200 && !connected; i++)
+    {
+      connected = out.send_ump(cmidi2_ump_midi2_cc(0, 0, 7, 0)) == stdx::error{};
+      if (!connected)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(connected);
+  }
+
+  void wait_for(std::size_t count)
+  {
+    for (int i = 0; i < 300; i++)
+    {
+      {
+        std::lock_guard lock{mtx};
+        if (received.size() >= count)
+          break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+};
+}
+
+TEST_CASE("network midi2 session over loopback", "[network_midi2]")
+{
+  // Arbitrary fixed port
+  const int port = 21938;
+  session s{port, port, {.flush_interval = std::chrono::milliseconds(1)}};
+
+  const uint32_t count = 2000;
+  for (uint32_t i = 1; i <= count; i++)
+    REQUIRE(s.out.send_ump(cmidi2_ump_midi2_cc(0, 0, 7, i)) == stdx::error{});
+
+  s.wait_for(count + 1);
+  std::lock_guard lock{s.mtx};
+  REQUIRE(s.received.size() == count + 1);
+  for (uint32_t i = 0; i <= count; i++)
+    REQUIRE(s.received[i] == i);
+}
+
+TEST_CASE("network midi2 session with losses", "[network_midi2]")
+{
+  const int port = 21940, proxy_port = 21942;
+  lossy_proxy proxy{proxy_port, port};
+
+  // Without redundancy, every loss has to be retransmitted
+  session s{port, proxy_port, {.fec_count = 0}};
+
+  const uint32_t count = 200;
+  for (uint32_t i = 1; i <= count; i++)
+  {
+    REQUIRE(s.out.send_ump(cmidi2_ump_midi2_cc(0, 0, 7, i)) == stdx::error{});
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+
+  s.wait_for(count + 1);
+  REQUIRE(!proxy.dropped.empty());
+
+  std::lock_guard lock{s.mtx};
+  REQUIRE(s.received.size() == count + 1);
+  for (uint32_t i = 0; i <= count; i++)
+    REQUIRE(s.received[i] == i);
+}
+
+TEST_CASE("network midi2 output destroyed with a queued flush", "[network_midi2]")
+{
+  const int port = 21944;
+
+  libremidi::midi_in in{
+      libremidi::ump_input_configuration{.on_message = [](libremidi::ump&&) {}},
+      libremidi::net_ump::dgram_input_configuration{
+          .protocol = libremidi::net_ump::protocol::NETWORK_MIDI2_UDP, .port = port}};
+  REQUIRE(in.open_virtual_port("libremidi in") == stdx::error{});
+
+  boost::asio::io_context ctx;
+  auto out = std::make_unique<libremidi::midi_out>(
+      libremidi::output_configuration{},
+      with_protocol(
+          {.io_context = &ctx, .flush_interval = std::chrono::milliseconds(10)}, port));
+  REQUIRE(out->open_virtual_port("libremidi out") == stdx::error{});
+
+  // The session is established from the caller's io_context
+  {
+    auto wg = boost::asio::make_work_guard(ctx);
+    std::thread runner{[&] { ctx.run(); }};
+    bool connected = false;
+    for (int i = 0; i < 200 && !connected; i++)
+    {
+      connected = out->send_ump(cmidi2_ump_midi2_cc(0, 0, 7, 0)) == stdx::error{};
+      if (!connected)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ctx.stop();
+    runner.join();
+    ctx.restart();
+    REQUIRE(connected);
+  }
+
+  // The flush is due, and its handler queued behind another one as the output is destroyed
+  std::promise<void> blocked, release;
+  boost::asio::steady_timer blocker{ctx};
+  blocker.expires_after(std::chrono::milliseconds(0));
+  blocker.async_wait([&](boost::system::error_code) {
+    blocked.set_value();
+    release.get_future().wait();
+  });
+
+  REQUIRE(out->send_ump(cmidi2_ump_midi2_cc(0, 0, 7, 1)) == stdx::error{});
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  std::thread runner{[&] { ctx.run(); }};
+  blocked.get_future().wait();
+  out.reset();
+  release.set_value();
+  runner.join();
+}
@@ -0,0 +1,332 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/network.hpp>
+#include <libremidi/backends/network_ump.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+std::vector<uint8_t> frame(std::vector<uint8_t> payload)
+{
+  const auto header = libremidi::stream_frame_header(payload.size());
+  payload.insert(payload.begin(), header.begin(), header.end());
+  return payload;
+}
+
+// Feeds the bytes to the reader in chunks of the given size
+std::vector<std::vector<uint8_t>> read_frames(
+    libremidi::stream_frame_reader& reader, std::span<const uint8_t> bytes, std::size_t chunk)
+{
+  std::vector<std::vector<uint8_t>> res;
+  while (!bytes.empty())
+  {
+    auto buf = reader.prepare();
+    const auto n = std::min({chunk, buf.size(), bytes.size()});
+    std::memcpy(buf.data(), bytes.data(), n);
+    bytes = bytes.subspan(n);
+    REQUIRE(reader.commit(
+        n, [&](std::span<const uint8_t> f) { res.emplace_back(f.begin(), f.end()); }));
+  }
+  return res;
+}
+}
+
+TEST_CASE("stream framing", "[network_stream]")
+{
+  std::vector<std::vector<uint8_t>> frames{
+      {0x90, 0x40, 0x7F}, {}, {0xF0, 0x7E, 0x00, 0xF7}, std::vector<uint8_t>(100000, 0x12)};
+  std::vector<uint8_t> stream;
+  for (auto& f : frames)
+  {
+    auto bytes = frame(f);
+    stream.insert(stream.end(), bytes.begin(), bytes.end());
+  }
+
+  for (std::size_t chunk : {1, 3, 4096, 1 << 20})
+  {
+    libremidi::stream_frame_reader reader{1 << 20};
+    REQUIRE(read_frames(reader, stream, chunk) == frames);
+  }
+
+  SECTION("frames above the limit break the stream")
+  {
+    libremidi::stream_frame_reader reader{1000};
+    auto bytes = frame(std::vector<uint8_t>(1001));
+    auto buf = reader.prepare();
+    std::memcpy(buf.data(), bytes.data(), 8);
+    REQUIRE(!reader.commit(8, [](auto) { }));
+  }
+
+  SECTION("UMPs are in network byte order")
+  {
+    std::vector<uint8_t> bytes;
+    const uint32_t ump[2]{0x40903C00, 0xFFFF0000};
+    libremidi::write_ump_frame(bytes, ump);
+    REQUIRE(
+        bytes
+        == std::vector<uint8_t>{0, 0, 0, 8, 0x40, 0x90, 0x3C, 0x00, 0xFF, 0xFF, 0x00, 0x00});
+  }
+}
+
+namespace
+{
+template <typename T>
+struct received
+{
+  std::mutex mtx;
+  std::vector<T> messages;
+
+  void push(T m)
+  {
+    std::lock_guard lock{mtx};
+    messages.push_back(std::move(m));
+  }
+
+  std::size_t wait_for(std::size_t count)
+  {
+    for (int i = 0; i < 300; i++)
+    {
+      {
+        std::lock_guard lock{mtx};
+        if (messages.size() >= count)
+          return messages.size();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::lock_guard lock{mtx};
+    return messages.size();
+  }
+};
+}
+
+TEST_CASE("stream over TCP", "[network_stream]")
+{
+  // Arbitrary fixed port
+  const int port = 21956;
+  received<std::vector<uint8_t>> r;
+
+  libremidi::midi_in in{
+      libremidi::input_configuration{
+          .on_message =
+              [&](libremidi::message&& m) {
+    r.push({m.bytes.begin(), m.bytes.end()});
+  },
+          .ignore_sysex = false},
+      libremidi::net::dgram_input_configuration{
+          .protocol = libremidi::net::protocol::STREAM_TCP, .accept = "127.0.0.1", .port = port}};
+  REQUIRE(in.open_virtual_port("in") == stdx::error{});
+
+  auto flush_interval = GENERATE(std::chrono::microseconds{0}, std::chrono::microseconds{500});
+  libremidi::midi_out out{
+      {},
+      libremidi::net::dgram_output_configuration{
+          .protocol = libremidi::net::protocol::STREAM_TCP,
+          .host = "127.0.0.1",
+          .port = port,
+          .flush_interval = flush_interval}};
+  REQUIRE(out.open_virtual_port("out") == stdx::error{});
+
+  std::vector<unsigned char> sysex(200000, 0x55);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+
+  const int count = 1000;
+  for (int i = 0; i < count; i++)
+    REQUIRE(out.send_message(0x90, i % 128, 64) == stdx::error{});
+  REQUIRE(out.send_message(sysex) == stdx::error{});
+  REQUIRE(out.flush() == stdx::error{});
+
+  REQUIRE(r.wait_for(count + 1) == count + 1);
+  std::lock_guard lock{r.mtx};
+  for (int i = 0; i < count; i++)
+    REQUIRE(r.messages[i] == std::vector<uint8_t>{0x90, uint8_t(i % 128), 64});
+  REQUIRE(r.messages[count] == std::vector<uint8_t>(sysex.begin(), sysex.end()));
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+TEST_CASE("stream over a Unix domain socket", "[network_stream]")
+{
+  const auto path
+      = (std::filesystem::temp_directory_path() / "libremidi_network_stream_test.sock").string();
+  received<uint32_t> r;
+  {
+    libremidi::midi_in in{
+        libremidi::ump_input_configuration{
+            .on_message = [&](libremidi::ump&& m) { r.push(m.data[1]); }},
+        libremidi::net_ump::dgram_input_configuration{
+            .protocol = libremidi::net_ump::protocol::STREAM_UNIX, .accept = path}};
+    REQUIRE(in.open_virtual_port("in") == stdx::error{});
+
+    libremidi::midi_out out{
+        {},
+        libremidi::net_ump::dgram_output_configuration{
+            .protocol = libremidi::net_ump::protocol::STREAM_UNIX,
+            .host = path,
+            .flush_interval = std::chrono::milliseconds(1)}};
+    REQUIRE(out.open_virtual_port("out") == stdx::error{});
+
+    const uint32_t count = 5000;
+    for (uint32_t i = 0; i < count; i++)
+      REQUIRE(out.send_ump(cmidi2_ump_midi2_cc(0, 0, 7, i)) == stdx::error{});
+
+    REQUIRE(r.wait_for(count) == count);
+    std::lock_guard lock{r.mtx};
+    for (uint32_t i = 0; i < count; i++)
+      REQUIRE(r.messages[i] == i);
+  }
+
+  // Removed along with the input
+  REQUIRE(!std::filesystem::exists(path));
+}
+#endif
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+TEST_CASE("Unix domain socket path already bound", "[network_stream]")
+{
+  const auto path
+      = (std::filesystem::temp_directory_path() / "libremidi_network_stream_bound.sock").string();
+  const libremidi::net::dgram_input_configuration conf{
+      .protocol = libremidi::net::protocol::STREAM_UNIX, .accept = path};
+  const auto on_message = [](libremidi::message&&) {};
+
+  // Left over by a process which did not remove it: nothing listens on it anymore
+  {
+    boost::asio::io_context ctx;
+    boost::asio::local::stream_protocol::acceptor stale{ctx, {path}};
+  }
+  REQUIRE(std::filesystem::is_socket(path));
+
+  libremidi::midi_in first{{.on_message = on_message}, conf};
+  REQUIRE(first.open_virtual_port("first") == stdx::error{});
+
+  // The socket of a running input is not taken over
+  {
+    libremidi::midi_in second{{.on_message = on_message}, conf};
+    REQUIRE(second.open_virtual_port("second") == std::errc::not_connected);
+  }
+  REQUIRE(std::filesystem::is_socket(path));
+
+  libremidi::midi_out out{
+      {},
+      libremidi::net::dgram_output_configuration{
+          .protocol = libremidi::net::protocol::STREAM_UNIX, .host = path}};
+  REQUIRE(out.open_virtual_port("out") == stdx::error{});
+}
+#endif
+
+TEST_CASE("stream connection errors", "[network_stream]")
+{
+  libremidi::midi_out out{
+      {},
+      libremidi::net::dgram_output_configuration{
+          .protocol = libremidi::net::protocol::STREAM_TCP, .host = "127.0.0.1", .port = 21958}};
+  REQUIRE(out.open_virtual_port("out") == std::errc::connection_refused);
+  REQUIRE(out.send_message(0x90, 0x40, 0x40) == std::errc::not_connected);
+}
+
+TEST_CASE("stream endpoints destroyed with a queued handler", "[network_stream]")
+{
+  const int port = 21966;
+  boost::asio::io_context ctx;
+
+  // A handler of the caller's io_context is queued behind another one as the object is
+  // destroyed: the completions are queued after what was posted before ctx.run()
+  std::promise<void> blocked, release;
+  const auto block = [&] {
+    boost::asio::post(ctx, [&] {
+      blocked.set_value();
+      release.get_future().wait();
+    });
+  };
+
+  SECTION("output with a due flush")
+  {
+    libremidi::midi_in in{
+        libremidi::input_configuration{.on_message = [](libremidi::message&&) {}},
+        libremidi::net::dgram_input_configuration{
+            .protocol = libremidi::net::protocol::STREAM_TCP,
+            .accept = "127.0.0.1",
+            .port = port}};
+    REQUIRE(in.open_virtual_port("in") == stdx::error{});
+
+    auto out = std::make_unique<libremidi::midi_out>(
+        libremidi::output_configuration{},
+        libremidi::net::dgram_output_configuration{
+            .protocol = libremidi::net::protocol::STREAM_TCP,
+            .host = "127.0.0.1",
+            .port = port,
+            .io_context = &ctx,
+            .flush_interval = std::chrono::milliseconds(10)});
+    REQUIRE(out->open_virtual_port("out") == stdx::error{});
+
+    block();
+    REQUIRE(out->send_message(0x90, 60, 100) == stdx::error{});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::thread runner{[&] { ctx.run(); }};
+    blocked.get_future().wait();
+    out.reset();
+    release.set_value();
+    runner.join();
+  }
+
+  SECTION("input with a completed read")
+  {
+    received<std::vector<uint8_t>> r;
+    auto in = std::make_unique<libremidi::midi_in>(
+        libremidi::input_configuration{
+            .on_message =
+                [&](libremidi::message&& m) {
+      r.push({m.bytes.begin(), m.bytes.end()});
+    }},
+        libremidi::net::dgram_input_configuration{
+            .protocol = libremidi::net::protocol::STREAM_TCP,
+            .accept = "127.0.0.1",
+            .port = port,
+            .io_context = &ctx});
+    REQUIRE(in->open_virtual_port("in") == stdx::error{});
+
+    libremidi::midi_out out{
+        {},
+        libremidi::net::dgram_output_configuration{
+            .protocol = libremidi::net::protocol::STREAM_TCP,
+            .host = "127.0.0.1",
+            .port = port}};
+    REQUIRE(out.open_virtual_port("out") == stdx::error{});
+
+    // The connection is accepted from the caller's io_context
+    {
+      auto wg = boost::asio::make_work_guard(ctx);
+      std::thread runner{[&] { ctx.run(); }};
+      REQUIRE(out.send_message(0x90, 60, 100) == stdx::error{});
+      const auto count = r.wait_for(1);
+      ctx.stop();
+      runner.join();
+      ctx.restart();
+      REQUIRE(count == 1);
+    }
+
+    block();
+    REQUIRE(out.send_message(0x80, 60, 0) == stdx::error{});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::thread runner{[&] { ctx.run(); }};
+    blocked.get_future().wait();
+    in.reset();
+    release.set_value();
+    runner.join();
+
+    REQUIRE(r.wait_for(1) == 1);
+  }
+}
@@ -0,0 +1,142 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/configurations.hpp>
+#include <libremidi/libremidi.hpp>
+#include <libremidi/port_counters.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+libremidi::input_configuration
+collect(libremidi::input_configuration conf, std::vector<libremidi::message>& received)
+{
+  conf.on_message = [&received](libremidi::message&& m) { received.push_back(std::move(m)); };
+  return conf;
+}
+
+struct raw_input
+{
+  std::vector<libremidi::message> received;
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  libremidi::midi_in midiin;
+
+  explicit raw_input(const libremidi::input_configuration& conf)
+      : midiin{
+            collect(conf, received),
+            libremidi::rawio_input_configuration{
+                .set_receive_callback = [this](auto cb) { on_receive = std::move(cb); },
+                .stop_receive = [this] { on_receive = nullptr; }}}
+  {
+    REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+  }
+};
+}
+
+TEST_CASE("filtered events are counted", "[port_counters]")
+{
+  raw_input in{libremidi::input_configuration{
+      .ignore_sysex = true, .ignore_timing = true, .ignore_sensing = true}};
+
+  const uint8_t bytes[]{0x90, 60, 100, 0xF8, 0xFE, 0x80, 60, 0, 0xF8};
+  in.on_receive(bytes, 0);
+  const uint8_t sysex[]{0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  in.on_receive(sysex, 0);
+
+  REQUIRE(in.received.size() == 2);
+  const auto c = in.midiin.counters();
+  REQUIRE(c.filtered == 4);
+  REQUIRE(c.dropped == 0);
+  REQUIRE(c.truncated == 0);
+  REQUIRE(c.malformed == 0);
+}
+
+TEST_CASE("filtered time code is counted once", "[port_counters]")
+{
+  raw_input in{libremidi::input_configuration{.ignore_timing = true}};
+
+  const uint8_t quarter_frame[]{0xF1, 0x23};
+  in.on_receive(quarter_frame, 0);
+
+  // Its data byte is missing at the end of the packet
+  const uint8_t trailing[]{0x90, 60, 100, 0xF1};
+  in.on_receive(trailing, 0);
+
+  REQUIRE(in.received.size() == 1);
+  const auto c = in.midiin.counters();
+  REQUIRE(c.filtered == 2);
+  REQUIRE(c.truncated == 0);
+  REQUIRE(c.malformed == 0);
+}
+
+TEST_CASE("truncated and malformed events are counted", "[port_counters]")
+{
+  raw_input in{libremidi::input_configuration{}};
+
+  // The data byte of the program change is missing
+  const uint8_t truncated[]{0x90, 60, 100, 0xC0};
+  in.on_receive(truncated, 0);
+  REQUIRE(in.received.size() == 1);
+
+  // Data bytes without status
+  const uint8_t malformed[]{0x40, 0x40};
+  in.on_receive(malformed, 0);
+  REQUIRE(in.received.size() == 1);
+
+  const auto c = in.midiin.counters();
+  REQUIRE(c.truncated == 1);
+  REQUIRE(c.malformed == 1);
+  REQUIRE(c.filtered == 0);
+}
+
+TEST_CASE("queue drops are counted", "[port_counters]")
+{
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{.queue_size = 4},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+
+  for (uint8_t n = 0; n < 16; n++)
+  {
+    const uint8_t bytes[3]{0x90, n, 100};
+    on_receive(bytes, 0);
+  }
+
+  const auto c = midiin.counters();
+  REQUIRE(c.dropped > 0);
+  REQUIRE(c.dropped == midiin.queue_dropped());
+  REQUIRE(c.overruns == 0);
+}
+
+TEST_CASE("overruns are counted and notified", "[port_counters]")
+{
+  libremidi::atomic_port_counters counters;
+  int notified = 0;
+  const libremidi::overrun_callback on_overrun = [&] { notified++; };
+
+  counters.overrun(on_overrun);
+  counters.overrun(on_overrun);
+  counters.overrun({});
+  libremidi::atomic_port_counters::add(counters.dropped, 10);
+
+  const auto c = counters.load();
+  REQUIRE(c.overruns == 3);
+  REQUIRE(c.dropped == 10);
+  REQUIRE(notified == 2);
+}
+
+TEST_CASE("output counters", "[port_counters]")
+{
+  libremidi::midi_out midiout{
+      libremidi::output_configuration{}, libremidi::rawio_output_configuration{}};
+  REQUIRE(midiout.open_virtual_port("test") == stdx::error{});
+  REQUIRE(midiout.send_message(0x90, 60, 100) == stdx::error{});
+
+  const auto c = midiout.counters();
+  REQUIRE(c.dropped == 0);
+  REQUIRE(c.overruns == 0);
+}
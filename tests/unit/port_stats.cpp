@@ -0,0 +1,117 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/configurations.hpp>
+#include <libremidi/libremidi.hpp>
+#include <libremidi/port_stats.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+TEST_CASE("duration histogram buckets", "[port_stats]")
+{
+  using h = libremidi::duration_histogram;
+  for (uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 100ull, 1000ull, 123456ull,
+                     1'000'000'000ull, (1ull << 36) - 1})
+  {
+    const int b = h::bucket(v);
+    REQUIRE(b >= 0);
+    REQUIRE(b < h::buckets);
+    REQUIRE(h::lowest(b) <= v);
+    REQUIRE(h::highest(b) >= v);
+
+    // Within 12.5%
+    REQUIRE(h::highest(b) - h::lowest(b) <= h::lowest(b) / 8);
+  }
+
+  // Contiguous
+  for (int b = 1; b < h::buckets; b++)
+    REQUIRE(h::lowest(b) == h::highest(b - 1) + 1);
+
+  REQUIRE(h::bucket(1ull << 40) == h::buckets - 1);
+}
+
+TEST_CASE("duration histogram quantiles", "[port_stats]")
+{
+  libremidi::port_statistics stats;
+  for (int i = 1; i <= 1000; i++)
+    stats.callback.record(i * 1000);
+  stats.callback.record(-5);
+
+  const auto snapshot = stats.snapshot();
+  const auto& h = snapshot.callback;
+  REQUIRE(h.count == 1001);
+  REQUIRE(h.max_ns == 1'000'000);
+  REQUIRE(h.counts[0] == 1);
+
+  const uint64_t median = h.quantile_ns(0.5);
+  REQUIRE(median >= 500'000);
+  REQUIRE(median <= 500'000 * 9 / 8);
+
+  REQUIRE(h.quantile_ns(1.) == 1'000'000);
+  REQUIRE(h.mean_ns() > 499'000.);
+  REQUIRE(h.mean_ns() < 501'000.);
+}
+
+TEST_CASE("input statistics", "[port_stats]")
+{
+  libremidi::rawio_input_configuration::receive_callback on_receive;
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .on_message =
+              [](libremidi::message&&) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  },
+          .timestamps = libremidi::timestamp_mode::SystemMonotonic},
+      libremidi::rawio_input_configuration{
+          .set_receive_callback = [&](auto cb) { on_receive = std::move(cb); },
+          .stop_receive = [&] { on_receive = nullptr; }}};
+  REQUIRE(midiin.open_virtual_port("test") == stdx::error{});
+
+  for (uint8_t n = 0; n < 10; n++)
+  {
+    const uint8_t bytes[3]{0x90, n, 100};
+    on_receive(bytes, 0);
+  }
+
+  const auto stats = midiin.stats();
+  if constexpr (libremidi::port_stats_enabled)
+  {
+    REQUIRE(stats.events == 10);
+    REQUIRE(stats.bytes == 30);
+    REQUIRE(stats.callback.count == 10);
+    REQUIRE(stats.callback.quantile_ns(0.) >= 100'000 * 7 / 8);
+    REQUIRE(stats.latency.count == 10);
+    REQUIRE(stats.jitter.count == 8);
+    REQUIRE(stats.send.count == 0);
+  }
+  else
+  {
+    REQUIRE(stats.events == 0);
+    REQUIRE(stats.callback.count == 0);
+  }
+}
+
+TEST_CASE("output statistics", "[port_stats]")
+{
+  libremidi::midi_out midiout{
+      libremidi::output_configuration{}, libremidi::rawio_output_configuration{}};
+  REQUIRE(midiout.open_virtual_port("test") == stdx::error{});
+
+  for (uint8_t n = 0; n < 5; n++)
+    REQUIRE(midiout.send_message(0x90, n, 100) == stdx::error{});
+  REQUIRE(midiout.send_message(0xC0, 1) == stdx::error{});
+
+  const auto stats = midiout.stats();
+  if constexpr (libremidi::port_stats_enabled)
+  {
+    REQUIRE(stats.events == 6);
+    REQUIRE(stats.bytes == 17);
+    REQUIRE(stats.send.count == 6);
+  }
+  else
+  {
+    REQUIRE(stats.events == 0);
+    REQUIRE(stats.send.count == 0);
+  }
+}
@@ -2,8 +2,13 @@
 
 #include <libremidi/protocols/mmc.hpp>
 #include <libremidi/protocols/msc.hpp>
+#include <libremidi/protocols/mtc.hpp>
 #include <libremidi/protocols/mvc.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 // MMC Tests
 
 TEST_CASE("MMC message building", "[mmc]")
@@ -685,3 +690,185 @@ TEST_CASE("MVC processor output", "[mvc]")
     REQUIRE(sent[0].get_message_type() == libremidi::message_type::PITCH_BEND);
   }
 }
+
+// MTC Tests
+
+namespace
+{
+using mtc = libremidi::mtc_protocol;
+
+struct mtc_source
+{
+  libremidi::mtc_assembler assembler;
+  std::vector<libremidi::mtc_event> events;
+  int64_t time = 1'000'000'000;
+  int64_t quarter_frame_ns = 10'000'000;
+
+  void send(const libremidi::message& m)
+  {
+    assembler.process(
+        {m.bytes.data(), m.bytes.size()}, time, [this](const auto& e) { events.push_back(e); });
+  }
+
+  // The quarter frames of count frames from tc, forward or backward
+  void play(mtc::timecode tc, int frames, int direction = 1)
+  {
+    auto frame = mtc::to_frames(tc);
+    for (int f = 0; f < frames; f += 2, frame += 2 * direction)
+    {
+      const auto cur = mtc::from_frames(frame, tc.rate);
+      for (int i = 0; i < 8; i++)
+      {
+        send(mtc::make_quarter_frame(cur, direction > 0 ? i : 7 - i));
+        time += quarter_frame_ns;
+      }
+    }
+  }
+
+  int count(libremidi::mtc_event::kind_t kind) const
+  {
+    return static_cast<int>(
+        std::count_if(events.begin(), events.end(), [=](auto& e) { return e.kind == kind; }));
+  }
+};
+}
+
+TEST_CASE("MTC timecode conversions", "[mtc]")
+{
+  SECTION("non drop frame")
+  {
+    const mtc::timecode tc{1, 23, 45, 12, mtc::frame_rate::fps_25};
+    REQUIRE(mtc::to_frames(tc) == ((1 * 60 + 23) * 60 + 45) * 25 + 12);
+    REQUIRE(mtc::from_frames(mtc::to_frames(tc), tc.rate) == tc);
+  }
+
+  SECTION("drop frame skips frames 0 and 1 except every tenth minute")
+  {
+    const auto r = mtc::frame_rate::fps_30_drop;
+    REQUIRE(mtc::to_frames({0, 1, 0, 2, r}) == 1800);
+    REQUIRE(mtc::from_frames(1800, r) == mtc::timecode{0, 1, 0, 2, r});
+    REQUIRE(mtc::from_frames(1799, r) == mtc::timecode{0, 0, 59, 29, r});
+    REQUIRE(mtc::from_frames(17982, r) == mtc::timecode{0, 10, 0, 0, r});
+    for (int64_t f = 0; f < 40000; f += 7)
+      REQUIRE(mtc::to_frames(mtc::from_frames(f, r)) == f);
+  }
+
+  SECTION("wraps around midnight")
+  {
+    REQUIRE(
+        mtc::from_frames(-1, mtc::frame_rate::fps_24)
+        == mtc::timecode{23, 59, 59, 23, mtc::frame_rate::fps_24});
+  }
+}
+
+TEST_CASE("MTC message building", "[mtc]")
+{
+  const mtc::timecode tc{1, 23, 45, 12, mtc::frame_rate::fps_30};
+
+  REQUIRE(mtc::make_quarter_frame(tc, 0).bytes == libremidi::message{0xF1, 0x0C}.bytes);
+  REQUIRE(mtc::make_quarter_frame(tc, 1).bytes == libremidi::message{0xF1, 0x10}.bytes);
+  REQUIRE(mtc::make_quarter_frame(tc, 7).bytes == libremidi::message{0xF1, 0x76}.bytes);
+
+  REQUIRE(
+      mtc::make_full_frame(tc).bytes
+      == libremidi::message{0xF0, 0x7F, 0x7F, 0x01, 0x01, 0x61, 23, 45, 12, 0xF7}.bytes);
+}
+
+TEST_CASE("MTC assembler", "[mtc]")
+{
+  mtc_source src;
+  const mtc::timecode tc{1, 2, 3, 4, mtc::frame_rate::fps_25};
+
+  SECTION("locks after a full sequence of quarter frames")
+  {
+    src.send(mtc::make_quarter_frame(tc, 4));
+    src.send(mtc::make_quarter_frame(tc, 5));
+    REQUIRE(!src.assembler.state().locked);
+
+    src.play(tc, 2);
+    const auto s = src.assembler.state();
+    REQUIRE(s.locked);
+    REQUIRE(s.direction == 1);
+    REQUIRE(s.rate == mtc::frame_rate::fps_25);
+    // The last quarter frame is in the second frame of the sequence
+    REQUIRE(s.timecode() == mtc::timecode{1, 2, 3, 5, mtc::frame_rate::fps_25});
+    REQUIRE(s.quarter_frames == 4 * mtc::to_frames(tc) + 7);
+    REQUIRE(src.count(libremidi::mtc_event::locked) == 1);
+  }
+
+  SECTION("one position event per frame")
+  {
+    src.play(tc, 10);
+    REQUIRE(src.count(libremidi::mtc_event::locked) == 1);
+    REQUIRE(src.count(libremidi::mtc_event::position) == 8);
+    // The last frame started 3 quarter frames ago
+    const auto last = src.events.back().state;
+    REQUIRE(last.timecode() == mtc::timecode{1, 2, 3, 13, mtc::frame_rate::fps_25});
+    REQUIRE(last.quarter_frames % 4 == 0);
+    REQUIRE(src.assembler.state().quarter_frames == last.quarter_frames + 3);
+  }
+
+  SECTION("interpolates the position while locked")
+  {
+    src.play(tc, 4);
+    const auto s = src.assembler.state();
+    const double qf = 1. / (4. * 25.);
+    REQUIRE(std::abs(s.seconds_at(s.time + 5'000'000) - (s.seconds() + 0.005)) < 1e-9);
+    // Bounded to a frame when the quarter frames stop
+    REQUIRE(std::abs(s.seconds_at(s.time + 1'000'000'000) - (s.seconds() + 4 * qf)) < 1e-9);
+  }
+
+  SECTION("follows jumps")
+  {
+    src.play(tc, 4);
+    const mtc::timecode later{2, 0, 0, 0, mtc::frame_rate::fps_25};
+    src.play(later, 2);
+    const auto s = src.assembler.state();
+    REQUIRE(s.locked);
+    REQUIRE(s.timecode() == mtc::timecode{2, 0, 0, 1, mtc::frame_rate::fps_25});
+  }
+
+  SECTION("backwards")
+  {
+    src.play(tc, 8, -1);
+    const auto s = src.assembler.state();
+    REQUIRE(s.locked);
+    REQUIRE(s.direction == -1);
+    REQUIRE(s.timecode() == mtc::from_frames(mtc::to_frames(tc) - 6, tc.rate));
+  }
+
+  SECTION("unlocks when the quarter frames stop or skip")
+  {
+    src.play(tc, 4);
+    REQUIRE(src.assembler.state().locked);
+    src.time += 1'000'000'000;
+    src.send(mtc::make_quarter_frame(tc, 0));
+    REQUIRE(!src.assembler.state().locked);
+    REQUIRE(src.count(libremidi::mtc_event::unlocked) == 1);
+
+    src.play(tc, 4);
+    REQUIRE(src.assembler.state().locked);
+    src.send(mtc::make_quarter_frame(tc, 3));
+    REQUIRE(!src.assembler.state().locked);
+  }
+
+  SECTION("full frame message")
+  {
+    src.play(tc, 4);
+    const mtc::timecode located{0, 10, 0, 0, mtc::frame_rate::fps_30_drop};
+    src.send(mtc::make_full_frame(located));
+
+    const auto s = src.assembler.state();
+    REQUIRE(!s.locked);
+    REQUIRE(s.direction == 0);
+    REQUIRE(s.timecode() == located);
+    REQUIRE(src.events.back().kind == libremidi::mtc_event::full_frame);
+  }
+
+  SECTION("other messages are ignored")
+  {
+    src.send(libremidi::message{0xF0, 0x7F, 0x7F, 0x06, 0x02, 0xF7});
+    src.send(libremidi::message{0xF8});
+    REQUIRE(src.events.empty());
+  }
+}
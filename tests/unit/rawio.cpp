@@ -3,6 +3,19 @@
 #include <libremidi/configurations.hpp>
 #include <libremidi/libremidi.hpp>
 
+#if defined(__linux__)
+  #include <libremidi/backends/rawio/fd_input.hpp>
+
+  #include <unistd.h>
+
+  #include <atomic>
+  #include <chrono>
+  #include <future>
+  #include <memory>
+  #include <mutex>
+  #include <thread>
+#endif
+
 TEST_CASE("rawio midi1 roundtrip", "[rawio]")
 {
   // The callback that the library will give us to feed bytes into
@@ -142,3 +155,145 @@ TEST_CASE("rawio midi2 ump roundtrip", "[rawio]")
     REQUIRE(received[0].data[1] == ump[1]);
   }
 }
+
+#if defined(__linux__)
+TEST_CASE("rawio midi1 from a file descriptor", "[rawio]")
+{
+  const bool use_io_uring = GENERATE(true, false);
+
+  int fds[2];
+  REQUIRE(::pipe(fds) == 0);
+
+  std::mutex mutex;
+  std::vector<libremidi::message> received;
+  std::atomic_int count{};
+
+  {
+    libremidi::midi_in midiin{
+        libremidi::input_configuration{
+            .on_message =
+                [&](const libremidi::message& m) {
+      std::lock_guard lock{mutex};
+      received.push_back(m);
+      count++;
+    }},
+        libremidi::rawio_fd_input_configuration(fds[0], use_io_uring)};
+    REQUIRE(midiin.open_virtual_port("fd") == stdx::error{});
+
+    const uint8_t first[]{0x90, 60, 100};
+    const uint8_t second[]{0x90, 62, 110, 0xB0, 7, 127};
+    REQUIRE(::write(fds[1], first, sizeof(first)) == sizeof(first));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(::write(fds[1], second, sizeof(second)) == sizeof(second));
+
+    for (int i = 0; i < 300 && count < 3; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::lock_guard lock{mutex};
+    REQUIRE(received.size() == 3);
+    REQUIRE(received[0].bytes == libremidi::midi_bytes{0x90, 60, 100});
+    REQUIRE(received[1].bytes == libremidi::midi_bytes{0x90, 62, 110});
+    REQUIRE(received[2].bytes == libremidi::midi_bytes{0xB0, 7, 127});
+  }
+
+  // Nothing is read anymore once the input is closed
+  const uint8_t after[]{0x80, 60, 0};
+  REQUIRE(::write(fds[1], after, sizeof(after)) == sizeof(after));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  REQUIRE(count == 3);
+
+  uint8_t left[3]{};
+  REQUIRE(::read(fds[0], left, sizeof(left)) == sizeof(left));
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("rawio input closed from its own callback", "[rawio]")
+{
+  // The input is the last user of the reading thread, which is then stopped from itself
+  const bool use_io_uring = GENERATE(true, false);
+
+  int fds[2];
+  REQUIRE(::pipe(fds) == 0);
+
+  for (int round = 0; round < 2; round++)
+  {
+    std::atomic_int count{};
+    std::unique_ptr<libremidi::midi_in> midiin;
+    midiin = std::make_unique<libremidi::midi_in>(
+        libremidi::input_configuration{
+            .on_message =
+                [&](const libremidi::message&) {
+      midiin->close_port();
+      count++;
+    }},
+        libremidi::rawio_fd_input_configuration(fds[0], use_io_uring));
+    REQUIRE(midiin->open_virtual_port("fd") == stdx::error{});
+
+    const uint8_t note[]{0x90, 60, 100};
+    REQUIRE(::write(fds[1], note, sizeof(note)) == sizeof(note));
+    for (int i = 0; i < 300 && count < 1; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(count == 1);
+    midiin.reset();
+  }
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("rawio input closed while its callback runs", "[rawio]")
+{
+  // The reading thread is not locked by a callback: other devices can be opened meanwhile,
+  // and closing the input waits for the callback to return
+  const bool use_io_uring = GENERATE(true, false);
+
+  int fds[2], other_fds[2];
+  REQUIRE(::pipe(fds) == 0);
+  REQUIRE(::pipe(other_fds) == 0);
+
+  std::promise<void> inside, release;
+  std::atomic_bool returned{};
+  libremidi::midi_in midiin{
+      libremidi::input_configuration{
+          .on_message =
+              [&](const libremidi::message&) {
+    inside.set_value();
+    release.get_future().wait();
+    returned = true;
+  }},
+      libremidi::rawio_fd_input_configuration(fds[0], use_io_uring)};
+  REQUIRE(midiin.open_virtual_port("fd") == stdx::error{});
+
+  libremidi::midi_in other{
+      libremidi::input_configuration{.on_message = [](const libremidi::message&) {}},
+      libremidi::rawio_fd_input_configuration(other_fds[0], use_io_uring)};
+
+  const uint8_t note[]{0x90, 60, 100};
+  REQUIRE(::write(fds[1], note, sizeof(note)) == sizeof(note));
+  inside.get_future().wait();
+
+  REQUIRE(other.open_virtual_port("other") == stdx::error{});
+
+  std::atomic_bool returned_before_close{};
+  std::thread closer{[&] {
+    midiin.close_port();
+    returned_before_close = returned.load();
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  release.set_value();
+  closer.join();
+  REQUIRE(returned_before_close);
+
+  other.close_port();
+  ::close(fds[0]);
+  ::close(fds[1]);
+  ::close(other_fds[0]);
+  ::close(other_fds[1]);
+}
+#endif
@@ -0,0 +1,461 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/network.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using bytes = std::vector<uint8_t>;
+using packet = std::vector<uint8_t>;
+
+struct sender
+{
+  libremidi::rtpmidi::stream_sender stream;
+  std::vector<packet> packets;
+  uint32_t time{};
+
+  void send(bytes msg)
+  {
+    auto on_packet = [this](std::span<const uint8_t> p) { packets.emplace_back(p.begin(), p.end()); };
+    stream.write(msg, time++, on_packet);
+    stream.flush(on_packet);
+  }
+};
+
+std::vector<bytes>
+receive(libremidi::rtpmidi::stream_receiver& receiver, const std::vector<packet>& packets)
+{
+  std::vector<bytes> res;
+  for (auto& p : packets)
+  {
+    auto rtp = libremidi::rtpmidi::read_rtp_packet(p);
+    REQUIRE(rtp);
+    receiver.read(rtp->first, rtp->second, [&](std::span<const uint8_t> msg, uint32_t) {
+      res.emplace_back(msg.begin(), msg.end());
+    });
+  }
+  return res;
+}
+}
+
+TEST_CASE("rtpmidi session packets", "[rtpmidi]")
+{
+  using namespace libremidi::rtpmidi;
+  std::vector<uint8_t> buf;
+
+  session_packet in{.command = command::invitation, .token = 0x1234, .ssrc = 42, .name = "foo"};
+  in.write(buf);
+  REQUIRE(buf.size() == 4 + 12 + 4);
+  auto res = session_packet::read(buf);
+  REQUIRE(res);
+  REQUIRE(res->command == command::invitation);
+  REQUIRE(res->token == 0x1234);
+  REQUIRE(res->ssrc == 42);
+  REQUIRE(res->name == "foo");
+
+  session_packet ck{.command = command::sync, .ssrc = 42, .count = 2, .timestamps = {1, 2, 3}};
+  ck.write(buf);
+  REQUIRE(buf.size() == 36);
+  res = session_packet::read(buf);
+  REQUIRE(res);
+  REQUIRE(res->timestamps == std::array<uint64_t, 3>{1, 2, 3});
+
+  buf.resize(20);
+  REQUIRE(!session_packet::read(buf));
+}
+
+TEST_CASE("rtpmidi command section", "[rtpmidi]")
+{
+  libremidi::rtpmidi::stream_sender stream;
+  std::vector<packet> packets;
+  auto on_packet = [&](std::span<const uint8_t> p) { packets.emplace_back(p.begin(), p.end()); };
+
+  SECTION("running status and delta times")
+  {
+    stream.write(bytes{0x90, 60, 100}, 1000, on_packet);
+    stream.write(bytes{0x90, 64, 100}, 1000, on_packet);
+    stream.write(bytes{0xF8}, 1200, on_packet);
+    stream.write(bytes{0x90, 67, 100}, 1200, on_packet);
+    REQUIRE(packets.empty());
+    stream.flush(on_packet);
+    REQUIRE(packets.size() == 1);
+
+    // header, 3 bytes, then delta + 2 bytes, delta (2 bytes) + 1 byte, delta + 2 bytes
+    REQUIRE(packets[0].size() == 12 + 1 + 3 + 3 + 3 + 3);
+
+    libremidi::rtpmidi::stream_receiver receiver;
+    std::vector<uint32_t> times;
+    auto rtp = libremidi::rtpmidi::read_rtp_packet(packets[0]);
+    REQUIRE(rtp);
+    std::vector<bytes> msgs;
+    REQUIRE(receiver.read(rtp->first, rtp->second, [&](std::span<const uint8_t> msg, uint32_t ts) {
+      msgs.emplace_back(msg.begin(), msg.end());
+      times.push_back(ts);
+    }));
+    REQUIRE(
+        msgs
+        == std::vector<bytes>{
+            {0x90, 60, 100}, {0x90, 64, 100}, {0xF8}, {0x90, 67, 100}});
+    REQUIRE(times == std::vector<uint32_t>{1000, 1000, 1200, 1200});
+  }
+
+  SECTION("segmented sysex")
+  {
+    stream.max_packet_size = 64;
+    bytes sysex(500, 0x12);
+    sysex.front() = 0xF0;
+    sysex.back() = 0xF7;
+    stream.write(bytes{0x90, 60, 100}, 0, on_packet);
+    stream.write(sysex, 0, on_packet);
+    stream.write(bytes{0x80, 60, 0}, 0, on_packet);
+    stream.flush(on_packet);
+    REQUIRE(packets.size() > 500 / 64);
+    for (auto& p : packets)
+      REQUIRE(p.size() <= 64);
+
+    libremidi::rtpmidi::stream_receiver receiver;
+    auto msgs = receive(receiver, packets);
+    REQUIRE(msgs.size() == 3);
+    REQUIRE(msgs[1] == sysex);
+
+    SECTION("lost segment")
+    {
+      packets.erase(packets.begin() + 2);
+      libremidi::rtpmidi::stream_receiver receiver;
+      auto msgs = receive(receiver, packets);
+      REQUIRE(msgs.size() == 2);
+      REQUIRE(msgs[0] == bytes{0x90, 60, 100});
+      REQUIRE(msgs[1] == bytes{0x80, 60, 0});
+    }
+  }
+
+  SECTION("malformed messages")
+  {
+    REQUIRE(!stream.write(bytes{}, 0, on_packet));
+    REQUIRE(!stream.write(bytes{0x90, 60}, 0, on_packet));
+    REQUIRE(!stream.write(bytes{0xC0}, 0, on_packet));
+    REQUIRE(!stream.write(bytes{60, 100}, 0, on_packet));
+    REQUIRE(stream.empty());
+    REQUIRE(stream.write(bytes{0xF8}, 0, on_packet));
+    REQUIRE(!stream.empty());
+  }
+}
+
+TEST_CASE("rtpmidi recovery journal", "[rtpmidi]")
+{
+  sender s;
+  libremidi::rtpmidi::stream_receiver receiver;
+
+  s.send({0xC1, 5});
+  s.send({0x90, 60, 100});
+  s.send({0x90, 64, 100});
+  REQUIRE(receive(receiver, s.packets).size() == 3);
+  s.packets.clear();
+
+  // Lost packets
+  s.send({0xB0, 7, 90});
+  s.send({0x80, 60, 0});
+  s.send({0xE0, 0, 0x50});
+  s.send({0xC1, 8});
+  s.packets.erase(s.packets.begin(), s.packets.end() - 1);
+
+  // The next packet brings the state back
+  s.send({0x90, 72, 100});
+  auto msgs = receive(receiver, s.packets);
+  REQUIRE(receiver.lost_packets() == 1);
+
+  auto has = [&](bytes m) { return std::ranges::find(msgs, m) != msgs.end(); };
+  REQUIRE(has({0xB0, 7, 90}));
+  REQUIRE(has({0x80, 60, 0}));
+  REQUIRE(has({0xE0, 0, 0x50}));
+  REQUIRE(has({0xC1, 8}));
+  REQUIRE(!has({0x90, 64, 100}));
+  REQUIRE(msgs.back() == bytes{0x90, 72, 100});
+
+  SECTION("acknowledged packets leave the journal")
+  {
+    s.stream.acknowledge(s.stream.sequence - 1);
+    s.packets.clear();
+    s.send({0x90, 74, 100});
+    // No journal: header and a 3 bytes command
+    REQUIRE(s.packets[0].size() == 12 + 1 + 3);
+  }
+}
+
+TEST_CASE("rtpmidi recovery journal with every note held", "[rtpmidi]")
+{
+  // 127 and 128 note logs do not fit the 7 bits of LEN as is
+  const int held = GENERATE(126, 127, 128);
+  sender s;
+  libremidi::rtpmidi::stream_receiver receiver;
+  s.send({0x90, 0, 100});
+  receive(receiver, s.packets);
+  s.packets.clear();
+
+  // Lost packets
+  for (int note = 1; note < held; note++)
+    s.send({0x90, uint8_t(note), 100});
+  s.packets.erase(s.packets.begin(), s.packets.end());
+
+  s.send({0xB0, 7, 90});
+  REQUIRE(s.stream.journal_complete());
+  auto msgs = receive(receiver, s.packets);
+  REQUIRE(receiver.lost_packets() == 1);
+  for (int note = 1; note < held; note++)
+    REQUIRE(std::ranges::find(msgs, bytes{0x90, uint8_t(note), 100}) != msgs.end());
+  REQUIRE(msgs.back() == bytes{0xB0, 7, 90});
+}
+
+TEST_CASE("rtpmidi recovery journal without feedback", "[rtpmidi]")
+{
+  sender s;
+  const std::size_t max_datagram_size = s.stream.max_packet_size;
+
+  // Notes held on every channel and never acknowledged
+  for (int note = 0; note < 128; note++)
+    for (uint8_t chan = 0; chan < 16; chan++)
+      s.send({uint8_t(0x90 | chan), uint8_t(note), 100});
+
+  REQUIRE(!s.stream.journal_complete());
+  for (auto& p : s.packets)
+    REQUIRE(p.size() <= max_datagram_size);
+
+  // The most recent changes are still recovered
+  libremidi::rtpmidi::stream_receiver receiver;
+  receive(receiver, {s.packets.front()});
+  s.send({0xB0, 7, 90});
+  s.send({0x80, 10, 0});
+  const std::vector<packet> last{s.packets.back()};
+  auto msgs = receive(receiver, last);
+  REQUIRE(receiver.lost_packets() == 1);
+  REQUIRE(std::ranges::find(msgs, bytes{0xB0, 7, 90}) != msgs.end());
+  REQUIRE(msgs.back() == bytes{0x80, 10, 0});
+}
+
+TEST_CASE("rtpmidi session over loopback", "[rtpmidi]")
+{
+  // Arbitrary fixed ports: RTP-MIDI needs a known control / data port pair
+  const int port = 21928;
+
+  std::mutex mtx;
+  std::vector<libremidi::message> received;
+  libremidi::midi_in in{
+      {.on_message =
+           [&](libremidi::message&& m) {
+    std::lock_guard lock{mtx};
+    received.push_back(std::move(m));
+  },
+       .ignore_sysex = false},
+      libremidi::net::dgram_input_configuration{
+          .protocol = libremidi::net::protocol::RTP_MIDI, .port = port}};
+  REQUIRE(in.open_virtual_port("libremidi in") == stdx::error{});
+
+  libremidi::midi_out out{
+      {},
+      libremidi::net::dgram_output_configuration{
+          .protocol = libremidi::net::protocol::RTP_MIDI, .port = port}};
+  REQUIRE(out.open_virtual_port("libremidi out") == stdx::error{});
+
+  // The invitation has to be accepted first
+  bool connected = false;
+  for (int i = 0; i < 200 && !connected; i++)
+  {
+    connected = out.send_message(0xF8) == stdx::error{};
+    if (!connected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  REQUIRE(connected);
+
+  // Bursts overflow the socket buffers and lose packets even over loopback:
+  // the recovery journal brings the controllers back to their last value anyway.
+  std::array<int, 16> sent{};
+  const int count = 2000;
+  for (int i = 0; i < count; i++)
+  {
+    const uint8_t cc = i % 16, value = (i * 7) % 128;
+    REQUIRE(out.send_message(0xB0, cc, value) == stdx::error{});
+    sent[cc] = value;
+  }
+
+  // Its journal covers whatever was lost before
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE(out.send_message(0xFA) == stdx::error{});
+
+  libremidi::midi_bytes sysex(3000, 0x33);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+  REQUIRE(out.send_message(sysex.data(), sysex.size()) == stdx::error{});
+
+  for (int i = 0; i < 200; i++)
+  {
+    {
+      std::lock_guard lock{mtx};
+      if (!received.empty() && received.back().bytes == sysex)
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard lock{mtx};
+  REQUIRE(!received.empty());
+  REQUIRE(received.back().bytes == sysex);
+
+  std::array<int, 16> state{};
+  for (auto& m : received)
+    if (m.bytes.size() == 3 && m.bytes[0] == 0xB0)
+      state[m.bytes[1]] = m.bytes[2];
+  REQUIRE(state == sent);
+}
+
+TEST_CASE("rtpmidi output destroyed with a queued flush", "[rtpmidi]")
+{
+  const int port = 21934;
+
+  libremidi::midi_in in{
+      {.on_message = [](libremidi::message&&) {}},
+      libremidi::net::dgram_input_configuration{
+          .protocol = libremidi::net::protocol::RTP_MIDI, .port = port}};
+  REQUIRE(in.open_virtual_port("libremidi in") == stdx::error{});
+
+  boost::asio::io_context ctx;
+  auto out = std::make_unique<libremidi::midi_out>(
+      libremidi::output_configuration{},
+      libremidi::net::dgram_output_configuration{
+          .protocol = libremidi::net::protocol::RTP_MIDI,
+          .port = port,
+          .io_context = &ctx,
+          .flush_interval = std::chrono::milliseconds(10)});
+  REQUIRE(out->open_virtual_port("libremidi out") == stdx::error{});
+
+  // The session is established from the caller's io_context
+  {
+    auto wg = boost::asio::make_work_guard(ctx);
+    std::thread runner{[&] { ctx.run(); }};
+    bool connected = false;
+    for (int i = 0; i < 200 && !connected; i++)
+    {
+      connected = out->send_message(0xF8) == stdx::error{};
+      if (!connected)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ctx.stop();
+    runner.join();
+    ctx.restart();
+    REQUIRE(connected);
+  }
+
+  // The flush is due, and its handler queued behind another one as the output is destroyed
+  std::promise<void> blocked, release;
+  boost::asio::steady_timer blocker{ctx};
+  blocker.expires_after(std::chrono::milliseconds(0));
+  blocker.async_wait([&](boost::system::error_code) {
+    blocked.set_value();
+    release.get_future().wait();
+  });
+
+  REQUIRE(out->send_message(0x90, 60, 100) == stdx::error{});
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  std::thread runner{[&] { ctx.run(); }};
+  blocked.get_future().wait();
+  out.reset();
+  release.set_value();
+  runner.join();
+}
+
+TEST_CASE("rtpmidi session end and payload types", "[rtpmidi]")
+{
+  using namespace libremidi::rtpmidi;
+  using boost::asio::ip::udp;
+  const int port = 21940;
+
+  std::mutex mtx;
+  std::vector<bytes> received;
+  libremidi::midi_in in{
+      {.on_message =
+           [&](libremidi::message&& m) {
+    std::lock_guard lock{mtx};
+    received.emplace_back(m.bytes.begin(), m.bytes.end());
+  }},
+      libremidi::net::dgram_input_configuration{
+          .protocol = libremidi::net::protocol::RTP_MIDI, .port = port}};
+  REQUIRE(in.open_virtual_port("libremidi in") == stdx::error{});
+
+  // A remote participant driven by hand
+  boost::asio::io_context ctx;
+  udp::socket control{ctx, udp::endpoint{udp::v4(), 0}};
+  udp::socket data{ctx, udp::endpoint{udp::v4(), 0}};
+  const auto localhost = boost::asio::ip::make_address("127.0.0.1");
+  const udp::endpoint in_control{localhost, port}, in_data{localhost, port + 1};
+
+  std::vector<uint8_t> buf;
+  auto session = [&](udp::socket& s, const udp::endpoint& to, command cmd, uint32_t token) {
+    session_packet{.command = cmd, .token = token, .ssrc = 42, .name = "remote"}.write(buf);
+    s.send_to(boost::asio::buffer(buf), to);
+  };
+  auto accepted = [&](udp::socket& s) {
+    std::array<uint8_t, 256> reply;
+    const auto n = s.receive(boost::asio::buffer(reply));
+    auto p = session_packet::read({reply.data(), n});
+    return p && p->command == command::accepted;
+  };
+
+  session(control, in_control, command::invitation, 1234);
+  REQUIRE(accepted(control));
+  session(data, in_data, command::invitation, 1234);
+  REQUIRE(accepted(data));
+
+  stream_sender stream;
+  stream.ssrc = 42;
+  auto send = [&](bytes msg, uint8_t pt) {
+    stream.write(msg, 0, [](auto) {});
+    stream.flush([&](std::span<const uint8_t> p) {
+      std::vector<uint8_t> packet{p.begin(), p.end()};
+      packet[1] = pt;
+      data.send_to(boost::asio::buffer(packet), in_data);
+    });
+  };
+  auto wait_for = [&](std::size_t count) {
+    for (int i = 0; i < 200; i++)
+    {
+      {
+        std::lock_guard lock{mtx};
+        if (received.size() >= count)
+          return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+  };
+
+  // Any dynamic payload type
+  send({0x90, 60, 100}, 0x61);
+  send({0x90, 61, 100}, 96);
+  REQUIRE(wait_for(2));
+
+  // Only the participant can end its session
+  session(control, in_control, command::end, 999);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  send({0x90, 62, 100}, 0x61);
+  REQUIRE(wait_for(3));
+
+  session(control, in_control, command::end, 1234);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  send({0x90, 63, 100}, 0x61);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  std::lock_guard lock{mtx};
+  REQUIRE(
+      received
+      == std::vector<bytes>{{0x90, 60, 100}, {0x90, 61, 100}, {0x90, 62, 100}});
+}
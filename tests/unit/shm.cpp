@@ -0,0 +1,362 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/shm.hpp>
+#include <libremidi/backends/shm_ump.hpp>
+#include <libremidi/libremidi.hpp>
+
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+template <typename T>
+struct received
+{
+  std::mutex mtx;
+  std::vector<T> messages;
+
+  void push(T m)
+  {
+    std::lock_guard lock{mtx};
+    messages.push_back(std::move(m));
+  }
+
+  std::size_t wait_for(std::size_t count)
+  {
+    for (int i = 0; i < 300; i++)
+    {
+      {
+        std::lock_guard lock{mtx};
+        if (messages.size() >= count)
+          return messages.size();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::lock_guard lock{mtx};
+    return messages.size();
+  }
+};
+
+// A fresh ring directory per test
+struct scoped_directory
+{
+  std::string path = (std::filesystem::temp_directory_path()
+                      / ("libremidi_shm_test_" + std::to_string(::getpid())))
+                         .string();
+  scoped_directory() { std::filesystem::remove_all(path); }
+  ~scoped_directory() { std::filesystem::remove_all(path); }
+};
+}
+
+TEST_CASE("shm ring", "[shm]")
+{
+  using namespace libremidi::shm;
+  scoped_directory dir;
+
+  ring source;
+  REQUIRE(
+      source.create(dir.path, "client", "port", ring_kind::midi1, ring_direction::source, 100)
+      == stdx::error{});
+  REQUIRE(source.header()->capacity == 4096);
+
+  auto rings = list_rings(dir.path, ring_kind::midi1, ring_direction::source);
+  REQUIRE(rings.size() == 1);
+  REQUIRE(rings[0].client_name == "client");
+  REQUIRE(rings[0].port_name == "port");
+  REQUIRE(list_rings(dir.path, ring_kind::ump, ring_direction::source).empty());
+  REQUIRE(list_rings(dir.path, ring_kind::midi1, ring_direction::sink).empty());
+
+  // Names are unique per directory
+  ring other;
+  REQUIRE(
+      other.create(dir.path, "client", "port", ring_kind::midi1, ring_direction::source, 100)
+      == std::errc::address_in_use);
+
+  // Writes without a reader are discarded
+  const uint8_t msg[3]{0x90, 0x40, 0x7F};
+  REQUIRE(source.write(1, msg) == stdx::error{});
+  REQUIRE(source.header()->write_index == 0);
+
+  ring sink;
+  REQUIRE(
+      sink.attach(rings[0].path, ring_kind::midi1, ring_direction::sink)
+      == std::errc::no_such_device);
+  REQUIRE(sink.attach(rings[0].path, ring_kind::midi1, ring_direction::source) == stdx::error{});
+  REQUIRE(!sink.is_producer());
+
+  // A single reader at a time
+  REQUIRE(
+      other.attach(rings[0].path, ring_kind::midi1, ring_direction::source)
+      == std::errc::device_or_resource_busy);
+
+  SECTION("full ring drops")
+  {
+    std::vector<uint8_t> big(1000, 0x12);
+    int written = 0;
+    while (source.write(written, big) == stdx::error{})
+      written++;
+    REQUIRE(written == 4096 / record_size(1000));
+    REQUIRE(source.write(0, big) == std::errc::no_buffer_space);
+    REQUIRE(source.header()->dropped == 2);
+    REQUIRE(source.write(0, std::vector<uint8_t>(4096)) == std::errc::message_size);
+
+    int read = 0;
+    sink.read([&](int64_t ts, std::span<const uint8_t> bytes) {
+      REQUIRE(ts == read++);
+      REQUIRE(bytes.size() == 1000);
+    });
+    REQUIRE(read == written);
+    REQUIRE(sink.empty());
+  }
+
+  SECTION("records wrap around")
+  {
+    int64_t next_write = 0, next_read = 0;
+    for (int round = 0; round < 1000; round++)
+    {
+      for (int i = 0; i < 7; i++)
+      {
+        std::vector<uint8_t> payload(1 + (next_write * 37) % 300, uint8_t(next_write));
+        REQUIRE(source.write(next_write, payload) == stdx::error{});
+        next_write++;
+      }
+      sink.read([&](int64_t ts, std::span<const uint8_t> bytes) {
+        REQUIRE(ts == next_read);
+        REQUIRE(bytes.size() == std::size_t(1 + (next_read * 37) % 300));
+        REQUIRE(bytes.back() == uint8_t(next_read));
+        next_read++;
+      });
+    }
+    REQUIRE(next_read == next_write);
+    REQUIRE(source.header()->dropped == 0);
+  }
+
+  SECTION("wrap right before the end")
+  {
+    // 8 bytes left at the end of the ring: too short for a wrap marker
+    auto* end = reinterpret_cast<uint8_t*>(source.header() + 1) + 4096;
+    std::fill(end - 8, end, 0);
+    source.header()->write_index = 4096 - 8;
+    source.header()->read_index = 4096 - 8;
+
+    REQUIRE(source.write(42, msg) == stdx::error{});
+    REQUIRE(source.header()->write_index == 4096 + record_size(sizeof(msg)));
+    REQUIRE(std::all_of(end - 8, end, [](uint8_t b) { return b == 0; }));
+
+    int read = 0;
+    sink.read([&](int64_t ts, std::span<const uint8_t> bytes) {
+      REQUIRE(ts == 42);
+      REQUIRE(bytes.size() == sizeof(msg));
+      read++;
+    });
+    REQUIRE(read == 1);
+    REQUIRE(sink.empty());
+  }
+
+  SECTION("corrupted ring")
+  {
+    auto& h = *source.header();
+    auto* data = reinterpret_cast<uint8_t*>(source.header() + 1);
+    auto read_all = [&] {
+      int read = 0;
+      sink.read([&](int64_t, std::span<const uint8_t>) { read++; });
+      return read;
+    };
+
+    // A record larger than what was written
+    REQUIRE(source.write(0, msg) == stdx::error{});
+    const uint32_t huge = 100'000;
+    std::memcpy(data, &huge, sizeof(huge));
+    REQUIRE(read_all() == 0);
+    REQUIRE(sink.empty());
+
+    // A write index further than the capacity, or behind the read index
+    h.write_index = h.read_index + (uint64_t(1) << 40);
+    REQUIRE(read_all() == 0);
+    REQUIRE(sink.empty());
+    h.write_index = h.read_index - 16;
+    REQUIRE(read_all() == 0);
+    REQUIRE(sink.empty());
+
+    // A changed capacity is not used
+    h.capacity = uint64_t(1) << 40;
+    REQUIRE(source.write(1, msg) == stdx::error{});
+    REQUIRE(read_all() == 1);
+  }
+
+  SECTION("closing the source")
+  {
+    source.close();
+    REQUIRE(sink.header()->closed);
+    REQUIRE(!std::filesystem::exists(rings[0].path));
+    REQUIRE(list_rings(dir.path, ring_kind::midi1, ring_direction::source).empty());
+  }
+
+  SECTION("ring left over by a dead process")
+  {
+    // The pid of a child which exited
+    const pid_t child = ::fork();
+    if (child == 0)
+      ::_exit(0);
+    REQUIRE(::waitpid(child, nullptr, 0) == child);
+
+    source.header()->creator_pid = child;
+    REQUIRE(list_rings(dir.path, ring_kind::midi1, ring_direction::source).empty());
+    REQUIRE(
+        other.create(dir.path, "client", "port", ring_kind::midi1, ring_direction::source, 100)
+        == stdx::error{});
+    REQUIRE(list_rings(dir.path, ring_kind::midi1, ring_direction::source).size() == 1);
+  }
+}
+
+TEST_CASE("shm midi1 loopback", "[shm]")
+{
+  scoped_directory dir;
+  received<std::vector<uint8_t>> r;
+
+  libremidi::midi_out out{
+      {}, libremidi::shm::output_configuration{.client_name = "out", .directory = dir.path}};
+  REQUIRE(out.get_current_api() == libremidi::API::SHARED_MEMORY);
+  REQUIRE(out.open_virtual_port("my port") == stdx::error{});
+
+  libremidi::observer obs{
+      {.track_virtual = true}, libremidi::shm::observer_configuration{.directory = dir.path}};
+  auto ports = obs.get_input_ports();
+  REQUIRE(ports.size() == 1);
+  REQUIRE(ports[0].api == libremidi::API::SHARED_MEMORY);
+  REQUIRE(ports[0].device_name == "out");
+  REQUIRE(ports[0].port_name == "my port");
+  REQUIRE(obs.get_output_ports().empty());
+
+  libremidi::midi_in in{
+      {.on_message = [&](libremidi::message&& m) { r.push({m.bytes.begin(), m.bytes.end()}); },
+       .ignore_sysex = false},
+      libremidi::shm::input_configuration{.directory = dir.path}};
+  REQUIRE(in.open_port(ports[0]) == stdx::error{});
+
+  std::vector<unsigned char> sysex(10000, 0x55);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+
+  const int count = 10000;
+  for (int i = 0; i < count; i++)
+  {
+    // The reader may fall behind: retry rather than drop
+    while (out.send_message(0x90, i % 128, 64) == std::errc::no_buffer_space)
+      std::this_thread::yield();
+  }
+  REQUIRE(out.send_message(sysex) == stdx::error{});
+
+  REQUIRE(r.wait_for(count + 1) == count + 1);
+  std::lock_guard lock{r.mtx};
+  for (int i = 0; i < count; i++)
+    REQUIRE(r.messages[i] == std::vector<uint8_t>{0x90, uint8_t(i % 128), 64});
+  REQUIRE(r.messages[count] == std::vector<uint8_t>(sysex.begin(), sysex.end()));
+}
+
+TEST_CASE("shm ump to a virtual input", "[shm]")
+{
+  scoped_directory dir;
+  received<libremidi::ump> r;
+
+  libremidi::midi_in in{
+      libremidi::ump_input_configuration{.on_message = [&](libremidi::ump&& m) { r.push(m); }},
+      libremidi::shm_ump::input_configuration{.directory = dir.path}};
+  REQUIRE(in.get_current_api() == libremidi::API::SHARED_MEMORY_UMP);
+  REQUIRE(in.open_virtual_port("in") == stdx::error{});
+
+  libremidi::observer obs{
+      {.track_virtual = true}, libremidi::shm_ump::observer_configuration{.directory = dir.path}};
+  auto ports = obs.get_output_ports();
+  REQUIRE(ports.size() == 1);
+
+  libremidi::midi_out out{
+      libremidi::output_configuration{.timestamps = libremidi::timestamp_mode::Absolute},
+      libremidi::shm_ump::output_configuration{.directory = dir.path}};
+  REQUIRE(out.open_port(ports[0]) == stdx::error{});
+
+  // Timestamps are carried as is
+  const auto cc = cmidi2_ump_midi2_cc(0, 0, 7, 42);
+  const uint32_t words[2]{uint32_t(cc >> 32), uint32_t(cc)};
+  REQUIRE(out.schedule_ump(123456789, words, 2) == stdx::error{});
+  REQUIRE(r.wait_for(1) == 1);
+  std::lock_guard lock{r.mtx};
+  REQUIRE(r.messages[0].data[1] == 42);
+  REQUIRE(r.messages[0].timestamp == 123456789);
+}
+
+TEST_CASE("shm observer notifications", "[shm]")
+{
+  scoped_directory dir;
+  received<std::string> added, removed;
+
+  libremidi::observer obs{
+      {.input_added = [&](const libremidi::input_port& p) { added.push(p.port_name); },
+       .input_removed = [&](const libremidi::input_port& p) { removed.push(p.port_name); },
+       .track_virtual = true},
+      libremidi::shm::observer_configuration{
+          .directory = dir.path, .poll_period = std::chrono::milliseconds(5)}};
+
+  {
+    libremidi::midi_out out{{}, libremidi::shm::output_configuration{.directory = dir.path}};
+    REQUIRE(out.open_virtual_port("transient") == stdx::error{});
+    REQUIRE(added.wait_for(1) == 1);
+  }
+  REQUIRE(removed.wait_for(1) == 1);
+  REQUIRE(added.messages[0] == "transient");
+  REQUIRE(removed.messages[0] == "transient");
+}
+
+TEST_CASE("shm between two processes", "[shm]")
+{
+  scoped_directory dir;
+  const int count = 1000;
+
+  // Forked before any thread is started
+  const pid_t child = ::fork();
+  REQUIRE(child >= 0);
+  if (child == 0)
+  {
+    // Waits for the input of the parent, then writes to it
+    libremidi::observer obs{
+        {.track_virtual = true}, libremidi::shm::observer_configuration{.directory = dir.path}};
+    std::vector<libremidi::output_port> ports;
+    for (int i = 0; i < 500 && ports.empty(); i++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      ports = obs.get_output_ports();
+    }
+    if (ports.empty())
+      ::_exit(1);
+
+    libremidi::midi_out out{{}, libremidi::shm::output_configuration{.directory = dir.path}};
+    if (out.open_port(ports[0]) != stdx::error{})
+      ::_exit(2);
+    for (int i = 0; i < count; i++)
+      while (out.send_message(0xB0, 1, i % 128) != stdx::error{})
+        std::this_thread::yield();
+    ::_exit(0);
+  }
+
+  received<std::vector<uint8_t>> r;
+  libremidi::midi_in in{
+      {.on_message = [&](libremidi::message&& m) { r.push({m.bytes.begin(), m.bytes.end()}); }},
+      libremidi::shm::input_configuration{.client_name = "parent", .directory = dir.path}};
+  REQUIRE(in.open_virtual_port("parent in") == stdx::error{});
+
+  int status = -1;
+  REQUIRE(::waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  REQUIRE(r.wait_for(count) == count);
+  std::lock_guard lock{r.mtx};
+  for (int i = 0; i < count; i++)
+    REQUIRE(r.messages[i] == std::vector<uint8_t>{0xB0, 1, uint8_t(i % 128)});
+}
@@ -0,0 +1,71 @@
+#include "../include_catch.hpp"
+
+#include <libremidi/backends/linux/thread.hpp>
+
+#include <pthread.h>
+
+#include <thread>
+
+TEST_CASE("thread configuration", "[thread_configuration]")
+{
+  SECTION("default configuration changes nothing")
+  {
+    std::thread{[] {
+      auto report = libremidi::apply_thread_configuration({});
+      REQUIRE(report.error == stdx::error{});
+      REQUIRE(report.policy == libremidi::thread_policy::Default);
+      REQUIRE_FALSE(report.affinity_applied);
+      REQUIRE_FALSE(report.name_applied);
+      REQUIRE_FALSE(report.memory_locked);
+    }}.join();
+  }
+
+  SECTION("name, affinity and stack")
+  {
+    std::thread{[] {
+      bool called = false;
+      auto report = libremidi::apply_thread_configuration(
+          {.cpu_affinity = {0},
+           .stack_prefault = 64 * 1024,
+           .name = "libremidi-input-thread",
+           .on_started = [&](const libremidi::thread_report&) { called = true; }});
+      REQUIRE(called);
+      REQUIRE(report.name_applied);
+      REQUIRE(report.affinity_applied);
+
+      char name[16]{};
+      pthread_getname_np(pthread_self(), name, sizeof(name));
+      REQUIRE(std::string_view{name} == "libremidi-input");
+
+      cpu_set_t set;
+      pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+      REQUIRE(CPU_COUNT(&set) == 1);
+      REQUIRE(CPU_ISSET(0, &set));
+    }}.join();
+  }
+
+  SECTION("real-time scheduling is reported as achieved")
+  {
+    std::thread{[] {
+      auto report = libremidi::apply_thread_configuration(
+          {.policy = libremidi::thread_policy::Fifo, .priority = 10});
+
+      int policy{};
+      sched_param param{};
+      pthread_getschedparam(pthread_self(), &policy, &param);
+      REQUIRE(report.priority == param.sched_priority);
+
+      // Without the privileges, the thread keeps running with the default policy
+      if (report.error == stdx::error{})
+      {
+        REQUIRE(policy == SCHED_FIFO);
+        REQUIRE(report.policy == libremidi::thread_policy::Fifo);
+      }
+      else
+      {
+        REQUIRE(policy == SCHED_OTHER);
+        REQUIRE(report.policy == libremidi::thread_policy::Default);
+      }
+    }}.join();
+  }
+}